@@ -0,0 +1,253 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "string.h"
+#include "list.h"
+#include "lexer.h"
+#include "parser.h"
+#include "transform.h"
+
+// Terms of large input, which doesn't fit scratch region
+#define ALLOC_LARGE_TERMS 2000
+
+// Short inputs, same as typical requests
+static const char* const INPUTS[] = {
+	"a + b",
+	"2 * x + 3 * x - 1",
+	"(a - b) * (a + b)",
+	"a ^ 2 - b ^ 2",
+	"(x ^ 2 - y ^ 2) ^ 2 - (z ^ 2 - w ^ 2) ^ 2",
+	"1 / (x + 1) + 2 / (x - 1) - -3",
+	"((a_0 - 50) ^ 2 - eps ^ 2) * (alpha + beta / gamma) ^ 3",
+	"-(-(x)) * 0.5 + 1.25 * y ^ 0.5 - z / 4",
+	"a * b * c * d + a * b * c - a * b + a - (b - (c - (d - (e - f))))",
+};
+#define INPUTS_COUNT (sizeof(INPUTS) / sizeof(INPUTS[0]))
+
+typedef enum mode {
+	Mode_Simplify,
+	Mode_Expand,
+	Mode__count,
+} Mode;
+
+// Request of another thread, which also destroys expression and tokens
+// scanned by the main one, so that its blocks are freed remotely
+typedef struct remote_request {
+	List tokens;
+	Expression* expression;
+	FILE* output;
+	size_t allocations; // @NOTE: Heap allocations of the thread
+	bool result;
+} RemoteRequest;
+
+// @NOTE: Calls of our code are redirected here by the linker, calls inside
+// of C library are not counted
+extern void* __real_malloc(size_t size);
+extern void* __real_calloc(size_t count, size_t size);
+extern void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* pointer, size_t size);
+
+static size_t allocations = 0;
+
+// Scan, parse, transform and print text, same as expr does for an
+// argument, return false if it isn't an expression
+static bool run_request(const char* const text, const Mode mode, FILE* const output);
+
+// Run remote request, which is passed as argument
+static void* run_remote(void* const argument);
+
+// Parse input on the main thread, then release it and run request on
+// another one, return false if it fails
+static bool run_remote_request(const char* const text,
+                               FILE* const output,
+                               size_t* const allocations);
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	static char buffer[BUFSIZ];
+
+	FILE* const output = fopen("/dev/null", "w");
+	if (output == NULL) {
+		LOG("Failed to open /dev/null\n");
+		return EXIT_FAILURE;
+	}
+
+	setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+
+	// @NOTE: Large input falls back to the heap, it's only checked to
+	// succeed and to leave scratch region usable for the next requests
+	char* const large = __real_malloc(ALLOC_LARGE_TERMS * 16);
+	if (large == NULL) {
+		LOG("Out of memory\n");
+		fclose(output);
+		return EXIT_FAILURE;
+	}
+
+	size_t length = 0;
+	for (size_t i = 0; i < ALLOC_LARGE_TERMS; ++i)
+		length += sprintf(large + length, "%sx%zu * %zu", i > 0 ? " + " : "", i % 10, i);
+
+	size_t requests = 0;
+	size_t heap = 0;
+
+	for (size_t round = 0; round < 2; ++round) {
+		for (Mode mode = Mode_Simplify; mode < Mode__count; ++mode) {
+			for (size_t i = 0; i < INPUTS_COUNT; ++i) {
+				const size_t before = allocations;
+
+				if (!run_request(INPUTS[i], mode, output)) {
+					LOGF("Failed to parse %s\n", INPUTS[i]);
+					result = EXIT_FAILURE;
+				}
+
+				if (allocations != before)
+					printf("%s: %zu heap allocations\n", INPUTS[i], allocations - before);
+
+				heap += allocations - before;
+				++requests;
+			}
+		}
+
+		if (!run_request(large, Mode_Simplify, output)) {
+			LOG("Failed to parse large input\n");
+			result = EXIT_FAILURE;
+		}
+
+		// @NOTE: Region belongs to the main thread, so the other one
+		// allocates on the heap, and large input filling region, which it
+		// frees, must be returned to it for the second round not to allocate
+		if (round == 0) {
+			size_t remote = 0;
+
+			if (!run_remote_request(large, output, &remote)) {
+				LOG("Failed to run request on another thread\n");
+				result = EXIT_FAILURE;
+			}
+
+			printf("another thread: %zu heap allocations\n", remote);
+
+			if (remote == 0)
+				result = EXIT_FAILURE;
+		}
+	}
+
+	printf("%zu requests, %zu heap allocations\n", requests, heap);
+
+	if (heap > 0)
+		result = EXIT_FAILURE;
+
+	free(large);
+	fclose(output);
+
+	return result;
+}
+
+static bool run_request(const char* const text, const Mode mode, FILE* const output)
+{
+	const String input = string_init(text);
+
+	List tokens = lexical_scan(&input);
+
+	SyntaxErrors errors;
+	Expression* expression = expression_parse_checked(&tokens, &errors);
+
+	if (expression == NULL) {
+		list_deinit(&tokens);
+		return false;
+	}
+
+	switch (mode) {
+	case Mode_Simplify:
+		simplify_expression(&expression);
+		break;
+
+	case Mode_Expand:
+		expand_expression(&expression);
+		break;
+	}
+
+	expression_write(expression, output);
+	putc('\n', output);
+
+	expression_destroy(&expression);
+	list_deinit(&tokens);
+
+	return true;
+}
+
+static void* run_remote(void* const argument)
+{
+	RemoteRequest* const request = argument;
+
+	const size_t before = allocations;
+
+	expression_destroy(&request->expression);
+	list_deinit(&request->tokens);
+
+	request->result = run_request(INPUTS[0], Mode_Expand, request->output);
+	request->allocations = allocations - before;
+
+	return NULL;
+}
+
+static bool run_remote_request(const char* const text,
+                               FILE* const output,
+                               size_t* const allocations)
+{
+	const String input = string_init(text);
+
+	List tokens = lexical_scan(&input);
+
+	SyntaxErrors errors;
+	Expression* const expression = expression_parse_checked(&tokens, &errors);
+
+	if (expression == NULL) {
+		list_deinit(&tokens);
+		return false;
+	}
+
+	RemoteRequest request = {tokens, expression, output, 0, false};
+
+	// @NOTE: Counter of allocations is not shared meanwhile, as the main
+	// thread waits for the other one
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, run_remote, &request) != 0) {
+		expression_destroy(&request.expression);
+		list_deinit(&request.tokens);
+		return false;
+	}
+
+	pthread_join(thread, NULL);
+
+	*allocations = request.allocations;
+
+	return request.result;
+}
+
+void* __wrap_malloc(size_t size)
+{
+	++allocations;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	++allocations;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+	++allocations;
+	return __real_realloc(pointer, size);
+}
@@ -0,0 +1,183 @@
+#!/bin/sh
+readonly tmpdir="$(mktemp -d -q)"
+readonly runs=5
+
+# @NOTE: Build program first
+make -j >/dev/null
+
+# Print best wall time of a command out of several runs
+measure() {
+	name="$1"
+	shift
+
+	best=
+	for run in $(seq ${runs}); do
+		start=$(date +%s%N)
+		"$@" >/dev/null 2>&1
+		end=$(date +%s%N)
+
+		time=$(((end - start) / 1000))
+		if [ -z "${best}" ] || [ ${time} -lt ${best} ]; then
+			best=${time}
+		fi
+	done; unset run
+
+	printf "%-48s %10d us\n" "${name}" ${best}
+}
+
+# Integer-heavy input: 2000 parenthesised groups of 50 integer terms
+awk 'BEGIN {
+	srand(1);
+	for (i = 0; i < 2000; ++i) {
+		if (i > 0)
+			printf(" + ");
+		printf("(");
+		for (j = 0; j < 50; ++j) {
+			if (j > 0)
+				printf(j % 3 == 0 ? " - " : (j % 3 == 1 ? " + " : " * "));
+			printf("%d", int(rand() * 100) + 1);
+		}
+		printf(")");
+	}
+	printf("\n");
+}' >${tmpdir}/integers
+
+measure "eval integers, double" ./expr -f ${tmpdir}/integers eval
+measure "eval integers, exact" ./expr -x -f ${tmpdir}/integers eval
+
+# Bindings input: 10000 lines binding x and y
+awk 'BEGIN {
+	for (i = 0; i < 10000; ++i)
+		printf("x=%d y=%d.5\n", i, i % 100);
+}' >${tmpdir}/bindings
+
+measure "eval 10000 bindings, compiled" \
+	./expr -b ${tmpdir}/bindings eval "(x + y) ^ 3 - 2 * x * y / (x + 1)"
+
+# Polynomial input: 200 terms of shapes fused by the threaded evaluator
+awk 'BEGIN {
+	srand(2);
+	for (i = 0; i < 200; ++i) {
+		if (i > 0)
+			printf(i % 2 == 0 ? " + " : " - ");
+		k = int(rand() * 4);
+		c = int(rand() * 9) + 1;
+		if (k == 0)
+			printf("%d * x * y", c);
+		else if (k == 1)
+			printf("(x - %d) ^ 2", c);
+		else if (k == 2)
+			printf("y / (x + %d)", c);
+		else
+			printf("x * y ^ 3 / %d", c);
+	}
+	printf("\n");
+}' >${tmpdir}/terms
+
+measure "eval 10000 bindings of 200 terms, switch" \
+	./expr --switch-dispatch -b ${tmpdir}/bindings -f ${tmpdir}/terms eval
+measure "eval 10000 bindings of 200 terms, threaded" \
+	./expr -b ${tmpdir}/bindings -f ${tmpdir}/terms eval
+
+# @NOTE: Expression is compiled by the first run, the rest load it
+export EXPR_CACHE=${tmpdir}/cache
+
+measure "eval 10000 bindings of 200 terms, native" \
+	./expr -b ${tmpdir}/bindings -f ${tmpdir}/terms compile
+
+measure "eval 10000 bindings with gradient" \
+	./expr -b ${tmpdir}/bindings --grad eval "(x + y) ^ 3 - 2 * x * y / (x + 1)"
+
+measure "bounds with 100000 bisection evaluations" \
+	./expr -r 100000 -D x=-1:1 -D y=0:2 bounds "(x + y) ^ 3 - 2 * x * y / (x + 2)"
+
+measure "simplify short expression" ./expr simplify "(a - b * c) * (a + b * c)"
+measure "normalize (a+b+c)^20" ./expr normalize "(a + b + c) ^ 20"
+measure "normalize (a+b+c+d+e)^12" ./expr normalize "(a + b + c + d + e) ^ 12"
+measure "normalize product of 8 binomials" \
+	./expr normalize "(a+b)*(a+c)*(a+d)*(a+e)*(b+c)*(b+d)*(b+e)*(c+d)"
+measure "factor (a-b)^3*(a+b)^2*(a^2+b^2)" \
+	./expr factor "(a-b)^3*(a+b)^2*(a^2+b^2)"
+
+measure "fuzz 2000 cases" ./fuzz -n 2000
+
+# Sum input: 100000 monomials over 100 variables, most of them alike
+awk 'BEGIN {
+	srand(3);
+	for (i = 0; i < 100000; ++i) {
+		if (i > 0)
+			printf(i % 3 == 0 ? " - " : " + ");
+		printf("%d * x%d * x%d ^ 2", int(rand() * 9) + 1,
+			int(rand() * 100), int(rand() * 100));
+	}
+	printf("\n");
+}' >${tmpdir}/sum
+
+measure "collect 100000 like terms" ./expr -f ${tmpdir}/sum collect
+measure "simplify 100000 terms, balanced" ./expr -f ${tmpdir}/sum simplify
+
+# Large input: 200000 terms of x and y, about a million nodes, evaluated
+# once per line of 20 bindings
+awk 'BEGIN {
+	srand(4);
+	for (i = 0; i < 200000; ++i) {
+		if (i > 0)
+			printf(i % 2 == 0 ? " + " : " - ");
+		printf("%d * x * y ^ 2 / (x + %d)", int(rand() * 9) + 1, int(rand() * 9) + 1);
+	}
+	printf("\n");
+}' >${tmpdir}/large
+
+head -n 20 ${tmpdir}/bindings >${tmpdir}/bindings-20
+
+# @NOTE: Parallel runs take 2 threads at least, so that tasks are split and
+# stolen even on one processor
+threads=$(nproc)
+if [ ${threads} -lt 2 ]; then
+	threads=2
+fi
+
+# Print tasks split by parallel run of a command, reported last by -v
+report() {
+	name="$1"
+	shift
+
+	printf "%-48s %s\n" "${name}" "$("$@" 2>&1 >/dev/null | tail -n 1)"
+}
+
+measure "eval 20 bindings of 1M nodes, 1 thread" \
+	./expr -j 1 -b ${tmpdir}/bindings-20 -f ${tmpdir}/large eval
+measure "eval 20 bindings of 1M nodes, ${threads} threads" \
+	./expr -j ${threads} -b ${tmpdir}/bindings-20 -f ${tmpdir}/large eval
+report "eval 20 bindings of 1M nodes, split" \
+	./expr -v -j ${threads} -b ${tmpdir}/bindings-20 -f ${tmpdir}/large eval
+measure "expand 1M nodes, 1 thread" ./expr -j 1 -f ${tmpdir}/large expand
+measure "expand 1M nodes, ${threads} threads" ./expr -j ${threads} -f ${tmpdir}/large expand
+report "expand 1M nodes, split" ./expr -v -j ${threads} -f ${tmpdir}/large expand
+
+# @NOTE: Piped input is scanned as it arrives, chunk by chunk
+measure "simplify 1M nodes from pipe" \
+	sh -c "cat ${tmpdir}/large | ./expr -j 1 simplify"
+
+# Gradient input: 2000 products of powers of 100 variables
+awk 'BEGIN {
+	srand(2);
+	for (i = 0; i < 2000; ++i) {
+		if (i > 0)
+			printf(" + ");
+		printf("%d * x%d ^ %d * x%d / (x%d + 1)", int(rand() * 100) + 1,
+			int(rand() * 100), int(rand() * 5) + 1, int(rand() * 100),
+			int(rand() * 100));
+	}
+	printf("\n");
+}' >${tmpdir}/gradient
+
+variables=x0
+for i in $(seq 99); do
+	variables="${variables},x${i}"
+done; unset i
+
+measure "diff gradient of 100 variables" \
+	./expr -f ${tmpdir}/gradient diff ${variables}
+
+rm -r ${tmpdir}
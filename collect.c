@@ -0,0 +1,602 @@
+#include "collect.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "rational.h"
+#include "symbol.h"
+
+#define GROUP_NONE SIZE_MAX
+
+// Term of sum with the sign it has in sum
+typedef struct summand {
+	Expression* expression;
+	bool negative;
+} Summand;
+
+// Symbol of monomial raised to power, symbol is its identifier
+typedef struct monomial_factor {
+	uint32_t symbol;
+	uint32_t exponent;
+} MonomialFactor;
+
+typedef struct collect_term {
+	Summand summand;
+	size_t factors; // @NOTE: Offset of monomial in factors of collector
+	size_t length;
+	size_t group;   // GROUP_NONE if term is not a monomial
+} CollectTerm;
+
+// Like terms, coefficient is the sum of their signed coefficients
+typedef struct collect_group {
+	size_t first; // Index of the first term of group
+	size_t count;
+	uint64_t hash;
+	Rational coefficient;
+} CollectGroup;
+
+typedef struct collector {
+	SymbolTable symbols;
+	CollectTerm* terms;
+	size_t count;
+	size_t capacity;
+	// Monomials of all terms, factors of each one are sorted by symbol and
+	// have distinct symbols and nonzero exponents
+	MonomialFactor* factors;
+	size_t factors_length;
+	size_t factors_capacity;
+	CollectGroup* groups;
+	size_t group_count;
+	size_t* buckets; // @NOTE: Open addressing, group + 1 or 0 if empty
+	size_t bucket_count;
+} Collector;
+
+#define Collector() (Collector){SymbolTable(), NULL, 0, 0, NULL, 0, 0, NULL, 0, NULL, 0}
+
+static void collector_deinit(Collector* const collector);
+
+// Flatten sum into terms of collector in order
+static bool collect_terms(Collector* const collector, Expression* const expression);
+
+// Group monomial terms by their monomials
+static bool collect_groups(Collector* const collector);
+
+// Append factors of monomial term and multiply coefficient by its number
+// factors, return false if term is not a monomial
+static bool term_monomial(Collector* const collector,
+                          const Expression* const expression,
+                          Rational* const coefficient);
+static bool monomial_append(Collector* const collector,
+                            const String* const symbol,
+                            const uint32_t exponent);
+
+// Sort factors of monomial starting at offset, merging powers of the same
+// symbol; return false if an exponent overflows
+static bool monomial_canonical(Collector* const collector, const size_t offset);
+
+static uint64_t monomial_hash(const MonomialFactor* const factors, const size_t length);
+
+// Find group of term's monomial or add a new one
+static CollectGroup* collector_group(Collector* const collector, const size_t term);
+
+// Build term of group with absolute value of its coefficient, or with the
+// coefficient itself if negative is set
+static Expression* group_to_expression(const Collector* const collector,
+                                       const CollectGroup* const group,
+                                       const bool negative);
+
+// Build sum of summands [begin, end) as a balanced tree, which takes their
+// expressions; negative is set if tree is the sum negated
+static Expression* sum_build(Summand* const summands,
+                             const size_t begin,
+                             const size_t end,
+                             bool* const negative);
+
+static bool expression_sum(const Expression* const expression);
+
+Expression* collect_like_terms(Expression* const expression)
+{
+	assert(expression != NULL);
+
+	Collector collector = Collector();
+	Summand* summands = NULL;
+	size_t length = 0;
+	Expression* result = NULL;
+	bool changed = false;
+	bool negative = false;
+
+	if (!collect_terms(&collector, expression) || !collect_groups(&collector))
+		goto cleanup;
+
+	// @NOTE: Sum is kept as it is unless a term is merged or dropped
+	for (size_t i = 0; i < collector.group_count; ++i) {
+		const CollectGroup* const group = &collector.groups[i];
+
+		if (!rational_exact(group->coefficient) || group->coefficient.numerator == INT64_MIN)
+			goto cleanup;
+
+		changed |= group->count > 1 || group->coefficient.numerator == 0;
+	}
+
+	if (!changed)
+		goto cleanup;
+
+	summands = malloc(collector.count * sizeof(Summand));
+	if (summands == NULL)
+		goto cleanup;
+
+	for (size_t i = 0; i < collector.count; ++i) {
+		const CollectTerm* const term = &collector.terms[i];
+		const CollectGroup* const group = term->group != GROUP_NONE
+			? &collector.groups[term->group]
+			: NULL;
+
+		if (group != NULL && (group->first != i || group->coefficient.numerator == 0))
+			continue;
+
+		// @NOTE: Terms which were not merged are shared as they are
+		if (group == NULL || group->count == 1) {
+			summands[length++] = (Summand){
+				expression_retain(term->summand.expression), term->summand.negative
+			};
+			continue;
+		}
+
+		// @NOTE: Sign of the first term is kept in its coefficient
+		const bool first = length == 0;
+		negative = group->coefficient.numerator < 0;
+
+		Expression* const merged = group_to_expression(&collector, group, negative && first);
+		if (merged == NULL)
+			goto cleanup;
+
+		summands[length++] = (Summand){merged, negative && !first};
+	}
+
+	if (length == 0) {
+		result = (Expression*)expression_literal_create_rational(rational_integer(0));
+		goto cleanup;
+	}
+
+	result = sum_build(summands, 0, length, &negative);
+	length = 0;
+
+	assert(!negative);
+
+	// @NOTE: Sum of one term which was not merged is the term itself
+	if (result != NULL && !expression_unshare(&result))
+		expression_destroy(&result);
+
+cleanup:
+	for (size_t i = 0; i < length; ++i)
+		expression_destroy(&summands[i].expression);
+
+	free(summands);
+	collector_deinit(&collector);
+
+	return result;
+}
+
+static void collector_deinit(Collector* const collector)
+{
+	assert(collector != NULL);
+
+	symbol_table_deinit(&collector->symbols);
+	free(collector->terms);
+	free(collector->factors);
+	free(collector->groups);
+	free(collector->buckets);
+
+	*collector = Collector();
+}
+
+// @NOTE: Sums of thousands of terms are chains of as many nodes, so they
+// are walked with a stack of pending operands instead of recursion
+static bool collect_terms(Collector* const collector, Expression* const expression)
+{
+	assert(collector != NULL);
+	assert(expression != NULL);
+
+	Summand* stack = NULL;
+	size_t depth = 0;
+	size_t capacity = 0;
+
+	bool result = array_reserve((void**)&stack, &capacity, 1, sizeof(Summand));
+	if (result)
+		stack[depth++] = (Summand){expression, false};
+
+	while (result && depth > 0) {
+		const Summand summand = stack[--depth];
+		Expression* const operand = summand.expression;
+
+		if (expression_sum(operand)) {
+			const BinaryExpression* const binary = (BinaryExpression*)operand;
+
+			// @NOTE: Right operand is pushed first to come out second
+			result = array_reserve((void**)&stack, &capacity, depth + 2, sizeof(Summand));
+			if (result) {
+				stack[depth++] = (Summand){
+					binary->right, summand.negative != (binary->operator == TokenType_Minus)
+				};
+				stack[depth++] = (Summand){binary->left, summand.negative};
+			}
+
+			continue;
+		}
+
+		if (operand->type == ExpressionType_Unary &&
+		    expression_sum(((UnaryExpression*)operand)->subexpression)) {
+			const UnaryExpression* const unary = (UnaryExpression*)operand;
+
+			stack[depth++] = (Summand){
+				unary->subexpression, summand.negative != (unary->operator == TokenType_Minus)
+			};
+
+			continue;
+		}
+
+		result = array_reserve((void**)&collector->terms, &collector->capacity,
+		                 collector->count + 1, sizeof(CollectTerm));
+		if (result)
+			collector->terms[collector->count++] = (CollectTerm){summand, 0, 0, GROUP_NONE};
+	}
+
+	free(stack);
+
+	return result;
+}
+
+static bool collect_groups(Collector* const collector)
+{
+	assert(collector != NULL);
+
+	// @NOTE: Groups are at most as many as terms, so load factor of buckets
+	// is kept at most 1/2 without growing them
+	size_t bucket_count = 16;
+	while (bucket_count < 2 * collector->count)
+		bucket_count *= 2;
+
+	collector->groups = malloc(collector->count * sizeof(CollectGroup));
+	collector->buckets = calloc(bucket_count, sizeof(size_t));
+	collector->bucket_count = bucket_count;
+
+	if (collector->groups == NULL || collector->buckets == NULL)
+		return false;
+
+	for (size_t i = 0; i < collector->count; ++i) {
+		CollectTerm* const term = &collector->terms[i];
+
+		const size_t offset = collector->factors_length;
+		Rational coefficient = rational_integer(term->summand.negative ? -1 : 1);
+
+		if (!term_monomial(collector, term->summand.expression, &coefficient) ||
+		    !monomial_canonical(collector, offset)) {
+			// @NOTE: Symbols interned for the term are kept, they are unused
+			collector->factors_length = offset;
+			continue;
+		}
+
+		term->factors = offset;
+		term->length = collector->factors_length - offset;
+
+		CollectGroup* const group = collector_group(collector, i);
+
+		term->group = (size_t)(group - collector->groups);
+		group->coefficient = rational_add(group->coefficient, coefficient);
+	}
+
+	// @NOTE: Symbol table fails only if memory is exhausted, then terms are
+	// not monomials and nothing is collected
+	return true;
+}
+
+static bool term_monomial(Collector* const collector,
+                          const Expression* const expression,
+                          Rational* const coefficient)
+{
+	assert(collector != NULL);
+	assert(expression != NULL);
+	assert(coefficient != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Symbol)
+			return monomial_append(collector, &literal->symbol, 1);
+
+		*coefficient = rational_multiply(*coefficient, literal->rational);
+		return rational_exact(*coefficient);
+	}
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		if (!term_monomial(collector, unary->subexpression, coefficient))
+			return false;
+
+		if (unary->operator == TokenType_Minus)
+			*coefficient = rational_negate(*coefficient);
+
+		return true;
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		const Literal* const right = binary->right->type == ExpressionType_Literal
+			? (Literal*)binary->right
+			: NULL;
+
+		switch (binary->operator) {
+		case TokenType_Multiply:
+			return term_monomial(collector, binary->left, coefficient) &&
+			       term_monomial(collector, binary->right, coefficient);
+
+		// Division by nonzero number only
+		case TokenType_Divide:
+			if (right == NULL || right->tag != LiteralTag_Number ||
+			    right->rational.numerator == 0 ||
+			    !term_monomial(collector, binary->left, coefficient)) {
+				return false;
+			}
+
+			*coefficient = rational_divide(*coefficient, right->rational);
+			return rational_exact(*coefficient);
+
+		// Symbol raised to nonnegative integer power only
+		case TokenType_Exponent: {
+			const Literal* const base = binary->left->type == ExpressionType_Literal
+				? (Literal*)binary->left
+				: NULL;
+
+			if (base == NULL || base->tag != LiteralTag_Symbol ||
+			    right == NULL || right->tag != LiteralTag_Number ||
+			    !rational_integral(right->rational) ||
+			    right->rational.numerator < 0 ||
+			    right->rational.numerator > UINT32_MAX) {
+				return false;
+			}
+
+			return monomial_append(collector, &base->symbol, (uint32_t)right->rational.numerator);
+		}
+		}
+	} break;
+	}
+
+	return false;
+}
+
+static bool monomial_append(Collector* const collector,
+                            const String* const symbol,
+                            const uint32_t exponent)
+{
+	assert(collector != NULL);
+	assert(symbol != NULL);
+
+	const size_t id = symbol_table_intern(&collector->symbols, symbol);
+
+	if (id == SYMBOL_NONE || id > UINT32_MAX ||
+	    !array_reserve((void**)&collector->factors, &collector->factors_capacity,
+	             collector->factors_length + 1, sizeof(MonomialFactor))) {
+		return false;
+	}
+
+	collector->factors[collector->factors_length++] = (MonomialFactor){(uint32_t)id, exponent};
+
+	return true;
+}
+
+// @NOTE: Monomials of terms have few factors, so they are sorted by insertion
+static bool monomial_canonical(Collector* const collector, const size_t offset)
+{
+	assert(collector != NULL);
+	assert(offset <= collector->factors_length);
+
+	MonomialFactor* const factors = collector->factors + offset;
+	const size_t length = collector->factors_length - offset;
+
+	for (size_t i = 1; i < length; ++i) {
+		const MonomialFactor factor = factors[i];
+
+		size_t j = i;
+		for (; j > 0 && factors[j - 1].symbol > factor.symbol; --j)
+			factors[j] = factors[j - 1];
+
+		factors[j] = factor;
+	}
+
+	size_t merged = 0;
+
+	for (size_t i = 0; i < length; ++i) {
+		if (merged > 0 && factors[merged - 1].symbol == factors[i].symbol) {
+			if (factors[merged - 1].exponent > UINT32_MAX - factors[i].exponent)
+				return false;
+
+			factors[merged - 1].exponent += factors[i].exponent;
+		}
+		else
+			factors[merged++] = factors[i];
+	}
+
+	// @NOTE: Symbols raised to zero power are dropped
+	size_t result = 0;
+
+	for (size_t i = 0; i < merged; ++i) {
+		if (factors[i].exponent != 0)
+			factors[result++] = factors[i];
+	}
+
+	collector->factors_length = offset + result;
+
+	return true;
+}
+
+// @NOTE: Factors have no padding, so their bytes are their fields
+static uint64_t monomial_hash(const MonomialFactor* const factors, const size_t length)
+{
+	assert(factors != NULL || length == 0);
+
+	return hash_bytes(FNV_OFFSET_BASIS, factors, length * sizeof(MonomialFactor));
+}
+
+static CollectGroup* collector_group(Collector* const collector, const size_t term)
+{
+	assert(collector != NULL);
+	assert(term < collector->count);
+
+	const CollectTerm* const it = &collector->terms[term];
+	const MonomialFactor* const factors = collector->factors + it->factors;
+	const uint64_t hash = monomial_hash(factors, it->length);
+
+	const size_t mask = collector->bucket_count - 1;
+	size_t index = hash & mask;
+
+	for (; collector->buckets[index] != 0; index = (index + 1) & mask) {
+		CollectGroup* const group = &collector->groups[collector->buckets[index] - 1];
+		const CollectTerm* const first = &collector->terms[group->first];
+
+		if (group->hash == hash && first->length == it->length &&
+		    memcmp(collector->factors + first->factors, factors,
+		           it->length * sizeof(MonomialFactor)) == 0) {
+			++group->count;
+			return group;
+		}
+	}
+
+	CollectGroup* const group = &collector->groups[collector->group_count++];
+	*group = (CollectGroup){term, 1, hash, rational_integer(0)};
+
+	collector->buckets[index] = collector->group_count;
+
+	return group;
+}
+
+// @NOTE: Built as terms of polynomial_to_expression, so that collected sums
+// print as normalized ones
+static Expression* group_to_expression(const Collector* const collector,
+                                       const CollectGroup* const group,
+                                       const bool negative)
+{
+	assert(collector != NULL);
+	assert(group != NULL);
+
+	const CollectTerm* const term = &collector->terms[group->first];
+	const MonomialFactor* const factors = collector->factors + term->factors;
+
+	const Rational coefficient = group->coefficient;
+	const int64_t numerator = coefficient.numerator < 0 ? -coefficient.numerator
+	                                                    : coefficient.numerator;
+
+	Expression* result = NULL;
+
+	if (numerator != 1 || term->length == 0) {
+		result = (Expression*)expression_literal_create_rational(
+			rational_integer(negative ? -numerator : numerator));
+		if (result == NULL)
+			return NULL;
+	}
+
+	for (size_t i = 0; i < term->length; ++i) {
+		String symbol = *symbol_table_name(&collector->symbols, factors[i].symbol);
+
+		Expression* factor = (Expression*)expression_literal_create_symbol(&symbol);
+
+		if (factor != NULL && factors[i].exponent > 1) {
+			factor = expression_binary_join(
+				TokenType_Exponent,
+				factor,
+				(Expression*)expression_literal_create_rational(rational_integer(factors[i].exponent)));
+		}
+
+		// @NOTE: Sign of unit coefficient goes to the first factor
+		if (result == NULL) {
+			if (factor != NULL && negative) {
+				Expression* const unary = (Expression*)expression_unary_create(TokenType_Minus, factor);
+				if (unary == NULL)
+					expression_destroy(&factor);
+
+				factor = unary;
+			}
+
+			result = factor;
+
+			if (result == NULL)
+				return NULL;
+
+			continue;
+		}
+
+		result = expression_binary_join(TokenType_Multiply, result, factor);
+		if (result == NULL)
+			return NULL;
+	}
+
+	if (coefficient.denominator != 1) {
+		result = expression_binary_join(
+			TokenType_Divide,
+			result,
+			(Expression*)expression_literal_create_rational(rational_integer(coefficient.denominator)));
+	}
+
+	return result;
+}
+
+// @NOTE: Left half takes the middle summand, so sums of three print without
+// parentheses. Sign of the right half is taken by the operator joining it;
+// the first summand has no operator and is negated by unary minus.
+static Expression* sum_build(Summand* const summands,
+                             const size_t begin,
+                             const size_t end,
+                             bool* const negative)
+{
+	assert(summands != NULL);
+	assert(begin < end);
+	assert(negative != NULL);
+
+	if (end - begin == 1) {
+		Expression* term = summands[begin].expression;
+		*negative = summands[begin].negative;
+
+		if (begin > 0 || !*negative)
+			return term;
+
+		*negative = false;
+
+		Expression* const unary = (Expression*)expression_unary_create(TokenType_Minus, term);
+		if (unary == NULL)
+			expression_destroy(&term);
+
+		return unary;
+	}
+
+	const size_t middle = begin + (end - begin + 1) / 2;
+
+	bool left_negative = false;
+	bool right_negative = false;
+
+	Expression* const left = sum_build(summands, begin, middle, &left_negative);
+	Expression* const right = sum_build(summands, middle, end, &right_negative);
+
+	*negative = left_negative;
+
+	return expression_binary_join(left_negative == right_negative ? TokenType_Plus
+	                                                              : TokenType_Minus,
+	                              left,
+	                              right);
+}
+
+static bool expression_sum(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Binary)
+		return false;
+
+	const TokenType operator = ((BinaryExpression*)expression)->operator;
+
+	return operator == TokenType_Plus || operator == TokenType_Minus;
+}
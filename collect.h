@@ -0,0 +1,21 @@
+#ifndef __COLLECT_H__
+#define __COLLECT_H__
+
+#include <stdbool.h>
+
+#include "parser.h"
+
+// Collect like terms of sum, which is a chain of + and - operators, nested
+// sums and negated sums included. Terms are monomials, products of exact
+// numbers and symbols raised to nonnegative integer powers, which are
+// grouped by their symbols and exponents and have their coefficients
+// summed; other terms are kept as they are. Terms are grouped by a hash
+// map, so sum of n terms is collected in expected O(n) time.
+//
+// Returns balanced sum of groups in order of their first terms, which is
+// a new node sharing terms which were not merged, or NULL if there are no
+// like terms or zero terms in sum, if a coefficient overflows or memory is
+// exhausted.
+extern Expression* collect_like_terms(Expression* const expression);
+
+#endif // __COLLECT_H__
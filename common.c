@@ -0,0 +1,41 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+bool array_reserve(void** const items,
+                   size_t* const capacity,
+                   const size_t count,
+                   const size_t size)
+{
+	assert(items != NULL);
+	assert(capacity != NULL);
+
+	if (count <= *capacity)
+		return true;
+
+	size_t grown = *capacity > 0 ? *capacity : 16;
+	while (grown < count)
+		grown *= 2;
+
+	void* const result = realloc(*items, grown * size);
+	if (result == NULL)
+		return false;
+
+	*items = result;
+	*capacity = grown;
+
+	return true;
+}
+
+uint64_t hash_bytes(uint64_t hash, const void* const bytes, const size_t size)
+{
+	assert(bytes != NULL || size == 0);
+
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= ((const uint8_t*)bytes)[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
@@ -1,6 +1,10 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #define PRINT(message) fputs((message), stdout)
 #define PRINTF(format, ...) fprintf(stdout, (format), __VA_ARGS__)
 #define PRINTC(ch) fputc((ch), stdout)
@@ -9,4 +13,18 @@
 #define LOGF(format, ...) fprintf(stderr, (format), __VA_ARGS__)
 #define LOGC(ch) fputc((ch), stderr)
 
+// Initial hash of FNV-1a, see hash_bytes
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// Grow array of element size to hold at least count elements, doubling its
+// capacity; return false if memory is exhausted
+extern bool array_reserve(void** const items,
+                          size_t* const capacity,
+                          const size_t count,
+                          const size_t size);
+
+// Continue FNV-1a hash with bytes, starting from FNV_OFFSET_BASIS
+extern uint64_t hash_bytes(uint64_t hash, const void* const bytes, const size_t size);
+
 #endif // __COMMON_H__
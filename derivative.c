@@ -0,0 +1,813 @@
+#include "derivative.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lexer.h"
+#include "rational.h"
+#include "scratch.h"
+
+// Node of differentiated expression with its adjoint, that is derivative of
+// the whole expression with respect to the node
+typedef struct tape_entry {
+	const Expression* expression;
+	size_t operands[2];  // @NOTE: Tape indices of subexpressions
+	bool active;         // Depends on one of the variables
+	Expression* adjoint; // @NOTE: NULL while nothing was accumulated
+} TapeEntry;
+
+// Nodes of expression in pre-order, so that every node precedes its
+// subexpressions and its adjoint is complete before it is propagated
+typedef struct tape {
+	TapeEntry* entries;
+	size_t length;
+} Tape;
+
+static size_t expression_size(const Expression* expression);
+
+// Record expression to tape, return index of its entry; spine is shared by
+// walks of operands.
+static size_t tape_record(Tape* const tape,
+                          const Expression* const expression,
+                          const SymbolTable* const variables,
+                          ExpressionStack* const spine);
+
+// Record the given node to tape as tape_record, assuming its left operand
+// isn't recorded yet.
+static size_t tape_record_node(Tape* const tape,
+                               const Expression* const expression,
+                               const SymbolTable* const variables,
+                               ExpressionStack* const spine);
+
+// Propagate adjoint of the entry to its subexpressions.
+static GradientStatus tape_propagate(Tape* const tape,
+                                     const size_t index,
+                                     const SymbolTable* const variables,
+                                     Gradient* const gradient);
+
+// Add contribution to adjoint, return false if contribution is NULL or
+// memory is exhausted.
+static bool accumulate(Gradient* const gradient,
+                       Expression** const adjoint,
+                       Expression* const contribution);
+
+// Builders create nodes owned by gradient and simplify them on the way.
+// They return NULL if memory is exhausted or any operand is NULL.
+static Expression* build_number(Gradient* const gradient,
+                                const Rational exact,
+                                const double number);
+static Expression* build_integer(Gradient* const gradient, const int64_t integer);
+static Expression* build_node(Gradient* const gradient,
+                              const TokenType operator,
+                              Expression* const left,
+                              Expression* const right);
+static Expression* build_negation(Gradient* const gradient,
+                                  Expression* const operand);
+static Expression* build_sum(Gradient* const gradient,
+                             Expression* const left,
+                             Expression* const right);
+static Expression* build_difference(Gradient* const gradient,
+                                    Expression* const left,
+                                    Expression* const right);
+static Expression* build_product(Gradient* const gradient,
+                                 Expression* const left,
+                                 Expression* const right);
+static Expression* build_quotient(Gradient* const gradient,
+                                  Expression* const left,
+                                  Expression* const right);
+static Expression* build_power(Gradient* const gradient,
+                               Expression* const base,
+                               Expression* const exponent);
+
+static Expression* gradient_own(Gradient* const gradient,
+                                Expression* const node);
+
+static const Literal* number_literal(const Expression* const expression);
+static bool number_equal(const Expression* const expression, const double value);
+static bool number_negative(const Expression* const expression);
+
+// Operand of unary minus, or NULL if expression is not a negation
+static Expression* negation_operand(const Expression* const expression);
+
+// Product with number on the left, k * a, or NULL
+static const BinaryExpression* number_product(const Expression* const expression);
+
+// Sum or difference with number on the right, a + k or a - k, or NULL
+static const BinaryExpression* number_offset(const Expression* const expression);
+
+// Add number to sum or difference with number, folding them together
+static Expression* build_offset(Gradient* const gradient,
+                                const BinaryExpression* const left,
+                                Expression* const right,
+                                const bool subtract);
+
+// Compute operator on two number literals, return false if result is not
+// a finite number.
+static bool fold_numbers(const TokenType operator,
+                         const Literal* const lhs,
+                         const Literal* const rhs,
+                         Rational* const exact,
+                         double* const number);
+
+GradientStatus expression_gradient(const Expression* const expression,
+                                   const SymbolTable* const variables,
+                                   Gradient* const result)
+{
+	assert(expression != NULL);
+	assert(variables != NULL);
+	assert(result != NULL);
+
+	*result = Gradient();
+
+	result->derivatives = calloc(variables->count > 0 ? variables->count : 1,
+	                             sizeof(Expression*));
+	if (result->derivatives == NULL)
+		return GradientStatus_OutOfMemory;
+
+	result->count = variables->count;
+
+	Tape tape = {malloc(expression_size(expression) * sizeof(TapeEntry)), 0};
+	if (tape.entries == NULL)
+		return GradientStatus_OutOfMemory;
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	tape_record(&tape, expression, variables, &spine);
+	expression_stack_deinit(&spine);
+
+	GradientStatus status = GradientStatus_Success;
+
+	tape.entries[0].adjoint = build_integer(result, 1);
+	if (tape.entries[0].adjoint == NULL)
+		status = GradientStatus_OutOfMemory;
+
+	for (size_t i = 0; i < tape.length && status == GradientStatus_Success; ++i)
+		status = tape_propagate(&tape, i, variables, result);
+
+	free(tape.entries);
+
+	for (size_t i = 0; i < result->count && status == GradientStatus_Success; ++i) {
+		Expression** const derivative = &result->derivatives[i];
+
+		if (*derivative == NULL)
+			*derivative = build_integer(result, 0);
+
+		if (*derivative == NULL)
+			status = GradientStatus_OutOfMemory;
+	}
+
+	return status;
+}
+
+void gradient_deinit(Gradient* const gradient)
+{
+	assert(gradient != NULL);
+
+	// @NOTE: Nodes are freed one by one, as their subexpressions are shared
+	for list_range(it, gradient->nodes)
+		scratch_free(*list_node_data(it, Expression*));
+
+	list_deinit(&gradient->nodes);
+	free(gradient->derivatives);
+
+	*gradient = Gradient();
+}
+
+// @NOTE: Left operands and subexpressions are walked in a loop, so that
+// long chains don't nest calls
+static size_t expression_size(const Expression* expression)
+{
+	assert(expression != NULL);
+
+	size_t result = 0;
+
+	for (;;) {
+		result += 1;
+
+		if (expression->type == ExpressionType_Unary) {
+			expression = ((UnaryExpression*)expression)->subexpression;
+			continue;
+		}
+
+		if (expression->type != ExpressionType_Binary)
+			return result;
+
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		result += expression_size(binary->right);
+
+		expression = binary->left;
+	}
+}
+
+// @NOTE: Left operands are walked down in a loop, so that long chains
+// don't nest calls. Nodes on the way take consecutive entries, as they do
+// in pre-order, and their right operands are recorded on the way back up.
+static size_t tape_record(Tape* const tape,
+                          const Expression* const expression,
+                          const SymbolTable* const variables,
+                          ExpressionStack* const spine)
+{
+	assert(tape != NULL);
+	assert(expression != NULL);
+	assert(variables != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const size_t index = tape->length;
+
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom)) {
+		TapeEntry* const entry = &tape->entries[tape->length++];
+		entry->expression = bottom;
+		entry->operands[0] = tape->length;
+		entry->adjoint = NULL;
+
+		bottom = ((BinaryExpression*)bottom)->left;
+	}
+
+	tape_record_node(tape, bottom, variables, spine);
+
+	while (spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+		TapeEntry* const entry = &tape->entries[index + spine->count - base];
+
+		entry->operands[1] = tape_record(tape, binary->right, variables, spine);
+		entry->active = tape->entries[entry->operands[0]].active ||
+		                tape->entries[entry->operands[1]].active;
+	}
+
+	return index;
+}
+
+static size_t tape_record_node(Tape* const tape,
+                               const Expression* const expression,
+                               const SymbolTable* const variables,
+                               ExpressionStack* const spine)
+{
+	assert(tape != NULL);
+	assert(expression != NULL);
+	assert(variables != NULL);
+	assert(spine != NULL);
+
+	const size_t index = tape->length++;
+
+	// @NOTE: Tape is allocated for the whole expression, so entries stay
+	TapeEntry* const entry = &tape->entries[index];
+	entry->expression = expression;
+	entry->active = false;
+	entry->adjoint = NULL;
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		entry->active = literal->tag == LiteralTag_Symbol &&
+		                symbol_table_find(variables, &literal->symbol) != SYMBOL_NONE;
+	} break;
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		entry->operands[0] = tape_record(tape, unary->subexpression, variables, spine);
+		entry->active = tape->entries[entry->operands[0]].active;
+	} break;
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		entry->operands[0] = tape_record(tape, binary->left, variables, spine);
+		entry->operands[1] = tape_record(tape, binary->right, variables, spine);
+		entry->active = tape->entries[entry->operands[0]].active ||
+		                tape->entries[entry->operands[1]].active;
+	} break;
+	}
+
+	return index;
+}
+
+static GradientStatus tape_propagate(Tape* const tape,
+                                     const size_t index,
+                                     const SymbolTable* const variables,
+                                     Gradient* const gradient)
+{
+	assert(tape != NULL && index < tape->length);
+	assert(variables != NULL);
+	assert(gradient != NULL);
+
+	const TapeEntry* const entry = &tape->entries[index];
+	Expression* const adjoint = entry->adjoint;
+
+	if (!entry->active || adjoint == NULL)
+		return GradientStatus_Success;
+
+	bool success = true;
+
+	switch (entry->expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)entry->expression;
+
+		const size_t id = symbol_table_find(variables, &literal->symbol);
+		success = accumulate(gradient, &gradient->derivatives[id], adjoint);
+	} break;
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)entry->expression;
+		TapeEntry* const operand = &tape->entries[entry->operands[0]];
+
+		if (operand->active) {
+			success = accumulate(gradient, &operand->adjoint,
+				unary->operator == TokenType_Minus
+					? build_negation(gradient, adjoint)
+					: adjoint);
+		}
+	} break;
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)entry->expression;
+
+		TapeEntry* const left = &tape->entries[entry->operands[0]];
+		TapeEntry* const right = &tape->entries[entry->operands[1]];
+
+		// @NOTE: Derivatives share operands of the expression, which they
+		// never modify
+		Expression* const u = binary->left;
+		Expression* const v = binary->right;
+
+		Expression* left_adjoint = NULL;
+		Expression* right_adjoint = NULL;
+
+		switch (binary->operator) {
+		case TokenType_Plus:
+			left_adjoint = adjoint;
+			right_adjoint = adjoint;
+			break;
+
+		case TokenType_Minus:
+			left_adjoint = adjoint;
+			if (right->active)
+				right_adjoint = build_negation(gradient, adjoint);
+			break;
+
+		case TokenType_Multiply:
+			if (left->active)
+				left_adjoint = build_product(gradient, v, adjoint);
+			if (right->active)
+				right_adjoint = build_product(gradient, u, adjoint);
+			break;
+
+		// (u / v)' = u' / v - u * v' / v ^ 2
+		case TokenType_Divide:
+			if (left->active)
+				left_adjoint = build_quotient(gradient, adjoint, v);
+			if (right->active) {
+				right_adjoint = build_negation(gradient, build_quotient(gradient,
+					build_product(gradient, u, adjoint),
+					build_power(gradient, v, build_integer(gradient, 2))));
+			}
+			break;
+
+		// (u ^ v)' = v * u ^ (v - 1) * u' if v is constant
+		case TokenType_Exponent:
+			if (right->active)
+				return GradientStatus_VariableExponent;
+
+			left_adjoint = build_product(gradient,
+				build_product(gradient, v, build_power(gradient, u,
+					build_difference(gradient, v, build_integer(gradient, 1)))),
+				adjoint);
+			break;
+		}
+
+		if (left->active)
+			success = accumulate(gradient, &left->adjoint, left_adjoint);
+
+		if (right->active && success)
+			success = accumulate(gradient, &right->adjoint, right_adjoint);
+	} break;
+	}
+
+	return success ? GradientStatus_Success : GradientStatus_OutOfMemory;
+}
+
+static bool accumulate(Gradient* const gradient,
+                       Expression** const adjoint,
+                       Expression* const contribution)
+{
+	assert(gradient != NULL);
+	assert(adjoint != NULL);
+
+	if (contribution == NULL)
+		return false;
+
+	*adjoint = *adjoint == NULL
+		? contribution
+		: build_sum(gradient, *adjoint, contribution);
+
+	return *adjoint != NULL;
+}
+
+static Expression* build_number(Gradient* const gradient,
+                                const Rational exact,
+                                const double number)
+{
+	assert(gradient != NULL);
+
+	Literal* const literal = rational_exact(exact)
+		? expression_literal_create_rational(exact)
+		: expression_literal_create_number(number);
+
+	return gradient_own(gradient, (Expression*)literal);
+}
+
+static Expression* build_integer(Gradient* const gradient, const int64_t integer)
+{
+	return build_number(gradient, rational_integer(integer), (double)integer);
+}
+
+static Expression* build_node(Gradient* const gradient,
+                              const TokenType operator,
+                              Expression* const left,
+                              Expression* const right)
+{
+	assert(gradient != NULL);
+	assert(left != NULL && right != NULL);
+
+	return gradient_own(gradient,
+		(Expression*)expression_binary_create(operator, left, right));
+}
+
+static Expression* build_negation(Gradient* const gradient,
+                                  Expression* const operand)
+{
+	assert(gradient != NULL);
+
+	if (operand == NULL)
+		return NULL;
+
+	const Literal* const literal = number_literal(operand);
+	if (literal != NULL)
+		return build_number(gradient, rational_negate(literal->rational), -literal->number);
+
+	Expression* const negated = negation_operand(operand);
+	if (negated != NULL)
+		return negated;
+
+	const BinaryExpression* const product = number_product(operand);
+	if (product != NULL) {
+		return build_product(gradient,
+			build_negation(gradient, product->left), product->right);
+	}
+
+	return gradient_own(gradient,
+		(Expression*)expression_unary_create(TokenType_Minus, operand));
+}
+
+static Expression* build_sum(Gradient* const gradient,
+                             Expression* const left,
+                             Expression* const right)
+{
+	assert(gradient != NULL);
+
+	if (left == NULL || right == NULL)
+		return NULL;
+
+	if (number_equal(left, 0.0))
+		return right;
+
+	if (number_equal(right, 0.0))
+		return left;
+
+	Rational exact;
+	double number;
+
+	if (fold_numbers(TokenType_Plus, number_literal(left), number_literal(right),
+	                 &exact, &number)) {
+		return build_number(gradient, exact, number);
+	}
+
+	Expression* negated = negation_operand(right);
+	if (negated != NULL)
+		return build_difference(gradient, left, negated);
+
+	negated = negation_operand(left);
+	if (negated != NULL)
+		return build_difference(gradient, right, negated);
+
+	if (number_negative(right))
+		return build_difference(gradient, left, build_negation(gradient, right));
+
+	if (number_literal(right) != NULL && number_offset(left) != NULL)
+		return build_offset(gradient, number_offset(left), right, false);
+
+	return build_node(gradient, TokenType_Plus, left, right);
+}
+
+static Expression* build_difference(Gradient* const gradient,
+                                    Expression* const left,
+                                    Expression* const right)
+{
+	assert(gradient != NULL);
+
+	if (left == NULL || right == NULL)
+		return NULL;
+
+	if (number_equal(right, 0.0))
+		return left;
+
+	if (number_equal(left, 0.0))
+		return build_negation(gradient, right);
+
+	Rational exact;
+	double number;
+
+	if (fold_numbers(TokenType_Minus, number_literal(left), number_literal(right),
+	                 &exact, &number)) {
+		return build_number(gradient, exact, number);
+	}
+
+	Expression* const negated = negation_operand(right);
+	if (negated != NULL)
+		return build_sum(gradient, left, negated);
+
+	if (number_negative(right))
+		return build_sum(gradient, left, build_negation(gradient, right));
+
+	if (number_literal(right) != NULL && number_offset(left) != NULL)
+		return build_offset(gradient, number_offset(left), right, true);
+
+	return build_node(gradient, TokenType_Minus, left, right);
+}
+
+static Expression* build_product(Gradient* const gradient,
+                                 Expression* const left,
+                                 Expression* const right)
+{
+	assert(gradient != NULL);
+
+	if (left == NULL || right == NULL)
+		return NULL;
+
+	if (number_equal(left, 0.0) || number_equal(right, 0.0))
+		return build_integer(gradient, 0);
+
+	if (number_equal(left, 1.0))
+		return right;
+
+	if (number_equal(right, 1.0))
+		return left;
+
+	const Literal* const left_number = number_literal(left);
+	const Literal* const right_number = number_literal(right);
+
+	Rational exact;
+	double number;
+
+	if (fold_numbers(TokenType_Multiply, left_number, right_number, &exact, &number))
+		return build_number(gradient, exact, number);
+
+	Expression* negated = negation_operand(left);
+	if (negated != NULL)
+		return build_negation(gradient, build_product(gradient, negated, right));
+
+	negated = negation_operand(right);
+	if (negated != NULL)
+		return build_negation(gradient, build_product(gradient, left, negated));
+
+	// @NOTE: Number factors go first, so that they can be folded together
+	if (right_number != NULL)
+		return build_product(gradient, right, left);
+
+	if (left_number != NULL && left_number->number == -1.0)
+		return build_negation(gradient, right);
+
+	const BinaryExpression* product = number_product(right);
+	if (product != NULL) {
+		return left_number != NULL
+			? build_product(gradient,
+				build_product(gradient, left, product->left), product->right)
+			: build_product(gradient,
+				product->left, build_product(gradient, left, product->right));
+	}
+
+	product = number_product(left);
+	if (product != NULL) {
+		return build_product(gradient,
+			product->left, build_product(gradient, product->right, right));
+	}
+
+	return build_node(gradient, TokenType_Multiply, left, right);
+}
+
+static Expression* build_quotient(Gradient* const gradient,
+                                  Expression* const left,
+                                  Expression* const right)
+{
+	assert(gradient != NULL);
+
+	if (left == NULL || right == NULL)
+		return NULL;
+
+	if (number_equal(right, 1.0))
+		return left;
+
+	if (number_equal(right, 0.0))
+		return build_node(gradient, TokenType_Divide, left, right);
+
+	if (number_equal(left, 0.0))
+		return left;
+
+	Rational exact;
+	double number;
+
+	if (fold_numbers(TokenType_Divide, number_literal(left), number_literal(right),
+	                 &exact, &number)) {
+		return build_number(gradient, exact, number);
+	}
+
+	Expression* const negated = negation_operand(left);
+	if (negated != NULL)
+		return build_negation(gradient, build_quotient(gradient, negated, right));
+
+	return build_node(gradient, TokenType_Divide, left, right);
+}
+
+static Expression* build_power(Gradient* const gradient,
+                               Expression* const base,
+                               Expression* const exponent)
+{
+	assert(gradient != NULL);
+
+	if (base == NULL || exponent == NULL)
+		return NULL;
+
+	if (number_equal(exponent, 0.0))
+		return build_integer(gradient, 1);
+
+	if (number_equal(exponent, 1.0))
+		return base;
+
+	Rational exact;
+	double number;
+
+	if (fold_numbers(TokenType_Exponent, number_literal(base), number_literal(exponent),
+	                 &exact, &number)) {
+		return build_number(gradient, exact, number);
+	}
+
+	return build_node(gradient, TokenType_Exponent, base, exponent);
+}
+
+static Expression* gradient_own(Gradient* const gradient,
+                                Expression* const node)
+{
+	assert(gradient != NULL);
+
+	if (node == NULL)
+		return NULL;
+
+	Expression** const slot = list_insert_back(&gradient->nodes, Expression*);
+	if (slot == NULL) {
+		scratch_free(node);
+		return NULL;
+	}
+
+	*slot = node;
+
+	return node;
+}
+
+static const Literal* number_literal(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Literal)
+		return NULL;
+
+	const Literal* const literal = (Literal*)expression;
+
+	return literal->tag == LiteralTag_Number ? literal : NULL;
+}
+
+static bool number_equal(const Expression* const expression, const double value)
+{
+	const Literal* const literal = number_literal(expression);
+	return literal != NULL && literal->number == value;
+}
+
+static bool number_negative(const Expression* const expression)
+{
+	const Literal* const literal = number_literal(expression);
+	return literal != NULL && signbit(literal->number);
+}
+
+static Expression* negation_operand(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Unary)
+		return NULL;
+
+	const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+	return unary->operator == TokenType_Minus ? unary->subexpression : NULL;
+}
+
+static const BinaryExpression* number_product(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Binary)
+		return NULL;
+
+	const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+	if (binary->operator != TokenType_Multiply || number_literal(binary->left) == NULL)
+		return NULL;
+
+	return binary;
+}
+
+static const BinaryExpression* number_offset(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Binary)
+		return NULL;
+
+	const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+	if ((binary->operator != TokenType_Plus && binary->operator != TokenType_Minus) ||
+	    number_literal(binary->right) == NULL) {
+		return NULL;
+	}
+
+	return binary;
+}
+
+static Expression* build_offset(Gradient* const gradient,
+                                const BinaryExpression* const left,
+                                Expression* const right,
+                                const bool subtract)
+{
+	assert(gradient != NULL);
+	assert(left != NULL && right != NULL);
+
+	Expression* const offset = left->operator == TokenType_Minus
+		? build_negation(gradient, left->right)
+		: left->right;
+
+	return build_sum(gradient, left->left, subtract
+		? build_difference(gradient, offset, right)
+		: build_sum(gradient, offset, right));
+}
+
+static bool fold_numbers(const TokenType operator,
+                         const Literal* const lhs,
+                         const Literal* const rhs,
+                         Rational* const exact,
+                         double* const number)
+{
+	assert(exact != NULL);
+	assert(number != NULL);
+
+	if (lhs == NULL || rhs == NULL)
+		return false;
+
+	switch (operator) {
+	case TokenType_Plus:
+		*exact = rational_add(lhs->rational, rhs->rational);
+		*number = lhs->number + rhs->number;
+		break;
+
+	case TokenType_Minus:
+		*exact = rational_subtract(lhs->rational, rhs->rational);
+		*number = lhs->number - rhs->number;
+		break;
+
+	case TokenType_Multiply:
+		*exact = rational_multiply(lhs->rational, rhs->rational);
+		*number = lhs->number * rhs->number;
+		break;
+
+	case TokenType_Divide:
+		*exact = rational_divide(lhs->rational, rhs->rational);
+		*number = lhs->number / rhs->number;
+		break;
+
+	case TokenType_Exponent:
+		*exact = rational_power(lhs->rational, rhs->rational);
+		*number = pow(lhs->number, rhs->number);
+		break;
+	}
+
+	if (rational_exact(*exact)) {
+		*number = rational_to_double(*exact);
+		return true;
+	}
+
+	return isfinite(*number);
+}
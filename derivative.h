@@ -0,0 +1,38 @@
+#ifndef __DERIVATIVE_H__
+#define __DERIVATIVE_H__
+
+#include <stddef.h>
+
+#include "list.h"
+#include "parser.h"
+#include "symbol.h"
+
+typedef enum gradient_status {
+	GradientStatus_Success,
+	GradientStatus_VariableExponent, // @NOTE: Derivative needs logarithm
+	GradientStatus_OutOfMemory,
+	GradientStatus__count,
+} GradientStatus;
+
+// Partial derivatives of an expression with respect to symbols of a table.
+// They share unchanged subtrees with the differentiated expression, which
+// must outlive them, and with each other; only nodes created for them are
+// owned by the gradient.
+typedef struct gradient {
+	size_t count;
+	Expression** derivatives; // @NOTE: Indexed by symbol identifier
+	List nodes;               // Expression* of owned nodes
+} Gradient;
+
+#define Gradient() (Gradient){0, NULL, List()}
+
+// Differentiate expression with respect to every symbol of the table in a
+// single reverse pass over it, derivatives are simplified while they are
+// built. Gradient is initialized in any case.
+extern GradientStatus expression_gradient(const Expression* const expression,
+                                          const SymbolTable* const variables,
+                                          Gradient* const result);
+
+extern void gradient_deinit(Gradient* const gradient);
+
+#endif // __DERIVATIVE_H__
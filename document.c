@@ -0,0 +1,585 @@
+#include "document.h"
+#include "lexer.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Slots of expressions on the path from the root to the edited expression
+typedef struct path {
+	Expression*** slots;
+	size_t length;
+	size_t capacity;
+} Path;
+
+static bool path_push(Path* const path, Expression** const slot);
+
+static String text_create(const size_t length);
+
+static bool document_find_group(Document* const document,
+                                const size_t begin,
+                                const size_t end,
+                                Path* const path,
+                                size_t* const group);
+static void document_relex(Document* const document,
+                           const String* const text,
+                           const size_t begin,
+                           const size_t end,
+                           const ptrdiff_t delta);
+static bool document_reparse(Document* const document,
+                             const Path* const path,
+                             const size_t group);
+static void document_parse(Document* const document);
+static void document_transform_tree(Document* const document,
+                                    Expression** const expression);
+static void document_transform_node(Document* const document,
+                                    Expression** const expression);
+
+// Move spans and symbols of expression from old text to the new one, where
+// bytes [begin, end) of the old text were replaced; return false if memory
+// is exhausted, leaving expression partially moved
+static bool expression_shift(Expression* const expression,
+                             const String* const old_text,
+                             const String* const text,
+                             const size_t begin,
+                             const size_t end,
+                             const ptrdiff_t delta);
+
+// Move node and its subexpressions, but not nodes which were moved already
+static bool expression_shift_node(Expression* const expression,
+                                  const String* const old_text,
+                                  const String* const text,
+                                  const size_t begin,
+                                  const size_t end,
+                                  const ptrdiff_t delta,
+                                  ExpressionMap* const shifted);
+static bool expression_span_contains(const Expression* const expression,
+                                     const size_t begin,
+                                     const size_t end);
+
+static size_t token_begin(const ListNode* const node);
+
+Document* document_create(const String* const text, const TransformMode mode)
+{
+	assert(text != NULL);
+
+	Document* const result = malloc(sizeof(Document));
+	if (result == NULL)
+		return NULL;
+
+	result->text = text_create(text->length);
+	if (text->length > 0 && result->text.text == NULL) {
+		free(result);
+		return NULL;
+	}
+
+	if (text->length > 0)
+		memcpy(result->text.text, text->text, text->length);
+
+	result->tokens = lexical_scan(&result->text);
+	result->expression = NULL;
+	result->mode = mode;
+	result->illegal_tokens = 0;
+	result->errors.count = 0;
+
+	for list_range(it, result->tokens) {
+		if (list_node_data(it, Token)->type == TokenType_Illegal)
+			++result->illegal_tokens;
+	}
+
+	if (result->illegal_tokens == 0)
+		document_parse(result);
+
+	return result;
+}
+
+void document_destroy(Document** const document)
+{
+	assert(document != NULL && *document != NULL);
+
+	if ((*document)->expression != NULL)
+		expression_destroy(&(*document)->expression);
+
+	list_deinit(&(*document)->tokens);
+	string_destroy(&(*document)->text);
+
+	free(*document);
+	*document = NULL;
+}
+
+bool document_edit(Document* const document,
+                   const size_t begin,
+                   const size_t end,
+                   const String* const replacement)
+{
+	assert(document != NULL);
+	assert(begin <= end && end <= document->text.length);
+	assert(replacement != NULL);
+
+	const String old_text = document->text;
+	const size_t length = old_text.length - (end - begin) + replacement->length;
+	const ptrdiff_t delta = (ptrdiff_t)replacement->length - (ptrdiff_t)(end - begin);
+
+	String text = text_create(length);
+	if (length > 0 && text.text == NULL)
+		return false;
+
+	if (begin > 0)
+		memcpy(text.text, old_text.text, begin);
+
+	if (replacement->length > 0)
+		memcpy(text.text + begin, replacement->text, replacement->length);
+
+	if (old_text.length > end) {
+		memcpy(text.text + begin + replacement->length, old_text.text + end,
+		       old_text.length - end);
+	}
+
+	// Group must be found before spans are shifted to the new text, tree is
+	// only shifted if it is kept
+	Path path = {NULL, 0, 0};
+	size_t group = 0;
+	bool found = document->expression != NULL &&
+		document_find_group(document, begin, end, &path, &group);
+
+	document_relex(document, &text, begin, end, delta);
+
+	// @NOTE: Tree which can't be shifted is parsed again as a whole
+	if (found)
+		found = expression_shift(document->expression, &old_text, &text, begin, end, delta);
+
+	string_destroy(&document->text);
+	document->text = text;
+
+	if (document->illegal_tokens > 0) {
+		if (document->expression != NULL)
+			expression_destroy(&document->expression);
+
+		free(path.slots);
+		return false;
+	}
+
+	if (!found || !document_reparse(document, &path, group))
+		document_parse(document);
+
+	free(path.slots);
+	return document->expression != NULL;
+}
+
+bool document_update(Document* const document, const String* const text)
+{
+	assert(document != NULL);
+	assert(text != NULL);
+
+	const String* const old_text = &document->text;
+
+	size_t prefix = 0;
+	while (prefix < old_text->length && prefix < text->length &&
+	       old_text->text[prefix] == text->text[prefix]) {
+		++prefix;
+	}
+
+	if (prefix == old_text->length && prefix == text->length)
+		return document->expression != NULL;
+
+	size_t suffix = 0;
+	while (suffix < old_text->length - prefix && suffix < text->length - prefix &&
+	       old_text->text[old_text->length - suffix - 1] ==
+	       text->text[text->length - suffix - 1]) {
+		++suffix;
+	}
+
+	const String replacement = string_trim(text, prefix, text->length - suffix);
+
+	return document_edit(document, prefix, old_text->length - suffix, &replacement);
+}
+
+static bool path_push(Path* const path, Expression** const slot)
+{
+	assert(path != NULL);
+	assert(slot != NULL);
+
+	if (path->length == path->capacity) {
+		const size_t capacity = path->capacity > 0 ? 2 * path->capacity : 16;
+
+		Expression*** const slots = realloc(path->slots,
+		                                    capacity * sizeof(Expression**));
+		if (slots == NULL)
+			return false;
+
+		path->slots = slots;
+		path->capacity = capacity;
+	}
+
+	path->slots[path->length++] = slot;
+
+	return true;
+}
+
+static String text_create(const size_t length)
+{
+	if (length == 0)
+		return (String){NULL, 0, false};
+
+	return string_create(length);
+}
+
+// Find the deepest parenthesised expression strictly enclosing bytes
+// [begin, end) and record the path to it, return false if there is none
+static bool document_find_group(Document* const document,
+                                const size_t begin,
+                                const size_t end,
+                                Path* const path,
+                                size_t* const group)
+{
+	assert(document != NULL);
+	assert(path != NULL);
+	assert(group != NULL);
+
+	bool result = false;
+	Expression** slot = &document->expression;
+
+	while (slot != NULL) {
+		Expression* const expression = *slot;
+
+		if (!path_push(path, slot))
+			return false;
+
+		if (expression->parenthesised &&
+		    expression->begin < begin && end < expression->end) {
+			result = true;
+			*group = path->length - 1;
+		}
+
+		slot = NULL;
+
+		switch (expression->type) {
+		case ExpressionType_Unary: {
+			UnaryExpression* const unary = (UnaryExpression*)expression;
+
+			if (expression_span_contains(unary->subexpression, begin, end))
+				slot = &unary->subexpression;
+		} break;
+
+		case ExpressionType_Binary: {
+			BinaryExpression* const binary = (BinaryExpression*)expression;
+
+			if (expression_span_contains(binary->left, begin, end))
+				slot = &binary->left;
+			else if (expression_span_contains(binary->right, begin, end))
+				slot = &binary->right;
+		} break;
+		}
+	}
+
+	return result;
+}
+
+// Replace tokens of the edited bytes with tokens of the new text, scanning
+// from the last token before the edit until the scan meets an old token
+static void document_relex(Document* const document,
+                           const String* const text,
+                           const size_t begin,
+                           const size_t end,
+                           const ptrdiff_t delta)
+{
+	assert(document != NULL);
+	assert(text != NULL);
+
+	List* const tokens = &document->tokens;
+
+	ListNode* last_before = NULL;
+	ListNode* sync = tokens->head;
+
+	while (sync != NULL && token_begin(sync) < begin) {
+		last_before = sync;
+		sync = sync->next;
+	}
+
+	// Token right before the edit may be continued by the replacement
+	ListNode* const first = last_before != NULL ? last_before : tokens->head;
+	ListNode* tail = first != NULL ? first->prev : NULL;
+	size_t offset = last_before != NULL ? token_begin(last_before) : 0;
+
+	while (sync != NULL && token_begin(sync) < end)
+		sync = sync->next;
+
+	Token token;
+	bool synced = false;
+
+	while (lexical_scan_token(text, &offset, &token)) {
+		const ptrdiff_t start = (ptrdiff_t)token.position - 1;
+
+		while (sync != NULL && (ptrdiff_t)token_begin(sync) + delta < start)
+			sync = sync->next;
+
+		// Rest of the text is the same, so are the tokens
+		if (sync != NULL && (ptrdiff_t)token_begin(sync) + delta == start) {
+			synced = true;
+			break;
+		}
+
+		Token* const inserted = tail != NULL
+			? list_insert_after(tokens, tail, Token)
+			: list_insert_front(tokens, Token);
+
+		if (inserted == NULL)
+			break;
+
+		*inserted = token;
+		tail = tail != NULL ? tail->next : tokens->head;
+
+		if (token.type == TokenType_Illegal)
+			++document->illegal_tokens;
+	}
+
+	// Old tokens overlapped by the last scanned ones are removed as well
+	if (!synced)
+		sync = NULL;
+
+	for (ListNode* it = first; it != NULL && it != sync;) {
+		ListNode* const next = it->next;
+
+		if (list_node_data(it, Token)->type == TokenType_Illegal)
+			--document->illegal_tokens;
+
+		list_remove(tokens, it);
+		it = next;
+	}
+
+	for (ListNode* it = sync; it != NULL; it = it->next) {
+		Token* const moved = list_node_data(it, Token);
+		moved->position = (size_t)((ptrdiff_t)moved->position + delta);
+	}
+
+	for list_range(it, *tokens) {
+		Token* const current = list_node_data(it, Token);
+		current->content.text = text->text + current->position - 1;
+	}
+}
+
+// Parse and transform the parenthesised expression at the end of the path
+// alone, then transform nodes on the path back to the root
+static bool document_reparse(Document* const document,
+                             const Path* const path,
+                             const size_t group)
+{
+	assert(document != NULL);
+	assert(path != NULL && group < path->length);
+
+	Expression** const slot = path->slots[group];
+	const size_t begin = (*slot)->begin;
+	const size_t end = (*slot)->end;
+
+	ListNode* open = NULL;
+	ListNode* close = NULL;
+	size_t depth = 0;
+	bool balanced = true;
+
+	for list_range(it, document->tokens) {
+		const Token* const token = list_node_data(it, Token);
+
+		if (open == NULL) {
+			if (token_begin(it) == begin)
+				open = it;
+			continue;
+		}
+
+		if (token_begin(it) == end - 1) {
+			close = it;
+			break;
+		}
+
+		if (token->type == TokenType_LeftParen)
+			++depth;
+		else if (token->type == TokenType_RightParen) {
+			if (depth == 0)
+				balanced = false;
+			else
+				--depth;
+		}
+	}
+
+	// Parentheses inside the group must be balanced, otherwise full parse
+	// would pair them differently
+	if (open == NULL || close == NULL || !balanced || depth != 0)
+		return false;
+
+	if (list_node_data(open, Token)->type != TokenType_LeftParen ||
+	    list_node_data(close, Token)->type != TokenType_RightParen) {
+		return false;
+	}
+
+	Expression* expression = expression_parse_range(&document->tokens,
+	                                                open->next, close);
+	if (expression == NULL)
+		return false;
+
+	if (expression_empty(expression)) {
+		expression_destroy(&expression);
+		return false;
+	}
+
+	expression->parenthesised = true;
+	expression->begin = begin;
+	expression->end = end;
+
+	document_transform_tree(document, &expression);
+
+	// @NOTE: Nodes on the path have source spans, so they are not shared,
+	// see Transformer
+	expression_destroy(slot);
+	*slot = expression;
+
+	for (size_t i = group; i-- > 0;)
+		document_transform_node(document, path->slots[i]);
+
+	return true;
+}
+
+static void document_parse(Document* const document)
+{
+	assert(document != NULL);
+
+	if (document->expression != NULL)
+		expression_destroy(&document->expression);
+
+	document->expression = expression_parse_checked(&document->tokens,
+	                                                &document->errors);
+
+	if (document->expression != NULL)
+		document_transform_tree(document, &document->expression);
+}
+
+static void document_transform_tree(Document* const document,
+                                    Expression** const expression)
+{
+	assert(document != NULL);
+	assert(expression != NULL);
+
+	switch (document->mode) {
+	case TransformMode_Simplify:
+		simplify_expression(expression);
+		break;
+
+	case TransformMode_Expand:
+		expand_expression(expression);
+		break;
+	}
+}
+
+static void document_transform_node(Document* const document,
+                                    Expression** const expression)
+{
+	assert(document != NULL);
+	assert(expression != NULL);
+
+	switch (document->mode) {
+	case TransformMode_Simplify:
+		simplify_expression_node(expression);
+		break;
+
+	case TransformMode_Expand:
+		expand_expression_node(expression);
+		break;
+	}
+}
+
+static bool expression_shift(Expression* const expression,
+                             const String* const old_text,
+                             const String* const text,
+                             const size_t begin,
+                             const size_t end,
+                             const ptrdiff_t delta)
+{
+	assert(expression != NULL);
+
+	ExpressionMap shifted = ExpressionMap();
+
+	const bool result = expression_shift_node(expression, old_text, text,
+	                                          begin, end, delta, &shifted);
+
+	expression_map_deinit(&shifted);
+
+	return result;
+}
+
+// @NOTE: Nodes shared by rewrites are reached several times, but must be
+// moved once
+static bool expression_shift_node(Expression* const expression,
+                                  const String* const old_text,
+                                  const String* const text,
+                                  const size_t begin,
+                                  const size_t end,
+                                  const ptrdiff_t delta,
+                                  ExpressionMap* const shifted)
+{
+	assert(expression != NULL);
+	assert(shifted != NULL);
+
+	if (expression_shared(expression)) {
+		if (expression_map_find(shifted, expression) != EXPRESSION_MAP_NONE)
+			return true;
+
+		if (!expression_map_insert(shifted, expression, 0))
+			return false;
+	}
+
+	if (expression->begin > begin)
+		expression->begin = (size_t)((ptrdiff_t)expression->begin + delta);
+
+	if (expression->end > begin)
+		expression->end = (size_t)((ptrdiff_t)expression->end + delta);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		Literal* const literal = (Literal*)expression;
+
+		if (literal->tag != LiteralTag_Symbol)
+			break;
+
+		size_t offset = literal->symbol.text - old_text->text;
+
+		// @NOTE: Symbols of the edited bytes are destroyed on reparse
+		if (offset >= end)
+			offset = (size_t)((ptrdiff_t)offset + delta);
+		else if (offset > begin)
+			offset = begin;
+
+		literal->symbol.text = text->text + offset;
+	} break;
+
+	case ExpressionType_Unary: {
+		UnaryExpression* const unary = (UnaryExpression*)expression;
+		return expression_shift_node(unary->subexpression, old_text, text,
+		                             begin, end, delta, shifted);
+	}
+
+	case ExpressionType_Binary: {
+		BinaryExpression* const binary = (BinaryExpression*)expression;
+		return expression_shift_node(binary->left, old_text, text,
+		                             begin, end, delta, shifted) &&
+		       expression_shift_node(binary->right, old_text, text,
+		                             begin, end, delta, shifted);
+	}
+	}
+
+	return true;
+}
+
+static bool expression_span_contains(const Expression* const expression,
+                                     const size_t begin,
+                                     const size_t end)
+{
+	assert(expression != NULL);
+
+	return expression->begin < expression->end &&
+	       expression->begin <= begin && end <= expression->end;
+}
+
+static size_t token_begin(const ListNode* const node)
+{
+	assert(node != NULL);
+	return list_node_data(node, Token)->position - 1;
+}
@@ -0,0 +1,41 @@
+#ifndef __DOCUMENT_H__
+#define __DOCUMENT_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "string.h"
+#include "list.h"
+#include "parser.h"
+#include "transform.h"
+
+// Document keeps text, tokens and transformed expression tree between edits,
+// so that an edit relexes only the changed bytes, reparses only the smallest
+// parenthesised expression enclosing the edit and transforms it and the
+// path from it to the root.
+typedef struct document {
+	String text;
+	List tokens;
+	Expression* expression; // @NOTE: NULL while text has illegal tokens or
+	                        // syntax errors
+	TransformMode mode;
+	size_t illegal_tokens;
+	SyntaxErrors errors;
+} Document;
+
+extern Document* document_create(const String* const text,
+                                 const TransformMode mode);
+extern void document_destroy(Document** const document);
+
+// Replace bytes [begin, end) of document text, return false if resulting
+// text contains illegal tokens or syntax errors
+extern bool document_edit(Document* const document,
+                          const size_t begin,
+                          const size_t end,
+                          const String* const replacement);
+
+// Replace whole document text, edit is made for the changed bytes only
+extern bool document_update(Document* const document,
+                            const String* const text);
+
+#endif // __DOCUMENT_H__
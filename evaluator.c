@@ -0,0 +1,1349 @@
+#include "evaluator.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "transform.h"
+
+// Part of symbol intervals with enclosure of expression over it
+typedef struct box {
+	Interval* slots;
+	Interval value;
+} Box;
+
+// Max-heap of boxes by width of their enclosures
+typedef struct box_heap {
+	Box* boxes;
+	size_t* indices;
+	size_t length;
+} BoxHeap;
+
+typedef struct compiler {
+	Evaluator* evaluator;
+	const SymbolTable* symbols; // @NOTE: Symbols of compiled expression
+	size_t depth;               // Values on stack after emitted code
+	ExpressionStack* spine;     // @NOTE: Chain nodes, see compiler_emit
+} Compiler;
+
+static const Opcode BINARY_OPCODE[TokenType__count] = {
+	[TokenType_Plus] = Opcode_Add,
+	[TokenType_Minus] = Opcode_Subtract,
+	[TokenType_Multiply] = Opcode_Multiply,
+	[TokenType_Divide] = Opcode_Divide,
+	[TokenType_Exponent] = Opcode_Power,
+};
+
+// Superinstructions of binary operations with number or slot operand, or
+// Opcode_Number if there is none
+static const Opcode NUMBER_OPCODE[Opcode__count] = {
+	[Opcode_Add] = Opcode_AddNumber,
+	[Opcode_Subtract] = Opcode_SubtractNumber,
+	[Opcode_Multiply] = Opcode_MultiplyNumber,
+	[Opcode_Divide] = Opcode_DivideNumber,
+	[Opcode_Power] = Opcode_PowerNumber,
+};
+
+static const Opcode LOAD_OPCODE[Opcode__count] = {
+	[Opcode_Add] = Opcode_AddLoad,
+	[Opcode_Subtract] = Opcode_SubtractLoad,
+	[Opcode_Multiply] = Opcode_MultiplyLoad,
+	[Opcode_Divide] = Opcode_DivideLoad,
+	[Opcode_Power] = Opcode_PowerLoad,
+};
+
+// Intern symbols of expression and count instructions needed for it.
+static bool expression_collect(const Expression* const expression,
+                               SymbolTable* const symbols,
+                               ExpressionStack* const spine,
+                               size_t* const length);
+static bool expression_collect_node(const Expression* const expression,
+                                    SymbolTable* const symbols,
+                                    ExpressionStack* const spine,
+                                    size_t* const length);
+
+static bool compiler_emit(Compiler* const compiler,
+                          const Expression* const expression);
+static bool compiler_emit_node(Compiler* const compiler,
+                               const Expression* const expression);
+
+// Append instruction, which changes stack depth by the given amount.
+static bool compiler_push(Compiler* const compiler,
+                          const Instruction instruction,
+                          const int depth);
+
+// Check whether code starting at the position is compiled from expression,
+// and move position past it.
+static bool evaluator_matches(const Evaluator* const evaluator,
+                              const Expression* const expression,
+                              ExpressionStack* const spine,
+                              size_t* const position);
+static bool evaluator_matches_node(const Evaluator* const evaluator,
+                                   const Expression* const expression,
+                                   ExpressionStack* const spine,
+                                   size_t* const position);
+static bool evaluator_matches_instruction(const Evaluator* const evaluator,
+                                          const Opcode opcode,
+                                          size_t* const position);
+
+// Fuse code into superinstructions by peephole pass and thread it.
+static bool evaluator_thread(Evaluator* const evaluator);
+
+// Execute threaded code, or get addresses of handlers by opcode if code is
+// NULL.
+static double threaded_execute(const ThreadedInstruction* const code,
+                               const double* const slots,
+                               const void* const** const handlers);
+
+static bool number_identical(const double lhs, const double rhs);
+static bool interval_identical(const Interval lhs, const Interval rhs);
+
+// Set tangent to scaled tangent plus scaled operand tangent, skipping
+// inactive ones, which are zero
+static void tangent_combine(double* const tangent,
+                            bool* const active,
+                            const double scale,
+                            const double* const operand,
+                            const bool operand_active,
+                            const double operand_scale,
+                            const size_t count);
+
+// Check whether every component of tangent is zero
+static bool tangent_zero(const double* const tangent, const size_t count);
+
+static double interval_width(const Interval interval);
+
+static void box_heap_push(BoxHeap* const heap, const size_t index);
+static size_t box_heap_pop(BoxHeap* const heap);
+
+// Split box in halves at midpoint of its widest finite symbol interval,
+// return false if there is none to split.
+static bool box_split(const Box* const box,
+                      const size_t count,
+                      Interval* const lower,
+                      Interval* const upper);
+
+static uint64_t hash_expression(uint64_t hash,
+                                const Expression* const expression,
+                                ExpressionStack* const spine);
+static uint64_t hash_node(uint64_t hash, const Expression* const expression);
+
+Evaluator* evaluator_compile(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	SymbolTable symbols = SymbolTable();
+	size_t length = 0;
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	Evaluator* result = NULL;
+
+	if (!expression_collect(expression, &symbols, &spine, &length))
+		goto cleanup;
+
+	result = malloc(sizeof(Evaluator));
+	if (result == NULL)
+		goto cleanup;
+
+	size_t names_length = 0;
+	for (size_t i = 0; i < symbols.count; ++i)
+		names_length += symbol_table_name(&symbols, i)->length;
+
+	result->code = malloc((length > 0 ? length : 1) * sizeof(Instruction));
+	result->length = 0;
+	result->threaded = NULL;
+	result->threaded_length = 0;
+	result->stack_size = 0;
+	result->symbols = SymbolTable();
+	result->names = malloc(names_length > 0 ? names_length : 1);
+	result->hash = expression_hash(expression);
+
+	if (result->code == NULL || result->names == NULL)
+		goto failure;
+
+	// @NOTE: Copies are interned in the same order, so identifiers agree
+	uint8_t* name = result->names;
+
+	for (size_t i = 0; i < symbols.count; ++i) {
+		const String* const symbol = symbol_table_name(&symbols, i);
+
+		memcpy(name, symbol->text, symbol->length);
+
+		const String copy = {name, symbol->length, false};
+		if (symbol_table_intern(&result->symbols, &copy) == SYMBOL_NONE)
+			goto failure;
+
+		name += symbol->length;
+	}
+
+	Compiler compiler = {result, &symbols, 0, &spine};
+
+	if (compiler_emit(&compiler, expression) && evaluator_thread(result))
+		goto cleanup;
+
+failure:
+	evaluator_destroy(&result);
+cleanup:
+	expression_stack_deinit(&spine);
+	symbol_table_deinit(&symbols);
+
+	return result;
+}
+
+void evaluator_destroy(Evaluator** const evaluator)
+{
+	assert(evaluator != NULL && *evaluator != NULL);
+
+	free((*evaluator)->code);
+	free((*evaluator)->threaded);
+	free((*evaluator)->names);
+	symbol_table_deinit(&(*evaluator)->symbols);
+	free(*evaluator);
+
+	*evaluator = NULL;
+}
+
+size_t evaluator_slot(const Evaluator* const evaluator,
+                      const String* const symbol)
+{
+	assert(evaluator != NULL);
+	assert(symbol != NULL);
+
+	return symbol_table_find(&evaluator->symbols, symbol);
+}
+
+double evaluator_run(const Evaluator* const evaluator,
+                     const double* const slots)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols.count == 0);
+
+	return threaded_execute(evaluator->threaded, slots, NULL);
+}
+
+double evaluator_run_switch(const Evaluator* const evaluator,
+                            const double* const slots)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols.count == 0);
+
+	double stack[EVALUATOR_STACK_MAX];
+	size_t top = 0;
+
+	const Instruction* const end = evaluator->code + evaluator->length;
+
+	for (const Instruction* it = evaluator->code; it != end; ++it) {
+		switch (it->opcode) {
+		case Opcode_Number:
+			stack[top++] = it->number;
+			break;
+
+		case Opcode_Load:
+			stack[top++] = slots[it->slot];
+			break;
+
+		case Opcode_Negate:
+			stack[top - 1] = -stack[top - 1];
+			break;
+
+		case Opcode_Add:
+			--top;
+			stack[top - 1] = stack[top - 1] + stack[top];
+			break;
+
+		case Opcode_Subtract:
+			--top;
+			stack[top - 1] = stack[top - 1] - stack[top];
+			break;
+
+		case Opcode_Multiply:
+			--top;
+			stack[top - 1] = stack[top - 1] * stack[top];
+			break;
+
+		case Opcode_Divide:
+			--top;
+			stack[top - 1] = stack[top - 1] / stack[top];
+			break;
+
+		case Opcode_Power:
+			--top;
+			stack[top - 1] = evaluate_power(stack[top - 1], stack[top]);
+			break;
+		}
+	}
+
+	assert(top == 1);
+
+	return stack[0];
+}
+
+Interval evaluator_run_interval(const Evaluator* const evaluator,
+                                const Interval* const slots)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols.count == 0);
+
+	Interval stack[EVALUATOR_STACK_MAX];
+	size_t top = 0;
+
+	const Instruction* const end = evaluator->code + evaluator->length;
+
+	for (const Instruction* it = evaluator->code; it != end; ++it) {
+		switch (it->opcode) {
+		case Opcode_Number:
+			stack[top++] = it->bounds;
+			break;
+
+		case Opcode_Load:
+			stack[top++] = slots[it->slot];
+			break;
+
+		case Opcode_Negate:
+			stack[top - 1] = interval_negate(stack[top - 1]);
+			break;
+
+		case Opcode_Add:
+			--top;
+			stack[top - 1] = interval_add(stack[top - 1], stack[top]);
+			break;
+
+		case Opcode_Subtract:
+			--top;
+			stack[top - 1] = interval_subtract(stack[top - 1], stack[top]);
+			break;
+
+		case Opcode_Multiply:
+			--top;
+			stack[top - 1] = interval_multiply(stack[top - 1], stack[top]);
+			break;
+
+		case Opcode_Divide:
+			--top;
+			stack[top - 1] = interval_divide(stack[top - 1], stack[top]);
+			break;
+
+		case Opcode_Power:
+			--top;
+			stack[top - 1] = interval_power(stack[top - 1], stack[top]);
+			break;
+		}
+	}
+
+	assert(top == 1);
+
+	return stack[0];
+}
+
+// @NOTE: Tangents of all slots are carried as rows by stack position, and
+// values without dependence on slots have no row, so that constant parts
+// of expression cost the same as in evaluator_run
+bool evaluator_run_gradient(const Evaluator* const evaluator,
+                            const double* const slots,
+                            double* const value,
+                            double* const gradient)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols.count == 0);
+	assert(value != NULL);
+	assert(gradient != NULL || evaluator->symbols.count == 0);
+
+	const size_t count = evaluator->symbols.count;
+
+	double* const tangents = malloc((evaluator->stack_size * count + 1) * sizeof(double));
+	if (tangents == NULL)
+		return false;
+
+	double stack[EVALUATOR_STACK_MAX];
+	bool active[EVALUATOR_STACK_MAX];
+	size_t top = 0;
+
+	const Instruction* const end = evaluator->code + evaluator->length;
+
+	for (const Instruction* it = evaluator->code; it != end; ++it) {
+		switch (it->opcode) {
+		case Opcode_Number:
+			active[top] = false;
+			stack[top++] = it->number;
+			break;
+
+		case Opcode_Load:
+			memset(tangents + top * count, 0, count * sizeof(double));
+			tangents[top * count + it->slot] = 1;
+
+			active[top] = true;
+			stack[top++] = slots[it->slot];
+			break;
+
+		case Opcode_Negate:
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1],
+			                -1, NULL, false, 0, count);
+			stack[top - 1] = -stack[top - 1];
+			break;
+
+		case Opcode_Add:
+			--top;
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1], 1,
+			                tangents + top * count, active[top], 1, count);
+			stack[top - 1] = stack[top - 1] + stack[top];
+			break;
+
+		case Opcode_Subtract:
+			--top;
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1], 1,
+			                tangents + top * count, active[top], -1, count);
+			stack[top - 1] = stack[top - 1] - stack[top];
+			break;
+
+		case Opcode_Multiply:
+			--top;
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1], stack[top],
+			                tangents + top * count, active[top], stack[top - 1], count);
+			stack[top - 1] = stack[top - 1] * stack[top];
+			break;
+
+		case Opcode_Divide: {
+			--top;
+			const double quotient = stack[top - 1] / stack[top];
+
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1], 1 / stack[top],
+			                tangents + top * count, active[top], -quotient / stack[top], count);
+			stack[top - 1] = quotient;
+		} break;
+
+		case Opcode_Power: {
+			--top;
+			const double base = stack[top - 1];
+			const double exponent = stack[top];
+			const double power = evaluate_power(base, exponent);
+
+			// @NOTE: Zero terms are left out, as their other factor may be
+			// infinite, like 1/x of x^0 or log x of 0^y at zero. Negative
+			// base has real powers at integer exponents only, which don't
+			// change with exponent, so it has no log term either.
+			const double base_scale = exponent != 0
+				? exponent * evaluate_power(base, exponent - 1)
+				: 0;
+			const double exponent_scale =
+				power != 0 && base >= 0 && active[top] &&
+				!tangent_zero(tangents + top * count, count)
+					? power * log(base)
+					: 0;
+
+			tangent_combine(tangents + (top - 1) * count, &active[top - 1], base_scale,
+			                tangents + top * count, active[top], exponent_scale, count);
+			stack[top - 1] = power;
+		} break;
+		}
+	}
+
+	assert(top == 1);
+
+	*value = stack[0];
+
+	for (size_t i = 0; i < count; ++i)
+		gradient[i] = active[0] ? tangents[i] : 0;
+
+	free(tangents);
+
+	return true;
+}
+
+// @NOTE: Widest enclosure is split first, as it overestimates most. Parts
+// cover symbol intervals, so that hull of their enclosures is an enclosure
+Interval evaluator_bound(const Evaluator* const evaluator,
+                         const Interval* const slots,
+                         const size_t budget)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols.count == 0);
+
+	const Interval whole = evaluator_run_interval(evaluator, slots);
+
+	const size_t count = evaluator->symbols.count;
+
+	if (count == 0 || budget < 3 || interval_empty(whole))
+		return whole;
+
+	// @NOTE: Every split evaluates two boxes and adds one
+	const size_t capacity = budget / 2 + 1;
+
+	BoxHeap heap = {
+		malloc(capacity * sizeof(Box)),
+		malloc(capacity * sizeof(size_t)),
+		0,
+	};
+	Interval* const storage = malloc(capacity * count * sizeof(Interval));
+
+	Interval result = whole;
+
+	if (heap.boxes == NULL || heap.indices == NULL || storage == NULL)
+		goto cleanup;
+
+	for (size_t i = 0; i < capacity; ++i)
+		heap.boxes[i].slots = storage + i * count;
+
+	memcpy(heap.boxes[0].slots, slots, count * sizeof(Interval));
+	heap.boxes[0].value = whole;
+	box_heap_push(&heap, 0);
+
+	Interval settled = INTERVAL_EMPTY; // @NOTE: Hull of boxes not split
+	size_t used = 1;
+
+	while (heap.length > 0 && 2 * used + 1 <= budget) {
+		const size_t index = box_heap_pop(&heap);
+		Box* const box = &heap.boxes[index];
+		Box* const half = &heap.boxes[used];
+
+		if (interval_width(box->value) <= 0 ||
+		    !box_split(box, count, box->slots, half->slots)) {
+			settled = interval_hull(settled, box->value);
+			continue;
+		}
+
+		box->value = evaluator_run_interval(evaluator, box->slots);
+		half->value = evaluator_run_interval(evaluator, half->slots);
+
+		box_heap_push(&heap, index);
+		box_heap_push(&heap, used++);
+	}
+
+	for (size_t i = 0; i < heap.length; ++i)
+		settled = interval_hull(settled, heap.boxes[heap.indices[i]].value);
+
+	// @NOTE: Both are enclosures, so is their intersection
+	if (interval_empty(settled))
+		result = settled;
+	else
+		result = Interval(fmax(settled.lower, whole.lower), fmin(settled.upper, whole.upper));
+
+cleanup:
+	free(heap.boxes);
+	free(heap.indices);
+	free(storage);
+
+	return result;
+}
+
+uint64_t expression_hash(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	const uint64_t result = hash_expression(FNV_OFFSET_BASIS, expression, &spine);
+
+	expression_stack_deinit(&spine);
+
+	return result;
+}
+
+void evaluator_cache_deinit(EvaluatorCache* const cache)
+{
+	assert(cache != NULL);
+
+	for (size_t i = 0; i < EVALUATOR_CACHE_CAPACITY; ++i) {
+		if (cache->entries[i] != NULL)
+			evaluator_destroy(&cache->entries[i]);
+	}
+
+	*cache = EvaluatorCache();
+}
+
+const Evaluator* evaluator_cache_get(EvaluatorCache* const cache,
+                                     const Expression* const expression)
+{
+	assert(cache != NULL);
+	assert(expression != NULL);
+
+	const uint64_t hash = expression_hash(expression);
+
+	Evaluator** const entry = &cache->entries[hash % EVALUATOR_CACHE_CAPACITY];
+
+	if (*entry != NULL && (*entry)->hash == hash) {
+		ExpressionStack spine;
+		expression_stack_init(&spine);
+
+		size_t position = 0;
+
+		const bool matches = evaluator_matches(*entry, expression, &spine, &position) &&
+		                     position == (*entry)->length;
+
+		expression_stack_deinit(&spine);
+
+		if (matches) {
+			++cache->hits;
+			return *entry;
+		}
+	}
+
+	++cache->misses;
+
+	Evaluator* const evaluator = evaluator_compile(expression);
+	if (evaluator == NULL)
+		return NULL;
+
+	if (*entry != NULL)
+		evaluator_destroy(entry);
+
+	*entry = evaluator;
+
+	return evaluator;
+}
+
+// @NOTE: Left operands are walked down in a loop, so that long chains don't
+// nest calls, and right operands on the way back up, in the order of calls
+static bool expression_collect(const Expression* const expression,
+                               SymbolTable* const symbols,
+                               ExpressionStack* const spine,
+                               size_t* const length)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+	assert(length != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom)) {
+		++*length;
+		bottom = ((BinaryExpression*)bottom)->left;
+	}
+
+	bool result = expression_collect_node(bottom, symbols, spine, length);
+
+	while (result && spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		result = expression_collect(binary->right, symbols, spine, length);
+	}
+
+	spine->count = base;
+
+	return result;
+}
+
+static bool expression_collect_node(const Expression* const expression,
+                                    SymbolTable* const symbols,
+                                    ExpressionStack* const spine,
+                                    size_t* const length)
+{
+	assert(expression != NULL);
+	assert(symbols != NULL);
+	assert(length != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		++*length;
+
+		if (literal->tag == LiteralTag_Symbol)
+			return symbol_table_intern(symbols, &literal->symbol) != SYMBOL_NONE;
+	} break;
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		*length += unary->operator == TokenType_Minus;
+
+		return expression_collect(unary->subexpression, symbols, spine, length);
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		++*length;
+
+		return expression_collect(binary->left, symbols, spine, length) &&
+		       expression_collect(binary->right, symbols, spine, length);
+	}
+
+	default:
+		++*length;
+		break;
+	}
+
+	return true;
+}
+
+// @NOTE: Chains are walked as by expression_collect
+static bool compiler_emit(Compiler* const compiler,
+                          const Expression* const expression)
+{
+	assert(compiler != NULL && compiler->spine != NULL);
+	assert(expression != NULL);
+
+	ExpressionStack* const spine = compiler->spine;
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom))
+		bottom = ((BinaryExpression*)bottom)->left;
+
+	bool result = compiler_emit_node(compiler, bottom);
+
+	while (result && spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+		const Instruction instruction = {.opcode = BINARY_OPCODE[binary->operator]};
+
+		result = compiler_emit(compiler, binary->right) &&
+		         compiler_push(compiler, instruction, -1);
+	}
+
+	spine->count = base;
+
+	return result;
+}
+
+static bool compiler_emit_node(Compiler* const compiler,
+                               const Expression* const expression)
+{
+	assert(compiler != NULL);
+	assert(expression != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Symbol) {
+			Instruction instruction = {.opcode = Opcode_Load};
+			instruction.slot = symbol_table_find(compiler->symbols, &literal->symbol);
+
+			return compiler_push(compiler, instruction, 1);
+		}
+
+		Instruction instruction = {.opcode = Opcode_Number};
+		instruction.number = literal->number;
+		instruction.bounds = interval_from_rational(literal->rational, literal->number);
+
+		return compiler_push(compiler, instruction, 1);
+	}
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		if (!compiler_emit(compiler, unary->subexpression))
+			return false;
+
+		if (unary->operator != TokenType_Minus)
+			return true;
+
+		const Instruction instruction = {.opcode = Opcode_Negate};
+		return compiler_push(compiler, instruction, 0);
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		if (!compiler_emit(compiler, binary->left) ||
+		    !compiler_emit(compiler, binary->right)) {
+			return false;
+		}
+
+		const Instruction instruction = {.opcode = BINARY_OPCODE[binary->operator]};
+		return compiler_push(compiler, instruction, -1);
+	}
+	}
+
+	// @NOTE: Empty expression evaluates to zero, see evaluate_expression
+	Instruction instruction = {.opcode = Opcode_Number};
+	instruction.number = 0;
+	instruction.bounds = Interval(0, 0);
+
+	return compiler_push(compiler, instruction, 1);
+}
+
+static bool compiler_push(Compiler* const compiler,
+                          const Instruction instruction,
+                          const int depth)
+{
+	assert(compiler != NULL);
+
+	Evaluator* const evaluator = compiler->evaluator;
+
+	compiler->depth += depth;
+
+	if (compiler->depth > EVALUATOR_STACK_MAX)
+		return false;
+
+	if (compiler->depth > evaluator->stack_size)
+		evaluator->stack_size = compiler->depth;
+
+	evaluator->code[evaluator->length++] = instruction;
+
+	return true;
+}
+
+// @NOTE: Chains are walked as by expression_collect
+static bool evaluator_matches(const Evaluator* const evaluator,
+                              const Expression* const expression,
+                              ExpressionStack* const spine,
+                              size_t* const position)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom))
+		bottom = ((BinaryExpression*)bottom)->left;
+
+	bool result = evaluator_matches_node(evaluator, bottom, spine, position);
+
+	while (result && spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		result = evaluator_matches(evaluator, binary->right, spine, position) &&
+		         evaluator_matches_instruction(evaluator, BINARY_OPCODE[binary->operator],
+		                                       position);
+	}
+
+	spine->count = base;
+
+	return result;
+}
+
+static bool evaluator_matches_node(const Evaluator* const evaluator,
+                                   const Expression* const expression,
+                                   ExpressionStack* const spine,
+                                   size_t* const position)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+	assert(position != NULL);
+
+	const Instruction* const code = evaluator->code;
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (*position == evaluator->length)
+			return false;
+
+		const Instruction* const instruction = &code[(*position)++];
+
+		if (literal->tag == LiteralTag_Symbol) {
+			return instruction->opcode == Opcode_Load &&
+			       string_equal(symbol_table_name(&evaluator->symbols, instruction->slot),
+			                    &literal->symbol);
+		}
+
+		return instruction->opcode == Opcode_Number &&
+		       number_identical(instruction->number, literal->number) &&
+		       interval_identical(instruction->bounds,
+		                          interval_from_rational(literal->rational,
+		                                                 literal->number));
+	}
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		if (!evaluator_matches(evaluator, unary->subexpression, spine, position))
+			return false;
+
+		if (unary->operator != TokenType_Minus)
+			return true;
+
+		return evaluator_matches_instruction(evaluator, Opcode_Negate, position);
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		if (!evaluator_matches(evaluator, binary->left, spine, position) ||
+		    !evaluator_matches(evaluator, binary->right, spine, position)) {
+			return false;
+		}
+
+		return evaluator_matches_instruction(evaluator, BINARY_OPCODE[binary->operator],
+		                                     position);
+	}
+	}
+
+	return *position < evaluator->length &&
+	       code[*position].opcode == Opcode_Number &&
+	       number_identical(code[(*position)++].number, 0);
+}
+
+static bool evaluator_matches_instruction(const Evaluator* const evaluator,
+                                          const Opcode opcode,
+                                          size_t* const position)
+{
+	assert(evaluator != NULL);
+	assert(position != NULL);
+
+	return *position < evaluator->length && evaluator->code[(*position)++].opcode == opcode;
+}
+
+// @NOTE: Fused instructions compute the same operations in the same order,
+// so that results are the same as of plain code
+static bool evaluator_thread(Evaluator* const evaluator)
+{
+	assert(evaluator != NULL);
+
+	// @NOTE: Fused code isn't longer than plain code, but ends with return
+	ThreadedInstruction* const threaded =
+		malloc((evaluator->length + 1) * sizeof(ThreadedInstruction));
+	if (threaded == NULL)
+		return false;
+
+	const void* const* handlers = NULL;
+	threaded_execute(NULL, NULL, &handlers);
+
+	const Instruction* const code = evaluator->code;
+	const size_t length = evaluator->length;
+
+	size_t count = 0;
+
+	for (size_t i = 0; i < length; ++i) {
+		const Opcode next = i + 1 < length ? code[i + 1].opcode : Opcode_Return;
+		const Opcode after = i + 2 < length ? code[i + 2].opcode : Opcode_Return;
+
+		ThreadedInstruction* const instruction = &threaded[count++];
+		Opcode opcode = code[i].opcode;
+
+		if (opcode == Opcode_Number)
+			instruction->number = code[i].number;
+		else if (opcode == Opcode_Load)
+			instruction->slot = code[i].slot;
+
+		// @NOTE: Powers are reduced the same way as by evaluate_power
+		const double number = opcode == Opcode_Number ? code[i].number : 0;
+
+		if (opcode == Opcode_Number && next == Opcode_Power && number == 2) {
+			opcode = Opcode_Square;
+			++i;
+		}
+		else if (opcode == Opcode_Number && next == Opcode_Power && number == 0.5) {
+			opcode = Opcode_SquareRoot;
+			++i;
+		}
+		else if (opcode == Opcode_Number && next == Opcode_Power &&
+		         fabs(number) <= POWER_CHAIN_MAX && trunc(number) == number) {
+			opcode = Opcode_PowerChain;
+			instruction->exponent = (int)number;
+			++i;
+		}
+		else if (opcode == Opcode_Number && NUMBER_OPCODE[next] != Opcode_Number) {
+			opcode = NUMBER_OPCODE[next];
+			++i;
+		}
+		else if (opcode == Opcode_Load && LOAD_OPCODE[next] != Opcode_Number) {
+			opcode = LOAD_OPCODE[next];
+			++i;
+		}
+		else if (opcode == Opcode_Multiply && next == Opcode_Add) {
+			opcode = Opcode_MultiplyAdd;
+			++i;
+		}
+		else if (opcode == Opcode_Multiply && next == Opcode_Load && after == Opcode_Add) {
+			opcode = Opcode_MultiplyAddLoad;
+			instruction->slot = code[i + 1].slot;
+			i += 2;
+		}
+
+		instruction->handler = handlers[opcode];
+	}
+
+	threaded[count++].handler = handlers[Opcode_Return];
+
+	evaluator->threaded = threaded;
+	evaluator->threaded_length = count;
+
+	return true;
+}
+
+// @NOTE: Every handler jumps to handler of the next instruction itself, so
+// that there is no central dispatch and its mispredicted branch
+static double threaded_execute(const ThreadedInstruction* const code,
+                               const double* const slots,
+                               const void* const** const handlers)
+{
+	static const void* const HANDLERS[Opcode__count] = {
+		[Opcode_Number] = &&number,
+		[Opcode_Load] = &&load,
+		[Opcode_Negate] = &&negate,
+		[Opcode_Add] = &&add,
+		[Opcode_Subtract] = &&subtract,
+		[Opcode_Multiply] = &&multiply,
+		[Opcode_Divide] = &&divide,
+		[Opcode_Power] = &&power,
+		[Opcode_AddNumber] = &&add_number,
+		[Opcode_SubtractNumber] = &&subtract_number,
+		[Opcode_MultiplyNumber] = &&multiply_number,
+		[Opcode_DivideNumber] = &&divide_number,
+		[Opcode_PowerNumber] = &&power_number,
+		[Opcode_AddLoad] = &&add_load,
+		[Opcode_SubtractLoad] = &&subtract_load,
+		[Opcode_MultiplyLoad] = &&multiply_load,
+		[Opcode_DivideLoad] = &&divide_load,
+		[Opcode_PowerLoad] = &&power_load,
+		[Opcode_Square] = &&square,
+		[Opcode_SquareRoot] = &&square_root,
+		[Opcode_PowerChain] = &&power_chain,
+		[Opcode_MultiplyAdd] = &&multiply_add,
+		[Opcode_MultiplyAddLoad] = &&multiply_add_load,
+		[Opcode_Return] = &&finish,
+	};
+
+	if (code == NULL) {
+		assert(handlers != NULL);
+
+		*handlers = HANDLERS;
+		return 0;
+	}
+
+	double stack[EVALUATOR_STACK_MAX];
+	size_t top = 0;
+
+	const ThreadedInstruction* it = code;
+
+#define DISPATCH() goto *(++it)->handler
+
+	goto *it->handler;
+
+number:
+	stack[top++] = it->number;
+	DISPATCH();
+
+load:
+	stack[top++] = slots[it->slot];
+	DISPATCH();
+
+negate:
+	stack[top - 1] = -stack[top - 1];
+	DISPATCH();
+
+add:
+	--top;
+	stack[top - 1] = stack[top - 1] + stack[top];
+	DISPATCH();
+
+subtract:
+	--top;
+	stack[top - 1] = stack[top - 1] - stack[top];
+	DISPATCH();
+
+multiply:
+	--top;
+	stack[top - 1] = stack[top - 1] * stack[top];
+	DISPATCH();
+
+divide:
+	--top;
+	stack[top - 1] = stack[top - 1] / stack[top];
+	DISPATCH();
+
+power:
+	--top;
+	stack[top - 1] = evaluate_power(stack[top - 1], stack[top]);
+	DISPATCH();
+
+add_number:
+	stack[top - 1] = stack[top - 1] + it->number;
+	DISPATCH();
+
+subtract_number:
+	stack[top - 1] = stack[top - 1] - it->number;
+	DISPATCH();
+
+multiply_number:
+	stack[top - 1] = stack[top - 1] * it->number;
+	DISPATCH();
+
+divide_number:
+	stack[top - 1] = stack[top - 1] / it->number;
+	DISPATCH();
+
+power_number:
+	stack[top - 1] = pow(stack[top - 1], it->number);
+	DISPATCH();
+
+add_load:
+	stack[top - 1] = stack[top - 1] + slots[it->slot];
+	DISPATCH();
+
+subtract_load:
+	stack[top - 1] = stack[top - 1] - slots[it->slot];
+	DISPATCH();
+
+multiply_load:
+	stack[top - 1] = stack[top - 1] * slots[it->slot];
+	DISPATCH();
+
+divide_load:
+	stack[top - 1] = stack[top - 1] / slots[it->slot];
+	DISPATCH();
+
+power_load:
+	stack[top - 1] = evaluate_power(stack[top - 1], slots[it->slot]);
+	DISPATCH();
+
+square:
+	// @NOTE: Square is exact before rounding, so is the same as pow
+	stack[top - 1] = stack[top - 1] * stack[top - 1];
+	DISPATCH();
+
+square_root:
+	stack[top - 1] = evaluate_square_root(stack[top - 1]);
+	DISPATCH();
+
+power_chain:
+	stack[top - 1] = evaluate_power_integer(stack[top - 1], it->exponent);
+	DISPATCH();
+
+multiply_add:
+	top -= 2;
+	stack[top - 1] = stack[top - 1] + stack[top] * stack[top + 1];
+	DISPATCH();
+
+multiply_add_load:
+	--top;
+	stack[top - 1] = stack[top - 1] * stack[top] + slots[it->slot];
+	DISPATCH();
+
+#undef DISPATCH
+
+finish:
+	assert(top == 1);
+
+	return stack[0];
+}
+
+static bool number_identical(const double lhs, const double rhs)
+{
+	return memcmp(&lhs, &rhs, sizeof(double)) == 0;
+}
+
+static bool interval_identical(const Interval lhs, const Interval rhs)
+{
+	return number_identical(lhs.lower, rhs.lower) &&
+	       number_identical(lhs.upper, rhs.upper);
+}
+
+// Empty intervals go last
+static void tangent_combine(double* const tangent,
+                            bool* const active,
+                            const double scale,
+                            const double* const operand,
+                            const bool operand_active,
+                            const double operand_scale,
+                            const size_t count)
+{
+	assert(tangent != NULL);
+	assert(active != NULL);
+	assert(operand != NULL || !operand_active);
+
+	if (*active && operand_active) {
+		for (size_t i = 0; i < count; ++i)
+			tangent[i] = scale * tangent[i] + operand_scale * operand[i];
+	}
+	else if (*active) {
+		for (size_t i = 0; i < count; ++i)
+			tangent[i] *= scale;
+	}
+	else if (operand_active) {
+		for (size_t i = 0; i < count; ++i)
+			tangent[i] = operand_scale * operand[i];
+	}
+
+	*active |= operand_active;
+}
+
+static bool tangent_zero(const double* const tangent, const size_t count)
+{
+	assert(tangent != NULL);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (tangent[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static double interval_width(const Interval interval)
+{
+	if (interval_empty(interval))
+		return -1;
+
+	return interval.upper - interval.lower;
+}
+
+static void box_heap_push(BoxHeap* const heap, const size_t index)
+{
+	assert(heap != NULL);
+
+	size_t child = heap->length++;
+
+	while (child > 0) {
+		const size_t parent = (child - 1) / 2;
+
+		if (interval_width(heap->boxes[heap->indices[parent]].value) >=
+		    interval_width(heap->boxes[index].value)) {
+			break;
+		}
+
+		heap->indices[child] = heap->indices[parent];
+		child = parent;
+	}
+
+	heap->indices[child] = index;
+}
+
+static size_t box_heap_pop(BoxHeap* const heap)
+{
+	assert(heap != NULL && heap->length > 0);
+
+	const size_t result = heap->indices[0];
+	const size_t last = heap->indices[--heap->length];
+	const double width = interval_width(heap->boxes[last].value);
+
+	size_t parent = 0;
+
+	for (;;) {
+		size_t child = 2 * parent + 1;
+
+		if (child >= heap->length)
+			break;
+
+		if (child + 1 < heap->length &&
+		    interval_width(heap->boxes[heap->indices[child + 1]].value) >
+		    interval_width(heap->boxes[heap->indices[child]].value)) {
+			++child;
+		}
+
+		if (interval_width(heap->boxes[heap->indices[child]].value) <= width)
+			break;
+
+		heap->indices[parent] = heap->indices[child];
+		parent = child;
+	}
+
+	if (heap->length > 0)
+		heap->indices[parent] = last;
+
+	return result;
+}
+
+static bool box_split(const Box* const box,
+                      const size_t count,
+                      Interval* const lower,
+                      Interval* const upper)
+{
+	assert(box != NULL);
+	assert(lower != NULL && upper != NULL);
+
+	size_t widest = count;
+	double width = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		const double slot_width = box->slots[i].upper - box->slots[i].lower;
+
+		if (isfinite(slot_width) && slot_width > width) {
+			widest = i;
+			width = slot_width;
+		}
+	}
+
+	if (widest == count)
+		return false;
+
+	const Interval slot = box->slots[widest];
+	const double midpoint = slot.lower + width / 2;
+
+	if (!(slot.lower < midpoint && midpoint < slot.upper))
+		return false;
+
+	memcpy(upper, box->slots, count * sizeof(Interval));
+
+	if (lower != box->slots)
+		memcpy(lower, box->slots, count * sizeof(Interval));
+
+	lower[widest].upper = midpoint;
+	upper[widest].lower = midpoint;
+
+	return true;
+}
+
+// @NOTE: Nodes are hashed in pre-order, which is unambiguous as arity of
+// every node is known from its type. Nodes of chain are hashed while it's
+// walked down in a loop, and right operands on the way back up.
+static uint64_t hash_expression(uint64_t hash,
+                                const Expression* const expression,
+                                ExpressionStack* const spine)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom)) {
+		hash = hash_node(hash, bottom);
+		bottom = ((BinaryExpression*)bottom)->left;
+	}
+
+	hash = hash_node(hash, bottom);
+
+	if (bottom->type == ExpressionType_Unary)
+		hash = hash_expression(hash, ((UnaryExpression*)bottom)->subexpression, spine);
+	else if (bottom->type == ExpressionType_Binary) {
+		const BinaryExpression* const binary = (BinaryExpression*)bottom;
+
+		hash = hash_expression(hash, binary->left, spine);
+		hash = hash_expression(hash, binary->right, spine);
+	}
+
+	while (spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		hash = hash_expression(hash, binary->right, spine);
+	}
+
+	return hash;
+}
+
+// Hash node without its operands
+static uint64_t hash_node(uint64_t hash, const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	hash = hash_bytes(hash, &expression->type, sizeof(expression->type));
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		hash = hash_bytes(hash, &literal->tag, sizeof(literal->tag));
+
+		if (literal->tag == LiteralTag_Symbol) {
+			hash = hash_bytes(hash, &literal->symbol.length, sizeof(size_t));
+			return hash_bytes(hash, literal->symbol.text, literal->symbol.length);
+		}
+
+		return hash_bytes(hash, &literal->number, sizeof(double));
+	}
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+		return hash_bytes(hash, &unary->operator, sizeof(unary->operator));
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		return hash_bytes(hash, &binary->operator, sizeof(binary->operator));
+	}
+	}
+
+	return hash;
+}
@@ -0,0 +1,148 @@
+#ifndef __EVALUATOR_H__
+#define __EVALUATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "parser.h"
+#include "symbol.h"
+#include "interval.h"
+
+// Expressions which need deeper evaluation stack aren't compiled
+#define EVALUATOR_STACK_MAX 1024
+
+// Evaluators are cached in this many slots, see EvaluatorCache
+#define EVALUATOR_CACHE_CAPACITY 256
+
+typedef enum opcode {
+	Opcode_Number,
+	Opcode_Load,
+	Opcode_Negate,
+	Opcode_Add,
+	Opcode_Subtract,
+	Opcode_Multiply,
+	Opcode_Divide,
+	Opcode_Power,
+
+	// @NOTE: Superinstructions are only in threaded code, fused by peephole
+	// pass. Ones with number or slot take it as right operand
+	Opcode_AddNumber,
+	Opcode_SubtractNumber,
+	Opcode_MultiplyNumber,
+	Opcode_DivideNumber,
+	Opcode_PowerNumber,
+	Opcode_AddLoad,
+	Opcode_SubtractLoad,
+	Opcode_MultiplyLoad,
+	Opcode_DivideLoad,
+	Opcode_PowerLoad,
+	Opcode_Square,          // Power by number 2
+	Opcode_SquareRoot,      // Power by number 0.5
+	Opcode_PowerChain,      // Power by small integer, see POWER_CHAIN_MAX
+	Opcode_MultiplyAdd,     // Multiply, then add product to value below
+	Opcode_MultiplyAddLoad, // Multiply, then add slot to product
+	Opcode_Return,
+	Opcode__count,
+} Opcode;
+
+typedef struct instruction {
+	Opcode opcode;
+	union {
+		struct {
+			double number;
+			Interval bounds; // @NOTE: Enclosure of exact value of number
+		};
+		size_t slot;
+	};
+} Instruction;
+
+// Instruction of direct-threaded code, which holds address of its handler
+// in place of opcode
+typedef struct threaded_instruction {
+	const void* handler;
+	union {
+		double number;
+		size_t slot;
+		int exponent;
+	};
+} ThreadedInstruction;
+
+// Expression compiled once into postfix code over a value stack, with
+// symbols resolved to slots in advance, so that it is evaluated for many
+// symbol values without walking the tree. Evaluator owns text of symbols and
+// doesn't depend on the compiled expression.
+//
+// Code is also threaded with common instruction sequences fused, which is
+// what evaluator_run executes.
+typedef struct evaluator {
+	Instruction* code;
+	size_t length;
+	ThreadedInstruction* threaded; // @NOTE: Ends with Opcode_Return
+	size_t threaded_length;
+	size_t stack_size;
+	SymbolTable symbols; // @NOTE: Symbol identifiers are slot indices
+	uint8_t* names;
+	uint64_t hash; // Structural hash of compiled expression
+} Evaluator;
+
+// Compile expression, return NULL if memory is exhausted or expression is
+// too deep
+extern Evaluator* evaluator_compile(const Expression* const expression);
+extern void evaluator_destroy(Evaluator** const evaluator);
+
+// Slot of symbol or SYMBOL_NONE if expression doesn't have it
+extern size_t evaluator_slot(const Evaluator* const evaluator,
+                             const String* const symbol);
+
+// Evaluate with values of symbols by slot, same as evaluate_expression
+// with symbols replaced by values
+extern double evaluator_run(const Evaluator* const evaluator,
+                            const double* const slots);
+
+// Evaluate plain code with a switch per instruction, as evaluator_run did
+// before code was threaded; kept as a baseline for benchmarks
+extern double evaluator_run_switch(const Evaluator* const evaluator,
+                                   const double* const slots);
+
+// Evaluate with forward-mode differentiation, writing value and partial
+// derivatives by slot; return false if memory is exhausted
+extern bool evaluator_run_gradient(const Evaluator* const evaluator,
+                                   const double* const slots,
+                                   double* const value,
+                                   double* const gradient);
+
+// Evaluate with interval arithmetic, result encloses values of expression
+// for all symbol values in intervals by slot
+extern Interval evaluator_run_interval(const Evaluator* const evaluator,
+                                       const Interval* const slots);
+
+// Refine enclosure by bisecting intervals of symbols and bounding parts
+// separately, at most budget evaluations are made
+extern Interval evaluator_bound(const Evaluator* const evaluator,
+                                const Interval* const slots,
+                                const size_t budget);
+
+// Hash of expression structure, operators, numbers and symbols, but not
+// parentheses or source spans
+extern uint64_t expression_hash(const Expression* const expression);
+
+// Direct-mapped cache of evaluators by structural hash of expressions; on
+// collision the older evaluator is replaced.
+typedef struct evaluator_cache {
+	Evaluator* entries[EVALUATOR_CACHE_CAPACITY];
+	size_t hits;
+	size_t misses;
+} EvaluatorCache;
+
+#define EvaluatorCache() (EvaluatorCache){{NULL}, 0, 0}
+
+extern void evaluator_cache_deinit(EvaluatorCache* const cache);
+
+// Return cached evaluator of structurally equal expression, compiling it on
+// miss, or NULL if compilation failed. Evaluator may be replaced by the
+// next call.
+extern const Evaluator* evaluator_cache_get(EvaluatorCache* const cache,
+                                            const Expression* const expression);
+
+#endif // __EVALUATOR_H__
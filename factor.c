@@ -0,0 +1,947 @@
+#include "factor.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Prime for modular coprimality test
+#define MODULUS 2147483647u
+
+typedef struct factor {
+	Polynomial polynomial;
+	uint32_t multiplicity;
+} Factor;
+
+typedef struct factors {
+	Factor* items;
+	size_t count;
+	size_t capacity;
+} Factors;
+
+static bool budget_exhausted(FactorBudget* const budget);
+
+static bool factors_add(Factors* const factors,
+                        Polynomial* const polynomial,
+                        const uint32_t multiplicity);
+static void factors_deinit(Factors* const factors);
+static Expression* factors_to_expression(const Factors* const factors,
+                                         const Rational constant,
+                                         const SymbolTable* const symbols);
+
+static bool factor_monomial(Polynomial* const polynomial,
+                            Factors* const factors);
+static bool factor_square_free(const Polynomial* const polynomial,
+                               FactorBudget* const budget,
+                               Factors* const factors);
+static bool factor_binomial(Polynomial* const polynomial,
+                            const uint32_t multiplicity,
+                            Factors* const factors);
+
+static bool polynomial_primitive(const Polynomial* const polynomial,
+                                 Polynomial* const result);
+static size_t polynomial_main_variable(const Polynomial* const lhs,
+                                       const Polynomial* const rhs);
+static bool polynomial_content(const Polynomial* const polynomial,
+                               const size_t variable,
+                               FactorBudget* const budget,
+                               Polynomial* const result);
+static bool polynomial_primitive_part(const Polynomial* const polynomial,
+                                      const size_t variable,
+                                      FactorBudget* const budget,
+                                      Polynomial* const result);
+static bool polynomial_pseudo_remainder(const Polynomial* const lhs,
+                                        const Polynomial* const rhs,
+                                        const size_t variable,
+                                        FactorBudget* const budget,
+                                        Polynomial* const result);
+static bool polynomial_gcd(const Polynomial* const lhs,
+                           const Polynomial* const rhs,
+                           FactorBudget* const budget,
+                           Polynomial* const result);
+
+static bool polynomial_coprime(const Polynomial* const lhs,
+                               const Polynomial* const rhs,
+                               const size_t variable);
+static bool polynomial_evaluate_modular(const Polynomial* const polynomial,
+                                        const size_t variable,
+                                        uint64_t* const coefficients);
+static uint32_t modular_gcd_degree(uint64_t* lhs,
+                                   uint32_t lhs_degree,
+                                   uint64_t* rhs,
+                                   uint32_t rhs_degree);
+static uint64_t modular_power(uint64_t base, uint64_t exponent);
+
+static int64_t integer_gcd(int64_t lhs, int64_t rhs);
+static int64_t integer_root(const int64_t value, const unsigned degree);
+
+FactorBudget factor_budget_start(void)
+{
+	return (FactorBudget){
+		clock() + (clock_t)FACTOR_TIME_BUDGET_MS * CLOCKS_PER_SEC / 1000,
+		false,
+	};
+}
+
+Expression* polynomial_factor(const Polynomial* const polynomial,
+                              const SymbolTable* const symbols,
+                              FactorBudget* const budget)
+{
+	assert(polynomial != NULL);
+	assert(symbols != NULL);
+	assert(budget != NULL);
+
+	if (polynomial->length < 2)
+		return polynomial_to_expression(polynomial, symbols);
+
+	Factors factors = {NULL, 0, 0};
+
+	Polynomial primitive, product, quotient;
+	Rational constant = RATIONAL_INEXACT;
+
+	product = quotient = Polynomial(polynomial->variables);
+
+	bool success = polynomial_primitive(polynomial, &primitive) &&
+	               factor_monomial(&primitive, &factors) &&
+	               factor_square_free(&primitive, budget, &factors) &&
+	               polynomial_append(&product, rational_integer(1), NULL);
+
+	// @NOTE: Factors are known up to constants, which are recovered by
+	// dividing polynomial by their product, this also checks the result
+	for (size_t i = 0; success && i < factors.count; ++i) {
+		Polynomial power, next = Polynomial(polynomial->variables);
+
+		success = polynomial_power(&factors.items[i].polynomial,
+		                           factors.items[i].multiplicity,
+		                           &power) &&
+		          polynomial_multiply(&product, &power, &next);
+
+		polynomial_deinit(&power);
+		polynomial_deinit(&product);
+		product = next;
+	}
+
+	success = success &&
+	          polynomial_divide(polynomial, &product, &quotient) &&
+	          polynomial_constant(&quotient, &constant);
+
+	Expression* result = NULL;
+
+	if (success) {
+		size_t count = 0;
+
+		for (size_t i = 0; i < factors.count; ++i)
+			count += factors.items[i].multiplicity;
+
+		const bool unit = constant.denominator == 1 &&
+		                  (constant.numerator == 1 || constant.numerator == -1);
+
+		if (count < 2 && unit)
+			result = polynomial_to_expression(polynomial, symbols);
+		else
+			result = factors_to_expression(&factors, constant, symbols);
+	}
+
+	polynomial_deinit(&primitive);
+	polynomial_deinit(&product);
+	polynomial_deinit(&quotient);
+	factors_deinit(&factors);
+
+	return result;
+}
+
+static bool budget_exhausted(FactorBudget* const budget)
+{
+	assert(budget != NULL);
+
+	if (!budget->exhausted && clock() > budget->deadline)
+		budget->exhausted = true;
+
+	return budget->exhausted;
+}
+
+// Take ownership of polynomial, it's released on failure
+static bool factors_add(Factors* const factors,
+                        Polynomial* const polynomial,
+                        const uint32_t multiplicity)
+{
+	assert(factors != NULL);
+	assert(polynomial != NULL);
+
+	if (factors->count == factors->capacity) {
+		const size_t capacity = factors->capacity > 0 ? 2 * factors->capacity : 4;
+
+		Factor* const items = realloc(factors->items, capacity * sizeof(Factor));
+		if (items == NULL) {
+			polynomial_deinit(polynomial);
+			return false;
+		}
+
+		factors->items = items;
+		factors->capacity = capacity;
+	}
+
+	factors->items[factors->count++] = (Factor){*polynomial, multiplicity};
+
+	return true;
+}
+
+static void factors_deinit(Factors* const factors)
+{
+	assert(factors != NULL);
+
+	for (size_t i = 0; i < factors->count; ++i)
+		polynomial_deinit(&factors->items[i].polynomial);
+
+	free(factors->items);
+}
+
+// Build [numerator *] factor [^ multiplicity] * ... [/ denominator]
+static Expression* factors_to_expression(const Factors* const factors,
+                                         const Rational constant,
+                                         const SymbolTable* const symbols)
+{
+	assert(factors != NULL);
+	assert(symbols != NULL);
+
+	const bool negative = constant.numerator < 0;
+	const int64_t numerator = negative ? -constant.numerator : constant.numerator;
+
+	Expression* result = NULL;
+
+	if (numerator != 1 || factors->count == 0) {
+		result = (Expression*)expression_literal_create_rational(
+			rational_integer(constant.numerator));
+		if (result == NULL)
+			return NULL;
+	}
+
+	for (size_t i = 0; i < factors->count; ++i) {
+		const Factor* const factor = &factors->items[i];
+
+		Expression* term = polynomial_to_expression(&factor->polynomial, symbols);
+
+		if (term != NULL && factor->multiplicity > 1) {
+			term = expression_binary_join(
+				TokenType_Exponent,
+				term,
+				(Expression*)expression_literal_create_rational(
+					rational_integer(factor->multiplicity)));
+		}
+
+		// @NOTE: Sign of unit constant goes to the first factor
+		if (result == NULL) {
+			if (term != NULL && negative) {
+				Expression* const unary = (Expression*)expression_unary_create(TokenType_Minus, term);
+				if (unary == NULL)
+					expression_destroy(&term);
+
+				term = unary;
+			}
+
+			result = term;
+
+			if (result == NULL)
+				return NULL;
+
+			continue;
+		}
+
+		result = expression_binary_join(TokenType_Multiply, result, term);
+		if (result == NULL)
+			return NULL;
+	}
+
+	if (constant.denominator != 1) {
+		result = expression_binary_join(
+			TokenType_Divide,
+			result,
+			(Expression*)expression_literal_create_rational(rational_integer(constant.denominator)));
+	}
+
+	return result;
+}
+
+// Divide polynomial by the greatest monomial dividing all its terms and
+// add symbols of that monomial as factors
+static bool factor_monomial(Polynomial* const polynomial, Factors* const factors)
+{
+	assert(polynomial != NULL && polynomial->length > 0);
+	assert(factors != NULL);
+
+	const size_t variables = polynomial->variables;
+
+	uint32_t* const exponents = malloc((variables + 1) * sizeof(uint32_t));
+	if (exponents == NULL)
+		return false;
+
+	memcpy(exponents, polynomial_monomial(polynomial, 0), variables * sizeof(uint32_t));
+
+	for (size_t i = 1; i < polynomial->length; ++i) {
+		const uint32_t* const monomial = polynomial_monomial(polynomial, i);
+
+		for (size_t id = 0; id < variables; ++id) {
+			if (monomial[id] < exponents[id])
+				exponents[id] = monomial[id];
+		}
+	}
+
+	Polynomial monomial = Polynomial(variables);
+	Polynomial quotient = Polynomial(variables);
+
+	bool success = polynomial_append(&monomial, rational_integer(1), exponents) &&
+	               polynomial_divide(polynomial, &monomial, &quotient);
+
+	uint32_t* const symbol = exponents;
+
+	for (size_t id = 0; success && id < variables; ++id) {
+		if (polynomial_monomial(&monomial, 0)[id] == 0)
+			continue;
+
+		memset(symbol, 0, variables * sizeof(uint32_t));
+		symbol[id] = 1;
+
+		Polynomial factor = Polynomial(variables);
+
+		success = polynomial_append(&factor, rational_integer(1), symbol) &&
+		          factors_add(factors, &factor, polynomial_monomial(&monomial, 0)[id]);
+	}
+
+	polynomial_deinit(&monomial);
+	free(exponents);
+
+	if (success) {
+		polynomial_deinit(polynomial);
+		*polynomial = quotient;
+	}
+	else
+		polynomial_deinit(&quotient);
+
+	return success;
+}
+
+// Yun's square-free decomposition in the first variable, the content in it
+// is decomposed recursively in the remaining ones
+static bool factor_square_free(const Polynomial* const polynomial,
+                               FactorBudget* const budget,
+                               Factors* const factors)
+{
+	assert(polynomial != NULL);
+	assert(budget != NULL);
+	assert(factors != NULL);
+
+	const size_t variable = polynomial_main_variable(polynomial, NULL);
+	if (variable == SYMBOL_NONE)
+		return true;
+
+	const size_t variables = polynomial->variables;
+
+	Polynomial content, primitive, derivative, divisor, c, d, a, y, z, next;
+
+	content = primitive = derivative = divisor = Polynomial(variables);
+	c = d = a = y = z = next = Polynomial(variables);
+
+	bool success =
+		polynomial_content(polynomial, variable, budget, &content) &&
+		polynomial_divide(polynomial, &content, &primitive) &&
+		factor_square_free(&content, budget, factors) &&
+		polynomial_derivative(&primitive, variable, &derivative) &&
+		polynomial_gcd(&primitive, &derivative, budget, &divisor) &&
+		polynomial_divide(&primitive, &divisor, &c) &&
+		polynomial_divide(&derivative, &divisor, &y) &&
+		polynomial_derivative(&c, variable, &z) &&
+		polynomial_subtract(&y, &z, &d);
+
+	for (uint32_t multiplicity = 1;
+	     success && polynomial_variable_degree(&c, variable) > 0;
+	     ++multiplicity) {
+		polynomial_deinit(&a);
+		polynomial_deinit(&next);
+		polynomial_deinit(&y);
+		polynomial_deinit(&z);
+
+		success = !budget_exhausted(budget) &&
+		          polynomial_gcd(&c, &d, budget, &a) &&
+		          polynomial_divide(&c, &a, &next) &&
+		          polynomial_divide(&d, &a, &y) &&
+		          polynomial_derivative(&next, variable, &z);
+
+		polynomial_deinit(&c);
+		polynomial_deinit(&d);
+		c = next;
+		next = Polynomial(variables);
+
+		success = success && polynomial_subtract(&y, &z, &d);
+
+		Rational value;
+
+		if (success && !polynomial_constant(&a, &value)) {
+			success = factor_binomial(&a, multiplicity, factors);
+			a = Polynomial(variables);
+		}
+	}
+
+	polynomial_deinit(&content);
+	polynomial_deinit(&primitive);
+	polynomial_deinit(&derivative);
+	polynomial_deinit(&divisor);
+	polynomial_deinit(&c);
+	polynomial_deinit(&d);
+	polynomial_deinit(&a);
+	polynomial_deinit(&y);
+	polynomial_deinit(&z);
+	polynomial_deinit(&next);
+
+	return success;
+}
+
+// Split differences of squares and sums and differences of cubes of
+// monomials, taking ownership of polynomial
+//
+// Examples: 4 * a ^ 2 - 9 -> (2 * a - 3) * (2 * a + 3),
+//           a ^ 3 + b ^ 3 -> (a + b) * (a ^ 2 - a * b + b ^ 2)
+static bool factor_binomial(Polynomial* const polynomial,
+                            const uint32_t multiplicity,
+                            Factors* const factors)
+{
+	assert(polynomial != NULL);
+	assert(factors != NULL);
+
+	if (polynomial->length != 2)
+		return factors_add(factors, polynomial, multiplicity);
+
+	const size_t variables = polynomial->variables;
+
+	const int64_t first = polynomial->coefficients[0].numerator;
+	const int64_t second = polynomial->coefficients[1].numerator;
+
+	if (first <= 0 || second == INT64_MIN)
+		return factors_add(factors, polynomial, multiplicity);
+
+	// @NOTE: Squares are tried first, so that a ^ 6 - b ^ 6 splits fully
+	for (unsigned degree = 2; degree <= 3; ++degree) {
+		if (degree == 2 && second > 0)
+			continue;
+
+		bool divisible = polynomial->coefficients[0].denominator == 1 &&
+		                 polynomial->coefficients[1].denominator == 1;
+
+		for (size_t i = 0; divisible && i < 2 * variables; ++i)
+			divisible = polynomial->exponents[i] % degree == 0;
+
+		const int64_t lhs_root = divisible ? integer_root(first, degree) : -1;
+		const int64_t rhs_root = divisible ? integer_root(second < 0 ? -second : second, degree) : -1;
+
+		if (lhs_root < 0 || rhs_root < 0)
+			continue;
+
+		uint32_t* const exponents = malloc((2 * variables + 1) * sizeof(uint32_t));
+		if (exponents == NULL)
+			break;
+
+		for (size_t i = 0; i < 2 * variables; ++i)
+			exponents[i] = polynomial->exponents[i] / degree;
+
+		Polynomial lhs, rhs, linear, rest, product, square;
+
+		lhs = rhs = linear = rest = product = square = Polynomial(variables);
+
+		const bool difference = second < 0;
+
+		bool success = polynomial_append(&lhs, rational_integer(lhs_root), exponents) &&
+		               polynomial_append(&rhs, rational_integer(rhs_root), exponents + variables);
+
+		free(exponents);
+
+		if (degree == 2) {
+			success = success &&
+			          polynomial_subtract(&lhs, &rhs, &linear) &&
+			          polynomial_add(&lhs, &rhs, &rest);
+		}
+		else {
+			// @NOTE: a ^ 2 -+ a * b + b ^ 2 is irreducible over rationals
+			success = success &&
+			          (difference ? polynomial_subtract(&lhs, &rhs, &linear)
+			                      : polynomial_add(&lhs, &rhs, &linear)) &&
+			          polynomial_multiply(&lhs, &rhs, &product) &&
+			          polynomial_multiply(&lhs, &lhs, &square) &&
+			          (difference ? polynomial_add(&square, &product, &rest)
+			                      : polynomial_subtract(&square, &product, &rest));
+
+			polynomial_deinit(&product);
+			polynomial_deinit(&square);
+
+			success = success &&
+			          polynomial_multiply(&rhs, &rhs, &square) &&
+			          polynomial_add(&rest, &square, &rest);
+		}
+
+		polynomial_deinit(&lhs);
+		polynomial_deinit(&rhs);
+		polynomial_deinit(&product);
+		polynomial_deinit(&square);
+
+		// @NOTE: Factors take ownership, so linear and rest are released
+		// here only if they weren't passed on
+		if (success) {
+			success = factor_binomial(&linear, multiplicity, factors);
+
+			if (success && degree == 2)
+				success = factor_binomial(&rest, multiplicity, factors);
+			else if (success)
+				success = factors_add(factors, &rest, multiplicity);
+			else
+				polynomial_deinit(&rest);
+		}
+		else {
+			polynomial_deinit(&linear);
+			polynomial_deinit(&rest);
+		}
+
+		polynomial_deinit(polynomial);
+
+		return success;
+	}
+
+	return factors_add(factors, polynomial, multiplicity);
+}
+
+// Scale polynomial to integer coefficients without common divisor and
+// positive leading coefficient
+static bool polynomial_primitive(const Polynomial* const polynomial,
+                                 Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(result != NULL);
+
+	if (!polynomial_copy(polynomial, result))
+		return false;
+
+	if (polynomial->length == 0)
+		return true;
+
+	int64_t numerator = 0;
+	int64_t denominator = 1;
+
+	for (size_t i = 0; i < polynomial->length; ++i) {
+		const Rational coefficient = polynomial->coefficients[i];
+
+		if (coefficient.numerator == INT64_MIN)
+			return false;
+
+		numerator = integer_gcd(numerator, coefficient.numerator < 0 ? -coefficient.numerator
+		                                                             : coefficient.numerator);
+
+		const int64_t divisor = integer_gcd(denominator, coefficient.denominator);
+
+		if (__builtin_mul_overflow(denominator / divisor, coefficient.denominator, &denominator))
+			return false;
+	}
+
+	if (polynomial->coefficients[0].numerator < 0)
+		numerator = -numerator;
+
+	return polynomial_scale(result, rational_divide(rational_integer(denominator),
+	                                                rational_integer(numerator)));
+}
+
+// First variable present in either polynomial, rhs may be NULL
+static size_t polynomial_main_variable(const Polynomial* const lhs,
+                                       const Polynomial* const rhs)
+{
+	assert(lhs != NULL);
+
+	for (size_t id = 0; id < lhs->variables; ++id) {
+		if (polynomial_variable_degree(lhs, id) > 0 ||
+		    (rhs != NULL && polynomial_variable_degree(rhs, id) > 0)) {
+			return id;
+		}
+	}
+
+	return SYMBOL_NONE;
+}
+
+// Greatest common divisor of coefficients in variable, which are
+// polynomials in the other variables
+static bool polynomial_content(const Polynomial* const polynomial,
+                               const size_t variable,
+                               FactorBudget* const budget,
+                               Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(budget != NULL);
+	assert(result != NULL);
+
+	*result = Polynomial(polynomial->variables);
+
+	const uint32_t degree = polynomial_variable_degree(polynomial, variable);
+
+	bool success = true;
+
+	for (uint32_t power = 0; success && power <= degree; ++power) {
+		Polynomial coefficient, divisor;
+
+		success = polynomial_coefficient(polynomial, variable, power, &coefficient);
+
+		if (success && coefficient.length > 0) {
+			success = polynomial_gcd(result, &coefficient, budget, &divisor);
+
+			polynomial_deinit(result);
+			*result = divisor;
+		}
+
+		polynomial_deinit(&coefficient);
+	}
+
+	return success;
+}
+
+// Divide polynomial by its content in variable and integer content, which
+// the content doesn't include as it's defined over rationals
+static bool polynomial_primitive_part(const Polynomial* const polynomial,
+                                      const size_t variable,
+                                      FactorBudget* const budget,
+                                      Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(budget != NULL);
+	assert(result != NULL);
+
+	Polynomial content, quotient;
+
+	content = quotient = Polynomial(polynomial->variables);
+
+	*result = Polynomial(polynomial->variables);
+
+	const bool success = polynomial_content(polynomial, variable, budget, &content) &&
+	                     polynomial_divide(polynomial, &content, &quotient) &&
+	                     polynomial_primitive(&quotient, result);
+
+	polynomial_deinit(&content);
+	polynomial_deinit(&quotient);
+
+	return success;
+}
+
+// Pseudo-remainder of lhs by rhs in variable, which is kept primitive in
+// variable, as rhs must be primitive and has no divisors free of it
+static bool polynomial_pseudo_remainder(const Polynomial* const lhs,
+                                        const Polynomial* const rhs,
+                                        const size_t variable,
+                                        FactorBudget* const budget,
+                                        Polynomial* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(budget != NULL);
+	assert(result != NULL);
+
+	const size_t variables = lhs->variables;
+	const uint32_t degree = polynomial_variable_degree(rhs, variable);
+
+	*result = Polynomial(variables);
+
+	Polynomial leading = Polynomial(variables);
+
+	uint32_t* const exponents = calloc(variables + 1, sizeof(uint32_t));
+
+	bool success = exponents != NULL &&
+	               polynomial_coefficient(rhs, variable, degree, &leading) &&
+	               polynomial_copy(lhs, result);
+
+	while (success && result->length > 0 &&
+	       polynomial_variable_degree(result, variable) >= degree) {
+		const uint32_t result_degree = polynomial_variable_degree(result, variable);
+
+		Polynomial result_leading, scaled, product, shifted, difference;
+
+		result_leading = scaled = product = shifted = difference = Polynomial(variables);
+
+		exponents[variable] = result_degree - degree;
+
+		success = !budget_exhausted(budget) &&
+		          polynomial_coefficient(result, variable, result_degree, &result_leading) &&
+		          polynomial_multiply(&leading, result, &scaled) &&
+		          polynomial_multiply(&result_leading, rhs, &product) &&
+		          polynomial_multiply_term(&product, rational_integer(1), exponents, &shifted) &&
+		          polynomial_subtract(&scaled, &shifted, &difference);
+
+		polynomial_deinit(result);
+
+		// @NOTE: Zero remainder stays in result and stops the loop
+		if (success && difference.length > 0)
+			success = polynomial_primitive_part(&difference, variable, budget, result);
+
+		polynomial_deinit(&result_leading);
+		polynomial_deinit(&scaled);
+		polynomial_deinit(&product);
+		polynomial_deinit(&shifted);
+		polynomial_deinit(&difference);
+	}
+
+	polynomial_deinit(&leading);
+	free(exponents);
+
+	return success;
+}
+
+// Greatest common divisor by primitive remainder sequence in the first
+// variable, contents are handled recursively in the remaining ones
+static bool polynomial_gcd(const Polynomial* const lhs,
+                           const Polynomial* const rhs,
+                           FactorBudget* const budget,
+                           Polynomial* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(lhs->variables == rhs->variables);
+	assert(budget != NULL);
+	assert(result != NULL);
+
+	const size_t variables = lhs->variables;
+
+	*result = Polynomial(variables);
+
+	if (budget_exhausted(budget))
+		return false;
+
+	if (lhs->length == 0)
+		return polynomial_primitive(rhs, result);
+
+	if (rhs->length == 0)
+		return polynomial_primitive(lhs, result);
+
+	const size_t variable = polynomial_main_variable(lhs, rhs);
+	if (variable == SYMBOL_NONE)
+		return polynomial_append(result, rational_integer(1), NULL);
+
+	Polynomial lhs_content, rhs_content, content, a, b, remainder;
+
+	lhs_content = rhs_content = content = a = b = remainder = Polynomial(variables);
+
+	bool success = polynomial_content(lhs, variable, budget, &lhs_content) &&
+	               polynomial_content(rhs, variable, budget, &rhs_content) &&
+	               polynomial_gcd(&lhs_content, &rhs_content, budget, &content);
+
+	const bool constant = polynomial_variable_degree(lhs, variable) == 0 ||
+	                      polynomial_variable_degree(rhs, variable) == 0;
+
+	// @NOTE: Divisors of polynomial constant in variable divide the content
+	// of the other one
+	if (success && constant) {
+		*result = content;
+		content = Polynomial(variables);
+	}
+	else if (success) {
+		const bool swap = polynomial_variable_degree(lhs, variable) <
+		                  polynomial_variable_degree(rhs, variable);
+
+		success = polynomial_divide(swap ? rhs : lhs, swap ? &rhs_content : &lhs_content, &a) &&
+		          polynomial_divide(swap ? lhs : rhs, swap ? &lhs_content : &rhs_content, &b);
+
+		// @NOTE: Remainder sequences of coprime polynomials are the longest
+		// and overflow most often, so coprimality is checked first
+		if (success && polynomial_coprime(&a, &b, variable)) {
+			polynomial_deinit(&b);
+			success = polynomial_append(&b, rational_integer(1), NULL);
+		}
+
+		while (success && polynomial_variable_degree(&b, variable) > 0) {
+			success = polynomial_pseudo_remainder(&a, &b, variable, budget, &remainder);
+
+			if (!success || remainder.length == 0)
+				break;
+
+			polynomial_deinit(&a);
+			a = b;
+			b = Polynomial(variables);
+
+			if (polynomial_variable_degree(&remainder, variable) == 0) {
+				success = polynomial_append(&b, rational_integer(1), NULL);
+				break;
+			}
+
+			success = polynomial_primitive_part(&remainder, variable, budget, &b);
+
+			polynomial_deinit(&remainder);
+		}
+
+		polynomial_deinit(&a);
+
+		success = success &&
+		          polynomial_multiply(&content, &b, &a) &&
+		          polynomial_primitive(&a, result);
+	}
+
+	polynomial_deinit(&lhs_content);
+	polynomial_deinit(&rhs_content);
+	polynomial_deinit(&content);
+	polynomial_deinit(&a);
+	polynomial_deinit(&b);
+	polynomial_deinit(&remainder);
+
+	return success;
+}
+
+// Check whether polynomials have no common divisors depending on variable
+// by their images modulo prime with the other variables substituted by
+// fixed values. Degree of image of the greatest common divisor can't be
+// lower unless leading coefficients vanish, so false means unknown.
+static bool polynomial_coprime(const Polynomial* const lhs,
+                               const Polynomial* const rhs,
+                               const size_t variable)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+
+	const uint32_t lhs_degree = polynomial_variable_degree(lhs, variable);
+	const uint32_t rhs_degree = polynomial_variable_degree(rhs, variable);
+
+	uint64_t* const lhs_image = calloc(lhs_degree + 1, sizeof(uint64_t));
+	uint64_t* const rhs_image = calloc(rhs_degree + 1, sizeof(uint64_t));
+
+	const bool result = lhs_image != NULL && rhs_image != NULL &&
+	                    polynomial_evaluate_modular(lhs, variable, lhs_image) &&
+	                    polynomial_evaluate_modular(rhs, variable, rhs_image) &&
+	                    lhs_image[lhs_degree] != 0 &&
+	                    rhs_image[rhs_degree] != 0 &&
+	                    modular_gcd_degree(lhs_image, lhs_degree, rhs_image, rhs_degree) == 0;
+
+	free(lhs_image);
+	free(rhs_image);
+
+	return result;
+}
+
+// Dense coefficients in variable modulo prime, other variables are
+// substituted by values depending on their identifiers only
+static bool polynomial_evaluate_modular(const Polynomial* const polynomial,
+                                        const size_t variable,
+                                        uint64_t* const coefficients)
+{
+	assert(polynomial != NULL);
+	assert(coefficients != NULL);
+
+	for (size_t i = 0; i < polynomial->length; ++i) {
+		const Rational coefficient = polynomial->coefficients[i];
+
+		const uint64_t denominator = (uint64_t)coefficient.denominator % MODULUS;
+		if (denominator == 0)
+			return false;
+
+		const uint64_t magnitude = coefficient.numerator < 0
+			? (uint64_t)0 - (uint64_t)coefficient.numerator
+			: (uint64_t)coefficient.numerator;
+
+		uint64_t value = magnitude % MODULUS * modular_power(denominator, MODULUS - 2) % MODULUS;
+		if (coefficient.numerator < 0)
+			value = (MODULUS - value) % MODULUS;
+
+		const uint32_t* const monomial = polynomial_monomial(polynomial, i);
+
+		for (size_t id = 0; id < polynomial->variables; ++id) {
+			if (id != variable && monomial[id] > 0)
+				value = value * modular_power(1000003u * (id + 1) % MODULUS, monomial[id]) % MODULUS;
+		}
+
+		coefficients[monomial[variable]] = (coefficients[monomial[variable]] + value) % MODULUS;
+	}
+
+	return true;
+}
+
+// Euclidean algorithm over integers modulo prime, arrays are overwritten
+static uint32_t modular_gcd_degree(uint64_t* lhs,
+                                   uint32_t lhs_degree,
+                                   uint64_t* rhs,
+                                   uint32_t rhs_degree)
+{
+	assert(lhs != NULL && lhs[lhs_degree] != 0);
+	assert(rhs != NULL && rhs[rhs_degree] != 0);
+
+	for (;;) {
+		if (lhs_degree < rhs_degree) {
+			uint64_t* const polynomial = lhs;
+			lhs = rhs;
+			rhs = polynomial;
+
+			const uint32_t degree = lhs_degree;
+			lhs_degree = rhs_degree;
+			rhs_degree = degree;
+		}
+
+		if (rhs_degree == 0)
+			return 0;
+
+		const uint64_t inverse = modular_power(rhs[rhs_degree], MODULUS - 2);
+
+		// Reduce lhs below degree of rhs
+		for (uint32_t degree = lhs_degree + 1; degree-- > rhs_degree;) {
+			const uint64_t factor = lhs[degree] * inverse % MODULUS;
+			const uint32_t shift = degree - rhs_degree;
+
+			for (uint32_t i = 0; factor != 0 && i <= rhs_degree; ++i)
+				lhs[shift + i] = (lhs[shift + i] + (MODULUS - factor) * rhs[i]) % MODULUS;
+		}
+
+		uint32_t degree = rhs_degree;
+		while (degree > 0 && lhs[degree - 1] == 0)
+			--degree;
+
+		// @NOTE: Zero remainder means rhs is the greatest common divisor
+		if (degree == 0)
+			return rhs_degree;
+
+		lhs_degree = degree - 1;
+	}
+}
+
+static uint64_t modular_power(uint64_t base, uint64_t exponent)
+{
+	uint64_t result = 1;
+
+	base %= MODULUS;
+
+	while (exponent != 0) {
+		if (exponent % 2 != 0)
+			result = result * base % MODULUS;
+
+		base = base * base % MODULUS;
+		exponent /= 2;
+	}
+
+	return result;
+}
+
+static int64_t integer_gcd(int64_t lhs, int64_t rhs)
+{
+	while (rhs != 0) {
+		const int64_t remainder = lhs % rhs;
+		lhs = rhs;
+		rhs = remainder;
+	}
+
+	return lhs;
+}
+
+// Exact root of nonnegative integer or -1 if there is none
+static int64_t integer_root(const int64_t value, const unsigned degree)
+{
+	assert(value >= 0);
+	assert(degree == 2 || degree == 3);
+
+	const int64_t estimate = llround(pow((double)value, 1.0 / degree));
+
+	// @NOTE: Estimate may be off by one due to rounding
+	for (int64_t root = estimate > 0 ? estimate - 1 : 0; root <= estimate + 1; ++root) {
+		__int128 power = root;
+
+		for (unsigned i = 1; i < degree; ++i)
+			power *= root;
+
+		if (power == value)
+			return root;
+	}
+
+	return -1;
+}
@@ -0,0 +1,29 @@
+#ifndef __FACTOR_H__
+#define __FACTOR_H__
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "parser.h"
+#include "symbol.h"
+#include "polynomial.h"
+
+// Factorization of one expression gives up after this much processor time
+#define FACTOR_TIME_BUDGET_MS 200
+
+typedef struct factor_budget {
+	clock_t deadline;
+	bool exhausted;
+} FactorBudget;
+
+extern FactorBudget factor_budget_start(void);
+
+// Factor polynomial over integers: content, common monomial, square-free
+// decomposition, then differences of squares and sums and differences of
+// cubes. Returns polynomial in normal form if it has no nontrivial factors,
+// or NULL if factorization failed or budget is exhausted.
+extern Expression* polynomial_factor(const Polynomial* const polynomial,
+                                     const SymbolTable* const symbols,
+                                     FactorBudget* const budget);
+
+#endif // __FACTOR_H__
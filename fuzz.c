@@ -0,0 +1,976 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "string.h"
+#include "list.h"
+#include "lexer.h"
+#include "parser.h"
+#include "transform.h"
+#include "evaluator.h"
+#include "parallel.h"
+
+// Cases run by default, and seed of the first one
+#define FUZZ_CASES_DEFAULT 10000
+#define FUZZ_SEED_DEFAULT 1
+
+// Deepest generated expression, bases of powers are shallower and have no
+// powers, so that polynomials are of low degree and evaluated accurately
+#define FUZZ_DEPTH_MAX 4
+#define FUZZ_POWER_DEPTH_MAX 1
+
+// Symbol values each transformed expression is compared at
+#define FUZZ_BINDINGS 8
+
+// Values are equal if they differ by this part of the larger one, or of 1
+#define FUZZ_TOLERANCE 1e-6
+
+// Threads of each worker checking parallel evaluation and transforms, which
+// split every subtree of this many nodes
+#define FUZZ_THREADS 4
+#define FUZZ_GRAIN 2
+
+// Operands of parsed chain which must be split by parallel checks
+#define FUZZ_CHAIN_OPERANDS 64
+
+// Streamed text is read in chunks of at most this many bytes, so that its
+// tokens are carried across them
+#define FUZZ_CHUNK_MAX 8
+
+static const char* const SYMBOLS[] = {"a", "b", "c"};
+#define SYMBOLS_COUNT (sizeof(SYMBOLS) / sizeof(SYMBOLS[0]))
+
+// Property checked for every case, in order
+typedef enum check {
+	Check_Parse,     // Generated text parses
+	Check_RoundTrip, // Printed expression parses back to the same text and values
+	Check_Simplify,  // Transforms keep values of expression
+	Check_Expand,
+	Check_Normalize,
+	Check_Factor,
+	Check_Collect,
+	Check_Balance,   // and balance keeps its text as well
+	Check_Parallel,  // Parallel evaluation and transforms give the same results
+	Check_Stream,    // Text streamed in chunks parses to the same expression
+	Check__count,
+} Check;
+
+static const char* const CHECK_NAME[Check__count] = {
+	[Check_Parse] = "parse",
+	[Check_RoundTrip] = "round trip",
+	[Check_Simplify] = "simplify",
+	[Check_Expand] = "expand",
+	[Check_Normalize] = "normalize",
+	[Check_Factor] = "factor",
+	[Check_Collect] = "collect",
+	[Check_Balance] = "balance",
+	[Check_Parallel] = "parallel",
+	[Check_Stream] = "stream",
+};
+
+// Pool of parallel check, created by each worker
+static ParallelPool* pool = NULL;
+
+// Counters of a worker, sent to parent when it's done
+typedef struct statistics {
+	size_t cases;
+	size_t failures;
+	size_t comparisons;
+	size_t skipped; // @NOTE: Comparisons with value out of domain
+} Statistics;
+
+// Slots of every node of expression
+typedef struct links {
+	Expression*** slots;
+	size_t count;
+	size_t capacity;
+} Links;
+
+// Expression parsed from text, which it refers to
+typedef struct parsed {
+	String text;
+	List tokens;
+	Expression* expression;
+} Parsed;
+
+static uint64_t random_next(uint64_t* const state);
+static size_t random_below(uint64_t* const state, const size_t bound);
+
+// Write random expression text of at most the given depth.
+static void generate(uint64_t* const state,
+                     const size_t depth,
+                     const bool powers,
+                     FILE* const file);
+
+// Parse copy of text, expression is NULL if it has syntax errors.
+static Parsed parsed_create(const char* const text);
+static void parsed_destroy(Parsed* const parsed);
+
+// Return text of expression, which must be freed.
+static char* expression_text(const Expression* const expression);
+
+// Check properties of expression text with bindings from seed, return the
+// first one which doesn't hold, or Check__count
+static Check check_text(const char* const text,
+                        const uint64_t seed,
+                        Statistics* const statistics);
+
+static bool check_round_trip(const Expression* const expression,
+                             const uint64_t seed,
+                             Statistics* const statistics);
+static bool check_transform(const Expression* const expression,
+                            const Check check,
+                            const uint64_t seed,
+                            Statistics* const statistics);
+static bool check_parallel(const Expression* const expression,
+                           const uint64_t seed,
+                           Statistics* const statistics);
+static bool check_parallel_evaluation(const Expression* const expression,
+                                      const uint64_t seed,
+                                      Statistics* const statistics);
+static bool check_parallel_transforms(const Expression* const expression);
+static bool check_stream(const char* const text,
+                         const Expression* const expression,
+                         const uint64_t seed);
+
+// Check that parallel evaluation and transforms of a long parsed chain of
+// symbols with the given operator both fork tasks and give the same results
+static bool check_chain(const char* const operator, Statistics* const statistics);
+
+// Compile expressions and compare their values.
+static bool evaluators_equal(const Expression* const lhs,
+                             const Expression* const rhs,
+                             const uint64_t seed,
+                             Statistics* const statistics);
+
+// Compare values of evaluators at the same random symbol values.
+static bool evaluations_equal(const Evaluator* const lhs,
+                              const Evaluator* const rhs,
+                              const uint64_t seed,
+                              Statistics* const statistics);
+
+// Shrink text while the same check fails for it, return the smallest one.
+static char* minimise(const char* const text, const Check check, const uint64_t seed);
+
+// Collect slots of every node of expression in pre-order.
+static bool expression_links(Expression** const slot, Links* const links);
+
+static void run_worker(const uint64_t seed,
+                       const size_t cases,
+                       const size_t worker,
+                       const size_t workers,
+                       const bool verbose,
+                       Statistics* const statistics);
+
+static void print_usage(void)
+{
+	LOG("Usage: fuzz [-h] [-v] [-n <cases>] [-s <seed>] [-j <jobs>]\n\n"
+		"\t-h\n"
+		"\t\tOutput a usage message and exit\n\n"
+		"\t-v\n"
+		"\t\tReport every case before it's checked\n\n"
+		"\t-n <cases>\n"
+		"\t\tCheck this many random expressions\n\n"
+		"\t-s <seed>\n"
+		"\t\tSeed of the first case, case i has seed + i, so that failing\n"
+		"\t\tcase is reproduced with -s <its seed> -n 1\n\n"
+		"\t-j <jobs>\n"
+		"\t\tCheck cases in this many processes, by default one per CPU\n\n");
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t cases = FUZZ_CASES_DEFAULT;
+	uint64_t seed = FUZZ_SEED_DEFAULT;
+	bool verbose = false;
+
+	const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t workers = processors > 0 ? (size_t)processors : 1;
+
+	for (int argp = 1; argp < argc; ++argp) {
+		if (strcmp(argv[argp], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[argp], "-n") == 0 && argp + 1 < argc)
+			cases = strtoull(argv[++argp], NULL, 10);
+		else if (strcmp(argv[argp], "-s") == 0 && argp + 1 < argc)
+			seed = strtoull(argv[++argp], NULL, 0);
+		else if (strcmp(argv[argp], "-j") == 0 && argp + 1 < argc)
+			workers = strtoull(argv[++argp], NULL, 10);
+		else
+			print_usage();
+	}
+
+	if (workers == 0)
+		workers = 1;
+
+	if (workers > cases && cases > 0)
+		workers = cases;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	Statistics total = {0, 0, 0, 0};
+
+	int channel[2];
+	if (pipe(channel) != 0) {
+		LOG("Failed to create pipe\n");
+		return EXIT_FAILURE;
+	}
+
+	// @NOTE: Output is flushed, so that workers don't repeat it
+	fflush(stdout);
+
+	size_t started = 0;
+
+	for (size_t worker = 0; worker < workers; ++worker) {
+		const pid_t child = fork();
+
+		if (child == 0) {
+			close(channel[0]);
+
+			Statistics statistics = {0, 0, 0, 0};
+			run_worker(seed, cases, worker, workers, verbose, &statistics);
+
+			const bool written =
+				write(channel[1], &statistics, sizeof(Statistics)) == sizeof(Statistics);
+
+			close(channel[1]);
+			exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+
+		if (child < 0) {
+			LOG("Failed to start worker\n");
+			break;
+		}
+
+		++started;
+	}
+
+	close(channel[1]);
+
+	bool result = started == workers;
+
+	Statistics statistics;
+	while (read(channel[0], &statistics, sizeof(Statistics)) == sizeof(Statistics)) {
+		total.cases += statistics.cases;
+		total.failures += statistics.failures;
+		total.comparisons += statistics.comparisons;
+		total.skipped += statistics.skipped;
+	}
+
+	close(channel[0]);
+
+	for (int status; wait(&status) > 0; )
+		result &= WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	const double seconds = (double)(end.tv_sec - start.tv_sec) +
+	                       (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+
+	printf("%zu cases, %zu failed, %zu comparisons, %zu out of domain\n",
+	       total.cases, total.failures, total.comparisons, total.skipped);
+	printf("%.3f s with %zu jobs, %.0f cases/s\n",
+	       seconds, workers, seconds > 0 ? (double)total.cases / seconds : 0.0);
+
+	result &= total.cases == cases && total.failures == 0;
+
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// @NOTE: SplitMix64, so that cases are the same on every platform
+static uint64_t random_next(uint64_t* const state)
+{
+	uint64_t result = (*state += 0x9e3779b97f4a7c15ull);
+	result = (result ^ (result >> 30)) * 0xbf58476d1ce4e5b9ull;
+	result = (result ^ (result >> 27)) * 0x94d049bb133111ebull;
+	return result ^ (result >> 31);
+}
+
+static size_t random_below(uint64_t* const state, const size_t bound)
+{
+	assert(bound > 0);
+
+	return random_next(state) % bound;
+}
+
+// @NOTE: Numbers are integers and halves, which are exact in both double
+// and rational arithmetic; exponents are small integers
+static void generate(uint64_t* const state,
+                     const size_t depth,
+                     const bool powers,
+                     FILE* const file)
+{
+	static const char* const OPERATORS[] = {" + ", " - ", " * ", " / "};
+
+	size_t choice = random_below(state, depth == 0 ? 2 : 8);
+
+	if (choice == 3 && !powers)
+		choice = random_below(state, 3);
+
+	switch (choice) {
+	case 0:
+		fputs(SYMBOLS[random_below(state, SYMBOLS_COUNT)], file);
+		break;
+
+	case 1:
+		if (random_below(state, 4) == 0)
+			fprintf(file, "%zu.5", random_below(state, 10));
+		else
+			fprintf(file, "%zu", random_below(state, 10));
+		break;
+
+	case 2:
+		putc('-', file);
+
+		if (random_below(state, 2) == 0)
+			generate(state, 0, powers, file);
+		else {
+			putc('(', file);
+			generate(state, depth - 1, powers, file);
+			putc(')', file);
+		}
+		break;
+
+	case 3:
+		putc('(', file);
+		generate(state, depth < FUZZ_POWER_DEPTH_MAX ? depth : FUZZ_POWER_DEPTH_MAX, false, file);
+		fprintf(file, ") ^ %zu", random_below(state, 4));
+		break;
+
+	default: {
+		const bool parenthesised = random_below(state, 2) == 0;
+
+		if (parenthesised)
+			putc('(', file);
+
+		generate(state, depth - 1, powers, file);
+		fputs(OPERATORS[random_below(state, 4)], file);
+		generate(state, depth - 1, powers, file);
+
+		if (parenthesised)
+			putc(')', file);
+	} break;
+	}
+}
+
+static Parsed parsed_create(const char* const text)
+{
+	assert(text != NULL);
+
+	Parsed result = {string_create(strlen(text)), List(), NULL};
+
+	if (result.text.length > 0 && result.text.text == NULL)
+		return result;
+
+	memcpy(result.text.text, text, result.text.length);
+
+	result.tokens = lexical_scan(&result.text);
+
+	for list_range(it, result.tokens) {
+		if (list_node_data(it, Token)->type == TokenType_Illegal)
+			return result;
+	}
+
+	SyntaxErrors errors;
+	result.expression = expression_parse_checked(&result.tokens, &errors);
+
+	return result;
+}
+
+static void parsed_destroy(Parsed* const parsed)
+{
+	assert(parsed != NULL);
+
+	if (parsed->expression != NULL)
+		expression_destroy(&parsed->expression);
+
+	list_deinit(&parsed->tokens);
+	string_destroy(&parsed->text);
+}
+
+static char* expression_text(const Expression* const expression)
+{
+	char* result = NULL;
+	size_t length = 0;
+
+	FILE* const stream = open_memstream(&result, &length);
+	if (stream == NULL)
+		return NULL;
+
+	expression_write(expression, stream);
+	fclose(stream);
+
+	return result;
+}
+
+static Check check_text(const char* const text,
+                        const uint64_t seed,
+                        Statistics* const statistics)
+{
+	Parsed parsed = parsed_create(text);
+
+	Check result = Check__count;
+
+	if (parsed.expression == NULL)
+		result = Check_Parse;
+	else if (!check_round_trip(parsed.expression, seed, statistics))
+		result = Check_RoundTrip;
+
+	for (Check check = Check_Simplify; check < Check_Parallel && result == Check__count; ++check) {
+		if (!check_transform(parsed.expression, check, seed, statistics))
+			result = check;
+	}
+
+	if (result == Check__count && !check_parallel(parsed.expression, seed, statistics))
+		result = Check_Parallel;
+
+	if (result == Check__count && !check_stream(text, parsed.expression, seed))
+		result = Check_Stream;
+
+	parsed_destroy(&parsed);
+
+	return result;
+}
+
+// @NOTE: Printer drops parentheses of associative operators, which regroups
+// operands, so printed expression is compared by its values and text
+static bool check_round_trip(const Expression* const expression,
+                             const uint64_t seed,
+                             Statistics* const statistics)
+{
+	char* const text = expression_text(expression);
+	if (text == NULL)
+		return false;
+
+	Parsed parsed = parsed_create(text);
+	char* const reprinted = parsed.expression != NULL
+		? expression_text(parsed.expression)
+		: NULL;
+
+	bool result = reprinted != NULL && strcmp(text, reprinted) == 0;
+
+	if (result)
+		result = evaluators_equal(expression, parsed.expression, seed, statistics);
+
+	free(reprinted);
+	parsed_destroy(&parsed);
+	free(text);
+
+	return result;
+}
+
+// @NOTE: Expression is transformed from its printed text, so that transform
+// sees it as the command line program does
+static bool check_transform(const Expression* const expression,
+                            const Check check,
+                            const uint64_t seed,
+                            Statistics* const statistics)
+{
+	char* const text = expression_text(expression);
+	if (text == NULL)
+		return false;
+
+	Parsed parsed = parsed_create(text);
+
+	if (parsed.expression == NULL) {
+		parsed_destroy(&parsed);
+		free(text);
+		return false;
+	}
+
+	switch (check) {
+	case Check_Simplify:
+		simplify_expression(&parsed.expression);
+		break;
+
+	case Check_Expand:
+		expand_expression(&parsed.expression);
+		break;
+
+	case Check_Normalize:
+		normalize_expression(&parsed.expression);
+		break;
+
+	case Check_Factor:
+		factor_expression(&parsed.expression);
+		break;
+
+	case Check_Collect:
+		collect_expression(&parsed.expression);
+		break;
+
+	// @NOTE: Every chain is rebalanced, however short
+	case Check_Balance:
+		balance_expression(&parsed.expression, 2);
+		break;
+	}
+
+	bool result = evaluators_equal(expression, parsed.expression, seed, statistics) &&
+	              check_round_trip(parsed.expression, seed, statistics);
+
+	if (result && check == Check_Balance) {
+		char* const balanced = expression_text(parsed.expression);
+
+		result = balanced != NULL && strcmp(text, balanced) == 0;
+		free(balanced);
+	}
+
+	parsed_destroy(&parsed);
+	free(text);
+
+	return result;
+}
+
+// @NOTE: Results must be the same as sequential ones, values are not only
+// close and transformed expressions have the same text. Chains are
+// evaluated in parallel as balanced, so values are compared with those of
+// balanced expression.
+static bool check_parallel(const Expression* const expression,
+                           const uint64_t seed,
+                           Statistics* const statistics)
+{
+	return check_parallel_evaluation(expression, seed, statistics) &&
+	       check_parallel_transforms(expression);
+}
+
+static bool check_parallel_evaluation(const Expression* const expression,
+                                      const uint64_t seed,
+                                      Statistics* const statistics)
+{
+	if (pool == NULL)
+		return true;
+
+	bool result = true;
+
+	Expression* balanced = expression_retain((Expression*)expression);
+	balance_expression(&balanced, FUZZ_GRAIN);
+
+	Evaluator* evaluator = evaluator_compile(balanced);
+	expression_destroy(&balanced);
+
+	ParallelEvaluator* parallel = evaluator != NULL
+		? parallel_create(expression, &evaluator->symbols, pool, FUZZ_GRAIN)
+		: NULL;
+
+	uint64_t state = seed;
+
+	double slots[SYMBOLS_COUNT + 1];
+
+	for (size_t i = 0; i < FUZZ_BINDINGS && parallel != NULL && result; ++i) {
+		for (size_t j = 0; j < SYMBOLS_COUNT; ++j) {
+			const String symbol = string_init(SYMBOLS[j]);
+			const size_t slot = evaluator_slot(evaluator, &symbol);
+
+			if (slot != SYMBOL_NONE)
+				slots[slot] = (double)random_below(&state, 13) / 2 - 3;
+		}
+
+		const double expected = evaluator_run(evaluator, slots);
+		const double actual = parallel_run(parallel, slots);
+
+		++statistics->comparisons;
+
+		result = expected == actual || (isnan(expected) && isnan(actual));
+	}
+
+	if (parallel != NULL)
+		parallel_destroy(&parallel);
+
+	if (evaluator != NULL)
+		evaluator_destroy(&evaluator);
+
+	return result;
+}
+
+static bool check_parallel_transforms(const Expression* const expression)
+{
+	if (pool == NULL)
+		return true;
+
+	char* const text = expression_text(expression);
+	if (text == NULL)
+		return true;
+
+	bool result = true;
+
+	const TransformOptions sequential_options = TransformOptions();
+	TransformOptions split_options = TransformOptions();
+	split_options.pool = pool;
+	split_options.grain = FUZZ_GRAIN;
+
+	for (size_t i = 0; i < 2 && result; ++i) {
+		TransformStatus (*const transform)(Expression** const,
+		                                   const TransformOptions* const) = i == 0
+			? simplify_expression_bounded
+			: expand_expression_bounded;
+
+		Parsed sequential = parsed_create(text);
+		Parsed split = parsed_create(text);
+
+		if (sequential.expression != NULL && split.expression != NULL) {
+			transform(&sequential.expression, &sequential_options);
+			transform(&split.expression, &split_options);
+
+			char* const expected = expression_text(sequential.expression);
+			char* const actual = expression_text(split.expression);
+
+			result = expected != NULL && actual != NULL && strcmp(expected, actual) == 0;
+
+			free(expected);
+			free(actual);
+		}
+
+		parsed_destroy(&sequential);
+		parsed_destroy(&split);
+	}
+
+	free(text);
+
+	return result;
+}
+
+// @NOTE: Pool counts tasks forked by all its runs, so chain is split if the
+// count grows while it's checked
+static bool check_chain(const char* const operator, Statistics* const statistics)
+{
+	if (pool == NULL)
+		return true;
+
+	char* text = NULL;
+	size_t length = 0;
+
+	FILE* const stream = open_memstream(&text, &length);
+	if (stream == NULL)
+		return false;
+
+	for (size_t i = 0; i < FUZZ_CHAIN_OPERANDS; ++i) {
+		if (i > 0)
+			fprintf(stream, " %s ", operator);
+
+		fputs(SYMBOLS[i % SYMBOLS_COUNT], stream);
+	}
+
+	fclose(stream);
+
+	Parsed parsed = parsed_create(text);
+	free(text);
+
+	bool result = parsed.expression != NULL;
+
+	for (size_t i = 0; i < 2 && result; ++i) {
+		const size_t forks = __atomic_load_n(&pool->forks, __ATOMIC_RELAXED);
+
+		result = i == 0
+			? check_parallel_evaluation(parsed.expression, FUZZ_SEED_DEFAULT, statistics)
+			: check_parallel_transforms(parsed.expression);
+
+		result = result && __atomic_load_n(&pool->forks, __ATOMIC_RELAXED) > forks;
+	}
+
+	parsed_destroy(&parsed);
+
+	return result;
+}
+
+// @NOTE: Streamed expression must have the same text and span, which is
+// counted from the beginning of the whole input
+static bool check_stream(const char* const text,
+                         const Expression* const expression,
+                         const uint64_t seed)
+{
+	FILE* const file = tmpfile();
+	if (file == NULL)
+		return true;
+
+	fputs(text, file);
+	fflush(file);
+	rewind(file);
+
+	uint64_t state = seed;
+	bool result = false;
+
+	TokenStream stream;
+
+	if (token_stream_init(&stream, fileno(file), 1 + random_below(&state, FUZZ_CHUNK_MAX))) {
+		SyntaxErrors errors;
+		Expression* streamed = expression_parse_stream(&stream, &errors);
+
+		if (streamed != NULL) {
+			char* const expected = expression_text(expression);
+			char* const actual = expression_text(streamed);
+
+			result = expected != NULL && actual != NULL && strcmp(expected, actual) == 0 &&
+			         expression->begin == streamed->begin && expression->end == streamed->end;
+
+			free(expected);
+			free(actual);
+
+			expression_destroy(&streamed);
+		}
+
+		token_stream_deinit(&stream);
+	}
+
+	fclose(file);
+
+	return result;
+}
+
+// @NOTE: Expressions too deep to compile are not compared
+static bool evaluators_equal(const Expression* const lhs,
+                             const Expression* const rhs,
+                             const uint64_t seed,
+                             Statistics* const statistics)
+{
+	Evaluator* before = evaluator_compile(lhs);
+	Evaluator* after = evaluator_compile(rhs);
+
+	const bool result = before == NULL || after == NULL ||
+	                    evaluations_equal(before, after, seed, statistics);
+
+	if (before != NULL)
+		evaluator_destroy(&before);
+
+	if (after != NULL)
+		evaluator_destroy(&after);
+
+	return result;
+}
+
+// @NOTE: Values are integers and halves in [-3, 3], so that polynomials
+// are computed almost exactly in any form
+static bool evaluations_equal(const Evaluator* const lhs,
+                              const Evaluator* const rhs,
+                              const uint64_t seed,
+                              Statistics* const statistics)
+{
+	uint64_t state = seed;
+
+	double values[SYMBOLS_COUNT];
+	double lhs_slots[SYMBOLS_COUNT + 1];
+	double rhs_slots[SYMBOLS_COUNT + 1];
+
+	for (size_t i = 0; i < FUZZ_BINDINGS; ++i) {
+		for (size_t j = 0; j < SYMBOLS_COUNT; ++j) {
+			values[j] = (double)random_below(&state, 13) / 2 - 3;
+
+			const String symbol = string_init(SYMBOLS[j]);
+			const size_t lhs_slot = evaluator_slot(lhs, &symbol);
+			const size_t rhs_slot = evaluator_slot(rhs, &symbol);
+
+			if (lhs_slot != SYMBOL_NONE)
+				lhs_slots[lhs_slot] = values[j];
+
+			if (rhs_slot != SYMBOL_NONE)
+				rhs_slots[rhs_slot] = values[j];
+		}
+
+		const double expected = evaluator_run(lhs, lhs_slots);
+		const double actual = evaluator_run(rhs, rhs_slots);
+
+		++statistics->comparisons;
+
+		// @NOTE: Transforms may extend domain, like x / x to 1
+		if (!isfinite(expected) || !isfinite(actual)) {
+			++statistics->skipped;
+			continue;
+		}
+
+		const double scale = fmax(1, fmax(fabs(expected), fabs(actual)));
+
+		if (fabs(expected - actual) > FUZZ_TOLERANCE * scale)
+			return false;
+	}
+
+	return true;
+}
+
+// @NOTE: Every node is tried to be replaced by its operands and by 1, and
+// the first replacement for which check still fails is taken
+static char* minimise(const char* const text, const Check check, const uint64_t seed)
+{
+	char* result = strdup(text);
+	if (result == NULL)
+		return NULL;
+
+	Expression* one = (Expression*)expression_literal_create_rational((Rational){1, 1});
+	if (one == NULL)
+		return result;
+
+	Statistics statistics = {0, 0, 0, 0};
+
+	for (bool shrunk = true; shrunk; ) {
+		shrunk = false;
+
+		Parsed parsed = parsed_create(result);
+		if (parsed.expression == NULL) {
+			parsed_destroy(&parsed);
+			break;
+		}
+
+		Links links = {NULL, 0, 0};
+
+		if (!expression_links(&parsed.expression, &links))
+			links.count = 0;
+
+		for (size_t i = 0; i < links.count && !shrunk; ++i) {
+			Expression* const node = *links.slots[i];
+
+			Expression* replacements[3] = {one, NULL, NULL};
+
+			if (node->type == ExpressionType_Unary)
+				replacements[1] = ((UnaryExpression*)node)->subexpression;
+			else if (node->type == ExpressionType_Binary) {
+				replacements[1] = ((BinaryExpression*)node)->left;
+				replacements[2] = ((BinaryExpression*)node)->right;
+			}
+
+			for (size_t j = 0; j < 3 && !shrunk; ++j) {
+				if (replacements[j] == NULL ||
+				    (node->type == ExpressionType_Literal && j == 0)) {
+					continue;
+				}
+
+				*links.slots[i] = replacements[j];
+				char* const candidate = expression_text(parsed.expression);
+				*links.slots[i] = node;
+
+				if (candidate != NULL && strlen(candidate) < strlen(result) &&
+				    check_text(candidate, seed, &statistics) == check) {
+					free(result);
+					result = candidate;
+					shrunk = true;
+				}
+				else
+					free(candidate);
+			}
+		}
+
+		free(links.slots);
+		parsed_destroy(&parsed);
+	}
+
+	expression_destroy(&one);
+
+	return result;
+}
+
+static bool expression_links(Expression** const slot, Links* const links)
+{
+	if (links->count == links->capacity) {
+		const size_t capacity = links->capacity > 0 ? 2 * links->capacity : 16;
+
+		Expression*** const slots = realloc(links->slots, capacity * sizeof(Expression**));
+		if (slots == NULL)
+			return false;
+
+		links->slots = slots;
+		links->capacity = capacity;
+	}
+
+	links->slots[links->count++] = slot;
+
+	Expression* const expression = *slot;
+
+	switch (expression->type) {
+	case ExpressionType_Unary:
+		return expression_links(&((UnaryExpression*)expression)->subexpression, links);
+
+	case ExpressionType_Binary:
+		return expression_links(&((BinaryExpression*)expression)->left, links) &&
+		       expression_links(&((BinaryExpression*)expression)->right, links);
+	}
+
+	return true;
+}
+
+// @NOTE: Cases are dealt to workers in turn, failure reports are written at
+// once, so that reports of workers don't interleave
+static void run_worker(const uint64_t seed,
+                       const size_t cases,
+                       const size_t worker,
+                       const size_t workers,
+                       const bool verbose,
+                       Statistics* const statistics)
+{
+	pool = parallel_pool_create(FUZZ_THREADS);
+
+	// @NOTE: Generated expressions are too shallow to have long chains
+	if (worker == 0 && cases > 0) {
+		static const char* const CHAIN_OPERATORS[] = {"+", "*"};
+
+		for (size_t i = 0; i < sizeof(CHAIN_OPERATORS) / sizeof(CHAIN_OPERATORS[0]); ++i) {
+			if (!check_chain(CHAIN_OPERATORS[i], statistics)) {
+				++statistics->failures;
+
+				printf("parallel failed with chain of %s\n", CHAIN_OPERATORS[i]);
+				fflush(stdout);
+			}
+		}
+	}
+
+	for (size_t i = worker; i < cases; i += workers) {
+		const uint64_t case_seed = seed + i;
+
+		uint64_t state = case_seed;
+
+		char* text = NULL;
+		size_t length = 0;
+
+		FILE* const stream = open_memstream(&text, &length);
+		if (stream == NULL)
+			continue;
+
+		generate(&state, 1 + random_below(&state, FUZZ_DEPTH_MAX), true, stream);
+		fclose(stream);
+
+		if (verbose)
+			LOGF("%" PRIu64 ": %s\n", case_seed, text);
+
+		++statistics->cases;
+
+		const Check check = check_text(text, case_seed, statistics);
+
+		if (check != Check__count) {
+			++statistics->failures;
+
+			char* const minimal = minimise(text, check, case_seed);
+
+			char* report = NULL;
+			size_t report_length = 0;
+
+			FILE* const output = open_memstream(&report, &report_length);
+
+			if (output != NULL) {
+				fprintf(output, "%s failed with seed %" PRIu64 ":\n\t%s\n\tminimal: %s\n",
+				        CHECK_NAME[check], case_seed, text,
+				        minimal != NULL ? minimal : text);
+				fclose(output);
+
+				fwrite(report, 1, report_length, stdout);
+				fflush(stdout);
+			}
+
+			free(report);
+			free(minimal);
+		}
+
+		free(text);
+	}
+
+	if (pool != NULL)
+		parallel_pool_destroy(&pool);
+}
@@ -0,0 +1,411 @@
+#include "interval.h"
+
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Below this magnitude errors of operations aren't exactly representable,
+// so that results are rounded outward unconditionally
+#define EXACT_ERROR_MIN 0x1p-969
+
+// Integers up to this magnitude are exact doubles
+#define EXACT_INTEGER_MAX 0x1p53
+
+typedef enum rounding {
+	Rounding_Down,
+	Rounding_Up,
+	Rounding__count,
+} Rounding;
+
+// Next double in direction of rounding.
+static double round_toward(const double number, const Rounding rounding);
+
+// Round result of operation in direction, given sign of its exact error.
+static double round_error(const double result,
+                          const double error,
+                          const Rounding rounding);
+
+// Largest finite bound in direction, if finite operands overflow.
+static double round_overflow(const double result, const Rounding rounding);
+
+// Operations on bounds rounded in direction; they are correctly rounded, as
+// error of nearest rounding is computed exactly.
+static double add_rounded(const double lhs, const double rhs, const Rounding rounding);
+static double multiply_rounded(const double lhs, const double rhs, const Rounding rounding);
+static double divide_rounded(const double lhs, const double rhs, const Rounding rounding);
+
+// Power of nonnegative base, rounded in direction.
+static double power_integer_rounded(const double base,
+                                    uint64_t exponent,
+                                    const Rounding rounding);
+static double power_rounded(const double base,
+                            const double exponent,
+                            const Rounding rounding);
+
+static Interval interval_power_integer(const Interval base, const double exponent);
+
+static void bound_write(const double bound, const Rounding rounding, FILE* const file);
+
+bool interval_empty(const Interval interval)
+{
+	return isnan(interval.lower) || isnan(interval.upper);
+}
+
+Interval interval_hull(const Interval lhs, const Interval rhs)
+{
+	if (interval_empty(lhs))
+		return rhs;
+
+	if (interval_empty(rhs))
+		return lhs;
+
+	return Interval(fmin(lhs.lower, rhs.lower), fmax(lhs.upper, rhs.upper));
+}
+
+Interval interval_from_rational(const Rational exact, const double number)
+{
+	if (!rational_exact(exact)) {
+		if (isnan(number))
+			return INTERVAL_EMPTY;
+
+		return Interval(round_toward(number, Rounding_Down),
+		                round_toward(number, Rounding_Up));
+	}
+
+	const double numerator = (double)exact.numerator;
+	const double denominator = (double)exact.denominator;
+
+	// @NOTE: Conversions are exact, so that division is the only rounding
+	if (fabs(numerator) <= EXACT_INTEGER_MAX && denominator <= EXACT_INTEGER_MAX) {
+		return Interval(divide_rounded(numerator, denominator, Rounding_Down),
+		                divide_rounded(numerator, denominator, Rounding_Up));
+	}
+
+	const double quotient = numerator / denominator;
+
+	return Interval(round_toward(round_toward(quotient, Rounding_Down), Rounding_Down),
+	                round_toward(round_toward(quotient, Rounding_Up), Rounding_Up));
+}
+
+Interval interval_negate(const Interval operand)
+{
+	return Interval(-operand.upper, -operand.lower);
+}
+
+Interval interval_add(const Interval lhs, const Interval rhs)
+{
+	if (interval_empty(lhs) || interval_empty(rhs))
+		return INTERVAL_EMPTY;
+
+	return Interval(add_rounded(lhs.lower, rhs.lower, Rounding_Down),
+	                add_rounded(lhs.upper, rhs.upper, Rounding_Up));
+}
+
+Interval interval_subtract(const Interval lhs, const Interval rhs)
+{
+	return interval_add(lhs, interval_negate(rhs));
+}
+
+Interval interval_multiply(const Interval lhs, const Interval rhs)
+{
+	if (interval_empty(lhs) || interval_empty(rhs))
+		return INTERVAL_EMPTY;
+
+	const double lhs_bounds[] = {lhs.lower, lhs.upper};
+	const double rhs_bounds[] = {rhs.lower, rhs.upper};
+
+	Interval result = Interval(INFINITY, -INFINITY);
+
+	for (size_t i = 0; i < 2; ++i) {
+		for (size_t j = 0; j < 2; ++j) {
+			result.lower = fmin(result.lower,
+				multiply_rounded(lhs_bounds[i], rhs_bounds[j], Rounding_Down));
+			result.upper = fmax(result.upper,
+				multiply_rounded(lhs_bounds[i], rhs_bounds[j], Rounding_Up));
+		}
+	}
+
+	return result;
+}
+
+Interval interval_divide(const Interval lhs, const Interval rhs)
+{
+	if (interval_empty(lhs) || interval_empty(rhs))
+		return INTERVAL_EMPTY;
+
+	if (rhs.lower == 0 && rhs.upper == 0)
+		return INTERVAL_EMPTY;
+
+	if (lhs.lower == 0 && lhs.upper == 0)
+		return Interval(0, 0);
+
+	// Divisor of one sign, quotient is bounded by quotients of bounds
+	if (rhs.lower > 0 || rhs.upper < 0) {
+		const double lhs_bounds[] = {lhs.lower, lhs.upper};
+		const double rhs_bounds[] = {rhs.lower, rhs.upper};
+
+		Interval result = Interval(INFINITY, -INFINITY);
+
+		// @NOTE: fmin and fmax skip NaN of infinite over infinite bounds
+		for (size_t i = 0; i < 2; ++i) {
+			for (size_t j = 0; j < 2; ++j) {
+				result.lower = fmin(result.lower,
+					divide_rounded(lhs_bounds[i], rhs_bounds[j], Rounding_Down));
+				result.upper = fmax(result.upper,
+					divide_rounded(lhs_bounds[i], rhs_bounds[j], Rounding_Up));
+			}
+		}
+
+		return result;
+	}
+
+	// Divisor approaches zero from one side, quotient is unbounded there
+	if (rhs.lower == 0) {
+		if (lhs.lower >= 0)
+			return Interval(divide_rounded(lhs.lower, rhs.upper, Rounding_Down), INFINITY);
+
+		if (lhs.upper <= 0)
+			return Interval(-INFINITY, divide_rounded(lhs.upper, rhs.upper, Rounding_Up));
+	}
+	else if (rhs.upper == 0) {
+		if (lhs.lower >= 0)
+			return Interval(-INFINITY, divide_rounded(lhs.lower, rhs.lower, Rounding_Up));
+
+		if (lhs.upper <= 0)
+			return Interval(divide_rounded(lhs.upper, rhs.lower, Rounding_Down), INFINITY);
+	}
+
+	return INTERVAL_ENTIRE;
+}
+
+Interval interval_power(const Interval base, const Interval exponent)
+{
+	if (interval_empty(base) || interval_empty(exponent))
+		return INTERVAL_EMPTY;
+
+	if (exponent.lower == exponent.upper && trunc(exponent.lower) == exponent.lower &&
+	    fabs(exponent.lower) <= EXACT_INTEGER_MAX) {
+		return interval_power_integer(base, exponent.lower);
+	}
+
+	// @NOTE: Negative bases are defined for integer exponents only, which
+	// give values of both signs
+	if (base.lower < 0 && floor(exponent.upper) >= exponent.lower)
+		return INTERVAL_ENTIRE;
+
+	if (base.upper < 0)
+		return INTERVAL_EMPTY;
+
+	// Power of positive base is monotonic in each operand, so that it's
+	// bounded by powers of bounds
+	const double base_bounds[] = {fmax(base.lower, 0), base.upper};
+	const double exponent_bounds[] = {exponent.lower, exponent.upper};
+
+	Interval result = Interval(INFINITY, -INFINITY);
+
+	for (size_t i = 0; i < 2; ++i) {
+		for (size_t j = 0; j < 2; ++j) {
+			result.lower = fmin(result.lower,
+				power_rounded(base_bounds[i], exponent_bounds[j], Rounding_Down));
+			result.upper = fmax(result.upper,
+				power_rounded(base_bounds[i], exponent_bounds[j], Rounding_Up));
+		}
+	}
+
+	return result;
+}
+
+void interval_write(const Interval interval, FILE* const file)
+{
+	assert(file != NULL);
+
+	if (interval_empty(interval)) {
+		fputs("empty", file);
+		return;
+	}
+
+	putc('[', file);
+	bound_write(interval.lower, Rounding_Down, file);
+	fputs(", ", file);
+	bound_write(interval.upper, Rounding_Up, file);
+	putc(']', file);
+}
+
+static double round_toward(const double number, const Rounding rounding)
+{
+	return nextafter(number, rounding == Rounding_Down ? -INFINITY : INFINITY);
+}
+
+static double round_error(const double result,
+                          const double error,
+                          const Rounding rounding)
+{
+	if (rounding == Rounding_Down ? error < 0 : error > 0)
+		return round_toward(result, rounding);
+
+	return result;
+}
+
+static double round_overflow(const double result, const Rounding rounding)
+{
+	if (rounding == Rounding_Down && result == INFINITY)
+		return DBL_MAX;
+
+	if (rounding == Rounding_Up && result == -INFINITY)
+		return -DBL_MAX;
+
+	return result;
+}
+
+static double add_rounded(const double lhs, const double rhs, const Rounding rounding)
+{
+	const double sum = lhs + rhs;
+
+	if (!isfinite(sum))
+		return isfinite(lhs) && isfinite(rhs) ? round_overflow(sum, rounding) : sum;
+
+	// @NOTE: Error of sum is exact, see Knuth's TwoSum
+	const double rhs_part = sum - lhs;
+	const double lhs_part = sum - rhs_part;
+	const double error = (lhs - lhs_part) + (rhs - rhs_part);
+
+	return round_error(sum, error, rounding);
+}
+
+static double multiply_rounded(const double lhs, const double rhs, const Rounding rounding)
+{
+	// @NOTE: Zero bound times infinite one is zero, as bounds aren't values
+	if (lhs == 0 || rhs == 0)
+		return 0;
+
+	const double product = lhs * rhs;
+
+	if (!isfinite(product))
+		return isfinite(lhs) && isfinite(rhs) ? round_overflow(product, rounding) : product;
+
+	if (fabs(product) < EXACT_ERROR_MIN)
+		return round_toward(product, rounding);
+
+	return round_error(product, fma(lhs, rhs, -product), rounding);
+}
+
+static double divide_rounded(const double lhs, const double rhs, const Rounding rounding)
+{
+	assert(rhs != 0);
+
+	if (lhs == 0 || isinf(rhs))
+		return lhs / rhs;
+
+	const double quotient = lhs / rhs;
+
+	if (!isfinite(quotient))
+		return isfinite(lhs) ? round_overflow(quotient, rounding) : quotient;
+
+	if (fabs(quotient) < EXACT_ERROR_MIN || fabs(lhs) < EXACT_ERROR_MIN)
+		return round_toward(quotient, rounding);
+
+	// @NOTE: Remainder lhs - quotient * rhs is exact and has sign of error
+	// times sign of rhs
+	const double remainder = -fma(quotient, rhs, -lhs);
+
+	return round_error(quotient, signbit(rhs) ? -remainder : remainder, rounding);
+}
+
+static double power_integer_rounded(const double base,
+                                    uint64_t exponent,
+                                    const Rounding rounding)
+{
+	assert(base >= 0);
+
+	// @NOTE: Products of nonnegative factors rounded one way are monotonic
+	double result = 1;
+	double square = base;
+
+	for (; exponent > 0; exponent >>= 1) {
+		if (exponent & 1)
+			result = multiply_rounded(result, square, rounding);
+
+		if (exponent > 1)
+			square = multiply_rounded(square, square, rounding);
+	}
+
+	return result;
+}
+
+static double power_rounded(const double base,
+                            const double exponent,
+                            const Rounding rounding)
+{
+	assert(base >= 0);
+
+	if (base == 1 || exponent == 0)
+		return 1;
+
+	if (exponent == 1)
+		return base;
+
+	const double result = pow(base, exponent);
+
+	if (isinf(result))
+		return rounding == Rounding_Down && base != 0 ? DBL_MAX : result;
+
+	if (result == 0)
+		return rounding == Rounding_Up && base != 0 ? nextafter(0, 1) : 0;
+
+	// @NOTE: pow is not correctly rounded, but its error is below one ulp
+	return round_toward(result, rounding);
+}
+
+static Interval interval_power_integer(const Interval base, const double exponent)
+{
+	if (exponent == 0)
+		return Interval(1, 1);
+
+	const uint64_t magnitude = (uint64_t)fabs(exponent);
+	const bool odd = magnitude & 1;
+
+	Interval result;
+
+	if (base.lower >= 0) {
+		result = Interval(power_integer_rounded(base.lower, magnitude, Rounding_Down),
+		                  power_integer_rounded(base.upper, magnitude, Rounding_Up));
+	}
+	else if (base.upper <= 0) {
+		const Interval absolute = interval_negate(base);
+
+		result = Interval(power_integer_rounded(absolute.lower, magnitude, Rounding_Down),
+		                  power_integer_rounded(absolute.upper, magnitude, Rounding_Up));
+
+		if (odd)
+			result = interval_negate(result);
+	}
+	else if (odd) {
+		result = Interval(-power_integer_rounded(-base.lower, magnitude, Rounding_Up),
+		                  power_integer_rounded(base.upper, magnitude, Rounding_Up));
+	}
+	else {
+		result = Interval(0, power_integer_rounded(fmax(-base.lower, base.upper),
+		                                           magnitude, Rounding_Up));
+	}
+
+	return exponent < 0 ? interval_divide(Interval(1, 1), result) : result;
+}
+
+// @NOTE: Shortest of 12 to 17 significant digits which still bounds the
+// value, 17 digits always do
+static void bound_write(const double bound, const Rounding rounding, FILE* const file)
+{
+	char text[32];
+
+	for (int precision = 12; precision <= 17; ++precision) {
+		snprintf(text, sizeof(text), "%.*g", precision, bound);
+
+		const double parsed = strtod(text, NULL);
+
+		if (!isfinite(bound) || (rounding == Rounding_Down ? parsed <= bound : parsed >= bound))
+			break;
+	}
+
+	fputs(text, file);
+}
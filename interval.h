@@ -0,0 +1,43 @@
+#ifndef __INTERVAL_H__
+#define __INTERVAL_H__
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "rational.h"
+
+// Closed interval of reals, bounds may be infinite. Operations round bounds
+// outward, so that result encloses every value of the operation on operand
+// values. Values where operation is undefined are left out, interval with
+// NaN bounds is empty.
+typedef struct interval {
+	double lower;
+	double upper;
+} Interval;
+
+#define Interval(lower, upper) (Interval){(lower), (upper)}
+#define INTERVAL_EMPTY (Interval){NAN, NAN}
+#define INTERVAL_ENTIRE (Interval){-INFINITY, INFINITY}
+
+extern bool interval_empty(const Interval interval);
+
+// Smallest interval containing both
+extern Interval interval_hull(const Interval lhs, const Interval rhs);
+
+// Enclosure of exact value, or of unknown value near the number if value
+// is inexact
+extern Interval interval_from_rational(const Rational exact, const double number);
+
+extern Interval interval_negate(const Interval operand);
+extern Interval interval_add(const Interval lhs, const Interval rhs);
+extern Interval interval_subtract(const Interval lhs, const Interval rhs);
+extern Interval interval_multiply(const Interval lhs, const Interval rhs);
+extern Interval interval_divide(const Interval lhs, const Interval rhs);
+extern Interval interval_power(const Interval base, const Interval exponent);
+
+// Write as [lower, upper] with decimal bounds rounded outward
+extern void interval_write(const Interval interval, FILE* const file);
+#define interval_print(interval) interval_write((interval), stdout)
+
+#endif // __INTERVAL_H__
@@ -1,16 +1,23 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "lexer.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 
 typedef struct lexer {
 	const String* const input;
 	size_t start;
 	size_t position;
 	List tokens;
+	Token* token; // @NOTE: If not NULL, single token is emitted here
 	bool stop;
 } Lexer;
 
@@ -29,6 +36,35 @@ static void lexer_emit(Lexer* const lexer, const TokenType type);
 
 static bool is_operator(const uint8_t c);
 
+static void report_illegal_token(const Token* const token);
+
+// Scan token following the scanned part of buffer into stream, reading
+// more input as needed; return NULL at the end of input
+static Token* token_stream_scan(TokenStream* const stream);
+
+// Move buffer from offset on to its beginning and read more input after
+// it, growing buffer if it's full
+static void token_stream_fill(TokenStream* const stream, const size_t offset);
+
+static const size_t OPERATOR_PRECEDENCE[TokenType__count] = {
+	[TokenType_Plus] = 1,
+	[TokenType_Minus] = 1,
+	[TokenType_Multiply] = 2,
+	[TokenType_Divide] = 2,
+	[TokenType_Exponent] = 3,
+};
+
+// @NOTE: Streamed operators refer to this text rather than to the buffer
+static const String OPERATOR_TEXT[TokenType__count] = {
+	[TokenType_Plus] = String("+"),
+	[TokenType_Minus] = String("-"),
+	[TokenType_Multiply] = String("*"),
+	[TokenType_Divide] = String("/"),
+	[TokenType_Exponent] = String("^"),
+	[TokenType_LeftParen] = String("("),
+	[TokenType_RightParen] = String(")"),
+};
+
 List lexical_scan(const String* const string)
 {
 	assert(string != NULL);
@@ -38,6 +74,7 @@ List lexical_scan(const String* const string)
 		.position = 0,
 		.start = 0,
 		.tokens = List(),
+		.token = NULL,
 		.stop = false,
 	};
 
@@ -48,6 +85,34 @@ List lexical_scan(const String* const string)
 	return lexer.tokens;
 }
 
+bool lexical_scan_token(const String* const string,
+                        size_t* const offset,
+                        Token* const token)
+{
+	assert(string != NULL);
+	assert(offset != NULL && *offset <= string->length);
+	assert(token != NULL);
+
+	Lexer lexer = {
+		.input = string,
+		.position = *offset,
+		.start = *offset,
+		.tokens = List(),
+		.token = token,
+		.stop = false,
+	};
+
+	token->type = TokenType__count;
+
+	LexerStateFn state = lexer_scan_text;
+	while (state != NULL && token->type == TokenType__count)
+		state = (LexerStateFn)state(&lexer);
+
+	*offset = lexer.position;
+
+	return token->type != TokenType__count;
+}
+
 bool check_illegal_tokens(const List* const tokens)
 {
 	assert(tokens != NULL);
@@ -59,16 +124,102 @@ bool check_illegal_tokens(const List* const tokens)
 
 		if (token->type == TokenType_Illegal) {
 			result = true;
-
-			fputs("Error: illegal character \'", stderr);
-			string_debug_print(&token->content);
-			fprintf(stderr, "\' encountered at %lu\n", token->position);
+			report_illegal_token(token);
 		}
 	}
 
 	return result;
 }
 
+bool token_stream_init(TokenStream* const stream,
+                       const int descriptor,
+                       const size_t chunk)
+{
+	assert(stream != NULL);
+	assert(chunk > 0);
+
+	*stream = (TokenStream){
+		.descriptor = descriptor,
+		.buffer = malloc(chunk),
+		.capacity = chunk,
+		.length = 0,
+		.offset = 0,
+		.consumed = 0,
+		.last = 1,
+		.illegal = 0,
+		.names = SymbolTable(),
+		.ahead = false,
+		.end = false,
+		.failed = false,
+	};
+
+	return stream->buffer != NULL;
+}
+
+void token_stream_deinit(TokenStream* const stream)
+{
+	assert(stream != NULL);
+
+	for (size_t i = 0; i < stream->names.count; ++i)
+		string_destroy(&stream->names.symbols[i]);
+
+	symbol_table_deinit(&stream->names);
+
+	free(stream->buffer);
+	stream->buffer = NULL;
+}
+
+Token* token_stream_peek(TokenStream* const stream)
+{
+	assert(stream != NULL);
+
+	if (!stream->ahead) {
+		if (token_stream_scan(stream) == NULL)
+			return NULL;
+
+		stream->ahead = true;
+	}
+
+	return &stream->token;
+}
+
+Token* token_stream_next(TokenStream* const stream)
+{
+	assert(stream != NULL);
+
+	Token* const result = token_stream_peek(stream);
+	stream->ahead = false;
+
+	return result;
+}
+
+String token_stream_keep(TokenStream* const stream, const String* const text)
+{
+	assert(stream != NULL);
+	assert(text != NULL && text->length > 0);
+
+	size_t id = symbol_table_find(&stream->names, text);
+
+	if (id == SYMBOL_NONE) {
+		String copy = string_create(text->length);
+		if (copy.text == NULL)
+			return (String){NULL, 0, false};
+
+		memcpy(copy.text, text->text, text->length);
+
+		id = symbol_table_intern(&stream->names, &copy);
+
+		if (id == SYMBOL_NONE) {
+			string_destroy(&copy);
+			return (String){NULL, 0, false};
+		}
+	}
+
+	const String* const name = symbol_table_name(&stream->names, id);
+
+	return (String){name->text, name->length, false};
+}
+
 void debug_print_tokens(const List* const tokens)
 {
 	assert(tokens != NULL);
@@ -115,6 +266,12 @@ bool token_type_is_right_associative(const TokenType type)
 	return type == TokenType_Exponent;
 }
 
+size_t token_type_precedence(const TokenType type)
+{
+	assert(token_type_is_binary_operator(type));
+	return OPERATOR_PRECEDENCE[type];
+}
+
 static LexerState lexer_scan_text(Lexer* const lexer)
 {
 	assert(lexer != NULL);
@@ -257,12 +414,17 @@ static void lexer_emit(Lexer* const lexer, const TokenType type)
 	assert(0 <= type && type < TokenType__count);
 
 	String content = string_trim(lexer->input, lexer->start, lexer->position);
-	*list_insert_back(&lexer->tokens, Token) = (Token){
+	const Token token = {
 		.type = type,
 		.position = lexer->start + 1,
 		.content = content,
 	};
 
+	if (lexer->token != NULL)
+		*lexer->token = token;
+	else
+		*list_insert_back(&lexer->tokens, Token) = token;
+
 	lexer->start = lexer->position;
 }
 
@@ -272,3 +434,108 @@ static bool is_operator(const uint8_t c)
 	       c == '(' || c == ')';
 }
 
+
+static void report_illegal_token(const Token* const token)
+{
+	assert(token != NULL);
+
+	fputs("Error: illegal character \'", stderr);
+	string_debug_print(&token->content);
+	fprintf(stderr, "\' encountered at %lu\n", token->position);
+}
+
+static Token* token_stream_scan(TokenStream* const stream)
+{
+	assert(stream != NULL);
+
+	Token token;
+
+	for (;;) {
+		const String window = {stream->buffer, stream->length, false};
+		size_t offset = stream->offset;
+
+		const bool found = lexical_scan_token(&window, &offset, &token);
+
+		// @NOTE: Token ending with read input may go on in the next chunk
+		if (found && (offset < stream->length || stream->end)) {
+			stream->offset = offset;
+			break;
+		}
+
+		// NUL byte ends input, as it does for lexical_scan
+		if (!found && offset > 0 && stream->buffer[offset - 1] == '\0')
+			stream->end = true;
+
+		if (!found && stream->end) {
+			stream->offset = offset;
+			return NULL;
+		}
+
+		// Token is scanned again from its beginning, whitespace is dropped
+		token_stream_fill(stream, found ? token.position - 1 : offset);
+	}
+
+	token.position += stream->consumed;
+
+	if (token.type == TokenType_Symbol || token.type == TokenType_Illegal) {
+		token.content = token_stream_keep(stream, &token.content);
+
+		if (token.content.text == NULL) {
+			stream->end = true;
+			stream->failed = true;
+			return NULL;
+		}
+	}
+	else if (token_type_is_operator(token.type))
+		token.content = OPERATOR_TEXT[token.type];
+
+	if (token.type == TokenType_Illegal) {
+		++stream->illegal;
+		report_illegal_token(&token);
+	}
+
+	stream->token = token;
+	stream->last = token.position + token.content.length;
+
+	return &stream->token;
+}
+
+static void token_stream_fill(TokenStream* const stream, const size_t offset)
+{
+	assert(stream != NULL);
+	assert(offset <= stream->length);
+
+	memmove(stream->buffer, stream->buffer + offset, stream->length - offset);
+	stream->consumed += offset;
+	stream->length -= offset;
+	stream->offset = 0;
+
+	if (stream->length == stream->capacity) {
+		uint8_t* const buffer = realloc(stream->buffer, 2 * stream->capacity);
+
+		if (buffer == NULL) {
+			stream->end = true;
+			stream->failed = true;
+			return;
+		}
+
+		stream->buffer = buffer;
+		stream->capacity *= 2;
+	}
+
+	for (;;) {
+		const ssize_t count = read(stream->descriptor, stream->buffer + stream->length,
+		                           stream->capacity - stream->length);
+
+		if (count > 0) {
+			stream->length += (size_t)count;
+			return;
+		}
+
+		if (count == 0 || errno != EINTR) {
+			stream->end = true;
+			stream->failed = count < 0;
+			return;
+		}
+	}
+}
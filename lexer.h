@@ -6,6 +6,10 @@
 
 #include "string.h"
 #include "list.h"
+#include "symbol.h"
+
+// Bytes read from file at once by token stream
+#define LEXER_CHUNK (1 << 16)
 
 typedef enum token_type {
 	TokenType_Illegal,
@@ -35,6 +39,57 @@ typedef struct token {
 } Token;
 
 extern List lexical_scan(const String* const string);
+
+// Scan one token of the string starting at the given offset, skipping
+// whitespace before it. On success the offset is moved past the token,
+// otherwise false is returned at the end of input.
+extern bool lexical_scan_token(const String* const string,
+                               size_t* const offset,
+                               Token* const token);
+
+// Tokens scanned on demand from chunks read of a file descriptor, so that
+// input of any length, possibly still arriving through a pipe, is scanned
+// in memory of one chunk. Token reaching the end of read input is carried
+// to the beginning of buffer and scanned again once more is read; buffer
+// grows only for tokens longer than a chunk.
+//
+// @NOTE: Expressions refer to text of symbols, which is copied once per
+// distinct symbol and lives as long as stream. Content of other tokens is
+// valid until the next one is scanned, operators refer to static text.
+typedef struct token_stream {
+	int descriptor;
+	uint8_t* buffer;
+	size_t capacity;
+	size_t length;   // Bytes read into buffer
+	size_t offset;   // Bytes of buffer scanned
+	size_t consumed; // Bytes of input before buffer
+	size_t last;     // Position past the last token scanned
+	size_t illegal;  // Illegal tokens, reported as they are scanned
+	SymbolTable names; // @NOTE: Owns text of its symbols
+	Token token;     // Token scanned ahead, if any
+	bool ahead;
+	bool end;        // No more input is read
+	bool failed;     // Reading failed, input is cut short
+} TokenStream;
+
+// Initialize stream reading chunks of given size from descriptor, which it
+// doesn't close; return false if memory is exhausted
+extern bool token_stream_init(TokenStream* const stream,
+                              const int descriptor,
+                              const size_t chunk);
+extern void token_stream_deinit(TokenStream* const stream);
+
+// Return next token without taking it, or NULL at the end of input
+extern Token* token_stream_peek(TokenStream* const stream);
+
+// Take next token, or return NULL at the end of input
+extern Token* token_stream_next(TokenStream* const stream);
+
+// Return copy of text living as long as stream, or empty string if memory
+// is exhausted
+extern String token_stream_keep(TokenStream* const stream,
+                                const String* const text);
+
 extern bool check_illegal_tokens(const List* const tokens);
 extern void debug_print_tokens(const List* const tokens);
 
@@ -44,4 +99,7 @@ extern bool token_type_is_binary_operator(const TokenType type);
 extern bool token_type_is_unary_operator(const TokenType type);
 extern bool token_type_is_right_associative(const TokenType type);
 
+// Precedence of binary operator, higher binds tighter
+extern size_t token_type_precedence(const TokenType type);
+
 #endif // __LEXER_H__
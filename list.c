@@ -1,7 +1,8 @@
 #include "list.h"
 
 #include <assert.h>
-#include <stdlib.h>
+
+#include "scratch.h"
 
 List list_init(void)
 {
@@ -18,12 +19,9 @@ void list_deinit(List* const list)
 	while (curr) {
 		prev = curr;
 		curr = curr->next;
-		free(prev);
+		scratch_free(prev);
 	}
 
-	if (prev == NULL)
-		free(curr);
-
 	list->head = NULL;
 	list->tail = NULL;
 }
@@ -33,7 +31,7 @@ void* list__insert_front(List* const list, const size_t size)
 	assert(list != NULL);
 	assert(size > 0);
 
-	ListNode* node = malloc(sizeof(ListNode) + size);
+	ListNode* node = scratch_allocate(sizeof(ListNode) + size);
 	if (node == NULL)
 		return NULL;
 
@@ -56,7 +54,7 @@ void* list__insert_back(List* const list, const size_t size)
 	assert(list != NULL);
 	assert(size > 0);
 
-	ListNode* node = malloc(sizeof(ListNode) + size);
+	ListNode* node = scratch_allocate(sizeof(ListNode) + size);
 	if (node == NULL)
 		return NULL;
 
@@ -82,7 +80,7 @@ void* list__insert_after(List* const list,
 	assert(node != NULL);
 	assert(size > 0);
 
-	ListNode* next = malloc(sizeof(ListNode) + size);
+	ListNode* next = scratch_allocate(sizeof(ListNode) + size);
 	if (next == NULL)
 		return NULL;
 
@@ -99,3 +97,21 @@ void* list__insert_after(List* const list,
 
 	return (void*)((char*)next + sizeof(ListNode));
 }
+
+void list_remove(List* const list, ListNode* const node)
+{
+	assert(list != NULL);
+	assert(node != NULL);
+
+	if (node->prev != NULL)
+		node->prev->next = node->next;
+	else
+		list->head = node->next;
+
+	if (node->next != NULL)
+		node->next->prev = node->prev;
+	else
+		list->tail = node->prev;
+
+	scratch_free(node);
+}
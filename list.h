@@ -32,6 +32,9 @@ extern void* list__insert_after(List* const list,
 #define list_insert_after(list_p, node_p, type) \
 	((type*)list__insert_after((list_p), (node_p), sizeof(type)))
 
+// Unlink given node from the list and free it
+extern void list_remove(List* const list, ListNode* const node);
+
 #define list_range(it, list) \
 	(ListNode* it = (list).head; (it) != NULL; (it) = (it)->next)
 
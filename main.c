@@ -1,7 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "common.h"
 #include "string.h"
@@ -9,62 +14,992 @@
 #include "lexer.h"
 #include "parser.h"
 #include "transform.h"
+#include "symbol.h"
+#include "derivative.h"
+#include "evaluator.h"
+#include "native.h"
+#include "document.h"
+#include "serialize.h"
+#include "trace.h"
+#include "parallel.h"
+
+// Longest value text of -D option or bindings file entry
+#define BINDING_VALUE_MAX 63
+
+// Bisection of bounds makes this many interval evaluations by default
+#define BOUNDS_BUDGET_DEFAULT 0
+
+// Lines of bindings file evaluated at once by compiled expression
+#define NATIVE_BATCH 256
+
+// Exit status of transform stopped by a limit, its partial result is printed
+#define EXIT_PARTIAL 2
+
+typedef struct binding {
+	String symbol;
+	bool point;     // @NOTE: Range bindings are for bounds command only
+	double value;   // Nearest double of point value
+	Interval range; // Enclosure of exact value or range
+} Binding;
+
+typedef struct evaluation_options {
+	bool exact;
+	bool bounds;   // Evaluate with interval arithmetic
+	bool gradient; // Evaluate partial derivatives by every symbol too
+	bool switched; // Run plain code with switch dispatch, see evaluator_run_switch
+	size_t budget; // Interval evaluations for bisection of bounds
+	const Native* native; // Compiled expression, if any
+	ParallelEvaluator* parallel; // @NOTE: Set for large expressions only
+} EvaluationOptions;
+
+typedef struct print_options {
+	bool verbose;
+	size_t limit; // Characters of expression printed at most, 0 for all
+	Format format;
+} PrintOptions;
+
+typedef struct trace_options {
+	const char* record;  // File to write trace of rewrites to, if any
+	const char* replay;  // File of trace replayed instead of transform, if any
+	const char* summary; // File of trace to summarise, if any
+} TraceOptions;
+
+typedef struct bindings {
+	Binding* items;
+	size_t count;
+} Bindings;
 
 static void print_short_usage(void)
 {
-	LOG("Usage: expr [-h|--help] [-v] [-f <file>] [<command>] {expression}\n");
+	LOG("Usage: expr [-h|--help] [-v] [-i] [-x] [-D <symbol>=<value>] [-b <file>] [-r <evaluations>] [-j <threads>] [-l <characters>] [--format=<format>] [--max-nodes=<count>] [--max-bytes=<count>] [--max-time=<ms>] [--trace=<file>] [--replay=<file>] [--trace-summary=<file>] [--grad] [--switch-dispatch] [-f <file>] [<command>] {expression}\n");
 	exit(EXIT_SUCCESS);
 }
 
 static void print_long_usage(void)
 {
-	LOG("Usage: expr [-h|--help] [-v] [<command>] {expression}\n\n"
+	LOG("Usage: expr [-h|--help] [-v] [-i] [-x] [-D <symbol>=<value>] [-b <file>] [-r <evaluations>] [-j <threads>] [-l <characters>] [--format=<format>] [--max-nodes=<count>] [--max-bytes=<count>] [--max-time=<ms>] [--trace=<file>] [--replay=<file>] [--trace-summary=<file>] [--grad] [--switch-dispatch] [<command>] {expression}\n\n"
 		"\t-h, --help\n"
 		"\t\tOutput a usage message and exit\n\n"
 		"\t-v\n"
-		"\t\tEnable verbose expression output\n\n"
+		"\t\tEnable verbose expression output, and report tasks split\n"
+		"\t\tby threads of -j\n\n"
+		"\t-i\n"
+		"\t\tRead edited versions of expression line by line from file\n"
+		"\t\tor standard input and transform changed parts only\n\n"
+		"\t-x\n"
+		"\t\tEvaluate with exact rational arithmetic where possible\n\n"
+		"\t-D <symbol>=<value>\n"
+		"\t\tBind symbol to value for evaluation, may be repeated; bounds\n"
+		"\t\tcommand also takes range <lower>:<upper> as value\n\n"
+		"\t-b <file>\n"
+		"\t\tEvaluate once for every line of file, which binds symbols\n"
+		"\t\tlike -D, separated by spaces or commas\n\n"
+		"\t-r <evaluations>\n"
+		"\t\tRefine bounds by bisecting ranges of symbols, making at most\n"
+		"\t\tthis many interval evaluations\n\n"
+		"\t-j <threads>\n"
+		"\t\tSimplify, expand and evaluate large expressions with this\n"
+		"\t\tmany threads, one per processor by default\n\n"
+		"\t-l <characters>\n"
+		"\t\tPrint at most this many characters of resulting expression,\n"
+		"\t\tfollowed by ... if it's longer\n\n"
+		"\t--format=<format>\n"
+		"\t\tPrint resulting expression as text (default), json, dot or\n"
+		"\t\tsexpr tree; shared subtrees are written once and referred\n"
+		"\t\tby node number, json notes rules which rewrote each node\n\n"
+		"\t--max-nodes=<count>, --max-bytes=<count>, --max-time=<ms>\n"
+		"\t\tStop simplify or expand command once expression has more\n"
+		"\t\tnodes or bytes of nodes, or once it takes longer; partial\n"
+		"\t\tresult is printed and exit status is 2, it keeps the last\n"
+		"\t\trewrite, so it may exceed node or byte limit\n\n"
+		"\t--trace=<file>\n"
+		"\t\tWrite rewrites of simplify or expand command to file, one\n"
+		"\t\tper line as rule, node path and node hashes before and after\n\n"
+		"\t--replay=<file>\n"
+		"\t\tApply rewrites of trace file instead of simplify or expand\n"
+		"\t\tcommand, checking that each one rewrites the same node\n\n"
+		"\t--trace-summary=<file>\n"
+		"\t\tPrint count of rewrites by rule and subtrees rewritten most\n"
+		"\t\toften in trace file and exit\n\n"
+		"\t--switch-dispatch\n"
+		"\t\tEvaluate with a switch per instruction instead of threaded\n"
+		"\t\tcode, as a baseline for benchmarks\n\n"
 		"\t-f <file>\n"
-		"\t\tRead expression from file\n\n"
+		"\t\tRead expression from file, or from standard input if it's -\n"
+		"\t\tor if neither file nor expression is given; input is scanned\n"
+		"\t\tas it's read, so it may be of any length\n\n"
 		"\tcommand, any of:\n"
 		"\t\tsimplify\tsimplify resulting expression (default)\n"
 		"\t\texpand\t\texpand resulting expression\n"
-		"\t\teval\t\tevaluate resulting expression\n\n");
+		"\t\tnormalize\texpand polynomials into sums of monomials\n"
+		"\t\tfactor\t\tfactor polynomials over integers\n"
+		"\t\tcollect\t\tcollect like terms of sums\n"
+		"\t\tdiff <x>[,<y>...]\n"
+		"\t\t\t\tdifferentiate with respect to each variable,\n"
+		"\t\t\t\tone derivative per line\n"
+		"\t\teval [--grad]\tevaluate resulting expression, with partial\n"
+		"\t\t\t\tderivatives by every symbol as d<symbol>=<value>\n"
+		"\t\tcompile\t\tevaluate resulting expression compiled into\n"
+		"\t\t\t\tnative code with cc, cached in $EXPR_CACHE or\n"
+		"\t\t\t\t~/.cache/expr\n"
+		"\t\tbounds\t\tbound resulting expression with interval\n"
+		"\t\t\t\tarithmetic, rounding outward\n\n");
 	exit(EXIT_SUCCESS);
 }
 
-static void print_expression(const Expression* const expression, const bool verbose)
+static void print_expression(const Expression* const expression,
+                             const PrintOptions* const print)
 {
 	assert(expression != NULL);
+	assert(print != NULL);
 
-	if (verbose)
+	if (print->verbose)
 		expression_verbose_print(expression);
+	else if (print->format != Format_Text) {
+		if (!expression_serialize(expression, print->format, stdout))
+			LOG("Out of memory, output is incomplete\n");
+	}
+	else if (print->limit > 0) {
+		expression_write_bounded(expression, stdout, print->limit);
+		putc('\n', stdout);
+	}
 	else
 		expression_print(expression);
 }
 
+// Read trace from file, return false if it can't be read
+static bool read_trace(const char* const filename, Trace* const trace)
+{
+	assert(filename != NULL);
+	assert(trace != NULL);
+
+	FILE* const file = fopen(filename, "r");
+	if (file == NULL) {
+		LOGF("Failed to open file %s\n", filename);
+		return false;
+	}
+
+	const bool result = trace_read(trace, file);
+	fclose(file);
+
+	return result;
+}
+
+// Simplify or expand expression within limits, recording or replaying
+// rewrites as asked, split into tasks of pool if it's not NULL; return
+// false if trace fails
+static bool run_transform(Expression** const expression,
+                          const TransformMode transform,
+                          const TraceOptions* const tracing,
+                          const TransformLimits* const limits,
+                          ParallelPool* const pool,
+                          TransformStatus* const status)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(transform == TransformMode_Simplify || transform == TransformMode_Expand);
+	assert(tracing != NULL);
+	assert(limits != NULL);
+	assert(status != NULL);
+
+	Trace trace = Trace();
+	bool result = true;
+
+	*status = TransformStatus_Complete;
+
+	if (tracing->replay != NULL) {
+		result = read_trace(tracing->replay, &trace) && trace_replay(&trace, expression);
+		trace_deinit(&trace);
+		return result;
+	}
+
+	TransformOptions options = TransformOptions();
+	options.limits = *limits;
+	options.pool = pool;
+	options.grain = PARALLEL_GRAIN;
+
+	if (tracing->record != NULL)
+		options.trace = &trace;
+
+	*status = transform == TransformMode_Simplify
+		? simplify_expression_bounded(expression, &options)
+		: expand_expression_bounded(expression, &options);
+
+	if (tracing->record == NULL)
+		return true;
+
+	if (trace.failed)
+		LOG("Out of memory, trace is incomplete\n");
+
+	FILE* const file = fopen(tracing->record, "w");
+	if (file != NULL) {
+		trace_write(&trace, file);
+		result = fclose(file) == 0 && !trace.failed;
+	}
+	else {
+		LOGF("Failed to open file %s\n", tracing->record);
+		result = false;
+	}
+
+	trace_deinit(&trace);
+
+	return result;
+}
+
+static void print_evaluation(const Expression* const expression, const bool exact)
+{
+	assert(expression != NULL);
+
+	if (exact) {
+		const Rational value = evaluate_expression_exact(expression);
+
+		if (rational_exact(value)) {
+			rational_print(value);
+			putc('\n', stdout);
+			return;
+		}
+	}
+
+	printf("%.12g\n", evaluate_expression(expression));
+}
+
+// Check whether text is a single symbol, surrounding whitespace aside
+static bool parse_symbol(const String* const text, String* const symbol)
+{
+	assert(text != NULL);
+	assert(symbol != NULL);
+
+	size_t offset = 0;
+	Token token;
+
+	if (!lexical_scan_token(text, &offset, &token) || token.type != TokenType_Symbol)
+		return false;
+
+	while (offset < text->length && isspace(text->text[offset]))
+		++offset;
+
+	*symbol = token.content;
+
+	return offset == text->length;
+}
+
+// Intern comma separated symbols, return false if any of them isn't one
+static bool parse_variables(const char* const names, SymbolTable* const variables)
+{
+	assert(names != NULL);
+	assert(variables != NULL);
+
+	const String list = string_init(names);
+
+	for (size_t begin = 0, end = 0; begin <= list.length; begin = end + 1) {
+		for (end = begin; end < list.length && list.text[end] != ','; ++end)
+			;
+
+		const String name = string_trim(&list, begin, end);
+
+		String symbol;
+
+		if (!parse_symbol(&name, &symbol)) {
+			LOGF("Invalid variable name '%.*s'\n", (int)name.length, (char*)name.text);
+			return false;
+		}
+
+		if (symbol_table_intern(variables, &symbol) == SYMBOL_NONE) {
+			LOG("Out of memory\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Parse decimal number with its enclosure
+static bool parse_number(const String* const text,
+                         double* const value,
+                         Interval* const range)
+{
+	assert(text != NULL);
+	assert(value != NULL);
+	assert(range != NULL);
+
+	if (text->length > BINDING_VALUE_MAX)
+		return false;
+
+	// @NOTE: Value is copied, as text may be not terminated
+	char number[BINDING_VALUE_MAX + 1];
+	memcpy(number, text->text, text->length);
+	number[text->length] = '\0';
+
+	char* end = number;
+	*value = strtod(number, &end);
+
+	if (end == number)
+		return false;
+
+	while (isspace(*end))
+		++end;
+
+	if (*end != '\0')
+		return false;
+
+	// @NOTE: Exact value is known for digits with optional sign only
+	size_t begin = 0, end_digits = text->length;
+
+	while (begin < end_digits && isspace(text->text[begin]))
+		++begin;
+
+	while (end_digits > begin && isspace(text->text[end_digits - 1]))
+		--end_digits;
+
+	const bool negative = begin < end_digits && text->text[begin] == '-';
+
+	if (negative || (begin < end_digits && text->text[begin] == '+'))
+		++begin;
+
+	const String digits = string_trim(text, begin, end_digits);
+	const Rational exact = rational_parse(&digits);
+
+	*range = interval_from_rational(negative ? rational_negate(exact) : exact, *value);
+
+	return true;
+}
+
+// Parse binding of form symbol=value or symbol=lower:upper
+static bool parse_binding(const String* const text, Binding* const binding)
+{
+	assert(text != NULL);
+	assert(binding != NULL);
+
+	size_t equals = 0;
+	while (equals < text->length && text->text[equals] != '=')
+		++equals;
+
+	if (equals == text->length) {
+		LOGF("Invalid binding '%.*s', expected <symbol>=<value>\n",
+		     (int)text->length, (char*)text->text);
+		return false;
+	}
+
+	const String name = string_trim(text, 0, equals);
+	const String value = string_trim(text, equals + 1, text->length);
+
+	if (!parse_symbol(&name, &binding->symbol)) {
+		LOGF("Invalid symbol '%.*s' in binding\n", (int)name.length, (char*)name.text);
+		return false;
+	}
+
+	size_t colon = 0;
+	while (colon < value.length && value.text[colon] != ':')
+		++colon;
+
+	binding->point = colon == value.length;
+
+	bool valid;
+
+	if (binding->point)
+		valid = parse_number(&value, &binding->value, &binding->range);
+	else {
+		const String lower_text = string_trim(&value, 0, colon);
+		const String upper_text = string_trim(&value, colon + 1, value.length);
+
+		double lower, upper;
+		Interval lower_range, upper_range;
+
+		valid = parse_number(&lower_text, &lower, &lower_range) &&
+		        parse_number(&upper_text, &upper, &upper_range) &&
+		        lower <= upper;
+
+		binding->value = NAN;
+		binding->range = Interval(lower_range.lower, upper_range.upper);
+	}
+
+	if (!valid) {
+		LOGF("Invalid value '%.*s' in binding\n", (int)value.length, (char*)value.text);
+		return false;
+	}
+
+	return true;
+}
+
+// Bind slot of symbol, if evaluator has it
+static void bind_slot(const Evaluator* const evaluator,
+                      const Binding* const binding,
+                      const Binding** const slots)
+{
+	const size_t slot = evaluator_slot(evaluator, &binding->symbol);
+
+	if (slot != SYMBOL_NONE)
+		slots[slot] = binding;
+}
+
+// Bind values of symbols by slot, first by bindings and then by bindings of
+// the line, if any. Ranges are needed for bounds only
+static bool bind_values(const Evaluator* const evaluator,
+                        const Bindings* const bindings,
+                        const String* const line,
+                        const EvaluationOptions* const options,
+                        double* const values,
+                        Interval* const ranges)
+{
+	assert(evaluator != NULL);
+	assert(bindings != NULL);
+	assert(options != NULL);
+	assert(values != NULL);
+	assert(ranges != NULL || !options->bounds);
+
+	const size_t count = evaluator->symbols.count;
+
+	// @NOTE: Bindings of the line are kept until values are copied
+	const Binding** const slots = calloc(count + 1, sizeof(Binding*));
+	Binding* const line_bindings = line != NULL
+		? malloc((line->length / 2 + 1) * sizeof(Binding))
+		: NULL;
+
+	bool result = slots != NULL && (line == NULL || line_bindings != NULL);
+
+	if (!result)
+		LOG("Out of memory\n");
+
+	for (size_t i = 0; i < bindings->count && result; ++i)
+		bind_slot(evaluator, &bindings->items[i], slots);
+
+	for (size_t begin = 0, end = 0, parsed = 0; line != NULL && result; begin = end) {
+		while (begin < line->length &&
+		       (isspace(line->text[begin]) || line->text[begin] == ','))
+			++begin;
+
+		if (begin == line->length)
+			break;
+
+		for (end = begin; end < line->length &&
+		     !isspace(line->text[end]) && line->text[end] != ','; ++end)
+			;
+
+		const String text = string_trim(line, begin, end);
+
+		Binding* const binding = &line_bindings[parsed++];
+
+		result = parse_binding(&text, binding);
+		if (result)
+			bind_slot(evaluator, binding, slots);
+	}
+
+	for (size_t i = 0; i < count && result; ++i) {
+		const String* const symbol = symbol_table_name(&evaluator->symbols, i);
+
+		if (slots[i] == NULL) {
+			LOGF("Unbound symbol '%.*s'\n", (int)symbol->length, (char*)symbol->text);
+			result = false;
+		}
+		else if (!slots[i]->point && !options->bounds) {
+			LOGF("Symbol '%.*s' is bound to range, which needs bounds command\n",
+			     (int)symbol->length, (char*)symbol->text);
+			result = false;
+		}
+		else {
+			values[i] = slots[i]->value;
+
+			if (ranges != NULL)
+				ranges[i] = slots[i]->range;
+		}
+	}
+
+	free(slots);
+	free(line_bindings);
+
+	return result;
+}
+
+// Evaluate with symbols bound by bindings and then by bindings of the line,
+// if any; expressions without symbols are evaluated as usual
+static bool print_bound_evaluation(const Expression* const expression,
+                                   const Evaluator* const evaluator,
+                                   const Bindings* const bindings,
+                                   const String* const line,
+                                   const EvaluationOptions* const options)
+{
+	assert(expression != NULL);
+	assert(evaluator != NULL);
+	assert(bindings != NULL);
+	assert(options != NULL);
+
+	const size_t count = evaluator->symbols.count;
+
+	if (count == 0 && !options->bounds && !options->gradient && options->native == NULL &&
+	    options->parallel == NULL) {
+		print_evaluation(expression, options->exact);
+		return true;
+	}
+
+	// @NOTE: Partial derivatives follow values of slots
+	double* const values = malloc((2 * count + 1) * sizeof(double));
+	Interval* const ranges = options->bounds
+		? malloc((count + 1) * sizeof(Interval))
+		: NULL;
+
+	if (values == NULL || (options->bounds && ranges == NULL)) {
+		LOG("Out of memory\n");
+		free(values);
+		free(ranges);
+		return false;
+	}
+
+	double* const gradient = values + count;
+
+	bool result = bind_values(evaluator, bindings, line, options, values, ranges);
+
+	if (result && options->bounds) {
+		interval_print(evaluator_bound(evaluator, ranges, options->budget));
+		putc('\n', stdout);
+	}
+	else if (result) {
+		double value;
+
+		if (options->gradient)
+			result = evaluator_run_gradient(evaluator, values, &value, gradient);
+		else if (options->native != NULL)
+			value = options->native->evaluate(values);
+		else if (options->parallel != NULL)
+			value = parallel_run(options->parallel, values);
+		else if (options->switched)
+			value = evaluator_run_switch(evaluator, values);
+		else
+			value = evaluator_run(evaluator, values);
+
+		if (result) {
+			printf("%.12g", value);
+
+			for (size_t i = 0; i < count && options->gradient; ++i) {
+				const String* const symbol = symbol_table_name(&evaluator->symbols, i);
+
+				printf(" d%.*s=%.12g", (int)symbol->length, (char*)symbol->text, gradient[i]);
+			}
+
+			putc('\n', stdout);
+		}
+		else
+			LOG("Out of memory\n");
+	}
+
+	free(values);
+	free(ranges);
+
+	return result;
+}
+
+// Evaluate pending lines of bindings file with native batch function
+static void print_native_batch(const Native* const native,
+                               const double* const values,
+                               double* const results,
+                               const size_t count)
+{
+	assert(native != NULL);
+
+	native->evaluate_batch(values, NATIVE_BATCH, results, count);
+
+	for (size_t i = 0; i < count; ++i)
+		printf("%.12g\n", results[i]);
+}
+
+// Evaluate expression once for every line of bindings file, natively in
+// batches of lines if expression is compiled
+static bool print_file_evaluations(const Expression* const expression,
+                                   const Evaluator* const evaluator,
+                                   const Bindings* const bindings,
+                                   const char* const filename,
+                                   const EvaluationOptions* const options)
+{
+	assert(evaluator != NULL);
+	assert(filename != NULL);
+	assert(options != NULL);
+
+	FILE* const file = fopen(filename, "r");
+	if (file == NULL) {
+		LOGF("Failed to open file %s\n", filename);
+		return false;
+	}
+
+	const size_t count = evaluator->symbols.count;
+	const Native* const native = options->native;
+
+	// @NOTE: Values of batch are by slot and then by line
+	double* const values = native != NULL
+		? malloc(((count + 1) * NATIVE_BATCH + count + 1) * sizeof(double))
+		: NULL;
+	double* const results = native != NULL
+		? malloc(NATIVE_BATCH * sizeof(double))
+		: NULL;
+
+	if (native != NULL && (values == NULL || results == NULL)) {
+		LOG("Out of memory\n");
+		free(values);
+		free(results);
+		fclose(file);
+		return false;
+	}
+
+	bool result = true;
+
+	double* const line_values = values != NULL ? values + count * NATIVE_BATCH : NULL;
+	size_t pending = 0;
+
+	char* line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+
+	while ((length = getline(&line, &capacity, file)) != -1) {
+		const String text = {(uint8_t*)line, length, false};
+
+		ssize_t blank = 0;
+		while (blank < length && isspace(line[blank]))
+			++blank;
+
+		if (blank == length)
+			continue;
+
+		if (native == NULL) {
+			result &= print_bound_evaluation(expression, evaluator, bindings, &text, options);
+			continue;
+		}
+
+		// @NOTE: Lines with invalid bindings are reported before pending ones
+		if (!bind_values(evaluator, bindings, &text, options, line_values, NULL)) {
+			result = false;
+			continue;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			values[i * NATIVE_BATCH + pending] = line_values[i];
+
+		if (++pending == NATIVE_BATCH) {
+			print_native_batch(native, values, results, pending);
+			pending = 0;
+		}
+	}
+
+	if (pending > 0)
+		print_native_batch(native, values, results, pending);
+
+	free(line);
+	free(values);
+	free(results);
+	fclose(file);
+
+	return result;
+}
+
+static bool print_gradient(const Expression* const expression,
+                           const char* const names,
+                           const PrintOptions* const print)
+{
+	assert(expression != NULL);
+	assert(names != NULL);
+
+	SymbolTable variables = SymbolTable();
+
+	if (!parse_variables(names, &variables)) {
+		symbol_table_deinit(&variables);
+		return false;
+	}
+
+	Gradient gradient;
+
+	const GradientStatus status = expression_gradient(expression, &variables, &gradient);
+
+	switch (status) {
+	case GradientStatus_Success:
+		for (size_t i = 0; i < gradient.count; ++i)
+			print_expression(gradient.derivatives[i], print);
+		break;
+
+	case GradientStatus_VariableExponent:
+		LOG("Can't differentiate power with variable exponent\n");
+		break;
+
+	case GradientStatus_OutOfMemory:
+		LOG("Out of memory\n");
+		break;
+	}
+
+	gradient_deinit(&gradient);
+	symbol_table_deinit(&variables);
+
+	return status == GradientStatus_Success;
+}
+
+static int run_incremental(const char* const filename,
+                           const TransformMode transform,
+                           const Bindings* const bindings,
+                           const PrintOptions* const print,
+                           const EvaluationOptions* const options)
+{
+	FILE* const file = filename != NULL ? fopen(filename, "r") : stdin;
+	if (file == NULL) {
+		LOGF("Failed to open file %s\n", filename);
+		return EXIT_FAILURE;
+	}
+
+	int result = EXIT_SUCCESS;
+
+	const bool evaluate = transform == TransformMode_Evaluate ||
+	                      transform == TransformMode_Bound;
+
+	const TransformMode mode = evaluate
+		? TransformMode_Simplify
+		: transform;
+
+	Document* document = NULL;
+
+	// @NOTE: Edits which bring back earlier structure reuse its evaluator
+	EvaluatorCache cache = EvaluatorCache();
+
+	char* line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+
+	while ((length = getline(&line, &capacity, file)) != -1) {
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+			--length;
+
+		const String text = {(uint8_t*)line, length, false};
+
+		bool valid;
+
+		if (document == NULL) {
+			document = document_create(&text, mode);
+			if (document == NULL) {
+				result = EXIT_FAILURE;
+				break;
+			}
+
+			valid = document->expression != NULL;
+		}
+		else
+			valid = document_update(document, &text);
+
+		if (!valid) {
+			if (document->illegal_tokens > 0)
+				check_illegal_tokens(&document->tokens);
+			else
+				syntax_errors_print(&document->errors);
+
+			result = EXIT_FAILURE;
+			continue;
+		}
+
+		if (expression_empty(document->expression))
+			continue;
+
+		if (evaluate) {
+			const Evaluator* const evaluator =
+				evaluator_cache_get(&cache, document->expression);
+
+			if (evaluator == NULL) {
+				LOG("Failed to compile expression\n");
+				result = EXIT_FAILURE;
+			}
+			else if (!print_bound_evaluation(document->expression, evaluator,
+			                                 bindings, NULL, options)) {
+				result = EXIT_FAILURE;
+			}
+		}
+		else
+			print_expression(document->expression, print);
+	}
+
+	free(line);
+
+	evaluator_cache_deinit(&cache);
+
+	if (document != NULL)
+		document_destroy(&document);
+
+	if (file != stdin)
+		fclose(file);
+
+	return result;
+}
+
 int main(int argc, char* argv[])
 {
 	int result = EXIT_SUCCESS;
-	bool verbose = false;
+	PrintOptions print = {false, 0, Format_Text};
+	TraceOptions tracing = {NULL, NULL, NULL};
+	TransformLimits limits = TransformLimits();
+	bool incremental = false;
+	EvaluationOptions options = {false, false, false, false, BOUNDS_BUDGET_DEFAULT, NULL, NULL};
+	size_t threads = 1;
+	ParallelPool* pool = NULL;
 	TransformMode transform = TransformMode_Simplify;
+	const char* variables = NULL;
 
-	String input;
+	String input = {NULL, 0, false};
+	List tokens = List();
+	TokenStream stream = {.buffer = NULL};
+	int descriptor = -1; // @NOTE: Expression is streamed from it, if any
 
 	int argp = 1;
-	char* filename = NULL;
+	char* filename = NULL; // @NOTE: NULL for standard input
+	bool standard_input = false;
+	char* bindings_filename = NULL;
+
+	// @NOTE: There are less -D options than arguments
+	Binding items[argc];
+	Bindings bindings = {items, 0};
+
+	// @NOTE: Output is buffered here rather than on the heap, line by line
+	// for terminal
+	static char output[BUFSIZ];
+	setvbuf(stdout, output, isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, sizeof(output));
+
+	const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	if (processors > 1)
+		threads = (size_t)processors;
 
 	if (argc > 1) {
 		while (argp != argc) {
 			if (strcmp(argv[argp], "-v") == 0) {
-				verbose = true;
+				print.verbose = true;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "-i") == 0) {
+				incremental = true;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "-x") == 0) {
+				options.exact = true;
 				++argp;
 			}
 			else if (strcmp(argv[argp], "-h") == 0)
 				print_short_usage();
 			else if (strcmp(argv[argp], "--help") == 0)
 				print_long_usage();
+			else if (strcmp(argv[argp], "-D") == 0) {
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				const String text = string_init(argv[argp + 1]);
+
+				if (!parse_binding(&text, &bindings.items[bindings.count++])) {
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				argp += 2;
+			}
+			else if (strcmp(argv[argp], "-b") == 0) {
+				bindings_filename = argv[argp + 1];
+				argp += 2;
+			}
+			else if (strcmp(argv[argp], "--grad") == 0) {
+				options.gradient = true;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "--switch-dispatch") == 0) {
+				options.switched = true;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "-r") == 0) {
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				char* end = NULL;
+				const long budget = strtol(argv[argp + 1], &end, 10);
+
+				if (end == argv[argp + 1] || *end != '\0' || budget < 0) {
+					LOGF("Invalid evaluation budget '%s'\n", argv[argp + 1]);
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				options.budget = (size_t)budget;
+				argp += 2;
+			}
+			else if (strcmp(argv[argp], "-j") == 0) {
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				char* end = NULL;
+				const long count = strtol(argv[argp + 1], &end, 10);
+
+				if (end == argv[argp + 1] || *end != '\0' || count <= 0) {
+					LOGF("Invalid count of threads '%s'\n", argv[argp + 1]);
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				threads = (size_t)count;
+				argp += 2;
+			}
+			else if (strcmp(argv[argp], "-l") == 0) {
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				char* end = NULL;
+				const long limit = strtol(argv[argp + 1], &end, 10);
+
+				if (end == argv[argp + 1] || *end != '\0' || limit <= 0) {
+					LOGF("Invalid output limit '%s'\n", argv[argp + 1]);
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				print.limit = (size_t)limit;
+				argp += 2;
+			}
+			else if (strncmp(argv[argp], "--format=", strlen("--format=")) == 0) {
+				const char* const name = argv[argp] + strlen("--format=");
+
+				print.format = format_from_name(name);
+
+				if (print.format == Format__count) {
+					LOGF("Unknown output format '%s'\n", name);
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				++argp;
+			}
+			else if (strncmp(argv[argp], "--max-nodes=", strlen("--max-nodes=")) == 0 ||
+			         strncmp(argv[argp], "--max-bytes=", strlen("--max-bytes=")) == 0 ||
+			         strncmp(argv[argp], "--max-time=", strlen("--max-time=")) == 0) {
+				const char* const value = strchr(argv[argp], '=') + 1;
+
+				char* end = NULL;
+				const long long limit = strtoll(value, &end, 10);
+
+				if (end == value || *end != '\0' || limit <= 0) {
+					LOGF("Invalid limit '%s'\n", argv[argp]);
+					result = EXIT_FAILURE;
+					goto exit;
+				}
+
+				if (argv[argp][strlen("--max-")] == 'n')
+					limits.nodes = (size_t)limit;
+				else if (argv[argp][strlen("--max-")] == 'b')
+					limits.bytes = (size_t)limit;
+				else
+					limits.milliseconds = (size_t)limit;
+
+				++argp;
+			}
+			else if (strncmp(argv[argp], "--trace=", strlen("--trace=")) == 0) {
+				tracing.record = argv[argp] + strlen("--trace=");
+				++argp;
+			}
+			else if (strncmp(argv[argp], "--replay=", strlen("--replay=")) == 0) {
+				tracing.replay = argv[argp] + strlen("--replay=");
+				++argp;
+			}
+			else if (strncmp(argv[argp], "--trace-summary=", strlen("--trace-summary=")) == 0) {
+				tracing.summary = argv[argp] + strlen("--trace-summary=");
+				++argp;
+			}
 			else if (strcmp(argv[argp], "-f") == 0) {
-				filename = argv[argp + 1];
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				standard_input = strcmp(argv[argp + 1], "-") == 0;
+				filename = standard_input ? NULL : argv[argp + 1];
 				argp += 2;
 			}
 			else if (strcmp(argv[argp], "simplify") == 0) {
@@ -75,54 +1010,178 @@ int main(int argc, char* argv[])
 				transform = TransformMode_Expand;
 				++argp;
 			}
+			else if (strcmp(argv[argp], "normalize") == 0) {
+				transform = TransformMode_Normalize;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "factor") == 0) {
+				transform = TransformMode_Factor;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "collect") == 0) {
+				transform = TransformMode_Collect;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "diff") == 0) {
+				if (argp + 1 == argc)
+					print_short_usage();
+
+				transform = TransformMode_Differentiate;
+				variables = argv[argp + 1];
+				argp += 2;
+			}
 			else if (strcmp(argv[argp], "eval") == 0) {
 				transform = TransformMode_Evaluate;
 				++argp;
 			}
+			else if (strcmp(argv[argp], "compile") == 0) {
+				transform = TransformMode_Compile;
+				++argp;
+			}
+			else if (strcmp(argv[argp], "bounds") == 0) {
+				transform = TransformMode_Bound;
+				options.bounds = true;
+				++argp;
+			}
 			else
 				break;
 		}
 	}
-	else
+	else if (isatty(STDIN_FILENO)) // @NOTE: Piped expression needs no arguments
 		print_short_usage();
 
-	if (filename != NULL) { // @NOTE: Expression provided as file
-		FILE* const file = fopen(filename, "r");
-		if (file == NULL) {
-			LOGF("Failed to open file %s\n", filename);
-			return EXIT_FAILURE;
-		}
+	// @NOTE: Rewriting a part depends on symbols of the whole expression
+	if (incremental && (transform == TransformMode_Normalize ||
+	                    transform == TransformMode_Factor ||
+	                    transform == TransformMode_Collect ||
+	                    transform == TransformMode_Differentiate ||
+	                    transform == TransformMode_Compile)) {
+		LOG("Incremental mode doesn't support normalize, factor, collect, diff and compile commands\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
 
-		fseek(file, 0, SEEK_END);
-		input = string_create(ftell(file));
-		rewind(file);
+	if (transform == TransformMode_Compile && options.exact) {
+		LOG("Compiled expression is evaluated without -x only\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
 
-		if (fread(input.text, sizeof(uint8_t), input.length, file) != input.length) {
-			LOGF("Failed to read file %s\n", filename);
-			string_destroy(&input);
-			fclose(file);
-			return EXIT_FAILURE;
-		}
+	if (options.gradient && (transform != TransformMode_Evaluate || options.exact)) {
+		LOG("Gradient is evaluated by eval command without -x only\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
 
-		fclose(file);
+	if (options.switched && transform != TransformMode_Evaluate) {
+		LOG("Switch dispatch is used by eval command only\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if (incremental && bindings_filename != NULL) {
+		LOG("Incremental mode doesn't support bindings file\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if (tracing.summary != NULL) {
+		Trace trace = Trace();
+
+		if (read_trace(tracing.summary, &trace))
+			trace_summary(&trace, stdout);
+		else
+			result = EXIT_FAILURE;
+
+		trace_deinit(&trace);
+		goto exit;
+	}
+
+	// @NOTE: Paths of rewrites are from the root of the whole expression
+	if ((tracing.record != NULL || tracing.replay != NULL) &&
+	    (incremental || (transform != TransformMode_Simplify &&
+	                     transform != TransformMode_Expand))) {
+		LOG("Trace is recorded and replayed by simplify and expand commands without -i only\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if ((limits.nodes > 0 || limits.bytes > 0 || limits.milliseconds > 0) &&
+	    (incremental || (transform != TransformMode_Simplify &&
+	                     transform != TransformMode_Expand))) {
+		LOG("Limits apply to simplify and expand commands without -i only\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if (tracing.record != NULL && tracing.replay != NULL) {
+		LOG("Trace is either recorded or replayed\n");
+		result = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if (incremental) {
+		result = run_incremental(filename, transform, &bindings, &print, &options);
+		goto exit;
 	}
+
+	if (filename != NULL) { // @NOTE: Expression provided as file
+		descriptor = open(filename, O_RDONLY);
+		if (descriptor < 0) {
+			LOGF("Failed to open file %s\n", filename);
+			result = EXIT_FAILURE;
+			goto exit;
+		}
+	}
+	else if (standard_input || (argv[argp] == NULL && !isatty(STDIN_FILENO)))
+		descriptor = STDIN_FILENO;
 	else if (argv[argp] != NULL) // @NOTE: Expression provided as argument
 		input = string_init(argv[argp]);
 	else
 		print_short_usage();
 
-	List tokens = lexical_scan(&input);
+	SyntaxErrors errors;
+	Expression* expression = NULL;
 
-	if (check_illegal_tokens(&tokens)) {
-		result = EXIT_FAILURE;
-		goto error_scan;
+	// @NOTE: Files and pipes are scanned chunk by chunk as the parser takes
+	// tokens, so neither their text nor their tokens are held as a whole
+	if (descriptor >= 0) {
+		if (!token_stream_init(&stream, descriptor, LEXER_CHUNK)) {
+			LOG("Out of memory\n");
+			result = EXIT_FAILURE;
+			goto error_scan;
+		}
+
+		expression = expression_parse_stream(&stream, &errors);
+
+		if (stream.failed) {
+			LOGF("Failed to read %s\n", filename != NULL ? filename : "standard input");
+			result = EXIT_FAILURE;
+			goto cleanup;
+		}
+
+		// @NOTE: Illegal characters were reported as they were scanned
+		if (stream.illegal > 0) {
+			result = EXIT_FAILURE;
+			goto cleanup;
+		}
 	}
+	else {
+		tokens = lexical_scan(&input);
+
+		if (check_illegal_tokens(&tokens)) {
+			result = EXIT_FAILURE;
+			goto error_scan;
+		}
 
-	if (verbose)
-		debug_print_tokens(&tokens);
+		if (print.verbose)
+			debug_print_tokens(&tokens);
+
+		expression = expression_parse_checked(&tokens, &errors);
+	}
 
-	Expression* expression = expression_parse(&tokens);
 	if (expression == NULL) {
+		syntax_errors_print(&errors);
 		result = EXIT_FAILURE;
 		goto error_scan;
 	}
@@ -130,20 +1189,108 @@ int main(int argc, char* argv[])
 	if (expression_empty(expression))
 		goto cleanup;
 
+	// @NOTE: Threads are started by the first large transform or evaluation
+	pool = parallel_pool_create(threads);
+
 	switch (transform) {
 	case TransformMode_Simplify:
-		simplify_expression(expression);
-		print_expression(expression, verbose);
+	case TransformMode_Expand: {
+		TransformStatus status;
+
+		if (!run_transform(&expression, transform, &tracing, &limits, pool, &status)) {
+			result = EXIT_FAILURE;
+			break;
+		}
+
+		// @NOTE: Long chains of results are rebalanced for structured formats
+		// once transformed, as parsed grouping decides rewrites and rounding
+		balance_expression(&expression, BALANCE_CHAIN_MIN);
+		print_expression(expression, &print);
+
+		if (status != TransformStatus_Complete) {
+			LOGF("Transform stopped, %s, result is partial\n", TRANSFORM_STATUS_NAME[status]);
+			result = EXIT_PARTIAL;
+		}
+	} break;
+
+	case TransformMode_Normalize:
+		normalize_expression(&expression);
+		balance_expression(&expression, BALANCE_CHAIN_MIN);
+		print_expression(expression, &print);
 		break;
 
-	case TransformMode_Expand:
-		expand_expression(expression);
-		print_expression(expression, verbose);
+	case TransformMode_Factor:
+		factor_expression(&expression);
+		balance_expression(&expression, BALANCE_CHAIN_MIN);
+		print_expression(expression, &print);
 		break;
 
-	case TransformMode_Evaluate:
-		printf("%.12g\n", evaluate_expression(expression));
+	case TransformMode_Collect:
+		collect_expression(&expression);
+		balance_expression(&expression, BALANCE_CHAIN_MIN);
+		print_expression(expression, &print);
+		break;
+
+	case TransformMode_Differentiate:
+		if (!print_gradient(expression, variables, &print))
+			result = EXIT_FAILURE;
 		break;
+
+	case TransformMode_Evaluate:
+	case TransformMode_Bound:
+	case TransformMode_Compile: {
+		Evaluator* evaluator = evaluator_compile(expression);
+
+		if (evaluator == NULL) {
+			LOG("Failed to compile expression\n");
+			result = EXIT_FAILURE;
+			break;
+		}
+
+		// @NOTE: Compiled evaluator is the fallback of native code
+		Native* native = transform == TransformMode_Compile
+			? native_load(evaluator)
+			: NULL;
+
+		if (transform == TransformMode_Compile && native == NULL)
+			LOG("Failed to compile native code, evaluating with interpreter\n");
+
+		options.native = native;
+
+		// @NOTE: Large expressions are split into tasks, unless evaluated
+		// otherwise; returns NULL for small ones
+		if (transform == TransformMode_Evaluate && native == NULL && pool != NULL &&
+		    !options.exact && !options.gradient && !options.switched) {
+			options.parallel = parallel_create(expression, &evaluator->symbols,
+			                                   pool, PARALLEL_GRAIN);
+		}
+
+		const bool success = bindings_filename != NULL
+			? print_file_evaluations(expression, evaluator, &bindings,
+			                         bindings_filename, &options)
+			: print_bound_evaluation(expression, evaluator, &bindings, NULL, &options);
+
+		if (!success)
+			result = EXIT_FAILURE;
+
+		if (native != NULL)
+			native_destroy(&native);
+
+		if (options.parallel != NULL)
+			parallel_destroy(&options.parallel);
+
+		evaluator_destroy(&evaluator);
+	} break;
+	}
+
+	if (pool != NULL) {
+		if (print.verbose) {
+			LOGF("%zu tasks forked, %zu of them stolen, by %zu threads\n",
+			     __atomic_load_n(&pool->forks, __ATOMIC_RELAXED),
+			     __atomic_load_n(&pool->steals, __ATOMIC_RELAXED), pool->count);
+		}
+
+		parallel_pool_destroy(&pool);
 	}
 
 cleanup:
@@ -151,7 +1298,13 @@ cleanup:
 error_scan:
 	list_deinit(&tokens);
 
-	string_destroy(&input);
+	if (stream.buffer != NULL)
+		token_stream_deinit(&stream);
+
+	if (descriptor > STDIN_FILENO)
+		close(descriptor);
 
+	string_destroy(&input);
+exit:
 	return result;
 }
@@ -0,0 +1,561 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "native.h"
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "transform.h"
+
+// Compiler is given by CC environment variable or is this one
+#define NATIVE_COMPILER "cc"
+
+// Value on stack of generated code, a temporary, a slot or a number
+typedef struct operand {
+	bool slot;
+	size_t index;
+	bool literal;
+	double number;
+} Operand;
+
+// Helpers of generated code, same as evaluate_power and its parts
+static const char POWER_HELPERS[] =
+	"static inline double power_chain(const double base, const int exponent)\n"
+	"{\n"
+	"\tdouble result = 1;\n"
+	"\tdouble square = base;\n"
+	"\tint first = 1;\n"
+	"\tfor (int bits = exponent; bits > 0; bits >>= 1) {\n"
+	"\t\tif (bits & 1) {\n"
+	"\t\t\tresult = first ? square : result * square;\n"
+	"\t\t\tfirst = 0;\n"
+	"\t\t}\n"
+	"\t\tif (bits > 1)\n"
+	"\t\t\tsquare *= square;\n"
+	"\t}\n"
+	"\treturn result;\n"
+	"}\n\n"
+	"static inline double power_integer(const double base, const int exponent)\n"
+	"{\n"
+	"\tconst double chain = power_chain(base, exponent < 0 ? -exponent : exponent);\n"
+	"\tif (isinf(chain))\n"
+	"\t\treturn pow(base, exponent);\n"
+	"\tif (exponent >= 0)\n"
+	"\t\treturn chain;\n"
+	"\tconst double result = 1 / chain;\n"
+	"\treturn fabs(result) < DBL_MIN ? pow(base, exponent) : result;\n"
+	"}\n\n"
+	"static inline double square_root(const double base)\n"
+	"{\n"
+	"\treturn base == -INFINITY ? INFINITY : sqrt(base) + 0.0;\n"
+	"}\n\n"
+	"static inline double power(const double base, const double exponent)\n"
+	"{\n"
+	"\tif (exponent == 0.5)\n"
+	"\t\treturn square_root(base);\n"
+	"\tif (fabs(exponent) <= POWER_CHAIN_MAX && trunc(exponent) == exponent)\n"
+	"\t\treturn power_integer(base, (int)exponent);\n"
+	"\treturn pow(base, exponent);\n"
+	"}\n\n";
+
+static void number_write(const double number, FILE* const file);
+static void operand_write(const Operand operand, FILE* const file);
+
+// Write power by constant exponent, reduced the same way as by
+// evaluate_power, into temporaries and return the last one.
+static Operand power_write(const Operand base,
+                           const double exponent,
+                           size_t* const temporaries,
+                           FILE* const file);
+
+// Write list of arguments to evaluate function, argument of slot i is
+// written by format with i
+static void arguments_write(const Evaluator* const evaluator,
+                            const char* const format,
+                            FILE* const file);
+
+// Return path of cache directory, creating it if needed, or NULL.
+static char* cache_directory(void);
+static bool make_directory(const char* const path);
+
+// Check whether file has exactly the given contents.
+static bool file_equals(const char* const path,
+                        const char* const contents,
+                        const size_t length);
+
+static bool file_write(const char* const path,
+                       const char* const contents,
+                       const size_t length);
+
+// Run compiler on source, return false if it failed.
+static bool compile(const char* const source, const char* const library);
+
+static Native* library_load(const char* const path);
+
+void native_write(const Evaluator* const evaluator, FILE* const file)
+{
+	assert(evaluator != NULL);
+	assert(file != NULL);
+
+	Operand stack[EVALUATOR_STACK_MAX];
+	size_t top = 0;
+	size_t temporaries = 0;
+
+	fputs("// Generated by expr, do not edit\n\n"
+	      "#include <float.h>\n"
+	      "#include <math.h>\n"
+	      "#include <stddef.h>\n\n", file);
+
+	fprintf(file, "#define POWER_CHAIN_MAX %d\n\n", POWER_CHAIN_MAX);
+
+	for (size_t i = 0; i < evaluator->symbols.count; ++i) {
+		const String* const symbol = symbol_table_name(&evaluator->symbols, i);
+
+		fprintf(file, "// Slot %zu is %.*s\n", i, (int)symbol->length, (char*)symbol->text);
+	}
+
+	fputs("\n", file);
+	fputs(POWER_HELPERS, file);
+	fputs("static inline double evaluate(", file);
+
+	if (evaluator->symbols.count == 0)
+		fputs("void", file);
+
+	for (size_t i = 0; i < evaluator->symbols.count; ++i)
+		fprintf(file, i > 0 ? ", const double s%zu" : "const double s%zu", i);
+
+	fputs(")\n{\n", file);
+
+	const Instruction* const end = evaluator->code + evaluator->length;
+
+	for (const Instruction* it = evaluator->code; it != end; ++it) {
+		if (it->opcode == Opcode_Load) {
+			stack[top++] = (Operand){true, it->slot, false, 0};
+			continue;
+		}
+
+		if (it->opcode == Opcode_Number) {
+			stack[top++] = (Operand){false, 0, true, it->number};
+			continue;
+		}
+
+		if (it->opcode == Opcode_Power && stack[top - 1].literal) {
+			top -= 1;
+			stack[top - 1] = power_write(stack[top - 1], stack[top].number,
+			                             &temporaries, file);
+			continue;
+		}
+
+		fprintf(file, "\tconst double t%zu = ", temporaries);
+
+		switch (it->opcode) {
+		case Opcode_Negate:
+			putc('-', file);
+			operand_write(stack[--top], file);
+			break;
+
+		case Opcode_Power:
+			top -= 2;
+			fputs("power(", file);
+			operand_write(stack[top], file);
+			fputs(", ", file);
+			operand_write(stack[top + 1], file);
+			putc(')', file);
+			break;
+
+		default:
+			top -= 2;
+			operand_write(stack[top], file);
+			fputs(it->opcode == Opcode_Add ? " + "
+			      : it->opcode == Opcode_Subtract ? " - "
+			      : it->opcode == Opcode_Multiply ? " * "
+			      : " / ", file);
+			operand_write(stack[top + 1], file);
+			break;
+		}
+
+		fputs(";\n", file);
+
+		stack[top++] = (Operand){false, temporaries++, false, 0};
+	}
+
+	assert(top == 1);
+
+	fputs("\treturn ", file);
+	operand_write(stack[0], file);
+	fputs(";\n}\n\n", file);
+
+	fputs("double expr_evaluate(const double* const slots)\n{\n"
+	      "\t(void)slots;\n"
+	      "\treturn evaluate(", file);
+	arguments_write(evaluator, "slots[%zu]", file);
+	fputs(");\n}\n\n", file);
+
+	fputs("void expr_evaluate_batch(const double* const restrict slots,\n"
+	      "                         const size_t stride,\n"
+	      "                         double* const restrict results,\n"
+	      "                         const size_t count)\n{\n"
+	      "\t(void)slots;\n"
+	      "\t(void)stride;\n"
+	      "\tfor (size_t i = 0; i < count; ++i)\n"
+	      "\t\tresults[i] = evaluate(", file);
+	arguments_write(evaluator, "slots[%zu * stride + i]", file);
+	fputs(");\n}\n", file);
+}
+
+// @NOTE: Library is named by hash, and source is kept beside it to tell
+// colliding expressions apart
+Native* native_load(const Evaluator* const evaluator)
+{
+	assert(evaluator != NULL);
+
+	char* source = NULL;
+	size_t length = 0;
+
+	FILE* const stream = open_memstream(&source, &length);
+	if (stream == NULL)
+		return NULL;
+
+	native_write(evaluator, stream);
+	fclose(stream);
+
+	Native* result = NULL;
+
+	char* const directory = cache_directory();
+	char* const path = directory != NULL ? malloc(strlen(directory) + 64) : NULL;
+	char* const temporary = directory != NULL ? malloc(strlen(directory) + 64) : NULL;
+
+	if (source == NULL || path == NULL || temporary == NULL)
+		goto cleanup;
+
+	const size_t base = sprintf(path, "%s/%016" PRIx64, directory, evaluator->hash);
+
+	strcpy(path + base, ".c");
+
+	if (file_equals(path, source, length)) {
+		strcpy(path + base, ".so");
+
+		result = library_load(path);
+		if (result != NULL)
+			goto cleanup;
+	}
+
+	// @NOTE: Files are written under unique names and renamed, library
+	// first, so that concurrent runs see either both or old source
+	const size_t unique = sprintf(temporary, "%s/%016" PRIx64 ".%ld",
+	                              directory, evaluator->hash, (long)getpid());
+
+	char* const library = malloc(unique + sizeof(".so"));
+	if (library == NULL)
+		goto cleanup;
+
+	memcpy(library, temporary, unique);
+	strcpy(library + unique, ".so");
+	strcpy(temporary + unique, ".c");
+
+	if (file_write(temporary, source, length) && compile(temporary, library)) {
+		strcpy(path + base, ".so");
+
+		if (rename(library, path) == 0) {
+			result = library_load(path);
+
+			strcpy(path + base, ".c");
+
+			if (result != NULL && rename(temporary, path) != 0) {
+				native_destroy(&result);
+			}
+		}
+	}
+
+	unlink(temporary);
+	unlink(library);
+	free(library);
+
+cleanup:
+	free(source);
+	free(directory);
+	free(path);
+	free(temporary);
+
+	return result;
+}
+
+void native_destroy(Native** const native)
+{
+	assert(native != NULL && *native != NULL);
+
+	dlclose((*native)->library);
+	free(*native);
+
+	*native = NULL;
+}
+
+// @NOTE: Chains are unrolled, so that compiler sees multiplications only
+static Operand power_write(const Operand base,
+                           const double exponent,
+                           size_t* const temporaries,
+                           FILE* const file)
+{
+	assert(temporaries != NULL);
+
+	if (exponent == 0.5 ||
+	    !(fabs(exponent) <= POWER_CHAIN_MAX && trunc(exponent) == exponent)) {
+		fprintf(file, "\tconst double t%zu = ", *temporaries);
+		fputs(exponent == 0.5 ? "square_root(" : "pow(", file);
+		operand_write(base, file);
+
+		if (exponent != 0.5) {
+			fputs(", ", file);
+			number_write(exponent, file);
+		}
+
+		fputs(");\n", file);
+
+		return (Operand){false, (*temporaries)++, false, 0};
+	}
+
+	const int magnitude = (int)fabs(exponent);
+
+	if (magnitude == 0)
+		return (Operand){false, 0, true, 1};
+
+	// @NOTE: Steps of evaluate_power_chain
+	Operand chain = base;
+	Operand square = base;
+	bool first = true;
+
+	for (int bits = magnitude; bits > 0; bits >>= 1) {
+		if (bits & 1) {
+			if (first)
+				chain = square;
+			else {
+				fprintf(file, "\tconst double t%zu = ", *temporaries);
+				operand_write(chain, file);
+				fputs(" * ", file);
+				operand_write(square, file);
+				fputs(";\n", file);
+
+				chain = (Operand){false, (*temporaries)++, false, 0};
+			}
+
+			first = false;
+		}
+
+		if (bits > 1) {
+			fprintf(file, "\tconst double t%zu = ", *temporaries);
+			operand_write(square, file);
+			fputs(" * ", file);
+			operand_write(square, file);
+			fputs(";\n", file);
+
+			square = (Operand){false, (*temporaries)++, false, 0};
+		}
+	}
+
+	if (exponent > 0 && magnitude == 1)
+		return chain;
+
+	// @NOTE: Falls back to pow as power_integer does
+	Operand result = chain;
+
+	if (exponent < 0) {
+		fprintf(file, "\tconst double t%zu = 1 / ", *temporaries);
+		operand_write(chain, file);
+		fputs(";\n", file);
+
+		result = (Operand){false, (*temporaries)++, false, 0};
+	}
+
+	fprintf(file, "\tconst double t%zu = isinf(", *temporaries);
+	operand_write(chain, file);
+
+	if (exponent < 0) {
+		fputs(") || fabs(", file);
+		operand_write(result, file);
+		fputs(") < DBL_MIN", file);
+	}
+	else
+		putc(')', file);
+
+	fputs(" ? pow(", file);
+	operand_write(base, file);
+	fputs(", ", file);
+	number_write(exponent, file);
+	fputs(") : ", file);
+	operand_write(result, file);
+	fputs(";\n", file);
+
+	return (Operand){false, (*temporaries)++, false, 0};
+}
+
+// @NOTE: Numbers are written exactly in hexadecimal
+static void number_write(const double number, FILE* const file)
+{
+	if (isnan(number))
+		fputs("NAN", file);
+	else if (isinf(number))
+		fputs(number < 0 ? "-INFINITY" : "INFINITY", file);
+	else
+		fprintf(file, "%a", number);
+}
+
+// @NOTE: Negative numbers are parenthesised, as they may follow minus
+static void operand_write(const Operand operand, FILE* const file)
+{
+	if (!operand.literal)
+		fprintf(file, operand.slot ? "s%zu" : "t%zu", operand.index);
+	else if (signbit(operand.number)) {
+		putc('(', file);
+		number_write(operand.number, file);
+		putc(')', file);
+	}
+	else
+		number_write(operand.number, file);
+}
+
+static void arguments_write(const Evaluator* const evaluator,
+                            const char* const format,
+                            FILE* const file)
+{
+	for (size_t i = 0; i < evaluator->symbols.count; ++i) {
+		if (i > 0)
+			fputs(", ", file);
+
+		fprintf(file, format, i);
+	}
+}
+
+static char* cache_directory(void)
+{
+	const char* const cache = getenv(NATIVE_CACHE_VARIABLE);
+	const char* const xdg = getenv("XDG_CACHE_HOME");
+	const char* const home = getenv("HOME");
+
+	char* result = NULL;
+
+	if (cache != NULL && cache[0] != '\0')
+		result = strdup(cache);
+	else if (xdg != NULL && xdg[0] != '\0') {
+		result = malloc(strlen(xdg) + sizeof("/expr"));
+		if (result != NULL)
+			sprintf(result, "%s/expr", xdg);
+	}
+	else if (home != NULL && home[0] != '\0') {
+		result = malloc(strlen(home) + sizeof("/.cache/expr"));
+		if (result != NULL) {
+			sprintf(result, "%s/.cache", home);
+
+			if (make_directory(result))
+				strcat(result, "/expr");
+			else {
+				free(result);
+				result = NULL;
+			}
+		}
+	}
+
+	if (result != NULL && !make_directory(result)) {
+		free(result);
+		result = NULL;
+	}
+
+	return result;
+}
+
+static bool make_directory(const char* const path)
+{
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static bool file_equals(const char* const path,
+                        const char* const contents,
+                        const size_t length)
+{
+	FILE* const file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	bool result = true;
+
+	for (size_t i = 0; i < length && result; ++i)
+		result = getc(file) == (unsigned char)contents[i];
+
+	result = result && getc(file) == EOF;
+
+	fclose(file);
+
+	return result;
+}
+
+static bool file_write(const char* const path,
+                       const char* const contents,
+                       const size_t length)
+{
+	FILE* const file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	const bool result = fwrite(contents, 1, length, file) == length;
+
+	return fclose(file) == 0 && result;
+}
+
+// @NOTE: Contraction into fma would round differently from evaluator_run
+static bool compile(const char* const source, const char* const library)
+{
+	const char* const compiler = getenv("CC");
+
+	const char* const arguments[] = {
+		compiler != NULL && compiler[0] != '\0' ? compiler : NATIVE_COMPILER,
+		"-std=c99", "-O2", "-ffp-contract=off", "-fPIC", "-shared",
+		"-o", library, source, "-lm",
+		NULL,
+	};
+
+	fflush(stdout);
+
+	const pid_t child = fork();
+
+	if (child == 0) {
+		execvp(arguments[0], (char* const*)arguments);
+		_exit(127);
+	}
+
+	int status;
+
+	return child > 0 && waitpid(child, &status, 0) == child &&
+	       WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static Native* library_load(const char* const path)
+{
+	void* const library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (library == NULL)
+		return NULL;
+
+	Native* const result = malloc(sizeof(Native));
+
+	if (result != NULL) {
+		result->library = library;
+		result->evaluate = (NativeFunction)dlsym(library, "expr_evaluate");
+		result->evaluate_batch = (NativeBatchFunction)dlsym(library, "expr_evaluate_batch");
+
+		if (result->evaluate != NULL && result->evaluate_batch != NULL)
+			return result;
+	}
+
+	free(result);
+	dlclose(library);
+
+	return NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef __NATIVE_H__
+#define __NATIVE_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "evaluator.h"
+
+// Directory of compiled code is given by this environment variable, or is
+// expr under XDG cache directory
+#define NATIVE_CACHE_VARIABLE "EXPR_CACHE"
+
+// Evaluate with values of symbols by slot
+typedef double (*NativeFunction)(const double* const slots);
+
+// Evaluate count times, value of slot i for evaluation j is at
+// slots[i * stride + j]
+typedef void (*NativeBatchFunction)(const double* const slots,
+                                    const size_t stride,
+                                    double* const results,
+                                    const size_t count);
+
+// Code of evaluator compiled into shared library with C compiler and
+// loaded. Libraries are cached on disk by structural hash of expression,
+// so that expression is compiled once.
+typedef struct native {
+	void* library;
+	NativeFunction evaluate;
+	NativeBatchFunction evaluate_batch;
+} Native;
+
+// Write C source of evaluator as straight-line functions expr_evaluate
+// and expr_evaluate_batch, same as evaluator_run
+extern void native_write(const Evaluator* const evaluator, FILE* const file);
+
+// Load compiled code of evaluator, compiling it on cache miss, return NULL
+// if compiler or cache directory is unavailable
+extern Native* native_load(const Evaluator* const evaluator);
+extern void native_destroy(Native** const native);
+
+#endif // __NATIVE_H__
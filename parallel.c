@@ -0,0 +1,719 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "lexer.h"
+#include "transform.h"
+
+// Evaluation of subtree, the root one or forked
+typedef struct evaluation_task {
+	ParallelTask task;
+	ParallelEvaluator* evaluator;
+	const Expression* expression;
+	const double* slots;
+	double value;
+} EvaluationTask;
+
+// Start threads of workers but the first one, pool runs with workers which
+// were started if some of them fail to
+static void pool_start(ParallelPool* const pool);
+static void* pool_work(void* const argument);
+
+static void task_execute(ParallelTask* const task, const size_t worker);
+
+// Take the oldest task of another worker, starting from the next one
+static ParallelTask* pool_steal(ParallelPool* const pool, const size_t worker);
+
+static bool deque_push(ParallelDeque* const deque, ParallelTask* const task);
+// Pop task if it's still at the bottom
+static bool deque_pop(ParallelDeque* const deque, const ParallelTask* const task);
+static ParallelTask* deque_steal(ParallelDeque* const deque);
+
+// Count nodes of expression, recording sizes of subtrees having at least
+// grain nodes and of shared ones, which are counted once per place but
+// walked once, and count forks; return false if memory is exhausted
+static bool evaluator_measure(ParallelEvaluator* const evaluator,
+                              const Expression* const expression,
+                              ExpressionStack* const spine,
+                              size_t* const size);
+// Measure node, which is not walked as a part of chain, see evaluator_measure
+static bool evaluator_measure_node(ParallelEvaluator* const evaluator,
+                                   const Expression* const expression,
+                                   ExpressionStack* const spine,
+                                   size_t* const size);
+// Record size of node whose operands were measured
+static bool evaluator_record(ParallelEvaluator* const evaluator,
+                             const Expression* const expression,
+                             const size_t lhs,
+                             const size_t rhs,
+                             size_t* const size);
+
+// Compile operands of subtrees having at least grain nodes which are
+// smaller, walking larger ones only
+static bool evaluator_split(ParallelEvaluator* const evaluator,
+                            const Expression* const expression);
+static bool evaluator_leaf(ParallelEvaluator* const evaluator,
+                           const Expression* const expression);
+static bool leaves_reserve(ParallelEvaluator* const evaluator);
+
+// Check whether subtree is split into tasks
+static bool evaluator_large(const ParallelEvaluator* const evaluator,
+                            const Expression* const expression);
+
+static void evaluation_run(ParallelTask* const task, const size_t worker);
+static double evaluation_value(ParallelEvaluator* const evaluator,
+                               const Expression* const expression,
+                               const double* const slots,
+                               const size_t worker);
+
+// Evaluate leaf on the worker, its symbols are bound by slots of expression
+static double leaf_run(ParallelEvaluator* const evaluator,
+                       const ParallelLeaf* const leaf,
+                       const double* const slots,
+                       const size_t worker);
+static double evaluate_operator(const TokenType operator,
+                                const double lhs,
+                                const double rhs);
+
+ParallelPool* parallel_pool_create(const size_t threads)
+{
+	if (threads < 2)
+		return NULL;
+
+	ParallelPool* const result = malloc(sizeof(ParallelPool));
+	if (result == NULL)
+		return NULL;
+
+	*result = (ParallelPool){
+		.count = threads,
+		.workers = malloc(threads * sizeof(ParallelWorker)),
+		.deques = malloc(threads * sizeof(ParallelDeque)),
+		.started = false,
+		.generation = 0,
+		.stopping = false,
+		.running = 0,
+		.forks = 0,
+		.steals = 0,
+	};
+
+	if (result->workers == NULL || result->deques == NULL) {
+		free(result->workers);
+		free(result->deques);
+		free(result);
+		return NULL;
+	}
+
+	pthread_mutex_init(&result->lock, NULL);
+	pthread_cond_init(&result->wake, NULL);
+
+	// @NOTE: The first worker is the thread calling parallel_pool_run
+	for (size_t i = 0; i < threads; ++i) {
+		pthread_mutex_init(&result->deques[i].lock, NULL);
+		result->deques[i].top = 0;
+		result->deques[i].bottom = 0;
+
+		result->workers[i] = (ParallelWorker){result, i, pthread_self()};
+	}
+
+	return result;
+}
+
+void parallel_pool_destroy(ParallelPool** const pool)
+{
+	assert(pool != NULL && *pool != NULL);
+
+	ParallelPool* const it = *pool;
+
+	if (it->started) {
+		pthread_mutex_lock(&it->lock);
+		it->stopping = true;
+		pthread_cond_broadcast(&it->wake);
+		pthread_mutex_unlock(&it->lock);
+
+		for (size_t i = 1; i < it->count; ++i)
+			pthread_join(it->workers[i].thread, NULL);
+	}
+
+	for (size_t i = 0; i < it->count; ++i)
+		pthread_mutex_destroy(&it->deques[i].lock);
+
+	pthread_cond_destroy(&it->wake);
+	pthread_mutex_destroy(&it->lock);
+
+	free(it->workers);
+	free(it->deques);
+	free(it);
+
+	*pool = NULL;
+}
+
+void parallel_pool_run(ParallelPool* const pool, ParallelTask* const task)
+{
+	assert(pool != NULL);
+	assert(task != NULL);
+
+	if (!pool->started)
+		pool_start(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	++pool->generation;
+	__atomic_store_n(&pool->running, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	task_execute(task, 0);
+
+	// @NOTE: All tasks were joined, so workers find nothing to steal and
+	// allocate nothing until the next run
+	__atomic_store_n(&pool->running, 0, __ATOMIC_RELEASE);
+}
+
+void parallel_fork(ParallelPool* const pool,
+                   const size_t worker,
+                   ParallelTask* const task)
+{
+	assert(pool != NULL);
+	assert(worker < pool->count);
+	assert(task != NULL);
+
+	task->done = 0;
+
+	__atomic_add_fetch(&pool->forks, 1, __ATOMIC_RELAXED);
+
+	if (!deque_push(&pool->deques[worker], task))
+		task_execute(task, worker);
+}
+
+void parallel_join(ParallelPool* const pool,
+                   const size_t worker,
+                   ParallelTask* const task)
+{
+	assert(pool != NULL);
+	assert(worker < pool->count);
+	assert(task != NULL);
+
+	if (deque_pop(&pool->deques[worker], task)) {
+		task_execute(task, worker);
+		return;
+	}
+
+	while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+		ParallelTask* const other = pool_steal(pool, worker);
+
+		if (other != NULL)
+			task_execute(other, worker);
+		else
+			sched_yield();
+	}
+}
+
+ParallelEvaluator* parallel_create(const Expression* const expression,
+                                   const SymbolTable* const symbols,
+                                   ParallelPool* const pool,
+                                   const size_t grain)
+{
+	assert(expression != NULL);
+	assert(symbols != NULL);
+	assert(pool != NULL);
+	assert(grain > 0);
+
+	ParallelEvaluator* result = malloc(sizeof(ParallelEvaluator));
+	if (result == NULL)
+		return NULL;
+
+	// @NOTE: Rebuilt chain nodes are copies, expression is only retained
+	Expression* balanced = expression_retain((Expression*)expression);
+	balance_expression(&balanced, grain > 2 ? grain : 2);
+
+	*result = (ParallelEvaluator){
+		.expression = balanced,
+		.symbols = symbols,
+		.pool = pool,
+		.grain = grain,
+		.sizes = ExpressionMap(),
+		.indices = ExpressionMap(),
+		.forks = 0,
+		.leaves = NULL,
+		.leaf_count = 0,
+		.leaf_capacity = 0,
+		.values = NULL,
+		.stride = 1,
+	};
+
+	size_t size = 0;
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	const bool measured = evaluator_measure(result, balanced, &spine, &size);
+
+	expression_stack_deinit(&spine);
+
+	// @NOTE: Without forks, large subtrees are chains of - or /, which are
+	// evaluated left to right and can't be split
+	if (!measured || result->forks == 0 || !evaluator_split(result, balanced)) {
+		parallel_destroy(&result);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < result->leaf_count; ++i) {
+		if (result->stride <= result->leaves[i].evaluator->symbols.count)
+			result->stride = result->leaves[i].evaluator->symbols.count + 1;
+	}
+
+	// @NOTE: Workers which fail to start are left out of count by the first
+	// run, so values of all of them are allocated
+	result->values = malloc(pool->count * result->stride * sizeof(double));
+	if (result->values == NULL) {
+		parallel_destroy(&result);
+		return NULL;
+	}
+
+	return result;
+}
+
+void parallel_destroy(ParallelEvaluator** const evaluator)
+{
+	assert(evaluator != NULL && *evaluator != NULL);
+
+	ParallelEvaluator* const it = *evaluator;
+
+	for (size_t i = 0; i < it->leaf_count; ++i) {
+		evaluator_destroy(&it->leaves[i].evaluator);
+		free(it->leaves[i].slots);
+	}
+
+	expression_map_deinit(&it->sizes);
+	expression_map_deinit(&it->indices);
+	expression_destroy(&it->expression);
+	free(it->leaves);
+	free(it->values);
+	free(it);
+
+	*evaluator = NULL;
+}
+
+double parallel_run(ParallelEvaluator* const evaluator, const double* const slots)
+{
+	assert(evaluator != NULL);
+	assert(slots != NULL || evaluator->symbols->count == 0);
+
+	EvaluationTask root = {{evaluation_run, 0}, evaluator, evaluator->expression, slots, 0};
+
+	parallel_pool_run(evaluator->pool, &root.task);
+
+	return root.value;
+}
+
+static void pool_start(ParallelPool* const pool)
+{
+	assert(pool != NULL);
+	assert(!pool->started);
+
+	size_t started = 1;
+
+	for (; started < pool->count; ++started) {
+		ParallelWorker* const worker = &pool->workers[started];
+
+		if (pthread_create(&worker->thread, NULL, pool_work, worker) != 0)
+			break;
+	}
+
+	// @NOTE: Tasks are stolen from running workers only, so the others are
+	// left out of count
+	for (size_t i = started; i < pool->count; ++i)
+		pthread_mutex_destroy(&pool->deques[i].lock);
+
+	pool->count = started;
+	pool->started = true;
+}
+
+// @NOTE: Worker sleeps between runs and steals tasks while one runs
+static void* pool_work(void* const argument)
+{
+	ParallelWorker* const worker = argument;
+	ParallelPool* const pool = worker->pool;
+
+	size_t generation = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+
+		while (!pool->stopping && pool->generation == generation)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+
+		const bool stopping = pool->stopping;
+		generation = pool->generation;
+
+		pthread_mutex_unlock(&pool->lock);
+
+		if (stopping)
+			break;
+
+		while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+			ParallelTask* const task = pool_steal(pool, worker->index);
+
+			if (task != NULL)
+				task_execute(task, worker->index);
+			else
+				sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void task_execute(ParallelTask* const task, const size_t worker)
+{
+	assert(task != NULL);
+
+	task->run(task, worker);
+	__atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+static ParallelTask* pool_steal(ParallelPool* const pool, const size_t worker)
+{
+	assert(pool != NULL);
+
+	for (size_t i = 1; i < pool->count; ++i) {
+		ParallelTask* const task = deque_steal(&pool->deques[(worker + i) % pool->count]);
+		if (task != NULL) {
+			__atomic_add_fetch(&pool->steals, 1, __ATOMIC_RELAXED);
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+static bool deque_push(ParallelDeque* const deque, ParallelTask* const task)
+{
+	assert(deque != NULL);
+	assert(task != NULL);
+
+	pthread_mutex_lock(&deque->lock);
+
+	const bool result = deque->bottom - deque->top < PARALLEL_DEQUE_CAPACITY;
+	if (result)
+		deque->tasks[deque->bottom++ % PARALLEL_DEQUE_CAPACITY] = task;
+
+	pthread_mutex_unlock(&deque->lock);
+
+	return result;
+}
+
+static bool deque_pop(ParallelDeque* const deque, const ParallelTask* const task)
+{
+	assert(deque != NULL);
+	assert(task != NULL);
+
+	pthread_mutex_lock(&deque->lock);
+
+	const bool result = deque->bottom > deque->top &&
+		deque->tasks[(deque->bottom - 1) % PARALLEL_DEQUE_CAPACITY] == task;
+	if (result)
+		--deque->bottom;
+
+	pthread_mutex_unlock(&deque->lock);
+
+	return result;
+}
+
+static ParallelTask* deque_steal(ParallelDeque* const deque)
+{
+	assert(deque != NULL);
+
+	pthread_mutex_lock(&deque->lock);
+
+	ParallelTask* const result = deque->bottom > deque->top
+		? deque->tasks[deque->top++ % PARALLEL_DEQUE_CAPACITY]
+		: NULL;
+
+	pthread_mutex_unlock(&deque->lock);
+
+	return result;
+}
+
+// @NOTE: Left operands owned by their nodes are walked down in a loop, so
+// that long chains don't nest calls, and nodes are recorded on the way back
+static bool evaluator_measure(ParallelEvaluator* const evaluator,
+                              const Expression* const expression,
+                              ExpressionStack* const spine,
+                              size_t* const size)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+	assert(size != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && !expression_shared(bottom) &&
+	       expression_stack_push(spine, bottom)) {
+		bottom = ((BinaryExpression*)bottom)->left;
+	}
+
+	bool result = evaluator_measure_node(evaluator, bottom, spine, size);
+
+	while (result && spine->count > base) {
+		const Expression* const node = spine->nodes[--spine->count];
+		const size_t lhs = *size;
+		size_t rhs = 0;
+
+		result = evaluator_measure(evaluator, ((BinaryExpression*)node)->right, spine, &rhs) &&
+		         evaluator_record(evaluator, node, lhs, rhs, size);
+	}
+
+	spine->count = base;
+
+	return result;
+}
+
+static bool evaluator_measure_node(ParallelEvaluator* const evaluator,
+                                   const Expression* const expression,
+                                   ExpressionStack* const spine,
+                                   size_t* const size)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+	assert(size != NULL);
+
+	if (expression_shared(expression)) {
+		const size_t known = expression_map_find(&evaluator->sizes, expression);
+
+		if (known != EXPRESSION_MAP_NONE) {
+			*size = known;
+			return true;
+		}
+	}
+
+	size_t lhs = 0;
+	size_t rhs = 0;
+
+	switch (expression->type) {
+	case ExpressionType_Unary:
+		if (!evaluator_measure(evaluator, ((UnaryExpression*)expression)->subexpression,
+		                       spine, &lhs)) {
+			return false;
+		}
+		break;
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		if (!evaluator_measure(evaluator, binary->left, spine, &lhs) ||
+		    !evaluator_measure(evaluator, binary->right, spine, &rhs)) {
+			return false;
+		}
+	} break;
+	}
+
+	return evaluator_record(evaluator, expression, lhs, rhs, size);
+}
+
+static bool evaluator_record(ParallelEvaluator* const evaluator,
+                             const Expression* const expression,
+                             const size_t lhs,
+                             const size_t rhs,
+                             size_t* const size)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+	assert(size != NULL);
+
+	*size = 1 + lhs + rhs;
+
+	if (lhs >= evaluator->grain && rhs >= evaluator->grain)
+		++evaluator->forks;
+
+	if (*size < evaluator->grain && !expression_shared(expression))
+		return true;
+
+	return expression_map_insert(&evaluator->sizes, expression, *size);
+}
+
+static bool evaluator_split(ParallelEvaluator* const evaluator,
+                            const Expression* const expression)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+
+	if (!evaluator_large(evaluator, expression))
+		return evaluator_leaf(evaluator, expression);
+
+	switch (expression->type) {
+	case ExpressionType_Unary:
+		return evaluator_split(evaluator, ((UnaryExpression*)expression)->subexpression);
+
+	case ExpressionType_Binary:
+		return evaluator_split(evaluator, ((BinaryExpression*)expression)->left) &&
+		       evaluator_split(evaluator, ((BinaryExpression*)expression)->right);
+	}
+
+	return true;
+}
+
+// @NOTE: Shared leaves are compiled once
+static bool evaluator_leaf(ParallelEvaluator* const evaluator,
+                           const Expression* const expression)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+
+	if (expression_map_find(&evaluator->indices, expression) != EXPRESSION_MAP_NONE)
+		return true;
+
+	if (!leaves_reserve(evaluator))
+		return false;
+
+	Evaluator* compiled = evaluator_compile(expression);
+	if (compiled == NULL)
+		return false;
+
+	const size_t count = compiled->symbols.count;
+
+	size_t* const slots = malloc((count + 1) * sizeof(size_t));
+
+	if (slots == NULL ||
+	    !expression_map_insert(&evaluator->indices, expression, evaluator->leaf_count)) {
+		free(slots);
+		evaluator_destroy(&compiled);
+		return false;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		slots[i] = symbol_table_find(evaluator->symbols, symbol_table_name(&compiled->symbols, i));
+
+	evaluator->leaves[evaluator->leaf_count++] = (ParallelLeaf){compiled, slots};
+
+	return true;
+}
+
+static bool leaves_reserve(ParallelEvaluator* const evaluator)
+{
+	assert(evaluator != NULL);
+
+	if (evaluator->leaf_count < evaluator->leaf_capacity)
+		return true;
+
+	const size_t capacity = evaluator->leaf_capacity > 0 ? 2 * evaluator->leaf_capacity : 16;
+
+	ParallelLeaf* const leaves = realloc(evaluator->leaves, capacity * sizeof(ParallelLeaf));
+	if (leaves == NULL)
+		return false;
+
+	evaluator->leaves = leaves;
+	evaluator->leaf_capacity = capacity;
+
+	return true;
+}
+
+static bool evaluator_large(const ParallelEvaluator* const evaluator,
+                            const Expression* const expression)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+
+	const size_t size = expression_map_find(&evaluator->sizes, expression);
+
+	return size != EXPRESSION_MAP_NONE && size >= evaluator->grain;
+}
+
+static void evaluation_run(ParallelTask* const task, const size_t worker)
+{
+	EvaluationTask* const it = (EvaluationTask*)task;
+
+	it->value = evaluation_value(it->evaluator, it->expression, it->slots, worker);
+}
+
+// @NOTE: Left operand is forked and stolen while the right one is
+// evaluated; both are evaluated as evaluate_expression does, so result
+// doesn't depend on which worker evaluates what
+static double evaluation_value(ParallelEvaluator* const evaluator,
+                               const Expression* const expression,
+                               const double* const slots,
+                               const size_t worker)
+{
+	assert(evaluator != NULL);
+	assert(expression != NULL);
+
+	const size_t leaf = expression_map_find(&evaluator->indices, expression);
+
+	if (leaf != EXPRESSION_MAP_NONE)
+		return leaf_run(evaluator, &evaluator->leaves[leaf], slots, worker);
+
+	switch (expression->type) {
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+		const double value = evaluation_value(evaluator, unary->subexpression, slots, worker);
+
+		return unary->operator == TokenType_Minus ? -value : value;
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		if (!evaluator_large(evaluator, binary->left) ||
+		    !evaluator_large(evaluator, binary->right)) {
+			const double lhs = evaluation_value(evaluator, binary->left, slots, worker);
+			const double rhs = evaluation_value(evaluator, binary->right, slots, worker);
+
+			return evaluate_operator(binary->operator, lhs, rhs);
+		}
+
+		EvaluationTask task = {{evaluation_run, 0}, evaluator, binary->left, slots, 0};
+
+		parallel_fork(evaluator->pool, worker, &task.task);
+		const double rhs = evaluation_value(evaluator, binary->right, slots, worker);
+		parallel_join(evaluator->pool, worker, &task.task);
+
+		return evaluate_operator(binary->operator, task.value, rhs);
+	}
+	}
+
+	return 0;
+}
+
+static double leaf_run(ParallelEvaluator* const evaluator,
+                       const ParallelLeaf* const leaf,
+                       const double* const slots,
+                       const size_t worker)
+{
+	assert(evaluator != NULL);
+	assert(leaf != NULL);
+
+	double* const values = evaluator->values + worker * evaluator->stride;
+
+	for (size_t i = 0; i < leaf->evaluator->symbols.count; ++i)
+		values[i] = leaf->slots[i] != SYMBOL_NONE ? slots[leaf->slots[i]] : 0;
+
+	return evaluator_run(leaf->evaluator, values);
+}
+
+static double evaluate_operator(const TokenType operator,
+                                const double lhs,
+                                const double rhs)
+{
+	switch (operator) {
+	case TokenType_Plus:
+		return lhs + rhs;
+
+	case TokenType_Minus:
+		return lhs - rhs;
+
+	case TokenType_Multiply:
+		return lhs * rhs;
+
+	case TokenType_Divide:
+		return lhs / rhs;
+
+	case TokenType_Exponent:
+		return evaluate_power(lhs, rhs);
+	}
+
+	return 0;
+}
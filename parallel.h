@@ -0,0 +1,142 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "parser.h"
+#include "symbol.h"
+#include "evaluator.h"
+
+// Subtrees of this many nodes at least are split into tasks by the program,
+// smaller ones are evaluated or transformed sequentially
+#define PARALLEL_GRAIN (1 << 14)
+
+// Tasks waiting in a worker's deque at most, further ones are run by the
+// worker at once
+#define PARALLEL_DEQUE_CAPACITY 256
+
+struct parallel_task;
+
+// Run task on worker, subtasks are forked on deque of that worker
+typedef void (*ParallelRunner)(struct parallel_task* const task, const size_t worker);
+
+// Task run by one worker, possibly stolen by another one; tasks of a kind
+// begin with it and have their arguments and results after it
+typedef struct parallel_task {
+	ParallelRunner run;
+	int done; // @NOTE: Accessed atomically, results are set once it's nonzero
+} ParallelTask;
+
+// Tasks of a worker, which pushes and pops them at the bottom, while idle
+// workers steal the oldest ones from the top
+typedef struct parallel_deque {
+	pthread_mutex_t lock;
+	ParallelTask* tasks[PARALLEL_DEQUE_CAPACITY];
+	size_t top;
+	size_t bottom;
+} ParallelDeque;
+
+struct parallel_pool;
+
+typedef struct parallel_worker {
+	struct parallel_pool* pool;
+	size_t index;
+	pthread_t thread;
+} ParallelWorker;
+
+// Pool of threads running fork-join tasks: a task forks subtasks on deque
+// of its worker and joins them afterwards, popping them back unless idle
+// workers stole them meanwhile. The first worker is the thread running the
+// root task, the other ones are started by the first run, so that pool of
+// a program which has nothing large to run costs an allocation only.
+//
+// @NOTE: Scratch region is used by the thread which allocated first, so
+// workers started by pool allocate on the heap; tasks take subtrees of at
+// least grain nodes, which wouldn't fit in the region anyway. Nodes may be
+// freed by any worker, see scratch.h
+typedef struct parallel_pool {
+	size_t count; // Workers, the first one is the calling thread
+	ParallelWorker* workers;
+	ParallelDeque* deques;
+	bool started;
+	pthread_mutex_t lock; // @NOTE: Guards generation and stopping
+	pthread_cond_t wake;
+	size_t generation; // Number of run, workers wake up when it grows
+	bool stopping;
+	int running; // @NOTE: Accessed atomically, workers steal while it's set
+	size_t forks;  // @NOTE: Accessed atomically, tasks forked by all runs
+	size_t steals; // @NOTE: Accessed atomically, forked tasks run by other workers
+} ParallelPool;
+
+// Create pool of given count of threads, return NULL if it's less than 2
+// or memory is exhausted
+extern ParallelPool* parallel_pool_create(const size_t threads);
+extern void parallel_pool_destroy(ParallelPool** const pool);
+
+// Run task on the calling thread, with other workers stealing its subtasks;
+// runs of a pool don't overlap
+extern void parallel_pool_run(ParallelPool* const pool, ParallelTask* const task);
+
+// Push task on deque of worker, or run it at once if deque is full
+extern void parallel_fork(ParallelPool* const pool,
+                          const size_t worker,
+                          ParallelTask* const task);
+
+// Wait until forked task is done, running it on worker unless it was
+// stolen, and running other tasks meanwhile otherwise
+extern void parallel_join(ParallelPool* const pool,
+                          const size_t worker,
+                          ParallelTask* const task);
+
+// Subtree of less than grain nodes, operand of a larger one, which is
+// evaluated sequentially; it's compiled on its own, so its symbols have
+// slots of their own
+typedef struct parallel_leaf {
+	Evaluator* evaluator;
+	size_t* slots; // Slot of expression of every slot of leaf
+} ParallelLeaf;
+
+// Evaluator of one expression by pool: operands of a binary node are
+// evaluated in parallel if both have at least grain nodes, the left one
+// being forked. Sizes of subtrees are computed and leaves are compiled
+// once, when evaluator is created, so that every evaluation decides splits
+// by lookup. Expression must outlive evaluator and must not be changed.
+//
+// @NOTE: Parsed chains are left-deep, so that none of their nodes has two
+// large operands; chains of at least grain operands are evaluated as
+// balanced by balance_expression. Their sums and products are regrouped,
+// so value may differ from the one of evaluator_run by rounding, but it's
+// the same for any count of workers.
+typedef struct parallel_evaluator {
+	Expression* expression; // @NOTE: Balanced, sharing operands with the given one
+	const SymbolTable* symbols; // @NOTE: Symbol identifiers are slot indices
+	ParallelPool* pool;
+	size_t grain;
+	ExpressionMap sizes;   // Nodes of subtrees having at least grain nodes
+	ExpressionMap indices; // Indices of leaves by their nodes
+	size_t forks;          // Nodes whose operands both have at least grain nodes
+	ParallelLeaf* leaves;
+	size_t leaf_count;
+	size_t leaf_capacity;
+	double* values; // @NOTE: Slots of leaf evaluated by each worker in turn
+	size_t stride;  // Values of a worker
+} ParallelEvaluator;
+
+// Create evaluator of expression run by pool, symbols are bound by slots of
+// table; return NULL if balanced expression has no node whose operands both
+// have at least grain nodes, so it's evaluated sequentially, or memory is
+// exhausted
+extern ParallelEvaluator* parallel_create(const Expression* const expression,
+                                          const SymbolTable* const symbols,
+                                          ParallelPool* const pool,
+                                          const size_t grain);
+extern void parallel_destroy(ParallelEvaluator** const evaluator);
+
+// Evaluate with values of symbols by slot, same as evaluator_run; symbols
+// which are not in table evaluate to zero, as of evaluate_expression
+extern double parallel_run(ParallelEvaluator* const evaluator, const double* const slots);
+
+#endif // __PARALLEL_H__
@@ -2,24 +2,38 @@
 #include "lexer.h"
 #include "string.h"
 #include "common.h"
+#include "scratch.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+// Parentheses of streamed tokens, matched as they are taken, so that the
+// same errors are found as by check_parentheses
+typedef struct parentheses {
+	SyntaxErrors errors;
+	size_t* opens; // Positions of left parentheses not yet closed
+	size_t count;
+	size_t capacity;
+} Parentheses;
 
 typedef struct parser {
 	List tokens;
-	// @TODO: Put syntax errors here
+	ListNode* end; // @NOTE: Parsing stops here, NULL for the whole list
+	TokenStream* stream; // @NOTE: Tokens are taken from it instead, if set
+	Parentheses* parentheses;
+	SyntaxErrors* errors;
+	size_t depth;  // Nesting of parsed expressions
+	size_t groups; // Nesting of parentheses
+	bool stop;     // @NOTE: Set when errors are full or nesting is too deep
 } Parser;
 
-static const size_t OPERATOR_PRECEDENCE[TokenType__count] = {
-	[TokenType_Plus] = 1,
-	[TokenType_Minus] = 1,
-	[TokenType_Multiply] = 2,
-	[TokenType_Divide] = 2,
-	[TokenType_Exponent] = 3,
-};
+// Deeper expressions are rejected, so that parsing can't exhaust the stack
+#define PARSER_DEPTH_MAX 1024
 
 static const String OPERATOR_STRING[TokenType__count] = {
 	[TokenType_Plus] = String("+"),
@@ -29,34 +43,269 @@ static const String OPERATOR_STRING[TokenType__count] = {
 	[TokenType_Exponent] = String("^"),
 };
 
+// @NOTE: Binary operators are printed surrounded by spaces
+static const String OPERATOR_SPACED_STRING[TokenType__count] = {
+	[TokenType_Plus] = String(" + "),
+	[TokenType_Minus] = String(" - "),
+	[TokenType_Multiply] = String(" * "),
+	[TokenType_Divide] = String(" / "),
+	[TokenType_Exponent] = String(" ^ "),
+};
+
+// Bytes of text written at once by expression_write
+#define PRINTER_CHUNK 4096
+
 static Expression* parser_parse_input(Parser* const parser);
 static Expression* parser_parse_expression(Parser* const parser,
                                            const size_t precedence);
+static Expression* parser_parse_primary(Parser* const parser);
+static Expression* parser_parse_group(Parser* const parser);
 static Expression* parser_parse_literal(Parser* const parser);
 static Expression* parser_parse_unary(Parser* const parser);
-static Expression* parser_parse_binary(Parser* const parser,
-                                       Expression* const lhs,
-                                       const size_t precedence);
+static bool parser_operand_ahead(Parser* const parser);
+static void parser_error(Parser* const parser,
+                         const SyntaxErrorType type,
+                         const Token* const token);
 
 static Token* parser_next(Parser* const parser);
 static Token* parser_peek(Parser* const parser);
-static void parser_backup(Parser* const parser);
 
-static void expression_clear(Expression* const expression);
-static void expression__print(const Expression* const expression);
+// Take streamed token, matching it if it's a parenthesis
+static Token* parser_take(Parser* const parser);
+static void parentheses_match(Parentheses* const parentheses,
+                              const Token* const token);
+// Add errors of left parentheses left open, the last one first
+static void parentheses_close(Parentheses* const parentheses);
+
+static bool syntax_errors_add(SyntaxErrors* const errors,
+                              const SyntaxErrorType type,
+                              const size_t position,
+                              const String* const content);
+static bool check_parentheses(const List* const tokens,
+                              SyntaxErrors* const errors);
+
+static void expression_clear(Expression* expression);
+static void literal_number_write(const Literal* const literal, FILE* const file);
 static void expression__verbose_print(const Expression* const expression);
 
+// Format number literal into buffer, return length of text
+static size_t literal_number_format(const Literal* const literal,
+                                    char* const buffer,
+                                    const size_t size);
+
+// Check whether operand of binary operator must be parenthesised to be
+// parsed back as the same operand
+static bool operand_needs_parentheses(const TokenType operator,
+                                      const Expression* const operand,
+                                      const bool right);
+static bool unary_operand_needs_parentheses(const Expression* const operand);
+
+// Make next piece of text pending, return false at the end of text or if
+// memory is exhausted
+static bool printer_advance(ExpressionPrinter* const printer);
+static bool printer_push(ExpressionPrinter* const printer,
+                         const Expression* const expression,
+                         const bool parenthesised);
+static void printer_emit(ExpressionPrinter* const printer,
+                         const void* const text,
+                         const size_t length);
+
 static Expression* create_empty_expression(void);
 
+// Fibonacci hashing of address, nodes are at least 8 bytes apart
+static size_t expression_map_slot(const ExpressionMap* const map,
+                                  const Expression* const expression);
+static void expression_set_span(Expression* const expression,
+                                const size_t begin,
+                                const size_t end);
+static size_t token_begin(const Token* const token);
+static size_t token_end(const Token* const token);
+
 Expression* expression_parse(const List* const tokens)
 {
 	assert(tokens != NULL);
 
+	SyntaxErrors errors = {.count = 0};
+
 	Parser parser = {
 		.tokens = *tokens,
+		.end = NULL,
+		.stream = NULL,
+		.parentheses = NULL,
+		.errors = &errors,
+		.depth = 0,
+		.groups = 0,
+		.stop = false,
 	};
 
-	return parser_parse_input(&parser);
+	Expression* const result = parser_parse_input(&parser);
+
+	syntax_errors_print(&errors);
+
+	return result;
+}
+
+Expression* expression_parse_checked(const List* const tokens,
+                                     SyntaxErrors* const errors)
+{
+	assert(tokens != NULL);
+	assert(errors != NULL);
+
+	errors->count = 0;
+
+	// @NOTE: Fast path, mismatched parentheses are rejected before any
+	// expression is created
+	if (!check_parentheses(tokens, errors))
+		return NULL;
+
+	Parser parser = {
+		.tokens = *tokens,
+		.end = NULL,
+		.stream = NULL,
+		.parentheses = NULL,
+		.errors = errors,
+		.depth = 0,
+		.groups = 0,
+		.stop = false,
+	};
+
+	Expression* result = parser_parse_input(&parser);
+
+	if (result != NULL && errors->count > 0)
+		expression_destroy(&result);
+
+	return result;
+}
+
+Expression* expression_parse_stream(TokenStream* const stream,
+                                    SyntaxErrors* const errors)
+{
+	assert(stream != NULL);
+	assert(errors != NULL);
+
+	errors->count = 0;
+
+	Parentheses parentheses = {
+		.errors = {.count = 0},
+		.opens = NULL,
+		.count = 0,
+		.capacity = 0,
+	};
+
+	Parser parser = {
+		.tokens = List(),
+		.end = NULL,
+		.stream = stream,
+		.parentheses = &parentheses,
+		.errors = errors,
+		.depth = 0,
+		.groups = 0,
+		.stop = false,
+	};
+
+	Expression* result = parser_parse_input(&parser);
+
+	// @NOTE: Input is taken to its end even if parsing stopped, so that all
+	// of its parentheses and illegal characters are found
+	while (parser_take(&parser) != NULL);
+
+	parentheses_close(&parentheses);
+	free(parentheses.opens);
+
+	// Mismatched parentheses are reported alone, same as by the fast path of
+	// expression_parse_checked
+	if (parentheses.errors.count > 0)
+		*errors = parentheses.errors;
+
+	if (result != NULL && errors->count > 0)
+		expression_destroy(&result);
+
+	return result;
+}
+
+Expression* expression_parse_range(const List* const tokens,
+                                   ListNode* const begin,
+                                   ListNode* const end)
+{
+	assert(tokens != NULL);
+
+	SyntaxErrors errors = {.count = 0};
+
+	Parser parser = {
+		.tokens = {begin, tokens->tail},
+		.end = end,
+		.stream = NULL,
+		.parentheses = NULL,
+		.errors = &errors,
+		.depth = 0,
+		.groups = 0,
+		.stop = false,
+	};
+
+	Expression* result = parser_parse_input(&parser);
+
+	// Whole range must be consumed without syntax errors
+	if (result != NULL &&
+	    (parser.tokens.head != parser.end || errors.count > 0)) {
+		expression_destroy(&result);
+	}
+
+	return result;
+}
+
+void syntax_errors_print(const SyntaxErrors* const errors)
+{
+	assert(errors != NULL);
+
+	for (size_t i = 0; i < errors->count; ++i) {
+		const SyntaxError* const error = &errors->errors[i];
+
+		switch (error->type) {
+		case SyntaxErrorType_MismatchedParenthesis:
+			LOG("Syntax error: mismatched \'");
+			string_debug_print(&error->content);
+			LOGF("\' found at position %lu\n", error->position);
+			break;
+
+		case SyntaxErrorType_ExpressionExpected:
+			if (string_empty(&error->content)) {
+				LOGF("Syntax error: expression expected at position %lu\n",
+				     error->position);
+				break;
+			}
+
+			LOG("Syntax error: expression expected, found \'");
+			string_debug_print(&error->content);
+			LOGF("\' at position %lu\n", error->position);
+			break;
+
+		case SyntaxErrorType_OperandExpected:
+			LOG("Syntax error: expression expected after binary operator \'");
+			string_debug_print(&error->content);
+			LOGF("\' at position %lu\n", error->position);
+			break;
+
+		case SyntaxErrorType_UnaryOperandExpected:
+			LOG("Syntax error: literal or parenthesised expression expected after unary \'");
+			string_debug_print(&error->content);
+			LOGF("\' at position %lu\n", error->position);
+			break;
+
+		case SyntaxErrorType_OperatorExpected:
+			LOG("Syntax error: operator expected, found \'");
+			string_debug_print(&error->content);
+			LOGF("\' at position %lu\n", error->position);
+			break;
+
+		case SyntaxErrorType_NestingTooDeep:
+			LOGF("Syntax error: expression nested too deep at position %lu\n",
+			     error->position);
+			break;
+		}
+	}
+
+	if (errors->count == SYNTAX_ERRORS_CAPACITY)
+		LOG("Syntax error: too many errors, parsing stopped\n");
 }
 
 void expression_destroy(Expression** const expression)
@@ -66,10 +315,319 @@ void expression_destroy(Expression** const expression)
 	*expression = NULL;
 }
 
+Expression* expression_retain(Expression* const expression)
+{
+	assert(expression != NULL);
+	assert(__atomic_load_n(&expression->references, __ATOMIC_RELAXED) > 0);
+
+	__atomic_add_fetch(&expression->references, 1, __ATOMIC_RELAXED);
+
+	return expression;
+}
+
+bool expression_shared(const Expression* const expression)
+{
+	assert(expression != NULL);
+	return __atomic_load_n(&expression->references, __ATOMIC_ACQUIRE) > 1;
+}
+
+bool expression_unshare(Expression** const slot)
+{
+	assert(slot != NULL && *slot != NULL);
+
+	const Expression* const expression = *slot;
+
+	if (!expression_shared(expression))
+		return true;
+
+	Expression* result = NULL;
+
+	switch (expression->type) {
+	case ExpressionType_Empty:
+		result = create_empty_expression();
+		break;
+
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		Literal* const copy = scratch_allocate(sizeof(Literal));
+		if (copy != NULL)
+			*copy = *literal;
+
+		result = (Expression*)copy;
+	} break;
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+		result = (Expression*)expression_unary_create(unary->operator,
+		                                              unary->subexpression);
+		if (result != NULL)
+			expression_retain(unary->subexpression);
+	} break;
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		result = (Expression*)expression_binary_create(binary->operator,
+		                                               binary->left,
+		                                               binary->right);
+		if (result != NULL) {
+			expression_retain(binary->left);
+			expression_retain(binary->right);
+		}
+	} break;
+	}
+
+	if (result == NULL)
+		return false;
+
+	result->parenthesised = expression->parenthesised;
+	result->references = 1;
+	result->rules = expression->rules;
+	result->begin = expression->begin;
+	result->end = expression->end;
+
+	expression_destroy(slot);
+	*slot = result;
+
+	return true;
+}
+
+void expression_map_deinit(ExpressionMap* const map)
+{
+	assert(map != NULL);
+
+	free(map->nodes);
+	free(map->values);
+
+	*map = ExpressionMap();
+}
+
+size_t expression_map_find(const ExpressionMap* const map,
+                           const Expression* const expression)
+{
+	assert(map != NULL);
+
+	if (map->capacity == 0)
+		return EXPRESSION_MAP_NONE;
+
+	for (size_t i = expression_map_slot(map, expression); map->nodes[i] != NULL;
+	     i = (i + 1) & (map->capacity - 1)) {
+		if (map->nodes[i] == expression)
+			return map->values[i];
+	}
+
+	return EXPRESSION_MAP_NONE;
+}
+
+bool expression_map_insert(ExpressionMap* const map,
+                           const Expression* const expression,
+                           const size_t value)
+{
+	assert(map != NULL);
+	assert(expression != NULL);
+
+	// @NOTE: Load factor is kept at most 1/2
+	if (2 * (map->count + 1) > map->capacity) {
+		ExpressionMap grown = {
+			.capacity = map->capacity > 0 ? 2 * map->capacity : 64,
+			.count = 0,
+		};
+
+		grown.nodes = calloc(grown.capacity, sizeof(const Expression*));
+		grown.values = malloc(grown.capacity * sizeof(size_t));
+
+		if (grown.nodes == NULL || grown.values == NULL) {
+			free(grown.nodes);
+			free(grown.values);
+			return false;
+		}
+
+		for (size_t i = 0; i < map->capacity; ++i) {
+			if (map->nodes[i] != NULL)
+				expression_map_insert(&grown, map->nodes[i], map->values[i]);
+		}
+
+		free(map->nodes);
+		free(map->values);
+		*map = grown;
+	}
+
+	size_t i = expression_map_slot(map, expression);
+	while (map->nodes[i] != NULL)
+		i = (i + 1) & (map->capacity - 1);
+
+	map->nodes[i] = expression;
+	map->values[i] = value;
+	++map->count;
+
+	return true;
+}
+
+void expression_stack_init(ExpressionStack* const stack)
+{
+	assert(stack != NULL);
+
+	stack->nodes = stack->inline_nodes;
+	stack->count = 0;
+	stack->capacity = EXPRESSION_STACK_INLINE;
+}
+
+void expression_stack_deinit(ExpressionStack* const stack)
+{
+	assert(stack != NULL);
+
+	if (stack->nodes != stack->inline_nodes)
+		free(stack->nodes);
+
+	stack->nodes = NULL;
+	stack->count = 0;
+	stack->capacity = 0;
+}
+
+bool expression_stack_push(ExpressionStack* const stack,
+                           const Expression* const expression)
+{
+	assert(stack != NULL);
+	assert(expression != NULL);
+
+	if (stack->count == stack->capacity) {
+		const size_t capacity = 2 * stack->capacity;
+
+		const Expression** const nodes = malloc(capacity * sizeof(const Expression*));
+		if (nodes == NULL)
+			return false;
+
+		memcpy(nodes, stack->nodes, stack->count * sizeof(const Expression*));
+
+		if (stack->nodes != stack->inline_nodes)
+			free(stack->nodes);
+
+		stack->nodes = nodes;
+		stack->capacity = capacity;
+	}
+
+	stack->nodes[stack->count++] = expression;
+
+	return true;
+}
+
+void expression_printer_init(ExpressionPrinter* const printer,
+                             const Expression* const expression)
+{
+	assert(printer != NULL);
+	assert(expression != NULL);
+
+	printer->frames = printer->inline_frames;
+	printer->depth = 0;
+	printer->capacity = PRINTER_DEPTH_INLINE;
+	printer->pending = NULL;
+	printer->pending_length = 0;
+	printer->failed = false;
+
+	printer_push(printer, expression, false);
+}
+
+void expression_printer_deinit(ExpressionPrinter* const printer)
+{
+	assert(printer != NULL);
+
+	if (printer->frames != printer->inline_frames)
+		scratch_free(printer->frames);
+
+	printer->frames = NULL;
+	printer->depth = 0;
+	printer->capacity = 0;
+}
+
+size_t expression_printer_read(ExpressionPrinter* const printer,
+                               char* const buffer,
+                               const size_t size)
+{
+	assert(printer != NULL);
+	assert(buffer != NULL);
+
+	size_t length = 0;
+
+	while (length < size) {
+		if (printer->pending_length == 0 && !printer_advance(printer))
+			break;
+
+		const size_t count = printer->pending_length < size - length
+			? printer->pending_length
+			: size - length;
+
+		memcpy(buffer + length, printer->pending, count);
+
+		printer->pending += count;
+		printer->pending_length -= count;
+		length += count;
+	}
+
+	return length;
+}
+
+void expression_write(const Expression* const expression, FILE* const file)
+{
+	assert(expression != NULL);
+	assert(file != NULL);
+
+	ExpressionPrinter printer;
+	expression_printer_init(&printer, expression);
+
+	char chunk[PRINTER_CHUNK];
+
+	for (size_t length; (length = expression_printer_read(&printer, chunk, sizeof(chunk))) > 0; )
+		fwrite(chunk, sizeof(char), length, file);
+
+	if (printer.failed)
+		LOG("Out of memory, expression is printed partially\n");
+
+	expression_printer_deinit(&printer);
+}
+
+// @NOTE: Text is read up to the limit and one byte more, which tells whether
+// it's cut, so that the rest of expression isn't visited
+bool expression_write_bounded(const Expression* const expression,
+                              FILE* const file,
+                              const size_t limit)
+{
+	assert(expression != NULL);
+	assert(file != NULL);
+
+	ExpressionPrinter printer;
+	expression_printer_init(&printer, expression);
+
+	char chunk[PRINTER_CHUNK];
+	size_t written = 0;
+
+	while (written < limit) {
+		const size_t size = limit - written < sizeof(chunk)
+			? limit - written
+			: sizeof(chunk);
+
+		const size_t length = expression_printer_read(&printer, chunk, size);
+		if (length == 0)
+			break;
+
+		fwrite(chunk, sizeof(char), length, file);
+		written += length;
+	}
+
+	const bool complete = written < limit ||
+	                      expression_printer_read(&printer, chunk, 1) == 0;
+
+	if (!complete)
+		fputs("...", file);
+
+	expression_printer_deinit(&printer);
+
+	return complete && !printer.failed;
+}
+
 void expression_print(const Expression* const expression)
 {
 	assert(expression != NULL);
-	expression__print(expression);
+	expression_write(expression, stdout);
 	putc('\n', stdout);
 }
 
@@ -82,14 +640,33 @@ void expression_verbose_print(const Expression* const expression)
 
 Literal* expression_literal_create_number(const double number)
 {
-	Literal* const result = malloc(sizeof(Literal));
+	Literal* const result = scratch_allocate(sizeof(Literal));
 	if (result == NULL)
 		return NULL;
 
 	result->base.type = ExpressionType_Literal;
 	result->base.parenthesised = false;
+	result->base.references = 1;
+	result->base.rules = 0;
+	result->base.begin = 0;
+	result->base.end = 0;
 	result->tag = LiteralTag_Number;
 	result->number = number;
+	result->rational = rational_from_double(number);
+
+	return result;
+}
+
+Literal* expression_literal_create_rational(const Rational number)
+{
+	assert(rational_exact(number));
+
+	Literal* const result = expression_literal_create_number(
+		rational_to_double(number));
+	if (result == NULL)
+		return NULL;
+
+	result->rational = number;
 
 	return result;
 }
@@ -98,12 +675,16 @@ Literal* expression_literal_create_symbol(String* const symbol)
 {
 	assert(symbol != NULL);
 
-	Literal* const result = malloc(sizeof(Literal));
+	Literal* const result = scratch_allocate(sizeof(Literal));
 	if (result == NULL)
 		return NULL;
 
 	result->base.type = ExpressionType_Literal;
 	result->base.parenthesised = false;
+	result->base.references = 1;
+	result->base.rules = 0;
+	result->base.begin = 0;
+	result->base.end = 0;
 	result->tag = LiteralTag_Symbol;
 	result->symbol = *symbol;
 
@@ -116,12 +697,16 @@ UnaryExpression* expression_unary_create(const TokenType operator,
 	assert(token_type_is_unary_operator(operator));
 	assert(subexpression != NULL);
 
-	UnaryExpression* const result = malloc(sizeof(UnaryExpression));
+	UnaryExpression* const result = scratch_allocate(sizeof(UnaryExpression));
 	if (result == NULL)
 		return NULL;
 
 	result->base.type = ExpressionType_Unary;
 	result->base.parenthesised = false;
+	result->base.references = 1;
+	result->base.rules = 0;
+	result->base.begin = 0;
+	result->base.end = 0;
 	result->operator = operator;
 	result->subexpression = subexpression;
 
@@ -136,12 +721,16 @@ BinaryExpression* expression_binary_create(const TokenType operator,
 	assert(left != NULL);
 	assert(right != NULL);
 
-	BinaryExpression* const result = malloc(sizeof(BinaryExpression));
+	BinaryExpression* const result = scratch_allocate(sizeof(BinaryExpression));
 	if (result == NULL)
 		return NULL;
 
 	result->base.type = ExpressionType_Binary;
 	result->base.parenthesised = false;
+	result->base.references = 1;
+	result->base.rules = 0;
+	result->base.begin = 0;
+	result->base.end = 0;
 	result->operator = operator;
 	result->left = left;
 	result->right = right;
@@ -149,6 +738,26 @@ BinaryExpression* expression_binary_create(const TokenType operator,
 	return result;
 }
 
+Expression* expression_binary_join(const TokenType operator,
+                                   Expression* left,
+                                   Expression* right)
+{
+	Expression* result = NULL;
+
+	if (left != NULL && right != NULL)
+		result = (Expression*)expression_binary_create(operator, left, right);
+
+	if (result == NULL) {
+		if (left != NULL)
+			expression_destroy(&left);
+
+		if (right != NULL)
+			expression_destroy(&right);
+	}
+
+	return result;
+}
+
 bool expression_empty(const Expression* const expression)
 {
 	assert(expression != NULL);
@@ -167,94 +776,154 @@ static Expression* parser_parse_input(Parser* const parser)
 	return parser_parse_expression(parser, 0);
 }
 
+// Parse operand followed by binary operators of greater precedence.
+//
+// @NOTE: Syntax errors are recovered from in place: missing operands become
+// empty expressions, tokens which can't continue expression are skipped at
+// the lowest precedence, so that every token is visited once
 static Expression* parser_parse_expression(Parser* const parser,
                                            const size_t precedence)
 {
 	assert(parser != NULL);
 
-	Token* const current = parser_next(parser);
-
-	Expression* result;
-
-	if (current == NULL)
+	if (parser->depth == PARSER_DEPTH_MAX) {
+		parser_error(parser, SyntaxErrorType_NestingTooDeep, parser_peek(parser));
+		parser->stop = true;
 		return create_empty_expression();
-	else if (token_type_is_literal(current->type)) {
-		parser_backup(parser);
-		result = parser_parse_literal(parser);
-	}
-	else if (token_type_is_unary_operator(current->type)) {
-		parser_backup(parser);
-		result = parser_parse_unary(parser);
 	}
-	else if (current->type == TokenType_LeftParen) {
-		result = parser_parse_expression(parser, 0);
 
-		Token* const ahead = parser_next(parser);
+	++parser->depth;
 
-		if (ahead == NULL || (ahead != NULL && ahead->type != TokenType_RightParen)) {
-			LOG("Syntax error: mismatched \'");
-			string_debug_print(&current->content);
-			LOGF("\' found at position %lu\n", current->position);
+	Expression* result = parser_parse_primary(parser);
 
-			if (result != NULL)
-				expression_clear(result);
+	for (;;) {
+		Token* const ahead = parser_peek(parser);
 
-			return parser_parse_expression(parser, 0);
+		if (ahead == NULL || result == NULL)
+			break;
+
+		TokenType operator;
+
+		if (token_type_is_binary_operator(ahead->type))
+			operator = ahead->type;
+		else if (ahead->type == TokenType_Symbol ||
+		         ahead->type == TokenType_LeftParen) {
+			// Implicit multiplication, e.g. 2a or a(b + c)
+			operator = TokenType_Multiply;
 		}
+		else {
+			// Right parenthesis closes a group, otherwise it is mismatched
+			if (precedence > 0 ||
+			    (ahead->type == TokenType_RightParen && parser->groups > 0)) {
+				break;
+			}
 
-		result->parenthesised = true;
-	}
-	else if (current->type == TokenType_RightParen) {
-		LOG("Syntax error: mismatched \'");
-		string_debug_print(&current->content);
-		LOGF("\' found at position %lu\n", current->position);
-		result = parser_parse_expression(parser, 0);
-	}
-	else {
-		LOG("Syntax error: expression expected, found \'");
-		string_debug_print(&current->content);
-		LOGF("\' at position %lu\n", current->position);
-		result = create_empty_expression();
-	}
+			parser_error(parser, ahead->type == TokenType_RightParen
+				? SyntaxErrorType_MismatchedParenthesis
+				: SyntaxErrorType_OperatorExpected, ahead);
+			parser_next(parser);
+			continue;
+		}
 
-	Token* const ahead = parser_peek(parser);
+		const size_t operator_precedence = token_type_precedence(operator);
+		const size_t bias = token_type_is_right_associative(operator);
 
-	if (ahead == NULL)
-		return result;
+		if (operator_precedence + bias <= precedence)
+			break;
 
-	if (token_type_is_binary_operator(ahead->type)) {
-		for (;;) {
-			Expression* const binary = parser_parse_binary(parser, result, precedence);
+		const bool implicit = operator != ahead->type;
 
-			if (binary == NULL) {
-				LOG("Syntax error: expression expected after binary opeartor \'");
-				string_debug_print(&ahead->content);
-				LOGF("\' at position %lu\n", ahead->position);
-				break;
-			}
+		Expression* rhs;
 
-			if (binary == result)
-				break;
+		if (!implicit) {
+			// @NOTE: Operator is copied, streamed token is overwritten by
+			// the next one
+			const Token token = *parser_next(parser);
 
-			parser_backup(parser);
-			result = binary;
+			if (!parser_operand_ahead(parser)) {
+				parser_error(parser, SyntaxErrorType_OperandExpected, &token);
+				rhs = create_empty_expression();
+			}
+			else
+				rhs = parser_parse_expression(parser, operator_precedence);
 		}
+		else
+			rhs = parser_parse_expression(parser, operator_precedence);
+
+		if (rhs == NULL)
+			break;
+
+		Expression* const binary = (Expression*)expression_binary_create(
+			operator, result, rhs);
+		expression_set_span(binary, result->begin, rhs->end);
+
+		result = binary;
 	}
-	else if (ahead->type == TokenType_Symbol) {
-		Expression* const rhs = parser_parse_literal(parser);
 
-		BinaryExpression* const binary = expression_binary_create(
-			TokenType_Multiply, result, rhs);
+	--parser->depth;
+
+	return result;
+}
+
+static Expression* parser_parse_primary(Parser* const parser)
+{
+	assert(parser != NULL);
+
+	Token* current = parser_peek(parser);
 
-		return (Expression*)binary;
+	// Skip mismatched right parentheses at the top level
+	while (current != NULL && current->type == TokenType_RightParen &&
+	       parser->groups == 0) {
+		parser_error(parser, SyntaxErrorType_MismatchedParenthesis, current);
+		parser_next(parser);
+		current = parser_peek(parser);
 	}
-	else if (ahead->type == TokenType_LeftParen) {
-		Expression* const rhs = parser_parse_expression(parser, 0);
 
-		BinaryExpression* const binary = expression_binary_create(
-			TokenType_Multiply, result, (Expression*)rhs);
+	if (current == NULL) {
+		parser_error(parser, SyntaxErrorType_ExpressionExpected, NULL);
+		return create_empty_expression();
+	}
+
+	if (token_type_is_literal(current->type))
+		return parser_parse_literal(parser);
+
+	if (token_type_is_unary_operator(current->type))
+		return parser_parse_unary(parser);
+
+	if (current->type == TokenType_LeftParen)
+		return parser_parse_group(parser);
 
-		return (Expression*)binary;
+	parser_error(parser, SyntaxErrorType_ExpressionExpected, current);
+
+	// @NOTE: Operators are left to be parsed with empty left operand
+	if (!token_type_is_operator(current->type))
+		parser_next(parser);
+
+	return create_empty_expression();
+}
+
+static Expression* parser_parse_group(Parser* const parser)
+{
+	assert(parser != NULL);
+
+	const Token open = *parser_next(parser);
+	assert(open.type == TokenType_LeftParen);
+
+	++parser->groups;
+	Expression* const result = parser_parse_expression(parser, 0);
+	--parser->groups;
+
+	// @NOTE: Group can only be stopped by right parenthesis or end of input
+	Token* const close = parser_next(parser);
+
+	if (close == NULL) {
+		parser_error(parser, SyntaxErrorType_MismatchedParenthesis, &open);
+		return result;
+	}
+
+	if (result != NULL) {
+		result->parenthesised = true;
+		expression_set_span(result, token_begin(&open), token_end(close));
 	}
 
 	return result;
@@ -267,99 +936,151 @@ static Expression* parser_parse_literal(Parser* const parser)
 	Token* const literal = parser_next(parser);
 	assert(token_type_is_literal(literal->type));
 
+	Expression* result = NULL;
+
 	if (literal->type == TokenType_Number) {
-		return (Expression*)expression_literal_create_number(
+		Literal* const number = expression_literal_create_number(
 			string_to_double(&literal->content));
+
+		if (number != NULL)
+			number->rational = rational_parse(&literal->content);
+
+		result = (Expression*)number;
 	}
 	else if (literal->type == TokenType_Symbol)
-		return (Expression*)expression_literal_create_symbol(&literal->content);
+		result = (Expression*)expression_literal_create_symbol(&literal->content);
 
-	// @NOTE: Never happens
-	return NULL;
+	expression_set_span(result, token_begin(literal), token_end(literal));
+
+	return result;
 }
 
 static Expression* parser_parse_unary(Parser* const parser)
 {
 	assert(parser != NULL);
 
-	Token* const operator = parser_next(parser);
-	assert(operator != NULL && token_type_is_unary_operator(operator->type));
+	// @NOTE: Operator is copied, streamed token is overwritten by the next one
+	const Token operator = *parser_next(parser);
+	assert(token_type_is_unary_operator(operator.type));
 
 	Token* const ahead = parser_peek(parser);
 
 	if (ahead == NULL) {
-		LOG("Syntax error: literal or parenthesised expression expected after unary \'");
-		string_debug_print(&operator->content);
-		LOGF("\' at position %lu\n", operator->position);
+		parser_error(parser, SyntaxErrorType_UnaryOperandExpected, &operator);
 		return create_empty_expression();
 	}
 
 	if (ahead->type == TokenType_Number) {
 		parser_next(parser);
 
-		if (operator->type == TokenType_Minus) {
-			return (Expression*)expression_literal_create_number(
-				-string_to_double(&ahead->content));
+		const double number = string_to_double(&ahead->content);
+		const Rational rational = rational_parse(&ahead->content);
+
+		// @NOTE: Subtraction from zero gives 0 for -0, which is printed as 0
+		Literal* const literal = expression_literal_create_number(
+			operator.type == TokenType_Minus ? 0 - number : number);
+
+		if (literal != NULL) {
+			literal->rational = operator.type == TokenType_Minus
+				? rational_negate(rational)
+				: rational;
 		}
 
-		return (Expression*)expression_literal_create_number(
-			string_to_double(&ahead->content));
+		expression_set_span((Expression*)literal, token_begin(&operator),
+		                    token_end(ahead));
+
+		return (Expression*)literal;
 	}
 	else if (ahead->type == TokenType_Symbol) {
 		parser_next(parser);
 
 		Expression* const literal = (Expression*)expression_literal_create_symbol(
 			&ahead->content);
+		expression_set_span(literal, token_begin(ahead), token_end(ahead));
 
-		if (operator->type == TokenType_Minus)
-			return (Expression*)expression_unary_create(operator->type, literal);
+		if (operator.type == TokenType_Minus) {
+			Expression* const unary = (Expression*)expression_unary_create(
+				operator.type, literal);
+			expression_set_span(unary, token_begin(&operator), token_end(ahead));
+			return unary;
+		}
 
 		return literal;
 	}
 	else if (ahead->type == TokenType_LeftParen) {
-		return (Expression*)expression_unary_create(operator->type,
-			parser_parse_expression(parser, 0));
+		Expression* const subexpression = parser_parse_group(parser);
+
+		if (subexpression == NULL)
+			return NULL;
+
+		Expression* const unary = (Expression*)expression_unary_create(
+			operator.type, subexpression);
+		expression_set_span(unary, token_begin(&operator), subexpression->end);
+
+		return unary;
 	}
 
-	LOG("Syntax error: literal or parenthesised expression expected after unary \'");
-	string_debug_print(&operator->content);
-	LOGF("\' at position %lu\n", operator->position);
+	parser_error(parser, SyntaxErrorType_UnaryOperandExpected, &operator);
 
 	return create_empty_expression();
 }
 
-static Expression* parser_parse_binary(Parser* const parser,
-                                       Expression* const lhs,
-                                       const size_t precedence)
+static bool parser_operand_ahead(Parser* const parser)
 {
 	assert(parser != NULL);
-	assert(lhs != NULL);
 
-	Token* const operator = parser_next(parser);
+	Token* const ahead = parser_peek(parser);
 
-	if (operator == NULL || !token_type_is_binary_operator(operator->type))
-		return lhs;
+	return ahead != NULL && (token_type_is_literal(ahead->type) ||
+	                         token_type_is_unary_operator(ahead->type) ||
+	                         ahead->type == TokenType_LeftParen);
+}
 
-	const size_t lhs_precedence = OPERATOR_PRECEDENCE[operator->type];
-	const size_t bias = token_type_is_right_associative(operator->type);
+static void parser_error(Parser* const parser,
+                         const SyntaxErrorType type,
+                         const Token* const token)
+{
+	assert(parser != NULL);
 
-	if (lhs_precedence + bias > precedence) {
-		Expression* const rhs = parser_parse_expression(parser, lhs_precedence);
+	if (parser->stop)
+		return;
 
-		if (rhs == NULL)
-			return NULL;
+	size_t position = 1;
 
-		return (Expression*)expression_binary_create(operator->type, lhs, rhs);
+	if (token != NULL)
+		position = token->position;
+	else if (parser->stream != NULL)
+		position = parser->stream->last;
+	else {
+		ListNode* const last = parser->end != NULL ? parser->end->prev
+		                                           : parser->tokens.tail;
+		if (last != NULL) {
+			const Token* const last_token = list_node_data(last, Token);
+			position = last_token->position + last_token->content.length;
+		}
 	}
 
-	return lhs;
+	String content = token != NULL ? token->content : (String){NULL, 0, false};
+
+	// @NOTE: Errors outlive streamed tokens, their text is kept by stream
+	if (token != NULL && parser->stream != NULL)
+		content = token_stream_keep(parser->stream, &token->content);
+
+	if (!syntax_errors_add(parser->errors, type, position, &content))
+		parser->stop = true;
 }
 
 static Token* parser_next(Parser* const parser)
 {
 	assert(parser);
 
-	if (parser->tokens.head == NULL)
+	if (parser->stop)
+		return NULL;
+
+	if (parser->stream != NULL)
+		return parser_take(parser);
+
+	if (parser->tokens.head == parser->end)
 		return NULL;
 
 	ListNode* node = parser->tokens.head;
@@ -372,99 +1093,408 @@ static Token* parser_peek(Parser* const parser)
 {
 	assert(parser);
 
-	if (parser->tokens.head == NULL)
+	if (parser->stop)
+		return NULL;
+
+	if (parser->stream != NULL)
+		return token_stream_peek(parser->stream);
+
+	if (parser->tokens.head == parser->end)
 		return NULL;
 
 	return list_node_data(parser->tokens.head, Token);
 }
 
-static void parser_backup(Parser* const parser)
+static Token* parser_take(Parser* const parser)
 {
-	assert(parser);
+	assert(parser != NULL && parser->stream != NULL);
 
-	if (parser->tokens.head != NULL)
-		parser->tokens.head = parser->tokens.head->prev;
-	else if (parser->tokens.tail != NULL)
-		parser->tokens.head = parser->tokens.tail;
+	Token* const result = token_stream_next(parser->stream);
+
+	if (result != NULL)
+		parentheses_match(parser->parentheses, result);
+
+	return result;
 }
 
-static void expression_clear(Expression* const expression)
+static void parentheses_match(Parentheses* const parentheses,
+                              const Token* const token)
 {
-	assert(expression != NULL);
+	assert(parentheses != NULL);
+	assert(token != NULL);
 
-	switch (expression->type) {
-	case ExpressionType_Unary: {
-		const UnaryExpression* const unary = (UnaryExpression*)expression;
-		expression_clear(unary->subexpression);
-	} break;
+	if (token->type == TokenType_LeftParen) {
+		if (parentheses->count == parentheses->capacity) {
+			const size_t capacity = parentheses->capacity > 0 ? 2 * parentheses->capacity : 16;
 
-	case ExpressionType_Binary: {
-		const BinaryExpression* const binary = (BinaryExpression*)expression;
-		expression_clear(binary->left);
-		expression_clear(binary->right);
-	} break;
+			size_t* const opens = realloc(parentheses->opens, capacity * sizeof(size_t));
+
+			// @NOTE: Parenthesis which can't be matched is reported mismatched
+			if (opens == NULL) {
+				syntax_errors_add(&parentheses->errors, SyntaxErrorType_MismatchedParenthesis,
+				                  token->position, &token->content);
+				return;
+			}
+
+			parentheses->opens = opens;
+			parentheses->capacity = capacity;
+		}
+
+		parentheses->opens[parentheses->count++] = token->position;
+	}
+	else if (token->type == TokenType_RightParen) {
+		if (parentheses->count > 0)
+			--parentheses->count;
+		else {
+			syntax_errors_add(&parentheses->errors, SyntaxErrorType_MismatchedParenthesis,
+			                  token->position, &token->content);
+		}
 	}
+}
+
+static void parentheses_close(Parentheses* const parentheses)
+{
+	assert(parentheses != NULL);
+
+	const String open = String("(");
+
+	while (parentheses->count > 0) {
+		const size_t position = parentheses->opens[--parentheses->count];
 
-	free(expression);
+		if (!syntax_errors_add(&parentheses->errors, SyntaxErrorType_MismatchedParenthesis,
+		                       position, &open)) {
+			break;
+		}
+	}
 }
 
-static void expression__print(const Expression* const expression)
+static bool syntax_errors_add(SyntaxErrors* const errors,
+                              const SyntaxErrorType type,
+                              const size_t position,
+                              const String* const content)
 {
-	assert(expression != NULL);
+	assert(errors != NULL);
+	assert(content != NULL);
 
-	switch (expression->type) {
-	case ExpressionType_Empty: {
-		fputs("()", stdout);
-	} break;
+	if (errors->count == SYNTAX_ERRORS_CAPACITY)
+		return false;
 
-	case ExpressionType_Literal: {
-		const Literal* const literal = (Literal*)expression;
+	errors->errors[errors->count++] = (SyntaxError){
+		.type = type,
+		.position = position,
+		.content = *content,
+	};
 
-		const bool parenthesised = literal->base.parenthesised;
+	return errors->count < SYNTAX_ERRORS_CAPACITY;
+}
 
-		if (parenthesised)
-			putc('(', stdout);
+// Find mismatched parentheses in a single pass and return true if there
+// are none
+static bool check_parentheses(const List* const tokens,
+                              SyntaxErrors* const errors)
+{
+	assert(tokens != NULL);
+	assert(errors != NULL);
 
-		switch (literal->tag) {
-		case LiteralTag_Number:
-			fprintf(stdout, "%.12g", literal->number);
-			break;
+	size_t depth = 0;
 
-		case LiteralTag_Symbol:
-			string_print(&literal->symbol);
+	for list_range(it, *tokens) {
+		const Token* const token = list_node_data(it, Token);
+
+		if (token->type == TokenType_LeftParen)
+			++depth;
+		else if (token->type == TokenType_RightParen) {
+			if (depth > 0)
+				--depth;
+			else if (!syntax_errors_add(errors, SyntaxErrorType_MismatchedParenthesis,
+			                            token->position, &token->content)) {
+				return false;
+			}
+		}
+	}
+
+	// Unclosed left parentheses are found from the end
+	size_t closed = 0;
+
+	for (ListNode* it = tokens->tail; it != NULL && depth > 0; it = it->prev) {
+		const Token* const token = list_node_data(it, Token);
+
+		if (token->type == TokenType_RightParen)
+			++closed;
+		else if (token->type == TokenType_LeftParen) {
+			if (closed > 0) {
+				--closed;
+				continue;
+			}
+
+			--depth;
+
+			if (!syntax_errors_add(errors, SyntaxErrorType_MismatchedParenthesis,
+			                       token->position, &token->content)) {
+				return false;
+			}
+		}
+	}
+
+	return errors->count == 0;
+}
+
+// @NOTE: Long chains of operators are left-deep, so the last operand to
+// clear, which is the left one, is cleared in a loop rather than a call.
+// Releases of other owners happen before the node is freed by the last one.
+static void expression_clear(Expression* expression)
+{
+	while (expression != NULL) {
+		assert(__atomic_load_n(&expression->references, __ATOMIC_RELAXED) > 0);
+
+		if (__atomic_sub_fetch(&expression->references, 1, __ATOMIC_ACQ_REL) > 0)
+			return;
+
+		Expression* next = NULL;
+
+		switch (expression->type) {
+		case ExpressionType_Unary:
+			next = ((UnaryExpression*)expression)->subexpression;
 			break;
+
+		case ExpressionType_Binary: {
+			const BinaryExpression* const binary = (BinaryExpression*)expression;
+			expression_clear(binary->right);
+			next = binary->left;
+		} break;
 		}
 
-		if (parenthesised)
-			putc(')', stdout);
-	} break;
+		scratch_free(expression);
+		expression = next;
+	}
+}
 
-	case ExpressionType_Unary: {
-		const UnaryExpression* const unary = (UnaryExpression*)expression;
-		string_print(&OPERATOR_STRING[unary->operator]);
-		expression__print(unary->subexpression);
-	} break;
+// Integers which are known exactly are printed with all digits, so that
+// printed expression can be parsed back
+static void literal_number_write(const Literal* const literal, FILE* const file)
+{
+	assert(literal != NULL && literal->tag == LiteralTag_Number);
+
+	if (rational_integral(literal->rational))
+		fprintf(file, "%" PRId64, literal->rational.numerator);
+	else
+		fprintf(file, "%.12g", literal->number);
+}
+
+static size_t literal_number_format(const Literal* const literal,
+                                    char* const buffer,
+                                    const size_t size)
+{
+	assert(literal != NULL && literal->tag == LiteralTag_Number);
+	assert(buffer != NULL);
+
+	const int length = rational_integral(literal->rational)
+		? snprintf(buffer, size, "%" PRId64, literal->rational.numerator)
+		: snprintf(buffer, size, "%.12g", literal->number);
+
+	if (length < 0)
+		return 0;
+
+	return (size_t)length < size ? (size_t)length : size - 1;
+}
+
+// Operands of lower precedence are parenthesised, and so are those of equal
+// precedence where grouping matters: right operands of left-associative
+// subtraction and division, left operands of right-associative power.
+// Negative bases are parenthesised too, as -a ^ b reads ambiguously.
+static bool operand_needs_parentheses(const TokenType operator,
+                                      const Expression* const operand,
+                                      const bool right)
+{
+	assert(token_type_is_binary_operator(operator));
+	assert(operand != NULL);
+
+	switch (operand->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)operand;
+
+		return operator == TokenType_Exponent && !right &&
+		       literal->tag == LiteralTag_Number && signbit(literal->number);
+	}
+
+	case ExpressionType_Unary:
+		return operator == TokenType_Exponent && !right;
 
 	case ExpressionType_Binary: {
-		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		const TokenType nested = ((BinaryExpression*)operand)->operator;
 
-		const bool parenthesised = binary->base.parenthesised;
+		const size_t precedence = token_type_precedence(operator);
+		const size_t nested_precedence = token_type_precedence(nested);
 
-		if (parenthesised)
-			putc('(', stdout);
+		if (nested_precedence != precedence)
+			return nested_precedence < precedence;
 
-		expression__print(binary->left);
-		putc(' ', stdout);
+		if (right)
+			return operator == TokenType_Minus || operator == TokenType_Divide;
 
-		string_print(&OPERATOR_STRING[binary->operator]);
-		putc(' ', stdout);
+		return token_type_is_right_associative(operator);
+	}
+	}
 
-		expression__print(binary->right);
+	return false;
+}
 
-		if (parenthesised)
-			putc(')', stdout);
-	} break;
+// @NOTE: Unary operator applies to a literal or to a parenthesised
+// expression only, see parser_parse_unary. Negated number is read as number
+// literal, which is 0 for -0, so that zero stays parenthesised.
+static bool unary_operand_needs_parentheses(const Expression* const operand)
+{
+	assert(operand != NULL);
+
+	if (operand->type != ExpressionType_Literal)
+		return operand->type != ExpressionType_Empty;
+
+	const Literal* const literal = (Literal*)operand;
+
+	return literal->tag == LiteralTag_Number &&
+	       (signbit(literal->number) || literal->number == 0);
+}
+
+// @NOTE: Every expression is printed in steps: opening parenthesis, its
+// pieces and operands in order, and closing parenthesis at the last step
+static bool printer_advance(ExpressionPrinter* const printer)
+{
+	assert(printer != NULL);
+
+	while (printer->depth > 0 && !printer->failed) {
+		ExpressionPrinterFrame* const frame = &printer->frames[printer->depth - 1];
+		const Expression* const expression = frame->expression;
+		const uint8_t step = frame->step++;
+
+		if (step == 0) {
+			if (frame->parenthesised) {
+				printer_emit(printer, "(", 1);
+				return true;
+			}
+
+			continue;
+		}
+
+		switch (expression->type) {
+		case ExpressionType_Empty:
+			if (step == 1) {
+				printer_emit(printer, "()", 2);
+				return true;
+			}
+			break;
+
+		case ExpressionType_Literal: {
+			const Literal* const literal = (Literal*)expression;
+
+			if (step != 1)
+				break;
+
+			switch (literal->tag) {
+			case LiteralTag_Number:
+				printer_emit(printer, printer->number, literal_number_format(
+					literal, printer->number, sizeof(printer->number)));
+				break;
+
+			case LiteralTag_Symbol:
+				printer_emit(printer, literal->symbol.text, literal->symbol.length);
+				break;
+			}
+
+			return true;
+		}
+
+		case ExpressionType_Unary: {
+			const UnaryExpression* const unary = (UnaryExpression*)expression;
+			const String* const operator = &OPERATOR_STRING[unary->operator];
+
+			if (step == 1) {
+				printer_emit(printer, operator->text, operator->length);
+				return true;
+			}
+
+			if (step == 2) {
+				printer_push(printer, unary->subexpression,
+				             unary_operand_needs_parentheses(unary->subexpression));
+				continue;
+			}
+		} break;
+
+		case ExpressionType_Binary: {
+			const BinaryExpression* const binary = (BinaryExpression*)expression;
+			const String* const operator = &OPERATOR_SPACED_STRING[binary->operator];
+
+			if (step == 1) {
+				printer_push(printer, binary->left, operand_needs_parentheses(
+					binary->operator, binary->left, false));
+				continue;
+			}
+
+			if (step == 2) {
+				printer_emit(printer, operator->text, operator->length);
+				return true;
+			}
+
+			if (step == 3) {
+				printer_push(printer, binary->right, operand_needs_parentheses(
+					binary->operator, binary->right, true));
+				continue;
+			}
+		} break;
+		}
+
+		--printer->depth;
+
+		if (frame->parenthesised) {
+			printer_emit(printer, ")", 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool printer_push(ExpressionPrinter* const printer,
+                         const Expression* const expression,
+                         const bool parenthesised)
+{
+	assert(printer != NULL);
+	assert(expression != NULL);
+
+	if (printer->depth == printer->capacity) {
+		const size_t capacity = 2 * printer->capacity;
+
+		ExpressionPrinterFrame* const frames = scratch_allocate(
+			capacity * sizeof(ExpressionPrinterFrame));
+		if (frames == NULL) {
+			printer->failed = true;
+			return false;
+		}
+
+		memcpy(frames, printer->frames, printer->depth * sizeof(ExpressionPrinterFrame));
+
+		if (printer->frames != printer->inline_frames)
+			scratch_free(printer->frames);
+
+		printer->frames = frames;
+		printer->capacity = capacity;
 	}
+
+	printer->frames[printer->depth++] = (ExpressionPrinterFrame){
+		expression, 0, parenthesised
+	};
+
+	return true;
+}
+
+static void printer_emit(ExpressionPrinter* const printer,
+                         const void* const text,
+                         const size_t length)
+{
+	assert(printer != NULL);
+	assert(text != NULL || length == 0);
+
+	printer->pending = text;
+	printer->pending_length = length;
 }
 
 static void expression__verbose_print(const Expression* const expression)
@@ -477,7 +1507,7 @@ static void expression__verbose_print(const Expression* const expression)
 
 		switch (literal->tag) {
 		case LiteralTag_Number:
-			fprintf(stdout, "%.12g", literal->number);
+			literal_number_write(literal, stdout);
 			break;
 
 		case LiteralTag_Symbol:
@@ -513,13 +1543,47 @@ static void expression__verbose_print(const Expression* const expression)
 
 static Expression* create_empty_expression(void)
 {
-	Expression* const result = malloc(sizeof(Expression));
+	Expression* const result = scratch_allocate(sizeof(Expression));
 	if (result == NULL)
 		return NULL;
 
 	result->type = ExpressionType_Empty;
 	result->parenthesised = false;
+	result->references = 1;
+	result->rules = 0;
+	result->begin = 0;
+	result->end = 0;
 
 	return result;
 }
 
+static size_t expression_map_slot(const ExpressionMap* const map,
+                                  const Expression* const expression)
+{
+	const uint64_t hash = ((uint64_t)(uintptr_t)expression >> 3) * UINT64_C(0x9E3779B97F4A7C15);
+	return (size_t)(hash >> 32) & (map->capacity - 1);
+}
+
+static void expression_set_span(Expression* const expression,
+                                const size_t begin,
+                                const size_t end)
+{
+	if (expression == NULL)
+		return;
+
+	expression->begin = begin;
+	expression->end = end;
+}
+
+static size_t token_begin(const Token* const token)
+{
+	assert(token != NULL);
+	return token->position - 1;
+}
+
+static size_t token_end(const Token* const token)
+{
+	assert(token != NULL);
+	return token->position - 1 + token->content.length;
+}
+
@@ -1,12 +1,15 @@
 #ifndef __PARSER_H__
 #define __PARSER_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "string.h"
 #include "list.h"
 #include "lexer.h"
+#include "rational.h"
 
 typedef enum expression_type {
 	ExpressionType_Empty,
@@ -24,14 +27,30 @@ typedef enum literal_tag {
 
 typedef struct expression {
 	ExpressionType type;
+	// @NOTE: Whether expression is parenthesised in source, printer places
+	// parentheses by precedence instead
 	bool parenthesised;
+	// @NOTE: Owners of expression, which is never changed while it has
+	// several; transforms share operands they keep, see expression_unshare.
+	// Count is changed atomically, so that owners on several threads may
+	// retain and release a shared tree at once.
+	uint32_t references;
+	uint32_t rules; // @NOTE: Bit per Rule which rewrote expression, see transform.h
+	// Source span of parsed expression in bytes, [begin, end), including
+	// parentheses; empty for expressions created by transformers, except
+	// for the rewritten node itself
+	size_t begin;
+	size_t end;
 } Expression;
 
 typedef struct expression_literal {
 	Expression base;
 	LiteralTag tag;
 	union {
-		double number;
+		struct {
+			double number;
+			Rational rational; // @NOTE: Exact value of number, if known
+		};
 		String symbol;
 	};
 } Literal;
@@ -49,17 +68,165 @@ typedef struct expression_binary {
 	Expression* right;
 } BinaryExpression;
 
-// Build expression tree from tokens
+typedef enum syntax_error_type {
+	SyntaxErrorType_MismatchedParenthesis,
+	SyntaxErrorType_ExpressionExpected,
+	SyntaxErrorType_OperandExpected,
+	SyntaxErrorType_UnaryOperandExpected,
+	SyntaxErrorType_OperatorExpected,
+	SyntaxErrorType_NestingTooDeep,
+	SyntaxErrorType__count,
+} SyntaxErrorType;
+
+typedef struct syntax_error {
+	SyntaxErrorType type;
+	size_t position;
+	String content; // @NOTE: Empty at the end of input
+} SyntaxError;
+
+// Parsing stops once this many syntax errors were found
+#define SYNTAX_ERRORS_CAPACITY 16
+
+typedef struct syntax_errors {
+	SyntaxError errors[SYNTAX_ERRORS_CAPACITY];
+	size_t count;
+} SyntaxErrors;
+
+// Build expression tree from tokens, syntax errors are reported and
+// recovered from
 extern Expression* expression_parse(const List* const tokens);
 
-// Destroy given expression and its subexpressions recursively
+// Build expression tree from tokens, returns NULL and collects syntax errors
+// if there are any
+extern Expression* expression_parse_checked(const List* const tokens,
+                                            SyntaxErrors* const errors);
+
+// Build expression tree from tokens taken from stream one at a time, same
+// as expression_parse_checked; stream is read to its end
+extern Expression* expression_parse_stream(TokenStream* const stream,
+                                           SyntaxErrors* const errors);
+
+// Build expression tree from tokens in range [begin, end), returns NULL if
+// the range is not an expression as a whole or has syntax errors
+extern Expression* expression_parse_range(const List* const tokens,
+                                          ListNode* const begin,
+                                          ListNode* const end);
+
+// Release owner of expression, destroying it once no owners are left and
+// releasing its subexpressions in turn
 extern void expression_destroy(Expression** const expression);
 
+// Add owner of expression and return it
+extern Expression* expression_retain(Expression* const expression);
+
+// Check whether expression has several owners
+extern bool expression_shared(const Expression* const expression);
+
+// Make expression in slot owned by slot alone before it's changed: if it's
+// shared, replace it with a copy of its node, which shares its operands.
+// Return false and leave slot as is if memory is exhausted.
+extern bool expression_unshare(Expression** const slot);
+
+#define EXPRESSION_MAP_NONE SIZE_MAX
+
+// Map of expression nodes by address to numbers, so that subtrees shared
+// by several parents are visited once
+typedef struct expression_map {
+	const Expression** nodes; // @NOTE: Open addressing, NULL if empty
+	size_t* values;
+	size_t count;
+	size_t capacity;
+} ExpressionMap;
+
+#define ExpressionMap() (ExpressionMap){NULL, NULL, 0, 0}
+
+extern void expression_map_deinit(ExpressionMap* const map);
+
+// Return value of expression, or EXPRESSION_MAP_NONE if it's not in map
+extern size_t expression_map_find(const ExpressionMap* const map,
+                                  const Expression* const expression);
+
+// Insert expression, which is not in map, return false if memory is
+// exhausted
+extern bool expression_map_insert(ExpressionMap* const map,
+                                  const Expression* const expression,
+                                  const size_t value);
+
+// Stack keeps this many nodes without allocating
+#define EXPRESSION_STACK_INLINE 64
+
+// Nodes of walks which go down left operands of binary nodes in a loop and
+// come back up by popping them, since parsed chains are left-deep and would
+// nest a call per operand. Walks of right operands share the stack of their
+// walk, pushing above the nodes of their parent.
+typedef struct expression_stack {
+	const Expression** nodes;
+	size_t count;
+	size_t capacity;
+	const Expression* inline_nodes[EXPRESSION_STACK_INLINE];
+} ExpressionStack;
+
+extern void expression_stack_init(ExpressionStack* const stack);
+extern void expression_stack_deinit(ExpressionStack* const stack);
+
+// Push expression, return false if memory is exhausted
+extern bool expression_stack_push(ExpressionStack* const stack,
+                                  const Expression* const expression);
+
+extern void syntax_errors_print(const SyntaxErrors* const errors);
+
+// Printer nests this many expressions without allocating
+#define PRINTER_DEPTH_INLINE 64
+
+// Longest printed number literal
+#define PRINTER_NUMBER_MAX 32
+
+typedef struct expression_printer_frame {
+	const Expression* expression;
+	uint8_t step; // @NOTE: Pieces of expression printed so far
+	bool parenthesised;
+} ExpressionPrinterFrame;
+
+// Printer produces text of expression on demand, walking only as much of
+// the tree as was read. Operands are parenthesised only where precedence
+// and associativity of operators require.
+typedef struct expression_printer {
+	ExpressionPrinterFrame* frames;
+	size_t depth;
+	size_t capacity;
+	ExpressionPrinterFrame inline_frames[PRINTER_DEPTH_INLINE];
+	const uint8_t* pending; // @NOTE: Rest of the current piece of text
+	size_t pending_length;
+	char number[PRINTER_NUMBER_MAX];
+	bool failed; // Memory was exhausted, text is incomplete
+} ExpressionPrinter;
+
+extern void expression_printer_init(ExpressionPrinter* const printer,
+                                    const Expression* const expression);
+extern void expression_printer_deinit(ExpressionPrinter* const printer);
+
+// Read next at most size bytes of text into buffer, return count of bytes
+// read or 0 at the end of text
+extern size_t expression_printer_read(ExpressionPrinter* const printer,
+                                      char* const buffer,
+                                      const size_t size);
+
+// Write expression as it would be printed, without trailing newline
+extern void expression_write(const Expression* const expression, FILE* const file);
+
+// Write at most limit bytes of expression followed by ... if it's longer,
+// return false if text was cut
+extern bool expression_write_bounded(const Expression* const expression,
+                                     FILE* const file,
+                                     const size_t limit);
+
 extern void expression_print(const Expression* const expression);
 extern void expression_verbose_print(const Expression* const expression);
 
 // Expression creation functions
 extern Literal* expression_literal_create_number(const double number);
+// Number literal with exact value, which must be exact
+extern Literal* expression_literal_create_rational(const Rational number);
 extern Literal* expression_literal_create_symbol(String* const symbol);
 extern UnaryExpression* expression_unary_create(const TokenType operator,
                                                 Expression* const subexpression);
@@ -67,6 +234,12 @@ extern BinaryExpression* expression_binary_create(const TokenType operator,
                                                   Expression* const left,
                                                   Expression* const right);
 
+// Create binary expression taking ownership of operands, which may be NULL
+// if their creation failed; operands are destroyed if result is NULL
+extern Expression* expression_binary_join(const TokenType operator,
+                                          Expression* left,
+                                          Expression* right);
+
 // Check whether expression is of type Empty, used in main function only
 extern bool expression_empty(const Expression* const expression);
 
@@ -0,0 +1,890 @@
+#include "polynomial.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool polynomial_reserve(Polynomial* const polynomial,
+                               const size_t capacity);
+static bool polynomial_combine(const Polynomial* const lhs,
+                               const Polynomial* const rhs,
+                               const bool subtract,
+                               Polynomial* const result);
+
+static uint64_t monomial_degree(const uint32_t* const exponents,
+                                const size_t variables);
+static int monomial_compare(const uint32_t* const lhs,
+                            const uint32_t* const rhs,
+                            const size_t variables);
+static void monomial_multiply(const uint32_t* const lhs,
+                              const uint32_t* const rhs,
+                              const size_t variables,
+                              uint32_t* const result);
+
+static void heap_push(size_t* const heap,
+                      size_t* const length,
+                      const size_t stream,
+                      const uint32_t* const products,
+                      const size_t variables);
+static size_t heap_pop(size_t* const heap,
+                       size_t* const length,
+                       const uint32_t* const products,
+                       const size_t variables);
+
+static Expression* term_to_expression(const Polynomial* const polynomial,
+                                      const size_t term,
+                                      const SymbolTable* const symbols,
+                                      const bool negative);
+
+Polynomial polynomial_init(const size_t variables)
+{
+	return Polynomial(variables);
+}
+
+void polynomial_deinit(Polynomial* const polynomial)
+{
+	assert(polynomial != NULL);
+
+	free(polynomial->coefficients);
+	free(polynomial->exponents);
+
+	*polynomial = Polynomial(polynomial->variables);
+}
+
+bool polynomial_constant(const Polynomial* const polynomial,
+                         Rational* const value)
+{
+	assert(polynomial != NULL);
+	assert(value != NULL);
+
+	if (polynomial->length == 0) {
+		*value = rational_integer(0);
+		return true;
+	}
+
+	if (polynomial->length > 1 ||
+	    monomial_degree(polynomial_monomial(polynomial, 0), polynomial->variables) > 0) {
+		return false;
+	}
+
+	*value = polynomial->coefficients[0];
+	return true;
+}
+
+bool polynomial_add(const Polynomial* const lhs,
+                    const Polynomial* const rhs,
+                    Polynomial* const result)
+{
+	return polynomial_combine(lhs, rhs, false, result);
+}
+
+bool polynomial_subtract(const Polynomial* const lhs,
+                         const Polynomial* const rhs,
+                         Polynomial* const result)
+{
+	return polynomial_combine(lhs, rhs, true, result);
+}
+
+// Products of each term of the shorter polynomial with all terms of the
+// longer one form sorted streams, since graded lexicographic order is
+// preserved by multiplication. Streams are merged with a heap, so that
+// like terms come out consecutively and are summed without a hash table
+// or sorting all pairwise products.
+bool polynomial_multiply(const Polynomial* const lhs,
+                         const Polynomial* const rhs,
+                         Polynomial* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(lhs->variables == rhs->variables);
+	assert(result != NULL);
+
+	const size_t variables = lhs->variables;
+
+	*result = Polynomial(variables);
+
+	if (lhs->length == 0 || rhs->length == 0)
+		return true;
+
+	if (polynomial_degree(lhs) + polynomial_degree(rhs) > POLYNOMIAL_DEGREE_MAX)
+		return false;
+
+	const Polynomial* const short_ = lhs->length <= rhs->length ? lhs : rhs;
+	const Polynomial* const long_ = lhs->length <= rhs->length ? rhs : lhs;
+
+	const size_t streams = short_->length;
+
+	// @NOTE: One extra exponent vector is used for the monomial being summed
+	size_t* const heap = malloc(streams * sizeof(size_t));
+	size_t* const next = malloc(streams * sizeof(size_t));
+	uint32_t* const products = malloc((streams + 1) * (variables + 1) * sizeof(uint32_t));
+
+	bool success = heap != NULL && next != NULL && products != NULL;
+
+	size_t length = 0;
+
+	for (size_t i = 0; success && i < streams; ++i) {
+		next[i] = 0;
+		monomial_multiply(polynomial_monomial(short_, i),
+		                  polynomial_monomial(long_, 0),
+		                  variables,
+		                  &products[i * variables]);
+		heap_push(heap, &length, i, products, variables);
+	}
+
+	uint32_t* const current = success ? &products[streams * variables] : NULL;
+
+	while (success && length > 0) {
+		memcpy(current, &products[heap[0] * variables], variables * sizeof(uint32_t));
+
+		Rational sum = rational_integer(0);
+
+		while (length > 0 &&
+		       monomial_compare(&products[heap[0] * variables], current, variables) == 0) {
+			const size_t i = heap_pop(heap, &length, products, variables);
+
+			sum = rational_add(sum, rational_multiply(short_->coefficients[i],
+			                                          long_->coefficients[next[i]]));
+
+			if (++next[i] < long_->length) {
+				monomial_multiply(polynomial_monomial(short_, i),
+				                  polynomial_monomial(long_, next[i]),
+				                  variables,
+				                  &products[i * variables]);
+				heap_push(heap, &length, i, products, variables);
+			}
+		}
+
+		success = polynomial_append(result, sum, current);
+	}
+
+	free(heap);
+	free(next);
+	free(products);
+
+	return success;
+}
+
+bool polynomial_power(const Polynomial* const base,
+                      const uint32_t exponent,
+                      Polynomial* const result)
+{
+	assert(base != NULL);
+	assert(result != NULL);
+
+	*result = Polynomial(base->variables);
+
+	if (polynomial_degree(base) * exponent > POLYNOMIAL_DEGREE_MAX)
+		return false;
+
+	// @NOTE: Exponentiation by squaring
+	Polynomial square = Polynomial(base->variables);
+
+	bool success = polynomial_append(result, rational_integer(1), NULL) &&
+	               polynomial_add(base, &square, &square);
+
+	for (uint32_t power = exponent; success && power != 0; power /= 2) {
+		Polynomial product;
+
+		if (power % 2 != 0) {
+			success = polynomial_multiply(result, &square, &product);
+			polynomial_deinit(result);
+			*result = product;
+		}
+
+		if (success && power / 2 != 0) {
+			success = polynomial_multiply(&square, &square, &product);
+			polynomial_deinit(&square);
+			square = product;
+		}
+	}
+
+	polynomial_deinit(&square);
+
+	return success;
+}
+
+bool polynomial_scale(Polynomial* const polynomial, const Rational factor)
+{
+	assert(polynomial != NULL);
+
+	if (!rational_exact(factor))
+		return false;
+
+	if (rational_equal(factor, rational_integer(0))) {
+		polynomial->length = 0;
+		return true;
+	}
+
+	for (size_t i = 0; i < polynomial->length; ++i) {
+		polynomial->coefficients[i] = rational_multiply(polynomial->coefficients[i], factor);
+
+		if (!rational_exact(polynomial->coefficients[i]))
+			return false;
+	}
+
+	return true;
+}
+
+bool polynomial_copy(const Polynomial* const source,
+                     Polynomial* const destination)
+{
+	assert(source != NULL);
+	assert(destination != NULL);
+
+	*destination = Polynomial(source->variables);
+
+	return polynomial_add(source, destination, destination);
+}
+
+uint32_t polynomial_variable_degree(const Polynomial* const polynomial,
+                                    const size_t variable)
+{
+	assert(polynomial != NULL);
+	assert(variable < polynomial->variables);
+
+	uint32_t result = 0;
+
+	for (size_t i = 0; i < polynomial->length; ++i) {
+		const uint32_t exponent = polynomial_monomial(polynomial, i)[variable];
+
+		if (exponent > result)
+			result = exponent;
+	}
+
+	return result;
+}
+
+// @NOTE: Dropping the same power of a variable from every term keeps their
+// order, as does differentiation below
+bool polynomial_coefficient(const Polynomial* const polynomial,
+                            const size_t variable,
+                            const uint32_t degree,
+                            Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(variable < polynomial->variables);
+	assert(result != NULL);
+
+	*result = Polynomial(polynomial->variables);
+
+	uint32_t* const exponents = malloc((polynomial->variables + 1) * sizeof(uint32_t));
+	bool success = exponents != NULL;
+
+	for (size_t i = 0; success && i < polynomial->length; ++i) {
+		const uint32_t* const monomial = polynomial_monomial(polynomial, i);
+
+		if (monomial[variable] != degree)
+			continue;
+
+		memcpy(exponents, monomial, polynomial->variables * sizeof(uint32_t));
+		exponents[variable] = 0;
+
+		success = polynomial_append(result, polynomial->coefficients[i], exponents);
+	}
+
+	free(exponents);
+
+	return success;
+}
+
+bool polynomial_derivative(const Polynomial* const polynomial,
+                           const size_t variable,
+                           Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(variable < polynomial->variables);
+	assert(result != NULL);
+
+	*result = Polynomial(polynomial->variables);
+
+	uint32_t* const exponents = malloc((polynomial->variables + 1) * sizeof(uint32_t));
+	bool success = exponents != NULL;
+
+	for (size_t i = 0; success && i < polynomial->length; ++i) {
+		const uint32_t* const monomial = polynomial_monomial(polynomial, i);
+
+		if (monomial[variable] == 0)
+			continue;
+
+		memcpy(exponents, monomial, polynomial->variables * sizeof(uint32_t));
+		--exponents[variable];
+
+		success = polynomial_append(
+			result,
+			rational_multiply(polynomial->coefficients[i], rational_integer(monomial[variable])),
+			exponents);
+	}
+
+	free(exponents);
+
+	return success;
+}
+
+bool polynomial_multiply_term(const Polynomial* const polynomial,
+                              const Rational coefficient,
+                              const uint32_t* const exponents,
+                              Polynomial* const result)
+{
+	assert(polynomial != NULL);
+	assert(exponents != NULL);
+	assert(result != NULL);
+
+	const size_t variables = polynomial->variables;
+
+	*result = Polynomial(variables);
+
+	if (polynomial_degree(polynomial) + monomial_degree(exponents, variables) > POLYNOMIAL_DEGREE_MAX)
+		return false;
+
+	uint32_t* const product = malloc((variables + 1) * sizeof(uint32_t));
+	bool success = product != NULL;
+
+	for (size_t i = 0; success && i < polynomial->length; ++i) {
+		monomial_multiply(polynomial_monomial(polynomial, i), exponents, variables, product);
+
+		success = polynomial_append(
+			result, rational_multiply(polynomial->coefficients[i], coefficient), product);
+	}
+
+	free(product);
+
+	return success;
+}
+
+// @NOTE: {divisor} is a Groebner basis of the ideal it generates, so the
+// remainder is zero exactly when divisor divides dividend, and the first
+// leading term which isn't divisible proves it doesn't
+bool polynomial_divide(const Polynomial* const dividend,
+                       const Polynomial* const divisor,
+                       Polynomial* const result)
+{
+	assert(dividend != NULL);
+	assert(divisor != NULL);
+	assert(dividend->variables == divisor->variables);
+	assert(result != NULL);
+
+	const size_t variables = dividend->variables;
+
+	*result = Polynomial(variables);
+
+	if (divisor->length == 0)
+		return false;
+
+	Polynomial remainder = Polynomial(variables);
+
+	uint32_t* const exponents = malloc((variables + 1) * sizeof(uint32_t));
+	bool success = exponents != NULL;
+
+	const uint32_t* const leading = polynomial_monomial(divisor, 0);
+
+	// @NOTE: Division by a term divides every term and keeps their order
+	for (size_t term = 0; success && divisor->length == 1 && term < dividend->length; ++term) {
+		const uint32_t* const monomial = polynomial_monomial(dividend, term);
+
+		for (size_t i = 0; success && i < variables; ++i) {
+			success = monomial[i] >= leading[i];
+			exponents[i] = monomial[i] - leading[i];
+		}
+
+		success = success && polynomial_append(
+			result,
+			rational_divide(dividend->coefficients[term], divisor->coefficients[0]),
+			exponents);
+	}
+
+	if (divisor->length > 1)
+		success = success && polynomial_copy(dividend, &remainder);
+
+	while (success && remainder.length > 0) {
+		const uint32_t* const monomial = polynomial_monomial(&remainder, 0);
+
+		for (size_t i = 0; success && i < variables; ++i) {
+			success = monomial[i] >= leading[i];
+			exponents[i] = monomial[i] - leading[i];
+		}
+
+		if (!success)
+			break;
+
+		const Rational coefficient = rational_divide(remainder.coefficients[0],
+		                                             divisor->coefficients[0]);
+
+		Polynomial product, difference;
+
+		success = polynomial_append(result, coefficient, exponents) &&
+		          polynomial_multiply_term(divisor, coefficient, exponents, &product) &&
+		          polynomial_subtract(&remainder, &product, &difference);
+
+		polynomial_deinit(&product);
+		polynomial_deinit(&remainder);
+		remainder = difference;
+	}
+
+	polynomial_deinit(&remainder);
+	free(exponents);
+
+	return success;
+}
+
+bool polynomial_append(Polynomial* const polynomial,
+                       const Rational coefficient,
+                       const uint32_t* const exponents)
+{
+	assert(polynomial != NULL);
+
+	if (!rational_exact(coefficient))
+		return false;
+
+	if (coefficient.numerator == 0)
+		return true;
+
+	if (!polynomial_reserve(polynomial, polynomial->length + 1))
+		return false;
+
+	uint32_t* const destination = &polynomial->exponents[polynomial->length * polynomial->variables];
+
+	if (exponents != NULL)
+		memcpy(destination, exponents, polynomial->variables * sizeof(uint32_t));
+	else
+		memset(destination, 0, polynomial->variables * sizeof(uint32_t));
+
+	polynomial->coefficients[polynomial->length++] = coefficient;
+
+	return true;
+}
+
+const uint32_t* polynomial_monomial(const Polynomial* const polynomial,
+                                    const size_t term)
+{
+	assert(polynomial != NULL);
+	assert(term < polynomial->length);
+
+	return &polynomial->exponents[term * polynomial->variables];
+}
+
+// Terms are sorted by degree first, so the first one has the highest
+uint64_t polynomial_degree(const Polynomial* const polynomial)
+{
+	assert(polynomial != NULL);
+
+	if (polynomial->length == 0)
+		return 0;
+
+	return monomial_degree(polynomial_monomial(polynomial, 0), polynomial->variables);
+}
+
+bool polynomial_operate(const TokenType operator,
+                        const Polynomial* const lhs,
+                        const Polynomial* const rhs,
+                        Polynomial* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(result != NULL);
+
+	Rational value;
+
+	*result = Polynomial(lhs->variables);
+
+	switch (operator) {
+	case TokenType_Plus:
+		return polynomial_add(lhs, rhs, result);
+
+	case TokenType_Minus:
+		return polynomial_subtract(lhs, rhs, result);
+
+	case TokenType_Multiply:
+		return polynomial_multiply(lhs, rhs, result);
+
+	// Only division by nonzero constant keeps polynomial
+	case TokenType_Divide:
+		return polynomial_constant(rhs, &value) &&
+		       value.numerator != 0 &&
+		       polynomial_add(lhs, result, result) &&
+		       polynomial_scale(result, rational_divide(rational_integer(1), value));
+
+	case TokenType_Exponent:
+		return polynomial_constant(rhs, &value) &&
+		       rational_integral(value) &&
+		       value.numerator >= 0 &&
+		       value.numerator <= POLYNOMIAL_DEGREE_MAX &&
+		       polynomial_power(lhs, (uint32_t)value.numerator, result);
+	}
+
+	return false;
+}
+
+bool polynomial_from_expression(const Expression* const expression,
+                                const SymbolTable* const symbols,
+                                Polynomial* const result)
+{
+	assert(expression != NULL);
+	assert(symbols != NULL);
+	assert(result != NULL);
+
+	const size_t variables = symbols->count;
+
+	*result = Polynomial(variables);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Number) {
+			if (!rational_exact(literal->rational))
+				return false;
+
+			return polynomial_append(result, literal->rational, NULL);
+		}
+
+		const size_t id = symbol_table_find(symbols, &literal->symbol);
+		if (id == SYMBOL_NONE || !polynomial_reserve(result, 1))
+			return false;
+
+		uint32_t* const exponents = &result->exponents[0];
+		memset(exponents, 0, variables * sizeof(uint32_t));
+		exponents[id] = 1;
+
+		result->coefficients[0] = rational_integer(1);
+		result->length = 1;
+
+		return true;
+	}
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		if (!polynomial_from_expression(unary->subexpression, symbols, result))
+			return false;
+
+		if (unary->operator == TokenType_Minus)
+			return polynomial_scale(result, rational_integer(-1));
+
+		return true;
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		Polynomial left;
+		Polynomial right = Polynomial(variables);
+
+		bool success = polynomial_from_expression(binary->left, symbols, &left) &&
+		               polynomial_from_expression(binary->right, symbols, &right);
+
+		if (success)
+			success = polynomial_operate(binary->operator, &left, &right, result);
+
+		polynomial_deinit(&left);
+		polynomial_deinit(&right);
+
+		return success;
+	}
+	}
+
+	return false;
+}
+
+Expression* polynomial_to_expression(const Polynomial* const polynomial,
+                                     const SymbolTable* const symbols)
+{
+	assert(polynomial != NULL);
+	assert(symbols != NULL);
+	assert(polynomial->variables <= symbols->count);
+
+	if (polynomial->length == 0)
+		return (Expression*)expression_literal_create_rational(rational_integer(0));
+
+	Expression* result = term_to_expression(
+		polynomial, 0, symbols, polynomial->coefficients[0].numerator < 0);
+
+	for (size_t i = 1; i < polynomial->length && result != NULL; ++i) {
+		const bool negative = polynomial->coefficients[i].numerator < 0;
+
+		result = expression_binary_join(negative ? TokenType_Minus : TokenType_Plus,
+		                         result,
+		                         term_to_expression(polynomial, i, symbols, false));
+	}
+
+	return result;
+}
+
+static bool polynomial_reserve(Polynomial* const polynomial,
+                               const size_t capacity)
+{
+	assert(polynomial != NULL);
+
+	if (capacity <= polynomial->capacity)
+		return true;
+
+	if (capacity > POLYNOMIAL_TERMS_MAX)
+		return false;
+
+	size_t new_capacity = polynomial->capacity > 0 ? polynomial->capacity : 4;
+	while (new_capacity < capacity)
+		new_capacity *= 2;
+
+	Rational* const coefficients = realloc(polynomial->coefficients,
+	                                       new_capacity * sizeof(Rational));
+	if (coefficients == NULL)
+		return false;
+
+	polynomial->coefficients = coefficients;
+
+	// @NOTE: Exponents of constant polynomials take no space, one extra is
+	// allocated so that realloc is never asked for zero bytes
+	uint32_t* const exponents = realloc(polynomial->exponents,
+	                                    (new_capacity * polynomial->variables + 1) * sizeof(uint32_t));
+	if (exponents == NULL)
+		return false;
+
+	polynomial->exponents = exponents;
+	polynomial->capacity = new_capacity;
+
+	return true;
+}
+
+static bool polynomial_combine(const Polynomial* const lhs,
+                               const Polynomial* const rhs,
+                               const bool subtract,
+                               Polynomial* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(lhs->variables == rhs->variables);
+	assert(result != NULL);
+
+	const size_t variables = lhs->variables;
+
+	Polynomial sum = Polynomial(variables);
+
+	size_t i = 0, j = 0;
+	bool success = true;
+
+	while (success && (i < lhs->length || j < rhs->length)) {
+		const int order = i == lhs->length ? -1
+		                : j == rhs->length ? 1
+		                : monomial_compare(polynomial_monomial(lhs, i),
+		                                   polynomial_monomial(rhs, j),
+		                                   variables);
+
+		if (order > 0) {
+			success = polynomial_append(&sum, lhs->coefficients[i], polynomial_monomial(lhs, i));
+			++i;
+			continue;
+		}
+
+		Rational coefficient = subtract ? rational_negate(rhs->coefficients[j])
+		                                : rhs->coefficients[j];
+
+		if (order == 0) {
+			coefficient = rational_add(lhs->coefficients[i], coefficient);
+			++i;
+		}
+
+		success = polynomial_append(&sum, coefficient, polynomial_monomial(rhs, j));
+		++j;
+	}
+
+	// @NOTE: Result may alias an operand, so it's replaced only at the end
+	if (result == lhs || result == rhs)
+		polynomial_deinit(result);
+
+	*result = sum;
+
+	return success;
+}
+
+static uint64_t monomial_degree(const uint32_t* const exponents,
+                                const size_t variables)
+{
+	assert(exponents != NULL);
+
+	uint64_t result = 0;
+
+	for (size_t i = 0; i < variables; ++i)
+		result += exponents[i];
+
+	return result;
+}
+
+// Graded lexicographic order: higher total degree first, then higher
+// exponent of symbol interned first
+static int monomial_compare(const uint32_t* const lhs,
+                            const uint32_t* const rhs,
+                            const size_t variables)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+
+	const uint64_t lhs_degree = monomial_degree(lhs, variables);
+	const uint64_t rhs_degree = monomial_degree(rhs, variables);
+
+	if (lhs_degree != rhs_degree)
+		return lhs_degree > rhs_degree ? 1 : -1;
+
+	for (size_t i = 0; i < variables; ++i) {
+		if (lhs[i] != rhs[i])
+			return lhs[i] > rhs[i] ? 1 : -1;
+	}
+
+	return 0;
+}
+
+static void monomial_multiply(const uint32_t* const lhs,
+                              const uint32_t* const rhs,
+                              const size_t variables,
+                              uint32_t* const result)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+	assert(result != NULL);
+
+	for (size_t i = 0; i < variables; ++i)
+		result[i] = lhs[i] + rhs[i];
+}
+
+// Binary max-heap of streams ordered by their current products
+static void heap_push(size_t* const heap,
+                      size_t* const length,
+                      const size_t stream,
+                      const uint32_t* const products,
+                      const size_t variables)
+{
+	assert(heap != NULL);
+	assert(length != NULL);
+	assert(products != NULL);
+
+	size_t i = (*length)++;
+
+	while (i > 0) {
+		const size_t parent = (i - 1) / 2;
+
+		if (monomial_compare(&products[heap[parent] * variables],
+		                     &products[stream * variables],
+		                     variables) >= 0) {
+			break;
+		}
+
+		heap[i] = heap[parent];
+		i = parent;
+	}
+
+	heap[i] = stream;
+}
+
+static size_t heap_pop(size_t* const heap,
+                       size_t* const length,
+                       const uint32_t* const products,
+                       const size_t variables)
+{
+	assert(heap != NULL);
+	assert(length != NULL && *length > 0);
+	assert(products != NULL);
+
+	const size_t result = heap[0];
+	const size_t last = heap[--*length];
+
+	size_t i = 0;
+
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if (child >= *length)
+			break;
+
+		if (child + 1 < *length &&
+		    monomial_compare(&products[heap[child + 1] * variables],
+		                     &products[heap[child] * variables],
+		                     variables) > 0) {
+			++child;
+		}
+
+		if (monomial_compare(&products[heap[child] * variables],
+		                     &products[last * variables],
+		                     variables) <= 0) {
+			break;
+		}
+
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = last;
+
+	return result;
+}
+
+// Build term as [numerator *] symbol [^ exponent] * ... [/ denominator],
+// with absolute value of coefficient unless negative is set
+static Expression* term_to_expression(const Polynomial* const polynomial,
+                                      const size_t term,
+                                      const SymbolTable* const symbols,
+                                      const bool negative)
+{
+	assert(polynomial != NULL);
+	assert(symbols != NULL);
+
+	const Rational coefficient = polynomial->coefficients[term];
+	const uint32_t* const exponents = polynomial_monomial(polynomial, term);
+
+	const int64_t numerator = coefficient.numerator < 0 ? -coefficient.numerator
+	                                                    : coefficient.numerator;
+	const bool monomial = monomial_degree(exponents, polynomial->variables) > 0;
+
+	Expression* result = NULL;
+
+	if (numerator != 1 || !monomial) {
+		result = (Expression*)expression_literal_create_rational(
+			rational_integer(negative ? -numerator : numerator));
+		if (result == NULL)
+			return NULL;
+	}
+
+	for (size_t id = 0; id < polynomial->variables; ++id) {
+		if (exponents[id] == 0)
+			continue;
+
+		String symbol = *symbol_table_name(symbols, id);
+
+		Expression* factor = (Expression*)expression_literal_create_symbol(&symbol);
+
+		if (factor != NULL && exponents[id] > 1) {
+			factor = expression_binary_join(
+				TokenType_Exponent,
+				factor,
+				(Expression*)expression_literal_create_rational(rational_integer(exponents[id])));
+		}
+
+		// @NOTE: Sign of unit coefficient goes to the first factor
+		if (result == NULL) {
+			if (factor != NULL && negative) {
+				Expression* const unary = (Expression*)expression_unary_create(TokenType_Minus, factor);
+				if (unary == NULL)
+					expression_destroy(&factor);
+
+				factor = unary;
+			}
+
+			result = factor;
+
+			if (result == NULL)
+				return NULL;
+
+			continue;
+		}
+
+		result = expression_binary_join(TokenType_Multiply, result, factor);
+		if (result == NULL)
+			return NULL;
+	}
+
+	if (coefficient.denominator != 1) {
+		result = expression_binary_join(
+			TokenType_Divide,
+			result,
+			(Expression*)expression_literal_create_rational(rational_integer(coefficient.denominator)));
+	}
+
+	return result;
+}
@@ -0,0 +1,115 @@
+#ifndef __POLYNOMIAL_H__
+#define __POLYNOMIAL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rational.h"
+#include "lexer.h"
+#include "symbol.h"
+#include "parser.h"
+
+// Operations fail instead of producing polynomials larger than this
+#define POLYNOMIAL_TERMS_MAX (1 << 16)
+#define POLYNOMIAL_DEGREE_MAX (1 << 16)
+
+// Sparse polynomial with exact coefficients over interned symbols. Terms are
+// kept sorted in descending graded lexicographic order of their monomials,
+// with nonzero coefficients and no duplicate monomials, so that equal
+// polynomials have equal representation.
+typedef struct polynomial {
+	size_t variables; // Length of exponent vectors, symbol identifiers are
+	                  // indices into them
+	size_t length;
+	size_t capacity;
+	Rational* coefficients;
+	uint32_t* exponents; // @NOTE: Term i has exponents [i * variables,
+	                     // (i + 1) * variables)
+} Polynomial;
+
+extern Polynomial polynomial_init(const size_t variables);
+#define Polynomial(variables) (Polynomial){(variables), 0, 0, NULL, NULL}
+
+extern void polynomial_deinit(Polynomial* const polynomial);
+
+extern bool polynomial_constant(const Polynomial* const polynomial,
+                                Rational* const value);
+
+// Exponents of given term
+extern const uint32_t* polynomial_monomial(const Polynomial* const polynomial,
+                                           const size_t term);
+
+// Total degree, zero for zero polynomial
+extern uint64_t polynomial_degree(const Polynomial* const polynomial);
+
+// Highest exponent of the variable
+extern uint32_t polynomial_variable_degree(const Polynomial* const polynomial,
+                                           const size_t variable);
+
+// Append term with monomial smaller than all present ones, zero
+// coefficients are skipped, NULL exponents mean constant term
+extern bool polynomial_append(Polynomial* const polynomial,
+                              const Rational coefficient,
+                              const uint32_t* const exponents);
+
+// Operations return false if coefficients overflow, result is too large or
+// memory is exhausted, result is initialized in any case
+extern bool polynomial_add(const Polynomial* const lhs,
+                           const Polynomial* const rhs,
+                           Polynomial* const result);
+extern bool polynomial_subtract(const Polynomial* const lhs,
+                                const Polynomial* const rhs,
+                                Polynomial* const result);
+extern bool polynomial_multiply(const Polynomial* const lhs,
+                                const Polynomial* const rhs,
+                                Polynomial* const result);
+extern bool polynomial_power(const Polynomial* const base,
+                             const uint32_t exponent,
+                             Polynomial* const result);
+
+extern bool polynomial_copy(const Polynomial* const source,
+                            Polynomial* const destination);
+
+// Coefficient of variable ^ degree, as polynomial in the other variables
+extern bool polynomial_coefficient(const Polynomial* const polynomial,
+                                   const size_t variable,
+                                   const uint32_t degree,
+                                   Polynomial* const result);
+
+extern bool polynomial_derivative(const Polynomial* const polynomial,
+                                  const size_t variable,
+                                  Polynomial* const result);
+
+extern bool polynomial_multiply_term(const Polynomial* const polynomial,
+                                     const Rational coefficient,
+                                     const uint32_t* const exponents,
+                                     Polynomial* const result);
+
+// Exact division, returns false if divisor doesn't divide dividend
+extern bool polynomial_divide(const Polynomial* const dividend,
+                              const Polynomial* const divisor,
+                              Polynomial* const result);
+
+// Apply binary operator, division is by nonzero constants only and
+// exponents are nonnegative integer constants only
+extern bool polynomial_operate(const TokenType operator,
+                               const Polynomial* const lhs,
+                               const Polynomial* const rhs,
+                               Polynomial* const result);
+
+// Multiply every coefficient in place
+extern bool polynomial_scale(Polynomial* const polynomial,
+                             const Rational factor);
+
+// Convert expression with symbols from given table to polynomial, return
+// false if expression is not a polynomial with exact coefficients
+extern bool polynomial_from_expression(const Expression* const expression,
+                                       const SymbolTable* const symbols,
+                                       Polynomial* const result);
+
+// Build expression tree as sum of terms, which prints in normal form
+extern Expression* polynomial_to_expression(const Polynomial* const polynomial,
+                                            const SymbolTable* const symbols);
+
+#endif // __POLYNOMIAL_H__
@@ -0,0 +1,228 @@
+#include "rational.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <ctype.h>
+
+// @NOTE: Products of two 64-bit integers are computed in 128 bits, then
+// reduced back to 64 bits if they fit
+typedef __int128 Int128;
+
+static Rational rational_reduce(Int128 numerator, Int128 denominator);
+static Int128 greatest_common_divisor(Int128 lhs, Int128 rhs);
+
+Rational rational_integer(const int64_t integer)
+{
+	return (Rational){integer, 1};
+}
+
+Rational rational_parse(const String* const string)
+{
+	assert(string != NULL);
+
+	int64_t numerator = 0;
+	int64_t denominator = 1;
+	bool fraction = false;
+
+	for (size_t i = 0; i < string->length; ++i) {
+		const uint8_t c = string->text[i];
+
+		if (c == '.') {
+			fraction = true;
+			continue;
+		}
+
+		if (!isdigit(c))
+			return RATIONAL_INEXACT;
+
+		if (__builtin_mul_overflow(numerator, 10, &numerator) ||
+		    __builtin_add_overflow(numerator, c - '0', &numerator)) {
+			return RATIONAL_INEXACT;
+		}
+
+		if (fraction && __builtin_mul_overflow(denominator, 10, &denominator))
+			return RATIONAL_INEXACT;
+	}
+
+	return rational_reduce(numerator, denominator);
+}
+
+Rational rational_from_double(const double number)
+{
+	// @NOTE: 2^63 is the first double out of int64_t range
+	if (!isfinite(number) || trunc(number) != number ||
+	    fabs(number) >= 9223372036854775808.0) {
+		return RATIONAL_INEXACT;
+	}
+
+	return (Rational){(int64_t)number, 1};
+}
+
+double rational_to_double(const Rational number)
+{
+	if (!rational_exact(number))
+		return NAN;
+
+	return (double)number.numerator / (double)number.denominator;
+}
+
+bool rational_exact(const Rational number)
+{
+	return number.denominator != 0;
+}
+
+bool rational_integral(const Rational number)
+{
+	return number.denominator == 1;
+}
+
+bool rational_equal(const Rational lhs, const Rational rhs)
+{
+	return rational_exact(lhs) && rational_exact(rhs) &&
+	       lhs.numerator == rhs.numerator && lhs.denominator == rhs.denominator;
+}
+
+Rational rational_negate(const Rational number)
+{
+	if (!rational_exact(number) || number.numerator == INT64_MIN)
+		return RATIONAL_INEXACT;
+
+	return (Rational){-number.numerator, number.denominator};
+}
+
+Rational rational_add(const Rational lhs, const Rational rhs)
+{
+	if (!rational_exact(lhs) || !rational_exact(rhs))
+		return RATIONAL_INEXACT;
+
+	// Fast path for integers
+	if (lhs.denominator == 1 && rhs.denominator == 1) {
+		int64_t result;
+
+		if (!__builtin_add_overflow(lhs.numerator, rhs.numerator, &result))
+			return (Rational){result, 1};
+	}
+
+	return rational_reduce(
+		(Int128)lhs.numerator * rhs.denominator + (Int128)rhs.numerator * lhs.denominator,
+		(Int128)lhs.denominator * rhs.denominator);
+}
+
+Rational rational_subtract(const Rational lhs, const Rational rhs)
+{
+	if (!rational_exact(lhs) || !rational_exact(rhs))
+		return RATIONAL_INEXACT;
+
+	if (lhs.denominator == 1 && rhs.denominator == 1) {
+		int64_t result;
+
+		if (!__builtin_sub_overflow(lhs.numerator, rhs.numerator, &result))
+			return (Rational){result, 1};
+	}
+
+	return rational_reduce(
+		(Int128)lhs.numerator * rhs.denominator - (Int128)rhs.numerator * lhs.denominator,
+		(Int128)lhs.denominator * rhs.denominator);
+}
+
+Rational rational_multiply(const Rational lhs, const Rational rhs)
+{
+	if (!rational_exact(lhs) || !rational_exact(rhs))
+		return RATIONAL_INEXACT;
+
+	if (lhs.denominator == 1 && rhs.denominator == 1) {
+		int64_t result;
+
+		if (!__builtin_mul_overflow(lhs.numerator, rhs.numerator, &result))
+			return (Rational){result, 1};
+	}
+
+	return rational_reduce((Int128)lhs.numerator * rhs.numerator,
+	                       (Int128)lhs.denominator * rhs.denominator);
+}
+
+Rational rational_divide(const Rational lhs, const Rational rhs)
+{
+	if (!rational_exact(lhs) || !rational_exact(rhs))
+		return RATIONAL_INEXACT;
+
+	return rational_reduce((Int128)lhs.numerator * rhs.denominator,
+	                       (Int128)lhs.denominator * rhs.numerator);
+}
+
+Rational rational_power(const Rational base, const Rational exponent)
+{
+	if (!rational_exact(base) || !rational_integral(exponent))
+		return RATIONAL_INEXACT;
+
+	// @NOTE: Exponentiation by squaring, inexact result stops the loop
+	Rational result = rational_integer(1);
+	Rational square = base;
+
+	int64_t power = exponent.numerator;
+	const bool reciprocal = power < 0;
+
+	while (power != 0 && rational_exact(result)) {
+		if (power % 2 != 0)
+			result = rational_multiply(result, square);
+
+		power /= 2;
+
+		if (power != 0)
+			square = rational_multiply(square, square);
+	}
+
+	if (reciprocal)
+		return rational_divide(rational_integer(1), result);
+
+	return result;
+}
+
+void rational_write(const Rational number, FILE* const file)
+{
+	assert(file != NULL);
+
+	if (!rational_exact(number)) {
+		fputs("nan", file);
+		return;
+	}
+
+	fprintf(file, "%" PRId64, number.numerator);
+
+	if (number.denominator != 1)
+		fprintf(file, "/%" PRId64, number.denominator);
+}
+
+static Rational rational_reduce(Int128 numerator, Int128 denominator)
+{
+	if (denominator == 0)
+		return RATIONAL_INEXACT;
+
+	if (denominator < 0) {
+		numerator = -numerator;
+		denominator = -denominator;
+	}
+
+	const Int128 divisor = greatest_common_divisor(
+		numerator < 0 ? -numerator : numerator, denominator);
+
+	numerator /= divisor;
+	denominator /= divisor;
+
+	if (numerator < INT64_MIN || numerator > INT64_MAX || denominator > INT64_MAX)
+		return RATIONAL_INEXACT;
+
+	return (Rational){(int64_t)numerator, (int64_t)denominator};
+}
+
+static Int128 greatest_common_divisor(Int128 lhs, Int128 rhs)
+{
+	while (rhs != 0) {
+		const Int128 remainder = lhs % rhs;
+		lhs = rhs;
+		rhs = remainder;
+	}
+
+	return lhs;
+}
@@ -0,0 +1,46 @@
+#ifndef __RATIONAL_H__
+#define __RATIONAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "string.h"
+
+// Exact rational number in lowest terms, denominator is always positive.
+// Results which don't fit into 64 bits, or are undefined, are inexact and
+// have zero denominator, operations on inexact numbers stay inexact.
+typedef struct rational {
+	int64_t numerator;
+	int64_t denominator;
+} Rational;
+
+#define RATIONAL_INEXACT (Rational){0, 0}
+
+extern Rational rational_integer(const int64_t integer);
+
+// Exact value of number literal, see TokenType_Number
+extern Rational rational_parse(const String* const string);
+
+// Exact value of integral double
+extern Rational rational_from_double(const double number);
+
+extern double rational_to_double(const Rational number);
+
+extern bool rational_exact(const Rational number);
+extern bool rational_integral(const Rational number);
+extern bool rational_equal(const Rational lhs, const Rational rhs);
+
+extern Rational rational_negate(const Rational number);
+extern Rational rational_add(const Rational lhs, const Rational rhs);
+extern Rational rational_subtract(const Rational lhs, const Rational rhs);
+extern Rational rational_multiply(const Rational lhs, const Rational rhs);
+extern Rational rational_divide(const Rational lhs, const Rational rhs);
+
+// Raise to power, exponent must be integral to be exact
+extern Rational rational_power(const Rational base, const Rational exponent);
+
+extern void rational_write(const Rational number, FILE* const file);
+#define rational_print(number) rational_write((number), stdout)
+
+#endif // __RATIONAL_H__
@@ -0,0 +1,188 @@
+#include "scratch.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// @NOTE: Freed blocks are poisoned when built with AddressSanitizer, so
+// that uses after free are reported as for heap blocks
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define SCRATCH_POISON(pointer, size) __asan_poison_memory_region((pointer), (size))
+#define SCRATCH_UNPOISON(pointer, size) __asan_unpoison_memory_region((pointer), (size))
+#else
+#define SCRATCH_POISON(pointer, size) ((void)(pointer), (void)(size))
+#define SCRATCH_UNPOISON(pointer, size) ((void)(pointer), (void)(size))
+#endif
+
+// Blocks are rounded up to multiple of this, which keeps them aligned
+#define SCRATCH_ALIGNMENT 16
+
+// Freed blocks up to this size are reused, larger ones are reclaimed only
+// when the region is reset
+#define SCRATCH_CLASS_SIZE_MAX 256
+#define SCRATCH_CLASSES (SCRATCH_CLASS_SIZE_MAX / SCRATCH_ALIGNMENT)
+#define SCRATCH_CLASS_NONE SCRATCH_CLASSES
+
+// Header precedes every block in the region
+typedef union scratch_header {
+	struct {
+		size_t class;
+		size_t size; // @NOTE: Rounded, which is poisoned once freed
+	};
+	uint8_t padding[SCRATCH_ALIGNMENT];
+} ScratchHeader;
+
+// Freed block, linked in place of its data
+typedef struct scratch_free_block {
+	struct scratch_free_block* next;
+} ScratchFreeBlock;
+
+static union {
+	long double alignment;
+	uint8_t bytes[SCRATCH_CAPACITY];
+} region;
+
+// @NOTE: Region is used by the thread which allocated first, the owner,
+// so that its state below is never shared; others allocate on the heap
+static bool region_claimed = false;
+static __thread bool region_owner = false;
+
+static size_t region_used = 0;
+static size_t region_live = 0; // @NOTE: Blocks allocated and not yet freed
+static ScratchFreeBlock* free_blocks[SCRATCH_CLASSES] = {NULL};
+
+// Blocks freed by other threads, pushed atomically and taken by the owner
+static ScratchFreeBlock* remote_blocks = NULL;
+
+// Return true if pointer is in region, not on the heap.
+static bool region_owns(const void* const pointer);
+
+// Return block of the owner to region.
+static void region_release(ScratchFreeBlock* const block);
+
+// Release blocks freed by other threads meanwhile, called by the owner.
+static void region_collect(void);
+
+void* scratch_allocate(const size_t size)
+{
+	assert(size > 0);
+
+	if (!region_owner) {
+		bool claimed = false;
+
+		if (__atomic_load_n(&region_claimed, __ATOMIC_RELAXED) ||
+		    !__atomic_compare_exchange_n(&region_claimed, &claimed, true, false,
+		                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return malloc(size);
+		}
+
+		region_owner = true;
+	}
+
+	region_collect();
+
+	const size_t rounded = (size + SCRATCH_ALIGNMENT - 1) & ~(size_t)(SCRATCH_ALIGNMENT - 1);
+	const size_t class = rounded <= SCRATCH_CLASS_SIZE_MAX
+		? rounded / SCRATCH_ALIGNMENT - 1
+		: SCRATCH_CLASS_NONE;
+
+	if (class != SCRATCH_CLASS_NONE && free_blocks[class] != NULL) {
+		ScratchFreeBlock* const block = free_blocks[class];
+
+		SCRATCH_UNPOISON(block, rounded);
+
+		free_blocks[class] = block->next;
+		++region_live;
+		return block;
+	}
+
+	if (region_used + sizeof(ScratchHeader) + rounded > SCRATCH_CAPACITY)
+		return malloc(size);
+
+	ScratchHeader* const header = (ScratchHeader*)(region.bytes + region_used);
+	header->class = class;
+	header->size = rounded;
+
+	region_used += sizeof(ScratchHeader) + rounded;
+	++region_live;
+
+	return header + 1;
+}
+
+// @NOTE: Other threads link blocks they free without touching the state of
+// region, which is updated once the owner collects them
+void scratch_free(void* const pointer)
+{
+	if (pointer == NULL)
+		return;
+
+	if (!region_owns(pointer)) {
+		free(pointer);
+		return;
+	}
+
+	ScratchFreeBlock* const block = pointer;
+
+	if (region_owner) {
+		region_release(block);
+		return;
+	}
+
+	block->next = __atomic_load_n(&remote_blocks, __ATOMIC_RELAXED);
+
+	while (!__atomic_compare_exchange_n(&remote_blocks, &block->next, block, true,
+	                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+	}
+}
+
+static bool region_owns(const void* const pointer)
+{
+	const uintptr_t address = (uintptr_t)pointer;
+	const uintptr_t begin = (uintptr_t)region.bytes;
+
+	return address >= begin && address < begin + SCRATCH_CAPACITY;
+}
+
+static void region_release(ScratchFreeBlock* const block)
+{
+	assert(region_owner);
+	assert(region_live > 0);
+
+	const ScratchHeader* const header = (ScratchHeader*)block - 1;
+
+	if (header->class != SCRATCH_CLASS_NONE) {
+		block->next = free_blocks[header->class];
+		free_blocks[header->class] = block;
+	}
+
+	SCRATCH_POISON(block, header->size);
+
+	// @NOTE: Free blocks are all in the region, so they are dropped with it
+	if (--region_live == 0) {
+		SCRATCH_UNPOISON(region.bytes, region_used);
+
+		region_used = 0;
+
+		for (size_t i = 0; i < SCRATCH_CLASSES; ++i)
+			free_blocks[i] = NULL;
+	}
+}
+
+static void region_collect(void)
+{
+	assert(region_owner);
+
+	if (__atomic_load_n(&remote_blocks, __ATOMIC_RELAXED) == NULL)
+		return;
+
+	ScratchFreeBlock* block = __atomic_exchange_n(&remote_blocks, NULL, __ATOMIC_ACQUIRE);
+
+	while (block != NULL) {
+		ScratchFreeBlock* const next = block->next;
+
+		region_release(block);
+		block = next;
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef __SCRATCH_H__
+#define __SCRATCH_H__
+
+#include <stddef.h>
+
+// Size of scratch region in bytes, enough for inputs of a few hundred
+// tokens to be scanned, parsed, transformed and printed
+#define SCRATCH_CAPACITY (64 * 1024)
+
+// Tokens, string buffers and expression nodes are allocated from a fixed
+// scratch region of the process, falling back to the heap once it's full.
+// Freed blocks are reused by blocks of the same size class, and the whole
+// region is reset once nothing in it is live, so that short requests don't
+// touch the heap at all.
+//
+// @NOTE: Region is used by the first thread which allocates, other threads
+// allocate on the heap, as a region is only worth it for short requests,
+// which are not split between threads. Blocks may be freed by any thread,
+// those of region are returned to it when its thread allocates next.
+
+// Allocate size bytes, return NULL if memory is exhausted
+extern void* scratch_allocate(const size_t size);
+
+// Free block of scratch_allocate, which may be NULL
+extern void scratch_free(void* const pointer);
+
+#endif // __SCRATCH_H__
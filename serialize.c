@@ -0,0 +1,463 @@
+#include "serialize.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "transform.h"
+
+// Longest text of a single formatted piece, as number or node identifier
+#define SERIALIZE_PIECE_MAX 64
+
+#define SERIALIZE_NONE SIZE_MAX
+
+const char* const FORMAT_NAME[Format__count] = {
+	[Format_Text] = "text",
+	[Format_Json] = "json",
+	[Format_Dot] = "dot",
+	[Format_Sexpr] = "sexpr",
+};
+
+static const char* const OPERATOR_NAME[TokenType__count] = {
+	[TokenType_Plus] = "+",
+	[TokenType_Minus] = "-",
+	[TokenType_Multiply] = "*",
+	[TokenType_Divide] = "/",
+	[TokenType_Exponent] = "^",
+};
+
+typedef struct writer {
+	FILE* file;
+	size_t length;
+	char buffer[SERIALIZE_BUFFER_CAPACITY];
+} Writer;
+
+// Node being written with its operands, written one per step
+typedef struct serialize_frame {
+	const Expression* expression;
+	size_t id;
+	size_t parent; // @NOTE: SERIALIZE_NONE for the root
+	size_t step;
+} SerializeFrame;
+
+typedef struct serializer {
+	Format format;
+	Writer writer;
+	SerializeFrame* frames;
+	size_t depth;
+	size_t capacity;
+	ExpressionMap visited; // @NOTE: Identifiers of nodes by address
+	size_t next_id;
+} Serializer;
+
+static void writer_write(Writer* const writer, const void* const text, const size_t length);
+static void writer_puts(Writer* const writer, const char* const text);
+static void writer_printf(Writer* const writer, const char* const format, ...);
+static void writer_flush(Writer* const writer);
+
+static bool serializer_push(Serializer* const serializer,
+                            const Expression* const expression,
+                            const size_t parent);
+
+// Write parts of node before, before every operand and after operands
+static void serializer_open(Serializer* const serializer, const SerializeFrame* const frame);
+static void serializer_separate(Serializer* const serializer, const SerializeFrame* const frame);
+static void serializer_close(Serializer* const serializer, const SerializeFrame* const frame);
+static void serializer_reference(Serializer* const serializer,
+                                 const size_t id,
+                                 const size_t parent);
+
+static size_t operands_count(const Expression* const expression);
+static const Expression* operand(const Expression* const expression, const size_t index);
+
+// Write number literal, integers known exactly with all digits
+static void write_number(Writer* const writer, const Literal* const literal);
+static void write_label(Writer* const writer, const Expression* const expression);
+
+Format format_from_name(const char* const name)
+{
+	assert(name != NULL);
+
+	for (Format format = 0; format < Format__count; ++format) {
+		if (strcmp(name, FORMAT_NAME[format]) == 0)
+			return format;
+	}
+
+	return Format__count;
+}
+
+// @NOTE: Walk is iterative, so that trees of any depth are written. Node
+// is visited in steps: opening it, then every operand preceded by a
+// separator, then closing it.
+bool expression_serialize(const Expression* const expression,
+                          const Format format,
+                          FILE* const file)
+{
+	assert(expression != NULL);
+	assert(format < Format__count);
+	assert(file != NULL);
+
+	if (format == Format_Text) {
+		expression_write(expression, file);
+		putc('\n', file);
+		return true;
+	}
+
+	Serializer serializer = {
+		.format = format,
+		.writer = {.file = file, .length = 0},
+		.frames = NULL,
+		.depth = 0,
+		.capacity = 0,
+		.visited = ExpressionMap(),
+		.next_id = 0,
+	};
+
+	if (format == Format_Dot)
+		writer_puts(&serializer.writer, "digraph expression {\n\tordering=out;\n");
+
+	bool result = serializer_push(&serializer, expression, SERIALIZE_NONE);
+
+	while (result && serializer.depth > 0) {
+		SerializeFrame* const frame = &serializer.frames[serializer.depth - 1];
+
+		// @NOTE: Only nodes with several owners may be visited again
+		const bool shared = expression_shared(frame->expression);
+
+		if (frame->step == 0) {
+			const size_t id = shared
+				? expression_map_find(&serializer.visited, frame->expression)
+				: EXPRESSION_MAP_NONE;
+
+			if (id != EXPRESSION_MAP_NONE) {
+				serializer_reference(&serializer, id, frame->parent);
+				--serializer.depth;
+				continue;
+			}
+
+			frame->id = serializer.next_id++;
+
+			if (shared && !expression_map_insert(&serializer.visited, frame->expression, frame->id)) {
+				result = false;
+				break;
+			}
+
+			serializer_open(&serializer, frame);
+		}
+
+		if (frame->step == operands_count(frame->expression)) {
+			serializer_close(&serializer, frame);
+			--serializer.depth;
+			continue;
+		}
+
+		serializer_separate(&serializer, frame);
+
+		const Expression* const next = operand(frame->expression, frame->step++);
+		result = serializer_push(&serializer, next, frame->id);
+	}
+
+	if (format == Format_Dot)
+		writer_puts(&serializer.writer, "}");
+
+	writer_write(&serializer.writer, "\n", 1);
+	writer_flush(&serializer.writer);
+
+	free(serializer.frames);
+	expression_map_deinit(&serializer.visited);
+
+	return result;
+}
+
+static void writer_write(Writer* const writer, const void* const text, const size_t length)
+{
+	assert(writer != NULL);
+
+	if (writer->length + length > sizeof(writer->buffer))
+		writer_flush(writer);
+
+	if (length > sizeof(writer->buffer)) {
+		fwrite(text, sizeof(char), length, writer->file);
+		return;
+	}
+
+	memcpy(writer->buffer + writer->length, text, length);
+	writer->length += length;
+}
+
+static void writer_puts(Writer* const writer, const char* const text)
+{
+	writer_write(writer, text, strlen(text));
+}
+
+static void writer_printf(Writer* const writer, const char* const format, ...)
+{
+	char piece[SERIALIZE_PIECE_MAX];
+
+	va_list arguments;
+	va_start(arguments, format);
+	const int length = vsnprintf(piece, sizeof(piece), format, arguments);
+	va_end(arguments);
+
+	if (length > 0)
+		writer_write(writer, piece, (size_t)length < sizeof(piece) ? (size_t)length : sizeof(piece) - 1);
+}
+
+static void writer_flush(Writer* const writer)
+{
+	assert(writer != NULL);
+
+	fwrite(writer->buffer, sizeof(char), writer->length, writer->file);
+	writer->length = 0;
+}
+
+static bool serializer_push(Serializer* const serializer,
+                            const Expression* const expression,
+                            const size_t parent)
+{
+	assert(serializer != NULL);
+	assert(expression != NULL);
+
+	if (serializer->depth == serializer->capacity) {
+		const size_t capacity = serializer->capacity > 0 ? 2 * serializer->capacity : 64;
+
+		SerializeFrame* const frames = realloc(serializer->frames,
+			capacity * sizeof(SerializeFrame));
+		if (frames == NULL)
+			return false;
+
+		serializer->frames = frames;
+		serializer->capacity = capacity;
+	}
+
+	serializer->frames[serializer->depth++] = (SerializeFrame){
+		expression, SERIALIZE_NONE, parent, 0
+	};
+
+	return true;
+}
+
+static void serializer_open(Serializer* const serializer, const SerializeFrame* const frame)
+{
+	assert(serializer != NULL);
+	assert(frame != NULL);
+
+	Writer* const writer = &serializer->writer;
+	const Expression* const expression = frame->expression;
+
+	switch (serializer->format) {
+	case Format_Json: {
+		static const char* const TYPE_NAME[ExpressionType__count] = {
+			[ExpressionType_Empty] = "empty",
+			[ExpressionType_Literal] = "literal",
+			[ExpressionType_Unary] = "unary",
+			[ExpressionType_Binary] = "binary",
+		};
+
+		const char* type = TYPE_NAME[expression->type];
+
+		if (expression->type == ExpressionType_Literal) {
+			type = ((Literal*)expression)->tag == LiteralTag_Number
+				? "number"
+				: "symbol";
+		}
+
+		writer_printf(writer, "{\"id\": %zu, \"type\": \"%s\"", frame->id, type);
+
+		switch (expression->type) {
+		case ExpressionType_Literal: {
+			const Literal* const literal = (Literal*)expression;
+
+			if (literal->tag == LiteralTag_Number) {
+				writer_puts(writer, ", \"value\": ");
+				write_number(writer, literal);
+			}
+			else {
+				writer_puts(writer, ", \"name\": \"");
+				writer_write(writer, literal->symbol.text, literal->symbol.length);
+				writer_puts(writer, "\"");
+			}
+		} break;
+
+		case ExpressionType_Unary:
+			writer_printf(writer, ", \"operator\": \"%s\"",
+			              OPERATOR_NAME[((UnaryExpression*)expression)->operator]);
+			break;
+
+		case ExpressionType_Binary:
+			writer_printf(writer, ", \"operator\": \"%s\"",
+			              OPERATOR_NAME[((BinaryExpression*)expression)->operator]);
+			break;
+		}
+
+		if (expression->rules != 0) {
+			writer_puts(writer, ", \"rules\": [");
+
+			bool first = true;
+			for (Rule rule = 0; rule < Rule__count; ++rule) {
+				if (expression->rules & RULE_BIT(rule)) {
+					writer_printf(writer, "%s\"%s\"", first ? "" : ", ", RULE_NAME[rule]);
+					first = false;
+				}
+			}
+
+			writer_puts(writer, "]");
+		}
+
+		if (operands_count(expression) > 0)
+			writer_puts(writer, ", \"operands\": [");
+	} break;
+
+	case Format_Dot:
+		writer_printf(writer, "\tn%zu [label=\"", frame->id);
+		write_label(writer, expression);
+
+		for (Rule rule = 0; rule < Rule__count; ++rule) {
+			if (expression->rules & RULE_BIT(rule))
+				writer_printf(writer, "\\n%s", RULE_NAME[rule]);
+		}
+
+		writer_puts(writer, "\"];\n");
+
+		if (frame->parent != SERIALIZE_NONE)
+			writer_printf(writer, "\tn%zu -> n%zu;\n", frame->parent, frame->id);
+		break;
+
+	case Format_Sexpr:
+		if (operands_count(expression) > 0)
+			writer_puts(writer, "(");
+
+		write_label(writer, expression);
+		break;
+	}
+}
+
+static void serializer_separate(Serializer* const serializer, const SerializeFrame* const frame)
+{
+	assert(serializer != NULL);
+	assert(frame != NULL);
+
+	switch (serializer->format) {
+	case Format_Json:
+		if (frame->step > 0)
+			writer_puts(&serializer->writer, ", ");
+		break;
+
+	case Format_Sexpr:
+		writer_puts(&serializer->writer, " ");
+		break;
+	}
+}
+
+static void serializer_close(Serializer* const serializer, const SerializeFrame* const frame)
+{
+	assert(serializer != NULL);
+	assert(frame != NULL);
+
+	const bool operands = operands_count(frame->expression) > 0;
+
+	switch (serializer->format) {
+	case Format_Json:
+		writer_puts(&serializer->writer, operands ? "]}" : "}");
+		break;
+
+	case Format_Sexpr:
+		if (operands)
+			writer_puts(&serializer->writer, ")");
+		break;
+	}
+}
+
+static void serializer_reference(Serializer* const serializer,
+                                 const size_t id,
+                                 const size_t parent)
+{
+	assert(serializer != NULL);
+
+	Writer* const writer = &serializer->writer;
+
+	switch (serializer->format) {
+	case Format_Json:
+		writer_printf(writer, "{\"ref\": %zu}", id);
+		break;
+
+	case Format_Dot:
+		if (parent != SERIALIZE_NONE)
+			writer_printf(writer, "\tn%zu -> n%zu;\n", parent, id);
+		break;
+
+	case Format_Sexpr:
+		writer_printf(writer, "#%zu#", id);
+		break;
+	}
+}
+
+static size_t operands_count(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Unary:
+		return 1;
+
+	case ExpressionType_Binary:
+		return 2;
+	}
+
+	return 0;
+}
+
+static const Expression* operand(const Expression* const expression, const size_t index)
+{
+	assert(expression != NULL);
+	assert(index < operands_count(expression));
+
+	if (expression->type == ExpressionType_Unary)
+		return ((UnaryExpression*)expression)->subexpression;
+
+	const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+	return index == 0 ? binary->left : binary->right;
+}
+
+static void write_number(Writer* const writer, const Literal* const literal)
+{
+	assert(literal != NULL && literal->tag == LiteralTag_Number);
+
+	if (rational_integral(literal->rational))
+		writer_printf(writer, "%" PRId64, literal->rational.numerator);
+	else
+		writer_printf(writer, "%.17g", literal->number);
+}
+
+static void write_label(Writer* const writer, const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Empty:
+		writer_puts(writer, "()");
+		break;
+
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Number)
+			write_number(writer, literal);
+		else
+			writer_write(writer, literal->symbol.text, literal->symbol.length);
+	} break;
+
+	case ExpressionType_Unary:
+		writer_puts(writer, OPERATOR_NAME[((UnaryExpression*)expression)->operator]);
+		break;
+
+	case ExpressionType_Binary:
+		writer_puts(writer, OPERATOR_NAME[((BinaryExpression*)expression)->operator]);
+		break;
+	}
+}
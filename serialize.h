@@ -0,0 +1,37 @@
+#ifndef __SERIALIZE_H__
+#define __SERIALIZE_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "parser.h"
+
+// Serialized text is collected in buffer of this many bytes before writing
+#define SERIALIZE_BUFFER_CAPACITY 4096
+
+typedef enum format {
+	Format_Text,  // Printed expression, see expression_print
+	Format_Json,  // Single line object per expression
+	Format_Dot,   // Graphviz digraph
+	Format_Sexpr, // S-expression
+	Format__count,
+} Format;
+
+extern const char* const FORMAT_NAME[Format__count];
+
+// Return format of given name, or Format__count if there is no such
+extern Format format_from_name(const char* const name);
+
+// Write tree of expression in format, followed by newline. Nodes are
+// numbered in order of visit, and subtrees shared by several parents are
+// written once and referred by number elsewhere. Return false if memory is
+// exhausted and output is incomplete.
+//
+// JSON object of node has fields id, type, operator or value or name,
+// rules which rewrote node if any, and operands; reference to shared node
+// is object with ref field only. S-expression writes reference as #id#.
+extern bool expression_serialize(const Expression* const expression,
+                                 const Format format,
+                                 FILE* const file);
+
+#endif // __SERIALIZE_H__
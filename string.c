@@ -7,6 +7,8 @@
 
 #include <alloca.h>
 
+#include "scratch.h"
+
 String string_init(const char* cstr)
 {
 	assert(cstr != NULL);
@@ -18,7 +20,7 @@ String string_create(const size_t length)
 {
 	assert(length > 0);
 
-	uint8_t* const text = malloc(length);
+	uint8_t* const text = scratch_allocate(length);
 	if (text == NULL)
 		return (String){NULL, 0, false};
 
@@ -32,7 +34,7 @@ void string_destroy(String* const string)
 	assert(string != NULL);
 
 	if (string->_allocated && string->text)
-		free(string->text);
+		scratch_free(string->text);
 
 	string->text = NULL;
 	string->length = 0;
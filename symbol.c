@@ -0,0 +1,127 @@
+#include "symbol.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "common.h"
+
+static uint64_t symbol_hash(const String* const symbol);
+static size_t* symbol_table_bucket(const SymbolTable* const table,
+                                   const String* const symbol);
+static bool symbol_table_grow(SymbolTable* const table);
+
+SymbolTable symbol_table_init(void)
+{
+	return (SymbolTable){NULL, 0, 0, NULL, 0};
+}
+
+void symbol_table_deinit(SymbolTable* const table)
+{
+	assert(table != NULL);
+
+	free(table->symbols);
+	free(table->buckets);
+
+	*table = SymbolTable();
+}
+
+size_t symbol_table_intern(SymbolTable* const table, const String* const symbol)
+{
+	assert(table != NULL);
+	assert(symbol != NULL);
+
+	// @NOTE: Load factor is kept at most 1/2
+	if (2 * (table->count + 1) > table->bucket_count &&
+	    !symbol_table_grow(table)) {
+		return SYMBOL_NONE;
+	}
+
+	size_t* const bucket = symbol_table_bucket(table, symbol);
+
+	if (*bucket != 0)
+		return *bucket - 1;
+
+	if (table->count == table->capacity) {
+		const size_t capacity = table->capacity > 0 ? 2 * table->capacity : 8;
+
+		String* const symbols = realloc(table->symbols, capacity * sizeof(String));
+		if (symbols == NULL)
+			return SYMBOL_NONE;
+
+		table->symbols = symbols;
+		table->capacity = capacity;
+	}
+
+	table->symbols[table->count] = *symbol;
+	*bucket = ++table->count;
+
+	return table->count - 1;
+}
+
+size_t symbol_table_find(const SymbolTable* const table,
+                         const String* const symbol)
+{
+	assert(table != NULL);
+	assert(symbol != NULL);
+
+	if (table->bucket_count == 0)
+		return SYMBOL_NONE;
+
+	const size_t* const bucket = symbol_table_bucket(table, symbol);
+
+	return *bucket != 0 ? *bucket - 1 : SYMBOL_NONE;
+}
+
+const String* symbol_table_name(const SymbolTable* const table, const size_t id)
+{
+	assert(table != NULL);
+	assert(id < table->count);
+
+	return &table->symbols[id];
+}
+
+static uint64_t symbol_hash(const String* const symbol)
+{
+	assert(symbol != NULL);
+
+	return hash_bytes(FNV_OFFSET_BASIS, symbol->text, symbol->length);
+}
+
+// Find bucket of symbol or empty bucket where it should be placed
+static size_t* symbol_table_bucket(const SymbolTable* const table,
+                                   const String* const symbol)
+{
+	assert(table != NULL && table->bucket_count > 0);
+	assert(symbol != NULL);
+
+	const size_t mask = table->bucket_count - 1;
+	size_t index = symbol_hash(symbol) & mask;
+
+	while (table->buckets[index] != 0 &&
+	       !string_equal(&table->symbols[table->buckets[index] - 1], symbol)) {
+		index = (index + 1) & mask;
+	}
+
+	return &table->buckets[index];
+}
+
+static bool symbol_table_grow(SymbolTable* const table)
+{
+	assert(table != NULL);
+
+	const size_t bucket_count = table->bucket_count > 0 ? 2 * table->bucket_count : 16;
+
+	size_t* const buckets = calloc(bucket_count, sizeof(size_t));
+	if (buckets == NULL)
+		return false;
+
+	free(table->buckets);
+	table->buckets = buckets;
+	table->bucket_count = bucket_count;
+
+	for (size_t id = 0; id < table->count; ++id)
+		*symbol_table_bucket(table, &table->symbols[id]) = id + 1;
+
+	return true;
+}
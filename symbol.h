@@ -0,0 +1,38 @@
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "string.h"
+
+#define SYMBOL_NONE SIZE_MAX
+
+// Symbol table maps distinct symbols to consecutive identifiers 0, 1, ...
+// in order of interning. Symbol text is not copied.
+typedef struct symbol_table {
+	String* symbols;
+	size_t count;
+	size_t capacity;
+	size_t* buckets; // @NOTE: Open addressing, identifier + 1 or 0 if empty
+	size_t bucket_count;
+} SymbolTable;
+
+extern SymbolTable symbol_table_init(void);
+#define SymbolTable() (SymbolTable){NULL, 0, 0, NULL, 0}
+
+extern void symbol_table_deinit(SymbolTable* const table);
+
+// Return identifier of symbol, adding it if needed, or SYMBOL_NONE if
+// out of memory
+extern size_t symbol_table_intern(SymbolTable* const table,
+                                  const String* const symbol);
+
+// Return identifier of symbol or SYMBOL_NONE if there is no such symbol
+extern size_t symbol_table_find(const SymbolTable* const table,
+                                const String* const symbol);
+
+extern const String* symbol_table_name(const SymbolTable* const table,
+                                       const size_t id);
+
+#endif // __SYMBOL_H__
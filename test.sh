@@ -1,45 +1,277 @@
 #!/bin/sh
-readonly tmpfile="$(mktemp -q)"
+# Usage: test.sh [-j <jobs>] [-t <budget ms>] [-o <report>]
+#
+# Cases run in parallel, each one timed; cases slower than budget are
+# flagged and every case is written to report as tab-separated
+# name, status and microseconds.
 
-total=0
-passed=0
-
-# @NOTE: Build program first
-make -j
-
-for t in $(find . -type f -iname '*-test'); do
-	total=$(($total+1))
+# Run single case given by its test file, print its result line and write
+# expected and found output to log on failure
+run_case() {
+	t="$1"
+	log="$2"
 	name="${t##./tests/}"
 	answer="${t%%-test}-answer"
+	mode=
+	verdict=
 
 	case "${t}" in
+		*format/json*)
+			mode="--format=json simplify"
+			;;
+		*format/dot*)
+			mode="--format=dot expand"
+			;;
+		*format/sexpr*)
+			mode="--format=sexpr normalize"
+			;;
+		*trace*)
+			mode="--trace=${log}.trace simplify"
+			;;
+		*limit*)
+			mode="--max-nodes=40 --max-bytes=4096 expand"
+			verdict=yes
+			;;
+		*balance*)
+			mode="--format=sexpr simplify"
+			;;
 		*simplify*)
 			mode=simplify
 			;;
 		*expand*)
 			mode=expand
 			;;
+		*normalize*)
+			mode=normalize
+			;;
+		*factor*)
+			mode=factor
+			;;
+		*collect*)
+			mode=collect
+			;;
+		*diff*)
+			mode="diff x,y"
+			;;
+		*interval*)
+			mode="-r 64 -D x=0:1 -D y=-1:2 bounds"
+			;;
+		*compile*)
+			mode="-D x=2 -D y=0.5 compile"
+			;;
+		*gradient*)
+			mode="-D x=2 -D y=0.5 --grad eval"
+			;;
+		*switch*)
+			mode="-D x=2 -D y=0.5 --switch-dispatch eval"
+			;;
+		*bindings*)
+			mode="-D x=2 -D y=0.5 eval"
+			;;
+		*exact*)
+			mode="-x eval"
+			;;
 		*eval*)
 			mode=eval
 			;;
+		*incremental*)
+			mode="-i simplify"
+			;;
+		*truncate*)
+			mode="-l 24 normalize"
+			;;
 	esac
 
-	./expr -f ${t} ${mode:-simplify} >${tmpfile}
+	output="${log}.out"
 
-	if ! diff -awB --strip-trailing-cr ${tmpfile} ${answer} >/dev/null 2>&1; then
-		echo "${name} failed:"
-		printf "Expected:\n\t%s\nFound:\n\t%s\n\n" "$(cat ${answer})" "$(cat ${tmpfile})"
+	start=$(date +%s%N)
+	./expr -f ${t} ${mode:-simplify} >${output} 2>${output}.err
+	code=$?
+	end=$(date +%s%N)
+
+	# @NOTE: Answer of cases stopped by limits ends with diagnostic and exit
+	# status as well
+	if [ -n "${verdict}" ]; then
+		cat ${output}.err >>${output}
+		echo "exit status ${code}" >>${output}
+	fi
+
+	rm ${output}.err
+
+	# @NOTE: Recorded trace must replay to the same result, its summary is
+	# part of the answer
+	if [ -f "${log}.trace" ]; then
+		./expr -f ${t} --replay=${log}.trace simplify >>${output} 2>/dev/null
+		./expr --trace-summary=${log}.trace >>${output} 2>/dev/null
+		rm "${log}.trace"
+	fi
+
+	status=passed
+	if ! diff -awB --strip-trailing-cr ${output} ${answer} >/dev/null 2>&1; then
+		status=failed
+		printf "Expected:\n\t%s\nFound:\n\t%s\n" "$(cat ${answer})" "$(cat ${output})" >${log}
+	fi
+
+	rm ${output}
+	printf "%s\t%s\t%d\n" "${name}" ${status} $(((end - start) / 1000))
+}
+
+# @NOTE: Cases are run by invoking this script again for each of them
+if [ "$1" = "--case" ]; then
+	run_case "$2" "$3"
+	exit 0
+fi
+
+jobs=$(nproc 2>/dev/null || echo 1)
+budget=1000
+report=test-report.tsv
+
+while getopts "j:t:o:" option; do
+	case "${option}" in
+		j)
+			jobs="${OPTARG}"
+			;;
+		t)
+			budget="${OPTARG}"
+			;;
+		o)
+			report="${OPTARG}"
+			;;
+		*)
+			echo "Usage: $0 [-j <jobs>] [-t <budget ms>] [-o <report>]" >&2
+			exit 2
+			;;
+	esac
+done; unset option
+
+readonly tmpdir="$(mktemp -d -q)"
+
+# @NOTE: Compiled expressions are cached apart from user cache
+export EXPR_CACHE="${tmpdir}/cache"
+
+# @NOTE: Build program first
+make -j
+
+suite_start=$(date +%s%N)
+
+find . -type f -iname '*-test' | sort | awk -v logs="${tmpdir}" '{
+	printf("%s\n%s/%d.log\n", $0, logs, NR);
+}' | xargs -n 2 -P ${jobs} sh "$0" --case >${tmpdir}/results
+
+# Run checking program as a case named after it, keeping its output in log
+programs=
+run_program() {
+	name="$1"
+	shift
+
+	programs="${programs} ${name}"
+
+	start=$(date +%s%N)
+	if "$@" >${tmpdir}/${name}.log 2>&1; then
+		status=passed
+		rm ${tmpdir}/${name}.log
 	else
-		passed=$(($passed+1))
+		status=failed
 	fi
-done; unset t
+	end=$(date +%s%N)
+	printf "%s\t%s\t%d\n" ${name} ${status} $(((end - start) / 1000)) >>${tmpdir}/results
+}
+
+# @NOTE: Transforms and printer are also checked against random expressions,
+# seeded the same each run
+run_program fuzz ./fuzz -n 2000 -j ${jobs}
+
+# @NOTE: Short requests must not allocate on the heap
+run_program alloc ./alloc
+
+# @NOTE: Expression is read from standard input which is not a terminal,
+# if neither file nor expression is given, even without any arguments
+run_program stdin sh -c "printf '(a - b) * (a + b)\n' | ./expr | grep -qxF 'a ^ 2 - b ^ 2'"
+
+# @NOTE: Long chains are parsed left-deep, so every command must walk them
+# in loops rather than nest a call per operand; each one must succeed
+awk 'BEGIN {
+	for (i = 0; i < 100000; ++i)
+		printf(i > 0 ? " + x%d" : "x", i % 7);
+	printf("\n");
+}' >${tmpdir}/sum
+
+awk 'BEGIN {
+	for (i = 0; i < 100000; ++i)
+		printf(i > 0 ? " * x%d" : "x", i % 7);
+	printf("\n");
+}' >${tmpdir}/product
+
+values=
+intervals=
+for symbol in x x0 x1 x2 x3 x4 x5 x6; do
+	values="${values} -D ${symbol}=1"
+	intervals="${intervals} -D ${symbol}=0:1"
+done; unset symbol
+
+for input in sum product; do
+	run_program chain-${input}-simplify ./expr -f ${tmpdir}/${input} simplify
+	run_program chain-${input}-expand ./expr -f ${tmpdir}/${input} expand
+	run_program chain-${input}-normalize ./expr -l 40 -f ${tmpdir}/${input} normalize
+	run_program chain-${input}-factor ./expr -l 40 -f ${tmpdir}/${input} factor
+	run_program chain-${input}-collect ./expr -l 40 -f ${tmpdir}/${input} collect
+	run_program chain-${input}-diff ./expr -l 40 -f ${tmpdir}/${input} diff x
+	run_program chain-${input}-eval ./expr ${values} -f ${tmpdir}/${input} eval
+	run_program chain-${input}-bounds ./expr ${intervals} -f ${tmpdir}/${input} bounds
+done; unset input values intervals
+
+suite_end=$(date +%s%N)
+
+sort ${tmpdir}/results >${tmpdir}/sorted
+printf "name\tstatus\tmicroseconds\n" >${report}
+cat ${tmpdir}/sorted >>${report}
+
+total=$(wc -l <${tmpdir}/sorted)
+passed=$(grep -c "	passed	" ${tmpdir}/sorted)
+
+# Print details of failures, cases are identified by their logs
+find . -type f -iname '*-test' | sort | awk '{ print NR, $0 }' >${tmpdir}/cases
+
+while read -r number t; do
+	log="${tmpdir}/${number}.log"
+	if [ -f ${log} ]; then
+		echo "${t##./tests/} failed:"
+		cat ${log}
+		echo
+	fi
+done <${tmpdir}/cases; unset number t
+
+for name in ${programs}; do
+	if [ -f ${tmpdir}/${name}.log ]; then
+		echo "${name} failed:"
+		cat ${tmpdir}/${name}.log
+		echo
+	fi
+done; unset name
+
+# @NOTE: Checking programs run many cases, so budget is for golden cases only
+awk -F '\t' -v budget=${budget} -v programs="${programs}" 'BEGIN {
+	split(programs, names, " ");
+	for (i in names)
+		program[names[i]] = 1;
+}
+!($1 in program) && $3 > budget * 1000 {
+	printf("%s is slow: %d ms, budget is %d ms\n", $1, $3 / 1000, budget);
+}' ${tmpdir}/sorted
+
+printf "\nSlowest:\n"
+sort -t "	" -k 3 -n -r ${tmpdir}/sorted | head -n 5 | awk -F '\t' '{
+	printf("\t%-56s %8d us\n", $1, $3);
+}'
+
+elapsed=$(((suite_end - suite_start) / 1000000))
 
-rm ${tmpfile}
+rm -r ${tmpdir}
 
 if [ ${passed} -eq ${total} ]; then
-	printf "\n◉ All ${total} tests passed!\n"
+	printf "\n◉ All ${total} tests passed in ${elapsed} ms with ${jobs} jobs!\n"
 	exit 0
 else
-	printf "\n○ ${passed}/${total} tests passed\n"
+	printf "\n○ ${passed}/${total} tests passed in ${elapsed} ms with ${jobs} jobs\n"
 	exit 1
 fi
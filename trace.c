@@ -0,0 +1,323 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "evaluator.h"
+
+// Subtree rewritten by events of trace, see trace_summary
+typedef struct trace_subtree {
+	uint64_t hash;
+	size_t count;
+	size_t first; // @NOTE: Index of first event rewriting subtree
+} TraceSubtree;
+
+static Rule rule_from_name(const char* const name);
+
+// Write path of event, . for the root
+static void path_write(const Trace* const trace,
+                       const TraceEvent* const event,
+                       FILE* const file);
+
+static int compare_subtrees_by_hash(const void* lhs, const void* rhs);
+static int compare_subtrees_by_count(const void* lhs, const void* rhs);
+
+void trace_deinit(Trace* const trace)
+{
+	assert(trace != NULL);
+
+	free(trace->events);
+	free(trace->steps);
+	free(trace->path);
+
+	*trace = Trace();
+}
+
+void trace_enter(Trace* const trace, const uint8_t operand)
+{
+	assert(trace != NULL);
+	assert(operand <= 1);
+
+	// @NOTE: Depth is counted even if memory is exhausted, so that leave
+	// matches enter
+	if (array_reserve((void**)&trace->path, &trace->path_capacity, trace->depth + 1, sizeof(uint8_t)))
+		trace->path[trace->depth] = operand;
+	else
+		trace->failed = true;
+
+	++trace->depth;
+}
+
+void trace_leave(Trace* const trace)
+{
+	assert(trace != NULL);
+	assert(trace->depth > 0);
+
+	--trace->depth;
+}
+
+void trace_record(Trace* const trace,
+                  const Rule rule,
+                  const uint64_t before,
+                  const uint64_t after)
+{
+	assert(trace != NULL);
+	assert(rule < Rule__count);
+
+	if (trace->depth > trace->path_capacity ||
+	    !array_reserve((void**)&trace->events, &trace->capacity, trace->count + 1, sizeof(TraceEvent)) ||
+	    !array_reserve((void**)&trace->steps, &trace->steps_capacity,
+	             trace->steps_length + trace->depth, sizeof(uint8_t))) {
+		trace->failed = true;
+		return;
+	}
+
+	if (trace->depth > 0)
+		memcpy(trace->steps + trace->steps_length, trace->path, trace->depth);
+
+	trace->events[trace->count++] = (TraceEvent){
+		rule, before, after, trace->steps_length, trace->depth
+	};
+
+	trace->steps_length += trace->depth;
+}
+
+void trace_write(const Trace* const trace, FILE* const file)
+{
+	assert(trace != NULL);
+	assert(file != NULL);
+
+	for (size_t i = 0; i < trace->count; ++i) {
+		const TraceEvent* const event = &trace->events[i];
+
+		fprintf(file, "%s ", RULE_NAME[event->rule]);
+		path_write(trace, event, file);
+		fprintf(file, " %016" PRIx64 " %016" PRIx64 "\n", event->before, event->after);
+	}
+}
+
+bool trace_read(Trace* const trace, FILE* const file)
+{
+	assert(trace != NULL && trace->count == 0);
+	assert(file != NULL);
+
+	bool result = true;
+
+	char* line = NULL;
+	size_t capacity = 0;
+	size_t number = 0;
+
+	while (getline(&line, &capacity, file) != -1) {
+		++number;
+
+		char* save = NULL;
+		const char* const name = strtok_r(line, " \t\r\n", &save);
+		const char* const path = strtok_r(NULL, " \t\r\n", &save);
+		const char* const before = strtok_r(NULL, " \t\r\n", &save);
+		const char* const after = strtok_r(NULL, " \t\r\n", &save);
+
+		if (name == NULL) // @NOTE: Blank line
+			continue;
+
+		const Rule rule = rule_from_name(name);
+
+		char* end_before = NULL;
+		char* end_after = NULL;
+
+		if (rule == Rule__count || path == NULL || before == NULL || after == NULL ||
+		    strtok_r(NULL, " \t\r\n", &save) != NULL ||
+		    strspn(path, strcmp(path, ".") == 0 ? "." : "01") != strlen(path) ||
+		    (strtoull(before, &end_before, 16), *end_before != '\0') ||
+		    (strtoull(after, &end_after, 16), *end_after != '\0')) {
+			LOGF("Invalid trace event at line %zu\n", number);
+			result = false;
+			break;
+		}
+
+		trace->depth = 0;
+
+		if (strcmp(path, ".") != 0) {
+			for (const char* step = path; *step != '\0'; ++step)
+				trace_enter(trace, (uint8_t)(*step - '0'));
+		}
+
+		trace_record(trace, rule, strtoull(before, NULL, 16), strtoull(after, NULL, 16));
+		trace->depth = 0;
+
+		if (trace->failed) {
+			LOG("Out of memory\n");
+			result = false;
+			break;
+		}
+	}
+
+	free(line);
+
+	return result;
+}
+
+bool trace_replay(const Trace* const trace, Expression** const expression)
+{
+	assert(trace != NULL);
+	assert(expression != NULL && *expression != NULL);
+
+	for (size_t i = 0; i < trace->count; ++i) {
+		const TraceEvent* const event = &trace->events[i];
+
+		// @NOTE: Nodes on the path are copied if they are shared, so that
+		// the rewrite doesn't change other places
+		Expression** slot = expression;
+
+		for (size_t j = 0; j < event->path_length && slot != NULL; ++j) {
+			const uint8_t operand = trace->steps[event->path + j];
+
+			if (!expression_unshare(slot))
+				slot = NULL;
+			else if ((*slot)->type == ExpressionType_Unary && operand == 0)
+				slot = &((UnaryExpression*)*slot)->subexpression;
+			else if ((*slot)->type == ExpressionType_Binary)
+				slot = operand == 0
+					? &((BinaryExpression*)*slot)->left
+					: &((BinaryExpression*)*slot)->right;
+			else
+				slot = NULL;
+		}
+
+		if (slot == NULL || expression_hash(*slot) != event->before) {
+			LOGF("Trace event %zu: %s doesn't find its node\n", i + 1, RULE_NAME[event->rule]);
+			return false;
+		}
+
+		if (!transform_rule(event->rule, slot) || expression_hash(*slot) != event->after) {
+			LOGF("Trace event %zu: %s rewrites its node differently\n", i + 1, RULE_NAME[event->rule]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void trace_summary(const Trace* const trace, FILE* const file)
+{
+	assert(trace != NULL);
+	assert(file != NULL);
+
+	size_t counts[Rule__count] = {0};
+	for (size_t i = 0; i < trace->count; ++i)
+		++counts[trace->events[i].rule];
+
+	size_t rules = 0;
+	Rule order[Rule__count];
+
+	// @NOTE: Insertion sort by descending count, rules of equal counts are
+	// in order of declaration
+	for (Rule rule = 0; rule < Rule__count; ++rule) {
+		if (counts[rule] == 0)
+			continue;
+
+		size_t j = rules++;
+		for (; j > 0 && counts[order[j - 1]] < counts[rule]; --j)
+			order[j] = order[j - 1];
+
+		order[j] = rule;
+	}
+
+	fprintf(file, "%zu rewrites by %zu rules\n", trace->count, rules);
+
+	if (rules > 0)
+		fprintf(file, "Rules:\n");
+
+	for (size_t i = 0; i < rules && i < TRACE_SUMMARY_TOP; ++i)
+		fprintf(file, "\t%-32s %zu\n", RULE_NAME[order[i]], counts[order[i]]);
+
+	if (trace->count == 0)
+		return;
+
+	TraceSubtree* const subtrees = malloc(trace->count * sizeof(TraceSubtree));
+	if (subtrees == NULL) {
+		LOG("Out of memory, subtrees are not summarised\n");
+		return;
+	}
+
+	for (size_t i = 0; i < trace->count; ++i)
+		subtrees[i] = (TraceSubtree){trace->events[i].before, 1, i};
+
+	// @NOTE: Events of equal subtrees are adjacent after sorting, in order
+	// of recording, and are merged into the first one
+	qsort(subtrees, trace->count, sizeof(TraceSubtree), compare_subtrees_by_hash);
+
+	size_t count = 0;
+
+	for (size_t i = 0; i < trace->count; ++i) {
+		if (count > 0 && subtrees[count - 1].hash == subtrees[i].hash)
+			++subtrees[count - 1].count;
+		else
+			subtrees[count++] = subtrees[i];
+	}
+
+	qsort(subtrees, count, sizeof(TraceSubtree), compare_subtrees_by_count);
+
+	fprintf(file, "Subtrees:\n");
+
+	for (size_t i = 0; i < count && i < TRACE_SUMMARY_TOP; ++i) {
+		fprintf(file, "\t%016" PRIx64 " %zu at ", subtrees[i].hash, subtrees[i].count);
+		path_write(trace, &trace->events[subtrees[i].first], file);
+		putc('\n', file);
+	}
+
+	free(subtrees);
+}
+
+static Rule rule_from_name(const char* const name)
+{
+	assert(name != NULL);
+
+	for (Rule rule = 0; rule < Rule__count; ++rule) {
+		if (strcmp(name, RULE_NAME[rule]) == 0)
+			return rule;
+	}
+
+	return Rule__count;
+}
+
+static void path_write(const Trace* const trace,
+                       const TraceEvent* const event,
+                       FILE* const file)
+{
+	assert(trace != NULL);
+	assert(event != NULL);
+
+	if (event->path_length == 0)
+		putc('.', file);
+
+	for (size_t i = 0; i < event->path_length; ++i)
+		putc('0' + trace->steps[event->path + i], file);
+}
+
+static int compare_subtrees_by_hash(const void* lhs, const void* rhs)
+{
+	const TraceSubtree* const left = lhs;
+	const TraceSubtree* const right = rhs;
+
+	if (left->hash != right->hash)
+		return left->hash < right->hash ? -1 : 1;
+
+	return left->first < right->first ? -1 : left->first > right->first;
+}
+
+// @NOTE: Descending count, then ascending first event, so order is stable
+static int compare_subtrees_by_count(const void* lhs, const void* rhs)
+{
+	const TraceSubtree* const left = lhs;
+	const TraceSubtree* const right = rhs;
+
+	if (left->count != right->count)
+		return left->count > right->count ? -1 : 1;
+
+	return left->first < right->first ? -1 : left->first > right->first;
+}
@@ -0,0 +1,73 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "parser.h"
+#include "transform.h"
+
+// Rules and subtrees listed by trace summary at most
+#define TRACE_SUMMARY_TOP 5
+
+// Rewrite of a single node by transformer of rule. Node is found by its
+// path from the root, which is a sequence of operand indices, 0 for left
+// or the only operand and 1 for right one.
+typedef struct trace_event {
+	Rule rule;
+	uint64_t before; // Structural hash of node before rewrite
+	uint64_t after;  // and after, see expression_hash
+	size_t path;     // @NOTE: Offset of path in steps of trace
+	size_t path_length;
+} TraceEvent;
+
+// Log of rewrites made by simplify_expression and expand_expression in
+// order, see TransformOptions. Paths of all events are kept in one array.
+typedef struct trace {
+	TraceEvent* events;
+	size_t count;
+	size_t capacity;
+	uint8_t* steps;
+	size_t steps_length;
+	size_t steps_capacity;
+	// Path of node being transformed while recording
+	uint8_t* path;
+	size_t depth;
+	size_t path_capacity;
+	bool failed; // Memory was exhausted, some events are missing
+} Trace;
+
+#define Trace() (Trace){NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, false}
+
+extern void trace_deinit(Trace* const trace);
+
+// Track path of node being transformed, operand is 0 or 1
+extern void trace_enter(Trace* const trace, const uint8_t operand);
+extern void trace_leave(Trace* const trace);
+
+// Record rewrite of node at the current path
+extern void trace_record(Trace* const trace,
+                         const Rule rule,
+                         const uint64_t before,
+                         const uint64_t after);
+
+// Write events one per line as rule name, path, hash before and after, the
+// path is . for the root
+extern void trace_write(const Trace* const trace, FILE* const file);
+
+// Read events written by trace_write into empty trace, return false and
+// report the line if it isn't a trace
+extern bool trace_read(Trace* const trace, FILE* const file);
+
+// Apply events of trace to expression in order, checking that every one
+// finds the node it was recorded at and rewrites it the same way. Return
+// false and report the first event which doesn't.
+extern bool trace_replay(const Trace* const trace, Expression** const expression);
+
+// Print count of rewrites by rule and subtrees rewritten most often, the
+// latter by structural hash and path of the first one
+extern void trace_summary(const Trace* const trace, FILE* const file);
+
+#endif // __TRACE_H__
@@ -1,97 +1,551 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "transform.h"
 
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "lexer.h"
+#include "symbol.h"
+#include "polynomial.h"
+#include "factor.h"
+#include "collect.h"
+#include "evaluator.h"
+#include "trace.h"
+#include "parallel.h"
+
+// Transformer builds rewritten node from the given one, assuming its
+// subexpressions were already transformed, or returns NULL if the node
+// isn't rewritten. Given node is not changed: operands which are kept are
+// shared by the result, so that a rewrite allocates new nodes only.
+//
+// @NOTE: Shared operands are under new nodes without source span, so that
+// every node reached from the root through nodes having a source span is
+// the transformed text of that span and is owned by its parent alone
+typedef Expression* (*Transformer)(Expression* const expression);
+
+typedef struct rule_transformer {
+	Rule rule;
+	Transformer transform;
+} RuleTransformer;
+
+// Clock is read once per this many nodes visited by transform walk
+#define TRANSFORM_CLOCK_INTERVAL 64
+
+// Size of expression tree, counted while it's transformed
+typedef struct tree_size {
+	size_t nodes;
+	size_t bytes;
+} TreeSize;
+
+// State of transform of one expression
+typedef struct transform_walk {
+	const RuleTransformer* transformers;
+	const TransformLimits* limits;
+	Trace* trace;       // @NOTE: NULL unless rewrites are recorded
+	bool counted;       // Whether size of tree is limited and counted
+	TreeSize size;      // Whole tree
+	uint64_t deadline;  // Milliseconds of monotonic clock, 0 for none
+	size_t visits;
+	TransformStatus status;
+	ParallelPool* pool;          // @NOTE: NULL unless walk is split
+	const ExpressionMap* splits; // Nodes whose operands are forked
+	const ExpressionMap* chains; // Operands per task of chains by their top nodes
+	size_t worker;               // Worker of pool running walk
+	ExpressionStack* spine;      // @NOTE: Chain nodes, see transform_tree
+} TransformWalk;
+
+// Transform of subtree with a walk of its own, run by a worker of pool
+typedef struct transform_task {
+	ParallelTask task;
+	Expression** slot;
+	TransformWalk walk;
+	TreeSize size;
+	bool result;
+} TransformTask;
+
+// Transform of right operands of consecutive nodes of chain, run by a worker
+// of pool as TransformTask
+typedef struct chain_task {
+	ParallelTask task;
+	BinaryExpression* node; // The first one, the others are its left operands
+	size_t count;
+	TransformWalk walk;
+	TreeSize size;
+	bool result;
+} ChainTask;
+
+// Operand of chain with operator joining it to the operands before it, the
+// first operand has the chain's + or * operator
+typedef struct chain_link {
+	Expression** slot;
+	TokenType operator;
+	bool atom; // @NOTE: Pending operand which is not a part of the chain
+} ChainLink;
+
+// State of balance of one expression, links of chains being rebuilt are
+// stacked in one array, as well as pending operands of the chain flattened
+typedef struct balance_walk {
+	size_t minimum;
+	ChainLink* links;
+	size_t length;
+	size_t capacity;
+	ChainLink* pending;
+	size_t depth;
+	size_t pending_capacity;
+} BalanceWalk;
+
+// Rewriter builds expression for polynomial, or returns NULL to keep the
+// expression it was converted from.
+typedef Expression* (*PolynomialRewriter)(const Polynomial* const polynomial,
+                                          const SymbolTable* const symbols,
+                                          void* const context);
+
+// State of rewrite of polynomial subexpressions of one expression
+typedef struct polynomial_walk {
+	const SymbolTable* symbols;
+	PolynomialRewriter rewriter;
+	void* context;
+	ExpressionStack* spine; // @NOTE: Chain nodes, see rewrite_polynomials_tree
+} PolynomialWalk;
 
 // @NOTE: Put transformer functions prototypes here
-static bool factor_difference_of_squares(Expression* const expression);
-static bool fold_multipliers_to_diff_of_squares(Expression* const expression);
-
-// Make deep copy of a given expression.
-static Expression* expression_copy(const Expression* const expression);
+static Expression* factor_difference_of_squares(Expression* const expression);
+static Expression* fold_multipliers_to_diff_of_squares(Expression* const expression);
+
+// @NOTE: Put simplification transformer functions here
+static const RuleTransformer SIMPLIFY_TRANSFORMERS[] = {
+	{Rule_FoldDifferenceOfSquares, fold_multipliers_to_diff_of_squares},
+	{Rule__count, NULL},
+};
+
+// @NOTE: Put expander transformer functions here
+static const RuleTransformer EXPAND_TRANSFORMERS[] = {
+	{Rule_FactorDifferenceOfSquares, factor_difference_of_squares},
+	{Rule__count, NULL},
+};
+
+const char* const RULE_NAME[Rule__count] = {
+	[Rule_FoldDifferenceOfSquares] = "fold-difference-of-squares",
+	[Rule_FactorDifferenceOfSquares] = "factor-difference-of-squares",
+	[Rule_NormalizePolynomial] = "normalize-polynomial",
+	[Rule_FactorPolynomial] = "factor-polynomial",
+	[Rule_CollectLikeTerms] = "collect-like-terms",
+};
+
+const char* const TRANSFORM_STATUS_NAME[TransformStatus__count] = {
+	[TransformStatus_Complete] = "complete",
+	[TransformStatus_NodeLimit] = "node limit reached",
+	[TransformStatus_MemoryLimit] = "memory limit reached",
+	[TransformStatus_TimeLimit] = "time limit reached",
+};
+
+static TransformStatus transform_bounded(Expression** const expression,
+                                         const RuleTransformer* const transformers,
+                                         const TransformOptions* const options);
+
+// Evaluate expression, see evaluate_expression; spine is shared by walks of
+// operands
+static double evaluate_chain(const Expression* const expression,
+                             ExpressionStack* const spine);
+static double evaluate_node(const Expression* const expression,
+                            ExpressionStack* const spine);
+static double evaluate_operation(const TokenType operator,
+                                 const double lhs,
+                                 const double rhs);
+
+static Rational evaluate_chain_exact(const Expression* const expression,
+                                     ExpressionStack* const spine);
+static Rational evaluate_node_exact(const Expression* const expression,
+                                    ExpressionStack* const spine);
+static Rational evaluate_operation_exact(const TokenType operator,
+                                         const Rational lhs,
+                                         const Rational rhs);
+
+// Apply transformers to every node of expression in slot, subexpressions
+// first, until a limit of walk is reached. Nodes on the path to a rewritten
+// one are copied if they are shared. Size of transformed expression is
+// returned in size.
+static bool transform_tree(Expression** const slot,
+                           TransformWalk* const walk,
+                           TreeSize* const size);
+
+// Transform operands of expression in slot, which is not walked as a part
+// of chain, and then the node itself, see transform_tree
+static bool transform_subtree(Expression** const slot,
+                              TransformWalk* const walk,
+                              TreeSize* const size);
+
+// Apply transformers to the node in slot, whose operands were transformed
+// to subtree of the given size and result
+static bool transform_visit(Expression** const slot,
+                            TransformWalk* const walk,
+                            const TreeSize subtree,
+                            const bool result,
+                            TreeSize* const size);
+
+// Count nodes of expression, which are shared if any of them is, and record
+// nodes whose operands both have at least grain nodes and none shared, and
+// top nodes of chains whose right operands have twice as many, with count
+// of operands per task; return false if memory is exhausted
+static bool transform_measure(const Expression* const expression,
+                              const size_t grain,
+                              ExpressionMap* const splits,
+                              ExpressionMap* const chains,
+                              ExpressionStack* const spine,
+                              size_t* const size,
+                              bool* const shared);
+
+// Measure node, which is not walked as a part of chain, see transform_measure
+static bool transform_measure_node(const Expression* const expression,
+                                   const size_t grain,
+                                   ExpressionMap* const splits,
+                                   ExpressionMap* const chains,
+                                   ExpressionStack* const spine,
+                                   size_t* const size,
+                                   bool* const shared);
+
+// Record chain whose right operands have the given count of nodes, if they
+// are split into tasks, see transform_measure
+static bool transform_measure_chain(const Expression* const top,
+                                    const size_t grain,
+                                    ExpressionMap* const chains,
+                                    const size_t operands,
+                                    const size_t nodes);
+
+// Transform operands of binary expression in slot by tasks
+static bool transform_fork(Expression** const slot,
+                           TransformWalk* const walk,
+                           TreeSize* const size);
+static void transform_run(ParallelTask* const task, const size_t worker);
+
+// Transform right operands of chain nodes on spine of walk from base by
+// tasks of the given count of them and then its bottom operand in slot,
+// while tasks run; return false if memory is exhausted and nothing was
+// transformed, otherwise set whether anything was rewritten in result
+static bool transform_chain(Expression** const bottom,
+                            const size_t base,
+                            const size_t operands,
+                            TransformWalk* const walk,
+                            TreeSize* const size,
+                            bool* const result);
+static void transform_chain_run(ParallelTask* const task, const size_t worker);
+
+// Transform operand of expression in slot, 0 for left or the only operand
+// and 1 for right one
+static bool transform_operand(Expression** const slot,
+                              const size_t index,
+                              TransformWalk* const walk,
+                              TreeSize* const size);
+
+// Return slot of operand of expression, see transform_operand
+static Expression** expression_operand(Expression* const expression, const size_t index);
+
+// Update status of walk by its limits after node was visited or rewritten
+static void transform_check(TransformWalk* const walk, const bool rewritten);
+
+static TreeSize tree_size(const Expression* expression);
+static size_t node_bytes(const Expression* const expression);
+static uint64_t clock_milliseconds(void);
+
+// Apply transformers to the node in slot only, replacing it with rewritten
+// ones, which record their rules; rewrites are recorded in trace, which may
+// be NULL.
+static bool transform_node(Expression** const slot,
+                           const RuleTransformer* const transformers,
+                           Trace* const trace);
+
+// Replace node in slot with its rewrite, which takes its place in source
+static void transform_replace(Expression** const slot,
+                              Expression* const rewritten,
+                              const Rule rule);
+
+// Intern symbols of expression in order of appearance; spine is shared by
+// walks of operands.
+static bool expression_collect_symbols(const Expression* const expression,
+                                       SymbolTable* const symbols,
+                                       ExpressionStack* const spine);
+static bool expression_collect_symbols_node(const Expression* const expression,
+                                            SymbolTable* const symbols,
+                                            ExpressionStack* const spine);
+
+// Rewrite largest polynomial subexpressions of expression.
+static void rewrite_polynomials(Expression** const expression,
+                                const PolynomialRewriter rewriter,
+                                void* const context);
+
+// Convert expression to polynomial, if it's one, otherwise rewrite its
+// largest polynomial subexpressions in place.
+static bool rewrite_polynomials_tree(Expression** const expression,
+                                     const PolynomialWalk* const walk,
+                                     Polynomial* const result);
+
+// Convert expression to polynomial as rewrite_polynomials_tree, assuming
+// its left operand isn't converted yet.
+static bool rewrite_polynomials_node(Expression** const expression,
+                                     const PolynomialWalk* const walk,
+                                     Polynomial* const result);
+
+// Combine polynomial of left operand of binary expression in result, if
+// it's one, with polynomial of its right operand into result, otherwise
+// rewrite them in place.
+static bool rewrite_polynomials_binary(Expression** const expression,
+                                       const PolynomialWalk* const walk,
+                                       const bool left_polynomial,
+                                       Polynomial* const result);
+
+// Replace expression with rewritten form of its polynomial.
+static void rewrite_polynomial(Expression** const expression,
+                               const SymbolTable* const symbols,
+                               const Polynomial* const polynomial,
+                               const PolynomialRewriter rewriter,
+                               void* const context);
+
+static Expression* normalize_polynomial(const Polynomial* const polynomial,
+                                        const SymbolTable* const symbols,
+                                        void* const context);
+static Expression* factor_polynomial(const Polynomial* const polynomial,
+                                     const SymbolTable* const symbols,
+                                     void* const context);
+
+// Collect like terms of sums in expression, innermost sums first; return
+// false if memory is exhausted.
+static bool collect_tree(Expression** expression);
+
+// Collect sums in operands of expression, except for nested sums of the
+// chain it's a part of, if chained is set.
+static bool collect_operands(Expression** const expression, const bool chained);
+
+// Check whether expression is a sum or a difference.
+static bool expression_sum(const Expression* const expression);
+
+// Rebalance chains of expression, innermost chains first; return false if
+// memory is exhausted.
+static bool balance_tree(Expression** const expression, BalanceWalk* const walk);
+
+// Append operands of chain at expression to links of walk in order.
+static bool balance_flatten(Expression** const expression, BalanceWalk* const walk);
+
+// Build balanced tree of links [begin, end), sharing their operands, or
+// return NULL if memory is exhausted.
+static Expression* balance_build(const ChainLink* const links,
+                                 const size_t begin,
+                                 const size_t end);
+
+// Check whether operator belongs to a chain of given operator: + and - to
+// one of sums, * and / to one of products.
+static bool chain_operator(const TokenType chain, const TokenType operator);
+
+// Grow array of links to hold at least count of them.
+static bool links_reserve(ChainLink** const links,
+                          size_t* const capacity,
+                          const size_t count);
+
+// Check whether number literal equals to integer, exactly if its exact
+// value is known.
+static bool literal_number_equal(const Literal* const literal,
+                                 const int64_t integer);
 
 // Compare two expressions, lhs and rhs and return true if two
 // expressions are identical, otherwise - false.
 static bool expression_equal(const Expression* const lhs,
                              const Expression* const rhs);
 
-void simplify_expression(Expression* const expression)
+void simplify_expression(Expression** const expression)
 {
-	assert(expression != NULL);
+	assert(expression != NULL && *expression != NULL);
 
-	// @NOTE: Put simplification transformer functions here
-	fold_multipliers_to_diff_of_squares(expression);
+	const TransformOptions options = TransformOptions();
+	transform_bounded(expression, SIMPLIFY_TRANSFORMERS, &options);
 }
 
-void expand_expression(Expression* const expression)
+void expand_expression(Expression** const expression)
 {
-	assert(expression != NULL);
+	assert(expression != NULL && *expression != NULL);
+
+	const TransformOptions options = TransformOptions();
+	transform_bounded(expression, EXPAND_TRANSFORMERS, &options);
+}
+
+TransformStatus simplify_expression_bounded(Expression** const expression,
+                                            const TransformOptions* const options)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(options != NULL);
+
+	return transform_bounded(expression, SIMPLIFY_TRANSFORMERS, options);
+}
+
+TransformStatus expand_expression_bounded(Expression** const expression,
+                                          const TransformOptions* const options)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(options != NULL);
+
+	return transform_bounded(expression, EXPAND_TRANSFORMERS, options);
+}
+
+void normalize_expression(Expression** const expression)
+{
+	assert(expression != NULL && *expression != NULL);
+	rewrite_polynomials(expression, normalize_polynomial, NULL);
+}
+
+void factor_expression(Expression** const expression)
+{
+	assert(expression != NULL && *expression != NULL);
+
+	FactorBudget budget = factor_budget_start();
+	rewrite_polynomials(expression, factor_polynomial, &budget);
+}
+
+void collect_expression(Expression** const expression)
+{
+	assert(expression != NULL && *expression != NULL);
+	collect_tree(expression);
+}
+
+void balance_expression(Expression** const expression, const size_t minimum)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(minimum >= 2);
+
+	BalanceWalk walk = {minimum, NULL, 0, 0, NULL, 0, 0};
+
+	balance_tree(expression, &walk);
+
+	free(walk.links);
+	free(walk.pending);
+}
+
+bool simplify_expression_node(Expression** const expression)
+{
+	assert(expression != NULL && *expression != NULL);
+	return transform_node(expression, SIMPLIFY_TRANSFORMERS, NULL);
+}
+
+bool expand_expression_node(Expression** const expression)
+{
+	assert(expression != NULL && *expression != NULL);
+	return transform_node(expression, EXPAND_TRANSFORMERS, NULL);
+}
+
+bool transform_rule(const Rule rule, Expression** const expression)
+{
+	assert(rule < Rule__count);
+	assert(expression != NULL && *expression != NULL);
+
+	const RuleTransformer* const tables[] = {SIMPLIFY_TRANSFORMERS, EXPAND_TRANSFORMERS};
 
-	// @NOTE: Put expander transformer functions here
-	factor_difference_of_squares(expression);
+	for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); ++i) {
+		for (const RuleTransformer* it = tables[i]; it->transform != NULL; ++it) {
+			if (it->rule == rule) {
+				Expression* const result = it->transform(*expression);
+				if (result == NULL)
+					return false;
+
+				transform_replace(expression, result, rule);
+				return true;
+			}
+		}
+	}
+
+	return false;
 }
 
 double evaluate_expression(const Expression* const expression)
 {
 	assert(expression != NULL);
 
-	switch (expression->type) {
-	case ExpressionType_Literal: {
-		Literal* const literal = (Literal*)expression;
+	ExpressionStack spine;
+	expression_stack_init(&spine);
 
-		if (literal->tag == LiteralTag_Number)
-			return literal->number;
-	} break;
+	const double result = evaluate_chain(expression, &spine);
 
-	case ExpressionType_Unary: {
-		UnaryExpression* const unary = (UnaryExpression*)expression;
+	expression_stack_deinit(&spine);
 
-		if (unary->operator == TokenType_Minus)
-			return -evaluate_expression(unary->subexpression);
+	return result;
+}
 
-		return evaluate_expression(unary->subexpression);
-	} break;
+double evaluate_power(const double base, const double exponent)
+{
+	if (exponent == 0.5)
+		return evaluate_square_root(base);
 
-	case ExpressionType_Binary: {
-		BinaryExpression* const binary = (BinaryExpression*)expression;
+	if (fabs(exponent) <= POWER_CHAIN_MAX && trunc(exponent) == exponent)
+		return evaluate_power_integer(base, (int)exponent);
+
+	return pow(base, exponent);
+}
 
-		switch (binary->operator) {
-		case TokenType_Plus:
-			return evaluate_expression(binary->left) +
-			       evaluate_expression(binary->right);
+// @NOTE: Chain rounds at every step, so it's exact to few ulps only while
+// result is normal; pow is correctly rounded beyond
+double evaluate_power_integer(const double base, const int exponent)
+{
+	const double chain = evaluate_power_chain(base, exponent < 0 ? -exponent : exponent);
+
+	if (isinf(chain))
+		return pow(base, exponent);
+
+	if (exponent >= 0)
+		return chain;
+
+	const double result = 1 / chain;
 
-		case TokenType_Minus:
-			return evaluate_expression(binary->left) -
-			       evaluate_expression(binary->right);
+	return fabs(result) < DBL_MIN ? pow(base, exponent) : result;
+}
 
-		case TokenType_Multiply:
-			return evaluate_expression(binary->left) *
-			       evaluate_expression(binary->right);
+// @NOTE: Code generated for compiled expressions multiplies in the same order
+double evaluate_power_chain(const double base, const int exponent)
+{
+	assert(exponent >= 0);
 
-		case TokenType_Divide:
-			return evaluate_expression(binary->left) /
-			       evaluate_expression(binary->right);
+	double result = 1;
+	double square = base;
+	bool first = true;
 
-		case TokenType_Exponent:
-			return pow(evaluate_expression(binary->left),
-			           evaluate_expression(binary->right));
+	for (int bits = exponent; bits > 0; bits >>= 1) {
+		if (bits & 1) {
+			result = first ? square : result * square;
+			first = false;
 		}
-	} break;
+
+		if (bits > 1)
+			square *= square;
 	}
 
-	// @NOTE: ExpressionType_Empty and LiteralTag_Symbol case
-	return 0;
+	return result;
+}
+
+double evaluate_square_root(const double base)
+{
+	// @NOTE: Adding zero turns -0 into +0 and keeps other values
+	return base == -INFINITY ? INFINITY : sqrt(base) + 0.0;
+}
+
+Rational evaluate_expression_exact(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	const Rational result = evaluate_chain_exact(expression, &spine);
+
+	expression_stack_deinit(&spine);
+
+	return result;
 }
 
 //
 // Expression transformers
 //
 
-// Transform expression to factor differences of squares and return
-// true if if differences of squared were found, false - otherwise.
+// Transform expression to factor differences of squares and return the
+// product if differences of squares were found, NULL - otherwise.
 //
 // Examples: a^2 - b^2 -> (a - b) * (a + b),
 //
@@ -112,7 +566,8 @@ double evaluate_expression(const Expression* const expression)
   A   2 B   2
 #endif
 // ..and tranform that subtree to this subtree below, where parentheses between
-// the operator means, that expression must be parenthesised.
+// the operator means, that expression must be parenthesised. Both A and B are
+// shared by the two factors.
 #if 0
        *
       / \
@@ -122,24 +577,14 @@ double evaluate_expression(const Expression* const expression)
   A   B A   B
 #endif
 // @NOTE: If statements were not flattened for relative clarity
-static bool factor_difference_of_squares(Expression* const expression)
+static Expression* factor_difference_of_squares(Expression* const expression)
 {
 	assert(expression != NULL);
 
 	switch (expression->type) {
-	// Try to find difference of squares in unary expression
-	case ExpressionType_Unary: {
-		UnaryExpression* const unary = (UnaryExpression*)expression;
-		return factor_difference_of_squares(unary->subexpression);
-	} break;
-
 	case ExpressionType_Binary: {
 		BinaryExpression* const binary = (BinaryExpression*)expression;
 
-		// Try to find difference of squares in the sides of binary expression first
-		const bool other_result = factor_difference_of_squares(binary->left) |
-		                          factor_difference_of_squares(binary->right);
-
 		// First step, find _difference_ of two expressions
 		if (binary->operator == TokenType_Minus) {
 			Expression* a = NULL;
@@ -160,7 +605,7 @@ static bool factor_difference_of_squares(Expression* const expression)
 						// specifically, number literal
 						if (number->tag == LiteralTag_Number) {
 							// specifically, with value of 2
-							if (fabs(number->number - 2.0) < DBL_EPSILON) {
+							if (literal_number_equal(number, 2)) {
 								lhs_pow_of_two = true;
 								a = lhs->left;
 							}
@@ -177,7 +622,7 @@ static bool factor_difference_of_squares(Expression* const expression)
 					if (rhs->right->type == ExpressionType_Literal) {
 						Literal* const number = (Literal*)rhs->right;
 						if (number->tag == LiteralTag_Number) {
-							if (fabs(number->number - 2.0) < DBL_EPSILON) {
+							if (literal_number_equal(number, 2)) {
 								rhs_pow_of_two = true;
 								b = rhs->left;
 							}
@@ -189,79 +634,51 @@ static bool factor_difference_of_squares(Expression* const expression)
 			// This is true when left and right differences
 			// are expressions "raise to power of two" respectively
 			if (lhs_pow_of_two && rhs_pow_of_two) {
-				// Change operator from subtraction to multiplication
-				binary->operator = TokenType_Multiply;
-
-				// Remove parentheses from factors
-				a->parenthesised = false;
-				b->parenthesised = false;
-
-				// Create new (A - B) expression, notice the copy
-				BinaryExpression* new_lhs = expression_binary_create(
-					TokenType_Minus, expression_copy(a), expression_copy(b));
-				// A - B subexpression must be parenthesised
-				new_lhs->base.parenthesised = true;
-
-				// Create new (A + B) expression, notice the copy
-				BinaryExpression* new_rhs = expression_binary_create(
-					TokenType_Plus, expression_copy(a), expression_copy(b));
-				// A + B subexpression must be parenthesised
-				new_rhs->base.parenthesised = true;
-
-				// Destroy old expressions
-				expression_destroy(&binary->left);
-				expression_destroy(&binary->right);
+				// Create new (A - B) expression, notice A and B are shared
+				Expression* const new_lhs = expression_binary_join(
+					TokenType_Minus, expression_retain(a), expression_retain(b));
 
-				// Assign the difference expression new left and right subexpressions
-				binary->left = (Expression*)new_lhs;
-				binary->right = (Expression*)new_rhs;
+				// Create new (A + B) expression
+				Expression* const new_rhs = expression_binary_join(
+					TokenType_Plus, expression_retain(a), expression_retain(b));
 
-				return true;
+				// Multiply them, replacing the difference
+				return expression_binary_join(TokenType_Multiply, new_lhs, new_rhs);
 			}
 		}
-
-		// Maybe the differences of squares were found deeper in the expression?
-		return other_result;
 	} break;
 	}
 
 	// Not found
-	return false;
+	return NULL;
 }
 
 // Transform expression to fold multiplication of terms back to differences of
-// squares and return true, if such subtree was found, false - otherwise.
+// squares and return the difference, if such subtree was found, NULL -
+// otherwise.
 //
 // Examples: (a - b) * (a + b) -> a^2 - b^2,
 //           (a - ((c - d) * (c + d))) * (a + ((c - d) * (c + d))) ->
 //        -> a ^ 2 * (c ^ 2 * d ^ 2) ^ 2
-static bool fold_multipliers_to_diff_of_squares(Expression* const expression)
+static Expression* fold_multipliers_to_diff_of_squares(Expression* const expression)
 {
 	assert(expression != NULL);
 
 	switch (expression->type) {
-	case ExpressionType_Unary: {
-		UnaryExpression* const unary = (UnaryExpression*)expression;
-		return fold_multipliers_to_diff_of_squares(unary->subexpression);
-	} break;
-
 	case ExpressionType_Binary: {
 		BinaryExpression* const binary = (BinaryExpression*)expression;
 
-		const bool other_result = fold_multipliers_to_diff_of_squares(binary->left) |
-		                          fold_multipliers_to_diff_of_squares(binary->right);
-
 		BinaryExpression* lhs = NULL;
 		BinaryExpression* rhs = NULL;
 
 		// Must be multiplication of factors
 		if (binary->operator != TokenType_Multiply)
-			return other_result;
+			return NULL;
 
 		// Factors must be binary operations
 		if (binary->left->type != ExpressionType_Binary ||
 		    binary->right->type != ExpressionType_Binary) {
-			return other_result;
+			return NULL;
 		}
 
 		lhs = (BinaryExpression*)binary->left;
@@ -270,110 +687,1458 @@ static bool fold_multipliers_to_diff_of_squares(Expression* const expression)
 		// Left factor must be a difference, right factor must be a sum
 		if (lhs->operator != TokenType_Minus ||
 		    rhs->operator != TokenType_Plus) {
-			return other_result;
+			return NULL;
 		}
 
-		// Left and right factors must be parenthesised
-		if (!lhs->base.parenthesised || !rhs->base.parenthesised)
-			return other_result;
-
 		// Subexpressions of factors must be the same
 		if (!expression_equal(lhs->left, rhs->left) ||
 		    !expression_equal(lhs->right, rhs->right)) {
-			return other_result;
+			return NULL;
 		}
 
-		binary->operator = TokenType_Minus;
-
-		BinaryExpression* const new_lhs = expression_binary_create(
+		// @NOTE: Terms of the difference factor are shared by the result
+		Expression* const new_lhs = expression_binary_join(
 			TokenType_Exponent,
-			expression_copy(lhs->left),
+			expression_retain(lhs->left),
 			(Expression*)expression_literal_create_number(2)
 		);
 
-		BinaryExpression* const new_rhs = expression_binary_create(
+		Expression* const new_rhs = expression_binary_join(
 			TokenType_Exponent,
-			expression_copy(lhs->right),
+			expression_retain(lhs->right),
 			(Expression*)expression_literal_create_number(2)
 		);
 
-		expression_destroy((Expression**)&lhs);
-		expression_destroy((Expression**)&rhs);
-
-		binary->left = (Expression*)new_lhs;
-		binary->right = (Expression*)new_rhs;
-
-		return true;
+		return expression_binary_join(TokenType_Minus, new_lhs, new_rhs);
 	} break;
 	}
 
-	return false;
+	return NULL;
 }
 
 //
 // Helper functions
 //
 
-static Expression* expression_copy(const Expression* const expression)
+// @NOTE: Left operands are walked down in a loop, so that long chains don't
+// nest calls, and operations are applied on the way back up, left to right
+static double evaluate_chain(const Expression* const expression,
+                             ExpressionStack* const spine)
 {
 	assert(expression != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom))
+		bottom = ((BinaryExpression*)bottom)->left;
 
-	Expression* result = NULL;
+	double result = evaluate_node(bottom, spine);
+
+	while (spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		result = evaluate_operation(binary->operator, result,
+		                            evaluate_chain(binary->right, spine));
+	}
+
+	return result;
+}
+
+static double evaluate_node(const Expression* const expression,
+                            ExpressionStack* const spine)
+{
+	assert(expression != NULL);
 
 	switch (expression->type) {
 	case ExpressionType_Literal: {
 		Literal* const literal = (Literal*)expression;
 
-		switch (literal->tag) {
-		case LiteralTag_Number:
-			result = (Expression*)expression_literal_create_number(literal->number);
-			break;
+		if (literal->tag == LiteralTag_Number)
+			return literal->number;
+	} break;
 
-		case LiteralTag_Symbol:
-			result = (Expression*)expression_literal_create_symbol(&literal->symbol);
-			break;
+	case ExpressionType_Unary: {
+		UnaryExpression* const unary = (UnaryExpression*)expression;
+
+		if (unary->operator == TokenType_Minus)
+			return -evaluate_chain(unary->subexpression, spine);
+
+		return evaluate_chain(unary->subexpression, spine);
+	} break;
+
+	case ExpressionType_Binary: {
+		BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		const double lhs = evaluate_chain(binary->left, spine);
+
+		return evaluate_operation(binary->operator, lhs,
+		                          evaluate_chain(binary->right, spine));
+	} break;
+	}
+
+	// @NOTE: ExpressionType_Empty and LiteralTag_Symbol case
+	return 0;
+}
+
+static double evaluate_operation(const TokenType operator,
+                                 const double lhs,
+                                 const double rhs)
+{
+	switch (operator) {
+	case TokenType_Plus:
+		return lhs + rhs;
+
+	case TokenType_Minus:
+		return lhs - rhs;
+
+	case TokenType_Multiply:
+		return lhs * rhs;
+
+	case TokenType_Divide:
+		return lhs / rhs;
+
+	case TokenType_Exponent:
+		return evaluate_power(lhs, rhs);
+	}
+
+	return 0;
+}
+
+// @NOTE: Chains are walked as by evaluate_chain, right operands of nodes
+// above inexact value are skipped
+static Rational evaluate_chain_exact(const Expression* const expression,
+                                     ExpressionStack* const spine)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom))
+		bottom = ((BinaryExpression*)bottom)->left;
+
+	Rational result = evaluate_node_exact(bottom, spine);
+
+	while (spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		if (rational_exact(result)) {
+			result = evaluate_operation_exact(binary->operator, result,
+			                                  evaluate_chain_exact(binary->right, spine));
 		}
+	}
+
+	return result;
+}
+
+static Rational evaluate_node_exact(const Expression* const expression,
+                                    ExpressionStack* const spine)
+{
+	assert(expression != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Number)
+			return literal->rational;
 	} break;
 
 	case ExpressionType_Unary: {
 		UnaryExpression* const unary = (UnaryExpression*)expression;
-		result = (Expression*)expression_unary_create(
-			unary->operator, expression_copy(unary->subexpression));
+
+		if (unary->operator == TokenType_Minus)
+			return rational_negate(evaluate_chain_exact(unary->subexpression, spine));
+
+		return evaluate_chain_exact(unary->subexpression, spine);
 	} break;
 
 	case ExpressionType_Binary: {
 		BinaryExpression* const binary = (BinaryExpression*)expression;
-		result = (Expression*)expression_binary_create(
-			binary->operator,
-			expression_copy(binary->left),
-			expression_copy(binary->right));
+
+		const Rational lhs = evaluate_chain_exact(binary->left, spine);
+		if (!rational_exact(lhs))
+			return RATIONAL_INEXACT;
+
+		return evaluate_operation_exact(binary->operator, lhs,
+		                                evaluate_chain_exact(binary->right, spine));
 	} break;
 	}
 
-	result->parenthesised = expression->parenthesised;
+	return RATIONAL_INEXACT;
+}
+
+static Rational evaluate_operation_exact(const TokenType operator,
+                                         const Rational lhs,
+                                         const Rational rhs)
+{
+	switch (operator) {
+	case TokenType_Plus:
+		return rational_add(lhs, rhs);
+
+	case TokenType_Minus:
+		return rational_subtract(lhs, rhs);
+
+	case TokenType_Multiply:
+		return rational_multiply(lhs, rhs);
+
+	case TokenType_Divide:
+		return rational_divide(lhs, rhs);
+
+	case TokenType_Exponent:
+		return rational_power(lhs, rhs);
+	}
+
+	return RATIONAL_INEXACT;
+}
+
+// @NOTE: Rewrites replace nodes, which are released as soon as nothing
+// shares them, so aborted walk leaves a whole tree, which is released as
+// usual
+static TransformStatus transform_bounded(Expression** const expression,
+                                         const RuleTransformer* const transformers,
+                                         const TransformOptions* const options)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(transformers != NULL);
+	assert(options != NULL);
+
+	const TransformLimits* const limits = &options->limits;
+
+	TransformWalk walk = {
+		.transformers = transformers,
+		.limits = limits,
+		.trace = options->trace,
+		.counted = limits->nodes > 0 || limits->bytes > 0,
+		.size = {0, 0},
+		.deadline = limits->milliseconds > 0
+			? clock_milliseconds() + limits->milliseconds
+			: 0,
+		.visits = 0,
+		.status = TransformStatus_Complete,
+		.pool = NULL,
+		.splits = NULL,
+		.chains = NULL,
+		.worker = 0,
+		.spine = NULL,
+	};
+
+	if (walk.counted)
+		walk.size = tree_size(*expression);
+
+	transform_check(&walk, true);
+
+	if (walk.status != TransformStatus_Complete)
+		return walk.status;
+
+	// @NOTE: Order of rewrites and sizes seen by limits would depend on
+	// workers, so limited and recorded transforms are sequential
+	ExpressionMap splits = ExpressionMap();
+	ExpressionMap chains = ExpressionMap();
+	size_t nodes = 0;
+	bool shared = false;
+
+	const size_t grain = options->grain > 0 ? options->grain : PARALLEL_GRAIN;
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	if (options->pool != NULL && !walk.counted && walk.deadline == 0 && walk.trace == NULL &&
+	    transform_measure(*expression, grain, &splits, &chains, &spine, &nodes, &shared) &&
+	    (splits.count > 0 || chains.count > 0)) {
+		walk.pool = options->pool;
+		walk.splits = &splits;
+		walk.chains = &chains;
+
+		TransformTask root = {{transform_run, 0}, expression, walk, {0, 0}, false};
+		parallel_pool_run(options->pool, &root.task);
+	}
+	else {
+		TreeSize size;
+		walk.spine = &spine;
+		transform_tree(expression, &walk, &size);
+	}
+
+	expression_stack_deinit(&spine);
+	expression_map_deinit(&splits);
+	expression_map_deinit(&chains);
+
+	return walk.status;
+}
+
+// @NOTE: Left operands owned by their nodes are walked down in a loop, so
+// that long chains don't nest calls, and the nodes are visited on the way
+// back up in the order of calls, as they would be by transform_subtree
+static bool transform_tree(Expression** const slot,
+                           TransformWalk* const walk,
+                           TreeSize* const size)
+{
+	assert(slot != NULL && *slot != NULL);
+	assert(walk != NULL && walk->spine != NULL);
+	assert(size != NULL);
+
+	ExpressionStack* const spine = walk->spine;
+	const size_t base = spine->count;
+
+	Trace* const trace = walk->trace;
+	Expression** bottom = slot;
+
+	while ((*bottom)->type == ExpressionType_Binary && !expression_shared(*bottom) &&
+	       (walk->splits == NULL ||
+	        expression_map_find(walk->splits, *bottom) == EXPRESSION_MAP_NONE) &&
+	       expression_stack_push(spine, *bottom)) {
+		if (trace != NULL)
+			trace_enter(trace, 0);
+
+		bottom = &((BinaryExpression*)*bottom)->left;
+	}
+
+	const size_t operands = spine->count > base && walk->chains != NULL
+		? expression_map_find(walk->chains, *slot)
+		: EXPRESSION_MAP_NONE;
+
+	bool result = false;
+
+	// @NOTE: Right operands of chain are transformed by tasks beforehand,
+	// then its nodes are visited as usual
+	const bool chained = operands != EXPRESSION_MAP_NONE &&
+	                     transform_chain(bottom, base, operands, walk, size, &result);
+
+	if (!chained)
+		result = transform_subtree(bottom, walk, size);
+
+	while (spine->count > base) {
+		--spine->count;
+
+		// @NOTE: Node is the left operand of the one below it on stack
+		Expression** const node = spine->count > base
+			? &((BinaryExpression*)spine->nodes[spine->count - 1])->left
+			: slot;
+
+		TreeSize subtree = {1 + size->nodes, node_bytes(*node) + size->bytes};
+		TreeSize operand = {0, 0};
+
+		if (trace != NULL) {
+			trace_leave(trace);
+			trace_enter(trace, 1);
+		}
+
+		if (walk->status == TransformStatus_Complete && !chained) {
+			result |= transform_operand(node, 1, walk, &operand);
+			subtree.nodes += operand.nodes;
+			subtree.bytes += operand.bytes;
+		}
+
+		if (trace != NULL)
+			trace_leave(trace);
+
+		result = transform_visit(node, walk, subtree, result, size);
+	}
 
 	return result;
 }
 
-static bool expression_equal(const Expression* const lhs,
-                             const Expression* const rhs)
+static bool transform_subtree(Expression** const slot,
+                              TransformWalk* const walk,
+                              TreeSize* const size)
 {
-	assert(lhs != NULL);
-	assert(rhs != NULL);
+	assert(slot != NULL && *slot != NULL);
+	assert(walk != NULL);
+	assert(size != NULL);
+
+	bool result = false;
+
+	// @NOTE: Sizes of operands are summed up here, so only rewritten nodes
+	// are counted again
+	TreeSize subtree = {1, node_bytes(*slot)};
+	TreeSize operand = {0, 0};
+
+	// @NOTE: Path is tracked only while recording, otherwise the cost of
+	// trace is a test per node
+	Trace* const trace = walk->trace;
+
+	switch ((*slot)->type) {
+	case ExpressionType_Unary:
+		if (trace != NULL)
+			trace_enter(trace, 0);
+
+		result = transform_operand(slot, 0, walk, &operand);
+		subtree.nodes += operand.nodes;
+		subtree.bytes += operand.bytes;
+
+		if (trace != NULL)
+			trace_leave(trace);
+		break;
+
+	case ExpressionType_Binary:
+		if (walk->splits != NULL && !expression_shared(*slot) &&
+		    expression_map_find(walk->splits, *slot) != EXPRESSION_MAP_NONE) {
+			result = transform_fork(slot, walk, &operand);
+			subtree.nodes += operand.nodes;
+			subtree.bytes += operand.bytes;
+			break;
+		}
 
-	if (lhs->type != rhs->type)
-		return false;
+		if (trace != NULL)
+			trace_enter(trace, 0);
 
-	switch (lhs->type) {
-	case ExpressionType_Literal: {
-		Literal* const lhs_literal = (Literal*)lhs;
-		Literal* const rhs_literal = (Literal*)rhs;
+		result = transform_operand(slot, 0, walk, &operand);
+		subtree.nodes += operand.nodes;
+		subtree.bytes += operand.bytes;
 
-		if (lhs_literal->tag != rhs_literal->tag)
-			return false;
+		if (trace != NULL) {
+			trace_leave(trace);
+			trace_enter(trace, 1);
+		}
+
+		if (walk->status == TransformStatus_Complete) {
+			result |= transform_operand(slot, 1, walk, &operand);
+			subtree.nodes += operand.nodes;
+			subtree.bytes += operand.bytes;
+		}
+
+		if (trace != NULL)
+			trace_leave(trace);
+		break;
+	}
+
+	return transform_visit(slot, walk, subtree, result, size);
+}
+
+static bool transform_visit(Expression** const slot,
+                            TransformWalk* const walk,
+                            const TreeSize subtree,
+                            const bool result,
+                            TreeSize* const size)
+{
+	assert(slot != NULL && *slot != NULL);
+	assert(walk != NULL);
+	assert(size != NULL);
+
+	*size = subtree;
+
+	if (walk->status != TransformStatus_Complete)
+		return result;
+
+	if (!transform_node(slot, walk->transformers, walk->trace)) {
+		transform_check(walk, false);
+		return result;
+	}
+
+	if (walk->counted) {
+		*size = tree_size(*slot);
+		walk->size.nodes = walk->size.nodes - subtree.nodes + size->nodes;
+		walk->size.bytes = walk->size.bytes - subtree.bytes + size->bytes;
+	}
+
+	transform_check(walk, true);
+
+	return true;
+}
+
+// @NOTE: Chains are walked down in a loop as by transform_tree, which stops
+// at split nodes, so the part of chain below one is a chain of its own, on
+// top of its left operand
+static bool transform_measure(const Expression* const expression,
+                              const size_t grain,
+                              ExpressionMap* const splits,
+                              ExpressionMap* const chains,
+                              ExpressionStack* const spine,
+                              size_t* const size,
+                              bool* const shared)
+{
+	assert(expression != NULL);
+	assert(spine != NULL);
+	assert(size != NULL);
+	assert(shared != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && !expression_shared(bottom) &&
+	       expression_stack_push(spine, bottom)) {
+		bottom = ((BinaryExpression*)bottom)->left;
+	}
+
+	bool result = transform_measure_node(bottom, grain, splits, chains, spine, size, shared);
+
+	// Right operands of chain nodes above the last split one
+	size_t operands = 0;
+	size_t nodes = 0;
+
+	while (result && spine->count > base) {
+		const Expression* const node = spine->nodes[--spine->count];
+
+		size_t rhs = 0;
+		bool rhs_shared = false;
+
+		result = transform_measure(((BinaryExpression*)node)->right, grain, splits, chains,
+		                           spine, &rhs, &rhs_shared);
+
+		const size_t lhs = *size;
+
+		*size = 1 + lhs + rhs;
+		*shared = *shared || rhs_shared;
+
+		if (result && !*shared && lhs >= grain && rhs >= grain) {
+			result = transform_measure_chain(((BinaryExpression*)node)->left, grain, chains,
+			                                 operands, nodes) &&
+			         expression_map_insert(splits, node, *size);
+
+			operands = 0;
+			nodes = 0;
+		}
+		else {
+			++operands;
+			nodes += rhs;
+		}
+	}
+
+	if (result && !*shared)
+		result = transform_measure_chain(expression, grain, chains, operands, nodes);
+
+	spine->count = base;
+
+	return result;
+}
+
+static bool transform_measure_node(const Expression* const expression,
+                                   const size_t grain,
+                                   ExpressionMap* const splits,
+                                   ExpressionMap* const chains,
+                                   ExpressionStack* const spine,
+                                   size_t* const size,
+                                   bool* const shared)
+{
+	assert(expression != NULL);
+	assert(splits != NULL);
+	assert(size != NULL);
+	assert(shared != NULL);
+
+	*size = 1;
+	*shared = expression_shared(expression);
+
+	// @NOTE: Nodes above shared one aren't split, so its size doesn't matter
+	if (*shared)
+		return true;
+
+	size_t lhs = 0;
+	size_t rhs = 0;
+	bool lhs_shared = false;
+	bool rhs_shared = false;
+
+	switch (expression->type) {
+	case ExpressionType_Unary:
+		if (!transform_measure(((UnaryExpression*)expression)->subexpression, grain,
+		                       splits, chains, spine, &lhs, shared)) {
+			return false;
+		}
+
+		*size += lhs;
+		break;
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+
+		if (!transform_measure(binary->left, grain, splits, chains, spine,
+		                       &lhs, &lhs_shared) ||
+		    !transform_measure(binary->right, grain, splits, chains, spine,
+		                       &rhs, &rhs_shared)) {
+			return false;
+		}
+
+		*size += lhs + rhs;
+		*shared = lhs_shared || rhs_shared;
+
+		if (!*shared && lhs >= grain && rhs >= grain)
+			return expression_map_insert(splits, expression, *size);
+	} break;
+	}
+
+	return true;
+}
+
+// @NOTE: Tasks take as many operands as have grain nodes on average, so
+// that chain of operands of one size is split evenly
+static bool transform_measure_chain(const Expression* const top,
+                                    const size_t grain,
+                                    ExpressionMap* const chains,
+                                    const size_t operands,
+                                    const size_t nodes)
+{
+	assert(top != NULL);
+	assert(chains != NULL);
+
+	if (operands < 2 || nodes < 2 * grain)
+		return true;
+
+	const size_t count = (size_t)((double)grain * (double)operands / (double)nodes);
+
+	return expression_map_insert(chains, top, count > 0 ? count : 1);
+}
+
+// @NOTE: Operands are owned by the node alone and share no nodes, so tasks
+// transform them at once, each with a copy of walk, which is not changed
+// as it has no limits and no trace. Rewrites of an operand depend on its
+// subtree only, so result is the same as of transform_operand.
+static bool transform_fork(Expression** const slot,
+                           TransformWalk* const walk,
+                           TreeSize* const size)
+{
+	assert(slot != NULL && *slot != NULL && (*slot)->type == ExpressionType_Binary);
+	assert(walk != NULL && walk->pool != NULL);
+	assert(size != NULL);
+
+	BinaryExpression* const binary = (BinaryExpression*)*slot;
+
+	TransformTask left = {{transform_run, 0}, &binary->left, *walk, {0, 0}, false};
+	TransformTask right = {{transform_run, 0}, &binary->right, *walk, {0, 0}, false};
+
+	parallel_fork(walk->pool, walk->worker, &left.task);
+	transform_run(&right.task, walk->worker);
+	parallel_join(walk->pool, walk->worker, &left.task);
+
+	size->nodes = left.size.nodes + right.size.nodes;
+	size->bytes = left.size.bytes + right.size.bytes;
+
+	return left.result || right.result;
+}
+
+static void transform_run(ParallelTask* const task, const size_t worker)
+{
+	TransformTask* const it = (TransformTask*)task;
+
+	// @NOTE: Task walks its subtree on a thread of its own
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	it->walk.worker = worker;
+	it->walk.spine = &spine;
+	it->result = transform_tree(it->slot, &it->walk, &it->size);
+
+	expression_stack_deinit(&spine);
+}
+
+// @NOTE: Right operands are owned by chain nodes alone and share no nodes,
+// and rewrites of one depend on its subtree only, so they are transformed
+// at once before nodes are visited, with the same result as of the walk up
+// the chain. Tasks find their nodes by left operands rather than on spine,
+// which grows while bottom is transformed. Size is the one of bottom and
+// all right operands, so that only the top node has its own size.
+static bool transform_chain(Expression** const bottom,
+                            const size_t base,
+                            const size_t operands,
+                            TransformWalk* const walk,
+                            TreeSize* const size,
+                            bool* const result)
+{
+	assert(bottom != NULL && *bottom != NULL);
+	assert(walk != NULL && walk->pool != NULL && walk->spine != NULL);
+	assert(operands > 0);
+	assert(size != NULL);
+	assert(result != NULL);
+
+	ExpressionStack* const spine = walk->spine;
+	const size_t nodes = spine->count - base;
+	const size_t count = (nodes + operands - 1) / operands;
+
+	ChainTask* const tasks = malloc(count * sizeof(ChainTask));
+	if (tasks == NULL)
+		return false;
+
+	for (size_t i = 0; i < count; ++i) {
+		tasks[i] = (ChainTask){
+			.task = {transform_chain_run, 0},
+			.node = (BinaryExpression*)spine->nodes[base + i * operands],
+			.count = i + 1 < count ? operands : nodes - i * operands,
+			.walk = *walk,
+			.size = {0, 0},
+			.result = false,
+		};
+
+		parallel_fork(walk->pool, walk->worker, &tasks[i].task);
+	}
+
+	*result = transform_subtree(bottom, walk, size);
+
+	// @NOTE: The last task forked is the first one on deque
+	for (size_t i = count; i-- > 0; ) {
+		parallel_join(walk->pool, walk->worker, &tasks[i].task);
+
+		size->nodes += tasks[i].size.nodes;
+		size->bytes += tasks[i].size.bytes;
+		*result = *result || tasks[i].result;
+	}
+
+	free(tasks);
+
+	return true;
+}
+
+static void transform_chain_run(ParallelTask* const task, const size_t worker)
+{
+	ChainTask* const it = (ChainTask*)task;
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	it->walk.worker = worker;
+	it->walk.spine = &spine;
+
+	BinaryExpression* node = it->node;
+
+	// @NOTE: Left operand of the last node is the next task's one or bottom
+	// of chain, which is changed meanwhile, so it's not read
+	for (size_t i = 0; i < it->count; ++i) {
+		if (i > 0)
+			node = (BinaryExpression*)node->left;
+
+		TreeSize operand = {0, 0};
+		it->result |= transform_tree(&node->right, &it->walk, &operand);
+
+		it->size.nodes += operand.nodes;
+		it->size.bytes += operand.bytes;
+	}
+
+	expression_stack_deinit(&spine);
+}
+
+// @NOTE: Operand of node owned by its slot alone is transformed in place.
+// Operand of shared node is transformed from another reference to it,
+// which makes it shared as well, and node is copied only if the operand
+// was rewritten.
+static bool transform_operand(Expression** const slot,
+                              const size_t index,
+                              TransformWalk* const walk,
+                              TreeSize* const size)
+{
+	assert(slot != NULL && *slot != NULL);
+
+	if (!expression_shared(*slot))
+		return transform_tree(expression_operand(*slot, index), walk, size);
+
+	Expression* rewritten = expression_retain(*expression_operand(*slot, index));
+
+	if (!transform_tree(&rewritten, walk, size) || !expression_unshare(slot)) {
+		expression_destroy(&rewritten);
+		return false;
+	}
+
+	// @NOTE: Node in slot is a copy now, which shares the old operand
+	Expression** const operand = expression_operand(*slot, index);
+
+	expression_destroy(operand);
+	*operand = rewritten;
+
+	return true;
+}
+
+static Expression** expression_operand(Expression* const expression, const size_t index)
+{
+	assert(expression != NULL);
+
+	if (expression->type == ExpressionType_Unary) {
+		assert(index == 0);
+		return &((UnaryExpression*)expression)->subexpression;
+	}
+
+	assert(expression->type == ExpressionType_Binary && index <= 1);
+
+	BinaryExpression* const binary = (BinaryExpression*)expression;
+
+	return index == 0 ? &binary->left : &binary->right;
+}
+
+static void transform_check(TransformWalk* const walk, const bool rewritten)
+{
+	assert(walk != NULL);
+
+	const TransformLimits* const limits = walk->limits;
+
+	if (limits->nodes > 0 && walk->size.nodes > limits->nodes)
+		walk->status = TransformStatus_NodeLimit;
+	else if (limits->bytes > 0 && walk->size.bytes > limits->bytes)
+		walk->status = TransformStatus_MemoryLimit;
+	else if (walk->deadline > 0 &&
+	         (rewritten || ++walk->visits % TRANSFORM_CLOCK_INTERVAL == 0) &&
+	         clock_milliseconds() > walk->deadline)
+		walk->status = TransformStatus_TimeLimit;
+}
+
+static bool transform_node(Expression** const slot,
+                           const RuleTransformer* const transformers,
+                           Trace* const trace)
+{
+	assert(slot != NULL && *slot != NULL);
+	assert(transformers != NULL);
+
+	bool result = false;
+
+	// @NOTE: Hash after a rewrite is the hash before the next one, the first
+	// one is taken only once node is rewritten, as hashing a subtree takes
+	// its size and long chains would hash every suffix
+	uint64_t hash = 0;
+
+	for (const RuleTransformer* it = transformers; it->transform != NULL; ++it) {
+		Expression* const rewritten = it->transform(*slot);
+		if (rewritten == NULL)
+			continue;
+
+		if (trace != NULL && !result)
+			hash = expression_hash(*slot);
+
+		transform_replace(slot, rewritten, it->rule);
+		result = true;
+
+		if (trace != NULL) {
+			const uint64_t after = expression_hash(*slot);
+			trace_record(trace, it->rule, hash, after);
+			hash = after;
+		}
+	}
+
+	return result;
+}
+
+static void transform_replace(Expression** const slot,
+                              Expression* const rewritten,
+                              const Rule rule)
+{
+	assert(slot != NULL && *slot != NULL);
+	assert(rewritten != NULL && rewritten->references == 1);
+
+	rewritten->parenthesised = (*slot)->parenthesised;
+	rewritten->rules = (*slot)->rules | RULE_BIT(rule);
+	rewritten->begin = (*slot)->begin;
+	rewritten->end = (*slot)->end;
+
+	expression_destroy(slot);
+	*slot = rewritten;
+}
+
+// @NOTE: Left operands and subexpressions are walked in a loop, so that
+// long chains don't nest calls
+static TreeSize tree_size(const Expression* expression)
+{
+	assert(expression != NULL);
+
+	TreeSize result = {0, 0};
+
+	for (;;) {
+		result.nodes += 1;
+		result.bytes += node_bytes(expression);
+
+		if (expression->type == ExpressionType_Unary) {
+			expression = ((UnaryExpression*)expression)->subexpression;
+			continue;
+		}
+
+		if (expression->type != ExpressionType_Binary)
+			return result;
+
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		const TreeSize operand = tree_size(binary->right);
+
+		result.nodes += operand.nodes;
+		result.bytes += operand.bytes;
+
+		expression = binary->left;
+	}
+}
+
+static size_t node_bytes(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal:
+		return sizeof(Literal);
+
+	case ExpressionType_Unary:
+		return sizeof(UnaryExpression);
+
+	case ExpressionType_Binary:
+		return sizeof(BinaryExpression);
+	}
+
+	return sizeof(Expression);
+}
+
+static uint64_t clock_milliseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// @NOTE: Left operands are walked down in a loop, so that long chains don't
+// nest calls, and symbols are interned on the way back up in order of
+// appearance
+static bool expression_collect_symbols(const Expression* const expression,
+                                       SymbolTable* const symbols,
+                                       ExpressionStack* const spine)
+{
+	assert(expression != NULL);
+	assert(symbols != NULL);
+	assert(spine != NULL);
+
+	const size_t base = spine->count;
+	const Expression* bottom = expression;
+
+	while (bottom->type == ExpressionType_Binary && expression_stack_push(spine, bottom))
+		bottom = ((BinaryExpression*)bottom)->left;
+
+	bool result = expression_collect_symbols_node(bottom, symbols, spine);
+
+	while (spine->count > base) {
+		const BinaryExpression* const binary = (BinaryExpression*)spine->nodes[--spine->count];
+
+		if (result)
+			result = expression_collect_symbols(binary->right, symbols, spine);
+	}
+
+	return result;
+}
+
+static bool expression_collect_symbols_node(const Expression* const expression,
+                                            SymbolTable* const symbols,
+                                            ExpressionStack* const spine)
+{
+	assert(expression != NULL);
+	assert(symbols != NULL);
+	assert(spine != NULL);
+
+	switch (expression->type) {
+	case ExpressionType_Literal: {
+		const Literal* const literal = (Literal*)expression;
+
+		if (literal->tag == LiteralTag_Symbol)
+			return symbol_table_intern(symbols, &literal->symbol) != SYMBOL_NONE;
+	} break;
+
+	case ExpressionType_Unary: {
+		const UnaryExpression* const unary = (UnaryExpression*)expression;
+		return expression_collect_symbols(unary->subexpression, symbols, spine);
+	}
+
+	case ExpressionType_Binary: {
+		const BinaryExpression* const binary = (BinaryExpression*)expression;
+		return expression_collect_symbols(binary->left, symbols, spine) &&
+		       expression_collect_symbols(binary->right, symbols, spine);
+	}
+	}
+
+	return true;
+}
+
+static void rewrite_polynomials(Expression** const expression,
+                                const PolynomialRewriter rewriter,
+                                void* const context)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(rewriter != NULL);
+
+	SymbolTable symbols = SymbolTable();
+
+	ExpressionStack spine;
+	expression_stack_init(&spine);
+
+	if (expression_collect_symbols(*expression, &symbols, &spine)) {
+		const PolynomialWalk walk = {&symbols, rewriter, context, &spine};
+		Polynomial polynomial;
+
+		if (rewrite_polynomials_tree(expression, &walk, &polynomial))
+			rewrite_polynomial(expression, &symbols, &polynomial, rewriter, context);
+
+		polynomial_deinit(&polynomial);
+	}
+
+	expression_stack_deinit(&spine);
+	symbol_table_deinit(&symbols);
+}
+
+// @NOTE: Polynomials of subexpressions are combined bottom-up, so that
+// every node is converted once; those which can't be combined are
+// rewritten. Left operands are walked down in a loop, so that long chains
+// don't nest calls, and combined on the way back up.
+static bool rewrite_polynomials_tree(Expression** const expression,
+                                     const PolynomialWalk* const walk,
+                                     Polynomial* const result)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(walk != NULL && walk->spine != NULL);
+	assert(result != NULL);
+
+	ExpressionStack* const spine = walk->spine;
+	const size_t base = spine->count;
+
+	Expression** bottom = expression;
+
+	// @NOTE: Operands are rewritten in place, so shared nodes are copied
+	// on the way down
+	while ((*bottom)->type == ExpressionType_Binary && expression_unshare(bottom) &&
+	       expression_stack_push(spine, *bottom)) {
+		bottom = &((BinaryExpression*)*bottom)->left;
+	}
+
+	bool polynomial = rewrite_polynomials_node(bottom, walk, result);
+
+	while (spine->count > base) {
+		--spine->count;
+
+		// @NOTE: Node is the left operand of the one below it on stack
+		Expression** const node = spine->count > base
+			? &((BinaryExpression*)spine->nodes[spine->count - 1])->left
+			: expression;
+
+		polynomial = rewrite_polynomials_binary(node, walk, polynomial, result);
+	}
+
+	return polynomial;
+}
+
+static bool rewrite_polynomials_node(Expression** const expression,
+                                     const PolynomialWalk* const walk,
+                                     Polynomial* const result)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(walk != NULL);
+	assert(result != NULL);
+
+	*result = Polynomial(walk->symbols->count);
+
+	if ((*expression)->type != ExpressionType_Literal && !expression_unshare(expression))
+		return false;
+
+	switch ((*expression)->type) {
+	case ExpressionType_Literal:
+		return polynomial_from_expression(*expression, walk->symbols, result);
+
+	case ExpressionType_Unary: {
+		UnaryExpression* const unary = (UnaryExpression*)*expression;
+
+		if (!rewrite_polynomials_tree(&unary->subexpression, walk, result))
+			return false;
+
+		if (unary->operator != TokenType_Minus ||
+		    polynomial_scale(result, rational_integer(-1))) {
+			return true;
+		}
+
+		polynomial_deinit(result);
+		return false;
+	}
+
+	case ExpressionType_Binary: {
+		BinaryExpression* const binary = (BinaryExpression*)*expression;
+
+		const bool left_polynomial = rewrite_polynomials_tree(&binary->left, walk, result);
+		return rewrite_polynomials_binary(expression, walk, left_polynomial, result);
+	}
+	}
+
+	return false;
+}
+
+static bool rewrite_polynomials_binary(Expression** const expression,
+                                       const PolynomialWalk* const walk,
+                                       const bool left_polynomial,
+                                       Polynomial* const result)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert((*expression)->type == ExpressionType_Binary);
+	assert(walk != NULL);
+	assert(result != NULL);
+
+	BinaryExpression* const binary = (BinaryExpression*)*expression;
+
+	Polynomial left = *result;
+	Polynomial right;
+
+	const bool right_polynomial = rewrite_polynomials_tree(&binary->right, walk, &right);
+
+	*result = Polynomial(walk->symbols->count);
+
+	const bool success = left_polynomial && right_polynomial &&
+	                     polynomial_operate(binary->operator, &left, &right, result);
+
+	if (!success) {
+		polynomial_deinit(result);
+
+		if (left_polynomial)
+			rewrite_polynomial(&binary->left, walk->symbols, &left, walk->rewriter, walk->context);
+
+		if (right_polynomial)
+			rewrite_polynomial(&binary->right, walk->symbols, &right, walk->rewriter, walk->context);
+	}
+
+	polynomial_deinit(&left);
+	polynomial_deinit(&right);
+
+	return success;
+}
+
+static void rewrite_polynomial(Expression** const expression,
+                               const SymbolTable* const symbols,
+                               const Polynomial* const polynomial,
+                               const PolynomialRewriter rewriter,
+                               void* const context)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(symbols != NULL);
+	assert(polynomial != NULL);
+
+	// @NOTE: Literals are in normal form already
+	if ((*expression)->type == ExpressionType_Literal)
+		return;
+
+	Expression* const result = rewriter(polynomial, symbols, context);
+	if (result == NULL)
+		return;
+
+	expression_destroy(expression);
+	*expression = result;
+}
+
+static Expression* normalize_polynomial(const Polynomial* const polynomial,
+                                        const SymbolTable* const symbols,
+                                        void* const context)
+{
+	(void)context;
+
+	Expression* const result = polynomial_to_expression(polynomial, symbols);
+	if (result != NULL)
+		result->rules |= RULE_BIT(Rule_NormalizePolynomial);
+
+	return result;
+}
+
+static Expression* factor_polynomial(const Polynomial* const polynomial,
+                                     const SymbolTable* const symbols,
+                                     void* const context)
+{
+	assert(context != NULL);
+
+	Expression* const result = polynomial_factor(polynomial, symbols, (FactorBudget*)context);
+	if (result != NULL)
+		result->rules |= RULE_BIT(Rule_FactorPolynomial);
+
+	return result;
+}
+
+// @NOTE: Nested and negated sums are parts of the chain, see
+// collect_like_terms, which is collected at its root once. Operands of
+// other binary nodes are independent, so their right operands are collected
+// first and left ones are walked down in a loop, so that long products
+// don't nest calls.
+static bool collect_tree(Expression** expression)
+{
+	assert(expression != NULL && *expression != NULL);
+
+	while ((*expression)->type == ExpressionType_Binary && !expression_sum(*expression)) {
+		if (!expression_unshare(expression) ||
+		    !collect_tree(&((BinaryExpression*)*expression)->right)) {
+			return false;
+		}
+
+		expression = &((BinaryExpression*)*expression)->left;
+	}
+
+	const bool sum = expression_sum(*expression);
+
+	if (!collect_operands(expression, sum))
+		return false;
+
+	if (!sum)
+		return true;
+
+	Expression* const collected = collect_like_terms(*expression);
+	if (collected != NULL)
+		transform_replace(expression, collected, Rule_CollectLikeTerms);
+
+	return true;
+}
+
+// @NOTE: Long sums are parsed into left-deep chains, so left operands of
+// sums are walked in a loop. Operands are collected in place, so shared
+// nodes are copied on the way down.
+static bool collect_operands(Expression** const expression, const bool chained)
+{
+	assert(expression != NULL && *expression != NULL);
+
+	Expression** operand = expression;
+
+	for (; expression_sum(*operand); operand = &((BinaryExpression*)*operand)->left) {
+		if (!expression_unshare(operand) ||
+		    !collect_operands(&((BinaryExpression*)*operand)->right, true)) {
+			return false;
+		}
+	}
+
+	switch ((*operand)->type) {
+	case ExpressionType_Unary: {
+		if (!expression_unshare(operand))
+			return false;
+
+		Expression** const subexpression = &((UnaryExpression*)*operand)->subexpression;
+
+		return chained && expression_sum(*subexpression)
+			? collect_operands(subexpression, true)
+			: collect_tree(subexpression);
+	}
+
+	case ExpressionType_Binary: {
+		if (!expression_unshare(operand))
+			return false;
+
+		BinaryExpression* const binary = (BinaryExpression*)*operand;
+
+		return collect_tree(&binary->left) && collect_tree(&binary->right);
+	}
+	}
+
+	return true;
+}
+
+static bool expression_sum(const Expression* const expression)
+{
+	assert(expression != NULL);
+
+	if (expression->type != ExpressionType_Binary)
+		return false;
+
+	const TokenType operator = ((BinaryExpression*)expression)->operator;
+
+	return operator == TokenType_Plus || operator == TokenType_Minus;
+}
+
+// @NOTE: Every chain is flattened once at its root, operands of chains are
+// balanced in place before the chain is rebuilt around them
+static bool balance_tree(Expression** const expression, BalanceWalk* const walk)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(walk != NULL);
+
+	if ((*expression)->type == ExpressionType_Unary) {
+		return expression_unshare(expression) &&
+		       balance_tree(&((UnaryExpression*)*expression)->subexpression, walk);
+	}
+
+	if ((*expression)->type != ExpressionType_Binary)
+		return true;
+
+	// @NOTE: Exponent is right associative and makes no chain
+	if (((BinaryExpression*)*expression)->operator == TokenType_Exponent) {
+		if (!expression_unshare(expression))
+			return false;
+
+		BinaryExpression* const binary = (BinaryExpression*)*expression;
+
+		return balance_tree(&binary->left, walk) && balance_tree(&binary->right, walk);
+	}
+
+	const size_t begin = walk->length;
+
+	bool result = balance_flatten(expression, walk);
+
+	for (size_t i = begin; result && i < walk->length; ++i)
+		result = balance_tree(walk->links[i].slot, walk);
+
+	if (result && walk->length - begin >= walk->minimum) {
+		Expression* const balanced = balance_build(walk->links, begin, walk->length);
+
+		if (balanced != NULL) {
+			balanced->parenthesised = (*expression)->parenthesised;
+			balanced->rules = (*expression)->rules;
+			balanced->begin = (*expression)->begin;
+			balanced->end = (*expression)->end;
+
+			expression_destroy(expression);
+			*expression = balanced;
+		}
+
+		result = balanced != NULL;
+	}
+
+	walk->length = begin;
+
+	return result;
+}
+
+// @NOTE: Long chains are left-deep, so they are walked with a stack of
+// pending operands instead of recursion. Right operand of - or / is printed
+// in parentheses, so it's an operand of its own rather than a part of the
+// chain, and chain nodes are copied if shared, since their operands are
+// balanced in place.
+static bool balance_flatten(Expression** const expression, BalanceWalk* const walk)
+{
+	assert(expression != NULL && *expression != NULL);
+	assert(walk != NULL && walk->depth == 0);
+
+	const TokenType chain = ((BinaryExpression*)*expression)->operator;
+	const TokenType first = chain == TokenType_Plus || chain == TokenType_Minus
+		? TokenType_Plus
+		: TokenType_Multiply;
+
+	if (!links_reserve(&walk->pending, &walk->pending_capacity, 1))
+		return false;
+
+	walk->pending[walk->depth++] = (ChainLink){expression, first, false};
+
+	while (walk->depth > 0) {
+		const ChainLink link = walk->pending[--walk->depth];
+		Expression** const slot = link.slot;
+
+		if (!link.atom && (*slot)->type == ExpressionType_Binary &&
+		    chain_operator(chain, ((BinaryExpression*)*slot)->operator)) {
+			if (!expression_unshare(slot) ||
+			    !links_reserve(&walk->pending, &walk->pending_capacity, walk->depth + 2)) {
+				walk->depth = 0;
+				return false;
+			}
+
+			BinaryExpression* const binary = (BinaryExpression*)*slot;
+
+			// @NOTE: Right operand is pushed first to come out second
+			walk->pending[walk->depth++] = (ChainLink){
+				&binary->right, binary->operator,
+				binary->operator == TokenType_Minus || binary->operator == TokenType_Divide
+			};
+			walk->pending[walk->depth++] = (ChainLink){&binary->left, link.operator, false};
+
+			continue;
+		}
+
+		if (!links_reserve(&walk->links, &walk->capacity, walk->length + 1)) {
+			walk->depth = 0;
+			return false;
+		}
+
+		walk->links[walk->length++] = (ChainLink){slot, link.operator, true};
+	}
+
+	return true;
+}
+
+// @NOTE: Range is split at + or * closest to its middle, which joins the
+// parts as they are printed. Range without such operators is built
+// left-deep, as it was parsed.
+static Expression* balance_build(const ChainLink* const links,
+                                 const size_t begin,
+                                 const size_t end)
+{
+	assert(links != NULL);
+	assert(begin < end);
+
+	const size_t middle = begin + (end - begin) / 2;
+
+	// @NOTE: Candidates are middle, then right and left of it in turn
+	for (size_t distance = 0; distance < end - begin; ++distance) {
+		for (size_t side = 0; side < 2; ++side) {
+			if (side == 1 && distance > middle - begin)
+				continue;
+
+			const size_t split = side == 0 ? middle + distance : middle - distance;
+
+			if (split <= begin || split >= end ||
+			    (links[split].operator != TokenType_Plus &&
+			     links[split].operator != TokenType_Multiply)) {
+				continue;
+			}
+
+			return expression_binary_join(links[split].operator,
+			                              balance_build(links, begin, split),
+			                              balance_build(links, split, end));
+		}
+	}
+
+	Expression* result = expression_retain(*links[begin].slot);
+
+	for (size_t i = begin + 1; i < end; ++i)
+		result = expression_binary_join(links[i].operator, result, expression_retain(*links[i].slot));
+
+	return result;
+}
+
+static bool chain_operator(const TokenType chain, const TokenType operator)
+{
+	switch (chain) {
+	case TokenType_Plus:
+	case TokenType_Minus:
+		return operator == TokenType_Plus || operator == TokenType_Minus;
+
+	case TokenType_Multiply:
+	case TokenType_Divide:
+		return operator == TokenType_Multiply || operator == TokenType_Divide;
+	}
+
+	return false;
+}
+
+static bool links_reserve(ChainLink** const links,
+                          size_t* const capacity,
+                          const size_t count)
+{
+	assert(links != NULL);
+	assert(capacity != NULL);
+
+	if (count <= *capacity)
+		return true;
+
+	size_t grown = *capacity > 0 ? *capacity : 64;
+	while (grown < count)
+		grown *= 2;
+
+	ChainLink* const result = realloc(*links, grown * sizeof(ChainLink));
+	if (result == NULL)
+		return false;
+
+	*links = result;
+	*capacity = grown;
+
+	return true;
+}
+
+static bool literal_number_equal(const Literal* const literal,
+                                 const int64_t integer)
+{
+	assert(literal != NULL && literal->tag == LiteralTag_Number);
+
+	if (rational_exact(literal->rational))
+		return rational_equal(literal->rational, rational_integer(integer));
+
+	return fabs(literal->number - (double)integer) < DBL_EPSILON;
+}
+
+static bool expression_equal(const Expression* const lhs,
+                             const Expression* const rhs)
+{
+	assert(lhs != NULL);
+	assert(rhs != NULL);
+
+	if (lhs->type != rhs->type)
+		return false;
+
+	switch (lhs->type) {
+	case ExpressionType_Literal: {
+		Literal* const lhs_literal = (Literal*)lhs;
+		Literal* const rhs_literal = (Literal*)rhs;
+
+		if (lhs_literal->tag != rhs_literal->tag)
+			return false;
+
+		switch (lhs_literal->tag) {
+		case LiteralTag_Number:
+			// Exact values are compared when both are known
+			if (rational_exact(lhs_literal->rational) &&
+			    rational_exact(rhs_literal->rational)) {
+				return rational_equal(lhs_literal->rational, rhs_literal->rational);
+			}
 
-		switch (lhs_literal->tag) {
-		case LiteralTag_Number:
 			if (fabs(lhs_literal->number - rhs_literal->number) < DBL_EPSILON)
 				return true;
 			break;
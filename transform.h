@@ -3,15 +3,151 @@
 
 #include "parser.h"
 
+// Integer powers up to this exponent magnitude are multiplication chains
+#define POWER_CHAIN_MAX 8
+
+// Chains of this many operands at least are rebalanced in results of
+// transforms printed by the program, see balance_expression
+#define BALANCE_CHAIN_MIN 32
+
+// Rewrite rules of transforms, nodes record which rules rewrote them
+typedef enum rule {
+	Rule_FoldDifferenceOfSquares,
+	Rule_FactorDifferenceOfSquares,
+	Rule_NormalizePolynomial,
+	Rule_FactorPolynomial,
+	Rule_CollectLikeTerms,
+	Rule__count,
+} Rule;
+
+#define RULE_BIT(rule) ((uint32_t)1 << (rule))
+
+extern const char* const RULE_NAME[Rule__count];
+
 typedef enum transform_mode {
 	TransformMode_Simplify,
 	TransformMode_Expand,
+	TransformMode_Normalize,
+	TransformMode_Factor,
+	TransformMode_Collect,
+	TransformMode_Differentiate,
 	TransformMode_Evaluate,
+	TransformMode_Bound,
+	TransformMode_Compile,
 } TransformMode;
 
-extern void simplify_expression(Expression* const expression);
-extern void expand_expression(Expression* const expression);
+// Limits of simplify and expand for one expression, 0 for no limit; shared
+// nodes are counted at every place they appear in the tree
+typedef struct transform_limits {
+	size_t nodes;        // Nodes of expression tree at most
+	size_t bytes;        // Bytes of expression nodes at most
+	size_t milliseconds; // Wall time of transform at most
+} TransformLimits;
+
+#define TransformLimits() (TransformLimits){0, 0, 0}
+
+struct trace;
+struct parallel_pool;
+
+// Options of simplify and expand for one expression. Operands of nodes are
+// transformed in parallel by tasks of pool, if both have at least grain
+// nodes and no shared ones, and so are right operands of chains, by about
+// grain nodes per task; result is the same as of sequential transform.
+// Transforms which are limited or recorded are not split, see parallel.h
+typedef struct transform_options {
+	TransformLimits limits;
+	struct trace* trace;        // Rewrites are recorded here, if it's not NULL, see trace.h
+	struct parallel_pool* pool; // @NOTE: NULL for sequential transform
+	size_t grain;               // 0 for PARALLEL_GRAIN
+} TransformOptions;
+
+#define TransformOptions() (TransformOptions){TransformLimits(), NULL, NULL, 0}
+
+typedef enum transform_status {
+	TransformStatus_Complete,
+	TransformStatus_NodeLimit,
+	TransformStatus_MemoryLimit,
+	TransformStatus_TimeLimit,
+	TransformStatus__count,
+} TransformStatus;
+
+extern const char* const TRANSFORM_STATUS_NAME[TransformStatus__count];
+
+// Simplify or expand expression, which may be replaced as a whole. Nodes
+// are never changed while they are shared: rewritten ones are replaced
+// together with the path to them, and operands kept by rewrites are shared,
+// so that other owners of expression see it unchanged.
+extern void simplify_expression(Expression** const expression);
+extern void expand_expression(Expression** const expression);
+
+// Simplify or expand expression until a limit of options is reached. Size
+// of tree is checked after every rewrite and time every few nodes. Walk
+// stops at the first limit reached, leaving expression rewritten up to that
+// point, which is equal to the original one and is the best result found.
+//
+// @NOTE: Rewrite which exceeds a limit is kept, so partial result may have
+// more nodes or bytes than limits, by as many as the last rewrite added
+// together with copies of shared nodes made for it.
+extern TransformStatus simplify_expression_bounded(Expression** const expression,
+                                                   const TransformOptions* const options);
+extern TransformStatus expand_expression_bounded(Expression** const expression,
+                                                 const TransformOptions* const options);
+
+// Rewrite largest polynomial subexpressions with exact coefficients as sums
+// of monomials in normal form, so that equal polynomials print equally;
+// expression may be replaced as a whole
+extern void normalize_expression(Expression** const expression);
+
+// Rewrite largest polynomial subexpressions with exact coefficients as
+// products of their factors over integers, see polynomial_factor
+extern void factor_expression(Expression** const expression);
+
+// Collect like terms of every sum, see collect_like_terms; expression may
+// be replaced as a whole
+extern void collect_expression(Expression** const expression);
+
+// Rebuild chains of + and - and of * and / having at least minimum operands
+// as trees of logarithmic depth, which print as the chains did. Chains are
+// split at + and * only, so that the right part keeps its text, and runs
+// of - and / stay left-deep. Inner nodes of rebuilt chains have no source
+// span and record no rules; expression may be replaced as a whole.
+//
+// @NOTE: Regrouped chains round and are rewritten differently, so it's not
+// applied before commands, but by parallel evaluation, see parallel.h
+extern void balance_expression(Expression** const expression, const size_t minimum);
+
+// Apply simplification or expansion to the given node only, assuming its
+// subexpressions are already transformed, return true if node was replaced
+extern bool simplify_expression_node(Expression** const expression);
+extern bool expand_expression_node(Expression** const expression);
+
+// Apply transformer of rule to the given node only, return true if node was
+// changed; polynomial and like terms rules rewrite whole subtrees and are
+// never applied
+extern bool transform_rule(const Rule rule, Expression** const expression);
 
 extern double evaluate_expression(const Expression* const expression);
 
+// Power as of pow, but with small integer exponents computed by chains of
+// multiplications, see evaluate_power_integer, and exponent 0.5 by square
+// root. Exponents 0, 1, 2, -1 and 0.5 give correctly rounded results,
+// others may differ from pow by few ulps.
+extern double evaluate_power(const double base, const double exponent);
+
+// Power by integer exponent as of evaluate_power: chain of multiplications,
+// or its reciprocal for negative exponent, or pow where chain overflows or
+// its reciprocal underflows to zero or a subnormal
+extern double evaluate_power_integer(const double base, const int exponent);
+
+// Power by binary exponentiation, squaring base from lowest bit of exponent
+extern double evaluate_power_chain(const double base, const int exponent);
+
+// Square root as of pow with exponent 0.5, which is +0 at -0 and +inf at
+// -inf unlike sqrt
+extern double evaluate_square_root(const double base);
+
+// Evaluate expression with exact rational arithmetic, result is inexact if
+// expression has symbols or can't be computed exactly
+extern Rational evaluate_expression_exact(const Expression* const expression);
+
 #endif // __TRANSFORM_H__